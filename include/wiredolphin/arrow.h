@@ -0,0 +1,78 @@
+/**
+ * \file arrow.h
+ * \brief Columnar export of the decoded headers (Arrow IPC stream).
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * The decoded fields of the packets are gathered in column vectors and
+ * written, one batch of ARROW_BATCH_ROWS packets at a time, as the record
+ * batches of an Arrow IPC stream, which dataframe libraries load as is
+ * (pyarrow.ipc.open_stream, polars.read_ipc_stream, ...). The flatbuffer
+ * metadata is built here: there is no dependency.
+ *
+ * Columns, null when the field is absent:
+ * - time: timestamp[us, tz=UTC].
+ * - interface: uint8, interface number.
+ * - length: uint32, original length.
+ * - packet_type: uint16, Ethernet packet type (after the VLAN tags).
+ * - vlan: uint16, VLAN ID of the outermost tag.
+ * - src_addr, dest_addr: fixed_size_binary[16], IPv6 addresses, IPv4
+ *   mapped (::ffff:a.b.c.d) ones for IPv4.
+ * - protocol: uint8, IP protocol.
+ * - src_port, dest_port: uint16, TCP and UDP ports.
+ * - tcp_flags: uint8.
+ * - dhcp_type: uint8, DHCP message type.
+ *
+ * The column buffers are allocated once, when the output is opened.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __ARROW_H__
+#define __ARROW_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "wiredolphin/packet.h"
+
+#define ARROW_BATCH_ROWS    16384   /**< Packets per record batch. */
+
+/**
+ * \brief Set the output file.
+ * \param path File path, "-" for stdout (NULL to disable the export).
+ */
+void arrow_set_path (const char * path);
+
+/**
+ * \brief Check whether the headers are exported.
+ * \retval true If a file is set.
+ * \retval false otherwise.
+ */
+bool arrow_enabled (void);
+
+/**
+ * \brief Open the output, allocate the columns and write the schema.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+bool arrow_open (void);
+
+/**
+ * \brief Add a packet to the current batch, written once full.
+ * \param info Decoded packet.
+ */
+void arrow_packet (const packet_info * info);
+
+/**
+ * \brief Write the last batch and the end of stream, close the output.
+ */
+void arrow_close (void);
+
+#endif /* __ARROW_H__ */
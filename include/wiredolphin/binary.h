@@ -0,0 +1,162 @@
+/**
+ * \file binary.h
+ * \brief Binary records of the decoded packets.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * Instead of printing the packets, their decoded fields are written as
+ * fixed-layout, length-prefixed records: the text is only built by
+ * wiredolphin-render, if someone reads it. A record holds the verbose mode
+ * level the packet would have been printed at, the timestamp as a delta to
+ * the previous record (absolute when the delta does not fit), the addresses,
+ * ports, flags and the offsets of the headers, the payload and the DHCP
+ * options, followed by the captured bytes, which the printers need to
+ * render the exact same text.
+ *
+ * Records are in host byte order: the file header tells readers the order it
+ * was written in.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __BINARY_H__
+#define __BINARY_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include <pcap/pcap.h>
+
+#include "wiredolphin/packet.h"
+#include "wiredolphin/callback.h"
+
+#define BINARY_MAGIC        0x52424457u /**< "WDBR" in host byte order. */
+#define BINARY_VERSION      1           /**< Layout version. */
+
+#define BINARY_ABSOLUTE     0x01    /**< An absolute timestamp follows. */
+#define BINARY_MALFORMED    0x02    /**< Truncated or invalid headers. */
+
+/**
+ * \brief File header.
+ */
+typedef struct binary_file_header
+{
+    u_int32_t magic;            /**< BINARY_MAGIC. */
+    u_int16_t version;          /**< BINARY_VERSION. */
+    u_int16_t record_size;      /**< Size of binary_record. */
+    u_int32_t linktype;         /**< Link type. */
+    u_int32_t snaplen;          /**< Snapshot length. */
+} binary_file_header;
+
+/**
+ * \brief Record header, followed by the absolute timestamp (u_int64_t
+ * microseconds, if BINARY_ABSOLUTE) and the captured bytes.
+ */
+typedef struct binary_record
+{
+    u_int32_t length;           /**< Record length, this header included. */
+    u_int32_t delta;            /**< Microseconds since the previous record. */
+    u_int32_t len;              /**< Original length. */
+    u_int32_t caplen;           /**< Captured length. */
+    u_int16_t packet_type;      /**< Ethernet packet type. */
+    u_int8_t protocol;          /**< IP protocol. */
+    u_int8_t level;             /**< Verbose mode level. */
+    u_int8_t application;       /**< Application. */
+    u_int8_t tcp_flags;         /**< TCP flags. */
+    u_int8_t interface;         /**< Interface number. */
+    u_int8_t flags;             /**< BINARY_ABSOLUTE, BINARY_MALFORMED. */
+    u_int16_t src_port;         /**< Source port. */
+    u_int16_t dest_port;        /**< Destination port. */
+    u_int16_t network;          /**< Network header offset (0 if none). */
+    u_int16_t transport;        /**< Transport header offset (0 if none). */
+    u_int16_t data;             /**< Payload offset (0 if none). */
+    u_int16_t options;          /**< DHCP options offset (0 if none). */
+    u_int8_t src_mac[6];        /**< Source MAC address. */
+    u_int8_t dest_mac[6];       /**< Destination MAC address. */
+    struct in6_addr src_addr;   /**< Source address. */
+    struct in6_addr dest_addr;  /**< Destination address. */
+} binary_record;
+
+/**
+ * \brief Reader state.
+ */
+typedef struct binary_reader
+{
+    FILE * stream;              /**< Input. */
+    binary_file_header header;  /**< File header. */
+    u_int64_t time;             /**< Timestamp of the last record (us). */
+    u_char * bytes;             /**< Captured bytes of the last record. */
+    size_t size;                /**< Size of bytes. */
+    bool failed;                /**< A record could not be read. */
+} binary_reader;
+
+/**
+ * \brief Set the output file.
+ * \param path File path, "-" for stdout (NULL to print the packets).
+ */
+void binary_set_path (const char * path);
+
+/**
+ * \brief Check whether records are written instead of text.
+ * \retval true If a file is set.
+ * \retval false otherwise.
+ */
+bool binary_enabled (void);
+
+/**
+ * \brief Open the output and write the file header.
+ * \param capture Capture.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+bool binary_open (pcap_t * capture);
+
+/**
+ * \brief Write the record of a packet.
+ * \param info Decoded packet.
+ * \param level Verbose mode level it would be printed at.
+ */
+void binary_packet (const packet_info * info, callback_level level);
+
+/**
+ * \brief Flush and close the output.
+ */
+void binary_close (void);
+
+/**
+ * \brief Start reading records.
+ * \param reader Reader.
+ * \param stream Input.
+ * \retval true On success.
+ * \retval false If the input is not a binary record file (a message is
+ * printed).
+ */
+bool binary_reader_open (binary_reader * reader, FILE * stream);
+
+/**
+ * \brief Read the next record.
+ * \param reader Reader.
+ * \param record Record header.
+ * \param header pcap header of the packet.
+ * \param bytes Captured bytes, valid until the next call.
+ * \retval true On success.
+ * \retval false At the end of the input or on error (failed is set and a
+ * message is printed).
+ */
+bool binary_reader_next (binary_reader * reader, binary_record * record,
+        struct pcap_pkthdr * header, const u_char ** bytes);
+
+/**
+ * \brief Release a reader (the stream is left open).
+ * \param reader Reader.
+ */
+void binary_reader_close (binary_reader * reader);
+
+#endif /* __BINARY_H__ */
@@ -133,4 +133,13 @@ typedef enum dhcp_message_type
  */
 const char * dhcp_message_type_string (dhcp_message_type type);
 
+/**
+ * \brief Get the DHCP message type of a BOOTP packet.
+ * \param bytes BOOTP header.
+ * \param limit Byte following the last captured byte.
+ * \return Message type, 0 if the packet is not a (complete) DHCP message.
+ */
+dhcp_message_type dhcp_message_type_get (const u_int8_t * bytes,
+        const u_int8_t * limit);
+
 #endif /* __BOOTP_H__ */
@@ -24,6 +24,29 @@
 
 #include "wiredolphin/headers.h"
 #include "wiredolphin/bootp.h"
+#include "wiredolphin/dns.h"
+
+/**
+ * \brief Verbosity levels.
+ */
+typedef enum callback_level
+{
+    CALLBACK_RAW = 0,       /**< callback_raw_packet. */
+    CALLBACK_CONCISE,       /**< callback_info_concise. */
+    CALLBACK_SYNTHETIC,     /**< callback_info_synthetic. */
+    CALLBACK_COMPLETE,      /**< callback_info_complete. */
+    CALLBACK_STATS,         /**< callback_stats. */
+    CALLBACK_LEVEL_COUNT,
+} callback_level;
+
+/**
+ * \brief Get the callback of a verbosity level.
+ * \param level Verbosity level.
+ * \return Callback.
+ *
+ * The callbacks print to the stream given as user parameter (stdout if NULL).
+ */
+pcap_handler callback_handler (callback_level level);
 
 /**
  * \brief Merely print a packet.
@@ -61,4 +84,13 @@ void callback_info_synthetic (u_char * user, const struct pcap_pkthdr * header,
 void callback_info_complete (u_char * user, const struct pcap_pkthdr * header,
     const u_char * bytes);
 
+/**
+ * \brief Print nothing, the capture layer only updates the statistics.
+ * \param user Additional user parameters.
+ * \param header pcap header.
+ * \param bytes Data.
+ */
+void callback_stats (u_char * user, const struct pcap_pkthdr * header,
+    const u_char * bytes);
+
 #endif /* __CALLBACK_H__ */
@@ -23,6 +23,32 @@
 #include <pcap/pcap.h>
 
 #include "wiredolphin/callback.h"
+#include "wiredolphin/packet.h"
+#include "wiredolphin/stats.h"
+#include "wiredolphin/sampling.h"
+#include "wiredolphin/limit.h"
+#include "wiredolphin/repeat.h"
+#include "wiredolphin/trigger.h"
+#include "wiredolphin/writer.h"
+#include "wiredolphin/split.h"
+#include "wiredolphin/sidecar.h"
+#include "wiredolphin/merge.h"
+#include "wiredolphin/follow.h"
+#include "wiredolphin/input.h"
+#include "wiredolphin/view.h"
+#include "wiredolphin/binary.h"
+#include "wiredolphin/arrow.h"
+#include "wiredolphin/json.h"
+#include "wiredolphin/compress.h"
+#include "wiredolphin/shared.h"
+#include "wiredolphin/metrics.h"
+#include "wiredolphin/top.h"
+#include "wiredolphin/rollup.h"
+#include "wiredolphin/distribution.h"
+#include "wiredolphin/tcpflow.h"
+#include "wiredolphin/dnsstat.h"
+#include "wiredolphin/profile.h"
+#include "wiredolphin/probes.h"
 
 /**
  * \brief Check whether an interface is available.
@@ -39,6 +65,18 @@ bool check_interface (const char * interface);
  */
 void monitor_interface (const char * interface, const char * filter);
 
+/**
+ * \brief Monitor several interfaces at once using a filter.
+ * \param interfaces Interface names.
+ * \param count Number of interfaces (at most STATS_INTERFACES_MAX).
+ * \param filter Filter.
+ *
+ * Packets are read from whichever interface is ready, in batches, and
+ * accounted for together.
+ */
+void monitor_interfaces (char * const * interfaces, size_t count,
+        const char * filter);
+
 /**
  * \brief Monitor an offline capture file using a filter.
  * \param file Offline capture file.
@@ -46,16 +84,38 @@ void monitor_interface (const char * interface, const char * filter);
  */
 void monitor_file (const char * file, const char * filter);
 
+/**
+ * \brief Monitor several offline capture files as one, in timestamp order.
+ * \param files Offline capture files.
+ * \param count Number of files.
+ * \param filter Filter.
+ */
+void monitor_files (char * const * files, size_t count, const char * filter);
+
+/**
+ * \brief Monitor an offline capture file as it grows, until interrupted.
+ * \param file Offline capture file.
+ * \param filter Filter.
+ */
+void monitor_follow (const char * file, const char * filter);
+
 /**
  * \brief Set the callback.
  * \param id
  *
  * Valid values for id:
+ * 0 -> Raw callback
  * 1 -> Concise callback
  * 2 -> Synthetic callback
  * 3 -> Complete callback
- * 4 -> Raw callback
+ * 4 -> Statistics only
  */
 void set_callback (unsigned int id);
 
+/**
+ * \brief Print the statistics at the end of the capture.
+ * \param statistics Whether to print the statistics.
+ */
+void set_statistics (bool statistics);
+
 #endif /* __CAPTURE_H__ */
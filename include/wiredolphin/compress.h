@@ -0,0 +1,62 @@
+/**
+ * \file compress.h
+ * \brief Compression of the standard output.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * The standard output is turned into a pipe, read by a thread of its own
+ * that cuts what is printed into frames of COMPRESS_FRAME_SIZE bytes (less
+ * after a second without output), compresses each frame on its own with zstd
+ * or lz4 and writes it to the original standard output. The capture thread
+ * only writes into the pipe.
+ *
+ * Frames are complete zstd or lz4 frames: the output is a valid file for
+ * zstdcat or lz4cat, and can be decompressed from any frame on.
+ *
+ * Available methods depend on the build (make WITH_ZSTD=1 WITH_LZ4=1).
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __COMPRESS_H__
+#define __COMPRESS_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#define COMPRESS_FRAME_SIZE (4 * 1024 * 1024)   /**< Bytes per frame. */
+
+/**
+ * \brief Set the compression method.
+ * \param method "zstd" or "lz4".
+ * \retval true On success.
+ * \retval false If the method is unknown or was left out of the build.
+ */
+bool compress_set_method (const char * method);
+
+/**
+ * \brief List the methods of the build.
+ * \return Comma separated methods, "none" if there is none.
+ */
+const char * compress_methods (void);
+
+/**
+ * \brief Redirect the standard output to the compression thread.
+ * \retval true On success (or if no method is set).
+ * \retval false otherwise.
+ */
+bool compress_open (void);
+
+/**
+ * \brief Flush the standard output, compress the last frame and restore the
+ * standard output.
+ */
+void compress_close (void);
+
+#endif /* __COMPRESS_H__ */
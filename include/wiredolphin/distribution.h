@@ -0,0 +1,77 @@
+/**
+ * \file distribution.h
+ * \brief Frame size, inter-arrival and burst distributions.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * Every received packet is recorded into log-linear histograms (see
+ * histogram.h), one set per application (packet_application, the port
+ * class), merged into the totals when printed:
+ *
+ * - the frame sizes (bytes, on the wire);
+ * - the gaps between the consecutive packets of a flow (microseconds);
+ * - the length of the bursts of a flow (packets): runs of packets less than
+ *   a gap apart, recorded when they end.
+ *
+ * Flows are tracked in a bounded flow table (one direction each): when it is
+ * full, the least recently used flow ends its burst and makes room. The
+ * percentiles are printed at the end of the capture.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __DISTRIBUTION_H__
+#define __DISTRIBUTION_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "wiredolphin/packet.h"
+
+#define DISTRIBUTION_GAP_DEFAULT    100     /**< Burst gap (us). */
+#define DISTRIBUTION_FLOWS          65536   /**< Flows tracked. */
+
+/**
+ * \brief Record the distributions.
+ * \param gap Largest gap within a burst (us).
+ */
+void distribution_set_gap (unsigned int gap);
+
+/**
+ * \brief Check whether the distributions are recorded.
+ * \retval true If they are.
+ * \retval false otherwise.
+ */
+bool distribution_enabled (void);
+
+/**
+ * \brief Allocate the flow table.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+bool distribution_open (void);
+
+/**
+ * \brief Record a packet.
+ * \param info Decoded packet.
+ */
+void distribution_packet (const packet_info * info);
+
+/**
+ * \brief End the bursts in progress and release the flow table.
+ */
+void distribution_close (void);
+
+/**
+ * \brief Print the percentiles.
+ * \param stream Output stream.
+ */
+void distribution_print (FILE * stream);
+
+#endif /* __DISTRIBUTION_H__ */
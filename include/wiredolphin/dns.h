@@ -0,0 +1,156 @@
+/**
+ * \file dns.h
+ * \brief DNS.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * Messages are read in place: records refer to their owner name and data in
+ * the message, and names are only followed (compression pointers included)
+ * when compared or formatted. Pointers must point backwards, which rules out
+ * loops.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __DNS_H__
+#define __DNS_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#define DNS_PORT            53      /**< Server port. */
+#define DNS_NAME_MAX        255     /**< Longest name (wire format). */
+
+#define DNS_FLAG_QR         0x8000  /**< Response. */
+#define DNS_FLAG_AA         0x0400  /**< Authoritative answer. */
+#define DNS_FLAG_TC         0x0200  /**< Truncated. */
+#define DNS_FLAG_RD         0x0100  /**< Recursion desired. */
+#define DNS_FLAG_RA         0x0080  /**< Recursion available. */
+
+#define DNS_OPCODE(flags)   (((flags) >> 11) & 0xf) /**< Opcode of flags. */
+#define DNS_RCODE(flags)    ((flags) & 0xf)         /**< Rcode of flags. */
+
+/**
+ * \brief DNS header (network byte order).
+ */
+typedef struct dns_header
+{
+    u_int16_t id;               /**< Transaction ID. */
+    u_int16_t flags;            /**< Flags, opcode and response code. */
+    u_int16_t questions;        /**< Questions. */
+    u_int16_t answers;          /**< Answer records. */
+    u_int16_t authorities;      /**< Authority records. */
+    u_int16_t additionals;      /**< Additional records. */
+} dns_header;
+
+/**
+ * \brief Sections of a message.
+ */
+typedef enum dns_section
+{
+    DNS_QUESTION = 0,
+    DNS_ANSWER,
+    DNS_AUTHORITY,
+    DNS_ADDITIONAL,
+    DNS_SECTION_COUNT,
+} dns_section;
+
+/**
+ * \brief Question or resource record.
+ */
+typedef struct dns_record
+{
+    dns_section section;        /**< Section. */
+    const u_char * name;        /**< Owner name, in the message. */
+    u_int16_t type;             /**< Type. */
+    u_int16_t class;            /**< Class. */
+    u_int32_t ttl;              /**< Time to live (0 for questions). */
+    u_int16_t length;           /**< Data length. */
+    const u_char * data;        /**< Data, in the message (NULL if none). */
+} dns_record;
+
+/**
+ * \brief Message being read.
+ */
+typedef struct dns_message
+{
+    const u_char * start;       /**< Header. */
+    const u_char * limit;       /**< Byte following the message. */
+    const u_char * cursor;      /**< Next record (NULL if malformed). */
+    dns_section section;        /**< Section of the next record. */
+    unsigned int remaining;     /**< Records left in the section. */
+} dns_message;
+
+/**
+ * \brief Start reading a message.
+ * \param message Message.
+ * \param start First byte (the header).
+ * \param limit Byte following the last byte.
+ * \retval true If the header fits.
+ * \retval false otherwise.
+ */
+bool dns_open (dns_message * message, const u_char * start,
+        const u_char * limit);
+
+/**
+ * \brief Get the header of a message.
+ * \param message Message.
+ * \return Header.
+ */
+const dns_header * dns_get_header (const dns_message * message);
+
+/**
+ * \brief Read the next question or record.
+ * \param message Message.
+ * \param record Record.
+ * \retval true If a record was read.
+ * \retval false At the end of the message, or if it is malformed (the
+ * cursor is then NULL).
+ */
+bool dns_next (dns_message * message, dns_record * record);
+
+/**
+ * \brief Format a name.
+ * \param message Message.
+ * \param name Name, in the message.
+ * \param buffer Buffer.
+ * \param size Buffer size.
+ * \retval true On success.
+ * \retval false If the name is malformed ("?" is written).
+ *
+ * Labels are separated by dots; the root is ".". Bytes other than printable
+ * ASCII are written as '?'.
+ */
+bool dns_name_format (const dns_message * message, const u_char * name,
+        char * buffer, size_t size);
+
+/**
+ * \brief Convert a record type into a string.
+ * \param type Type.
+ * \return String (NULL for types without a name).
+ */
+const char * dns_type_string (u_int16_t type);
+
+/**
+ * \brief Convert a response code into a string.
+ * \param rcode Response code.
+ * \return String (NULL for codes without a name).
+ */
+const char * dns_rcode_string (u_int8_t rcode);
+
+/**
+ * \brief Print a DNS message.
+ * \param stream Output stream.
+ * \param start First byte.
+ * \param limit Byte following the last byte.
+ */
+void dns_print (FILE * stream, const u_char * start, const u_char * limit);
+
+#endif /* __DNS_H__ */
@@ -0,0 +1,75 @@
+/**
+ * \file dnsstat.h
+ * \brief DNS transaction analysis.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * Every query sent to port 53 opens a transaction, keyed by client address,
+ * client port and transaction ID, in a bounded flow table (DNSSTAT_PENDING
+ * transactions; the oldest one makes room). The response coming back from
+ * port 53 closes it, and its latency, from the query to the response as seen
+ * from the capture point, is accounted for its server and for the type of its
+ * question. Transactions left unanswered for DNSSTAT_TIMEOUT time out.
+ *
+ * Retransmitted queries keep the time of the first one. Only the header and
+ * the first question are read, in place.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __DNSSTAT_H__
+#define __DNSSTAT_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "wiredolphin/packet.h"
+
+#define DNSSTAT_PENDING     16384   /**< Transactions tracked. */
+#define DNSSTAT_SERVERS     32      /**< Servers accounted for apart. */
+#define DNSSTAT_TIMEOUT     5000000 /**< Transaction timeout (us). */
+
+/**
+ * \brief Analyse the DNS transactions.
+ * \param enabled Whether to.
+ */
+void dnsstat_set_enabled (bool enabled);
+
+/**
+ * \brief Check whether the DNS transactions are analysed.
+ * \retval true If they are.
+ * \retval false otherwise.
+ */
+bool dnsstat_enabled (void);
+
+/**
+ * \brief Allocate the transaction table.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+bool dnsstat_open (void);
+
+/**
+ * \brief Account for a packet.
+ * \param info Decoded packet.
+ */
+void dnsstat_packet (const packet_info * info);
+
+/**
+ * \brief Release the transaction table.
+ */
+void dnsstat_close (void);
+
+/**
+ * \brief Print the servers, query types and response codes.
+ * \param stream Output stream.
+ */
+void dnsstat_print (FILE * stream);
+
+#endif /* __DNSSTAT_H__ */
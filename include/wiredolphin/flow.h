@@ -0,0 +1,127 @@
+/**
+ * \file flow.h
+ * \brief Flow tables.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * Bounded hash tables of per-flow values, keyed by 5-tuple.
+ *
+ * Lookups are O(1) amortised (open addressing, linear probing). Entries are
+ * kept in least recently used order: when the table is full, the least
+ * recently used entry is released to make room, and idle entries can be
+ * expired from the oldest one. The memory is allocated once, at creation.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __FLOW_H__
+#define __FLOW_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "wiredolphin/packet.h"
+
+/**
+ * \brief Flow table.
+ */
+typedef struct flow_table flow_table;
+
+/**
+ * \brief Function called when a value leaves the table.
+ * \param flow Flow.
+ * \param value Value.
+ * \param user Additional user parameters.
+ */
+typedef void (* flow_table_release) (const packet_flow * flow, void * value,
+        void * user);
+
+/**
+ * \brief Create a flow table.
+ * \param capacity Maximum number of flows.
+ * \param value_size Size of a value.
+ * \param release Function called when a value leaves the table (may be NULL).
+ * \param user Additional user parameters for \c release.
+ * \return Flow table, NULL on allocation failure.
+ *
+ * New values are zeroed.
+ */
+flow_table * flow_table_create (size_t capacity, size_t value_size,
+        flow_table_release release, void * user);
+
+/**
+ * \brief Release every value and destroy a flow table.
+ * \param table Flow table.
+ */
+void flow_table_destroy (flow_table * table);
+
+/**
+ * \brief Find the value of a flow, create it if needed.
+ * \param table Flow table.
+ * \param flow Flow.
+ * \param created Set to whether the value was created (may be NULL).
+ * \return Value.
+ *
+ * The flow becomes the most recently used one.
+ */
+void * flow_table_lookup (flow_table * table, const packet_flow * flow,
+        bool * created);
+
+/**
+ * \brief Find the value of a flow.
+ * \param table Flow table.
+ * \param flow Flow.
+ * \return Value, NULL if the flow is not in the table.
+ */
+void * flow_table_find (const flow_table * table, const packet_flow * flow);
+
+/**
+ * \brief Release a value and remove it from a flow table.
+ * \param table Flow table.
+ * \param value Value.
+ */
+void flow_table_remove (flow_table * table, void * value);
+
+/**
+ * \brief Get the least recently used value.
+ * \param table Flow table.
+ * \return Value, NULL if the table is empty.
+ */
+void * flow_table_oldest (const flow_table * table);
+
+/**
+ * \brief Get the next value, from the least to the most recently used.
+ * \param table Flow table.
+ * \param value Value.
+ * \return Next value, NULL if \c value is the most recently used.
+ */
+void * flow_table_next (const flow_table * table, const void * value);
+
+/**
+ * \brief Get the flow of a value.
+ * \param value Value.
+ * \return Flow.
+ */
+const packet_flow * flow_table_flow (const void * value);
+
+/**
+ * \brief Get the number of flows in a table.
+ * \param table Flow table.
+ * \return Number of flows.
+ */
+size_t flow_table_size (const flow_table * table);
+
+/**
+ * \brief Release every value of a flow table.
+ * \param table Flow table.
+ */
+void flow_table_clear (flow_table * table);
+
+#endif /* __FLOW_H__ */
@@ -0,0 +1,79 @@
+/**
+ * \file follow.h
+ * \brief Growing capture files.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * A capture file being written is read as it grows, as with tail -f. At the
+ * end of the data, the reader sleeps until the file or its directory changes
+ * (inotify), then resumes from the last complete record: a record only
+ * partially written yet is kept until the rest of it is.
+ *
+ * When the file is rotated, the reader moves on to the next file: a new file
+ * at the same path, or the next number of a numbered series (capture.pcap1
+ * after capture.pcap, capture.pcap.3 after capture.pcap.2).
+ *
+ * Only classic pcap files (not pcapng) can be followed.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __FOLLOW_H__
+#define __FOLLOW_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <signal.h>
+
+#include <pcap/pcap.h>
+
+#include "wiredolphin/pcapfile.h"
+
+/**
+ * \brief Followed file.
+ */
+typedef struct follow follow;
+
+/**
+ * \brief Open a capture file, waiting for its header if need be.
+ * \param file File.
+ * \param filter Filter.
+ * \param interrupted Flag set on interruption.
+ * \return Followed file, NULL on failure or interruption.
+ */
+follow * follow_open (const char * file, const char * filter,
+        volatile sig_atomic_t * interrupted);
+
+/**
+ * \brief Get a capture matching the file (link type, snapshot length).
+ * \param followed Followed file.
+ * \return Capture.
+ */
+pcap_t * follow_capture (const follow * followed);
+
+/**
+ * \brief Get the next packet matching the filter, waiting for it.
+ * \param followed Followed file.
+ * \param header pcap header.
+ * \param bytes Data.
+ * \retval true On success.
+ * \retval false On error or interruption.
+ *
+ * The packet is valid until the next call.
+ */
+bool follow_next (follow * followed, const struct pcap_pkthdr ** header,
+        const u_char ** bytes);
+
+/**
+ * \brief Close the file.
+ * \param followed Followed file.
+ */
+void follow_close (follow * followed);
+
+#endif /* __FOLLOW_H__ */
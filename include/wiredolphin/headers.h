@@ -119,6 +119,13 @@ struct in_addr header_ipv4_src (const u_char * bytes);
  */
 struct in_addr header_ipv4_dest (const u_char * bytes);
 
+/**
+ * \brief Convert an IP protocol into a string.
+ * \param protocol Protocol.
+ * \return String.
+ */
+const char * header_ip_protocol_string (u_int8_t protocol);
+
 /**
  * \brief Get an IPv6's next header.
  * \param bytes The IPv6 header.
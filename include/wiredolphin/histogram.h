@@ -0,0 +1,80 @@
+/**
+ * \file histogram.h
+ * \brief Log-linear histograms.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * HDR-style histograms of 64 bits values: values below HISTOGRAM_SUB are
+ * counted exactly, larger ones in HISTOGRAM_SUB sub-buckets per power of two
+ * (about 3% precision). A histogram has a fixed size, recording a value costs
+ * a bit scan and an increment, and histograms recorded apart (by different
+ * threads, for instance) are merged by adding their buckets.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#define HISTOGRAM_SUB_BITS  5   /**< log2 of the sub-buckets per power of 2. */
+#define HISTOGRAM_SUB       (1u << HISTOGRAM_SUB_BITS)  /**< Sub-buckets. */
+#define HISTOGRAM_BUCKETS   ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB)
+
+/**
+ * \brief Histogram. A zeroed histogram is empty.
+ */
+typedef struct histogram
+{
+    u_int64_t counts[HISTOGRAM_BUCKETS];    /**< Values per bucket. */
+    u_int64_t count;                        /**< Values. */
+    u_int64_t total;                        /**< Sum of the values. */
+    u_int64_t min;                          /**< Smallest value. */
+    u_int64_t max;                          /**< Largest value. */
+} histogram;
+
+/**
+ * \brief Record a value.
+ * \param values Histogram.
+ * \param value Value.
+ */
+void histogram_record (histogram * values, u_int64_t value);
+
+/**
+ * \brief Add a histogram to another.
+ * \param into Histogram to add to.
+ * \param from Histogram to add.
+ */
+void histogram_merge (histogram * into, const histogram * from);
+
+/**
+ * \brief Get a percentile.
+ * \param values Histogram.
+ * \param fraction Fraction of the values (0.99: 99th percentile).
+ * \return Value (0 if the histogram is empty).
+ */
+u_int64_t histogram_percentile (const histogram * values, double fraction);
+
+/**
+ * \brief Get the bucket of a value.
+ * \param value Value.
+ * \return Bucket.
+ */
+size_t histogram_bucket (u_int64_t value);
+
+/**
+ * \brief Get the value a bucket stands for.
+ * \param bucket Bucket.
+ * \return Middle of the bucket.
+ */
+u_int64_t histogram_value (size_t bucket);
+
+#endif /* __HISTOGRAM_H__ */
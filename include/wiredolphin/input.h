@@ -0,0 +1,44 @@
+/**
+ * \file input.h
+ * \brief Capture file input.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * Capture files are read from a path or from the standard input ("-"). Files
+ * compressed with gzip, zstd or lz4 are recognised by their magic number and
+ * decompressed alongside the capture, while the packets already read are
+ * decoded. Built with libzstd, zstd files are decompressed by a reader thread
+ * into a ring of buffers; the other formats, or zstd without the library, are
+ * decompressed by the matching program, writing into a pipe.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __INPUT_H__
+#define __INPUT_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+/**
+ * \brief Open a capture file, decompressing it if need be.
+ * \param file File, "-" for the standard input.
+ * \param plain Set to whether the file is read as is (may be NULL).
+ * \return Stream, NULL on failure (errno is set).
+ *
+ * A plain file is an uncompressed regular file: the stream can be seeked.
+ */
+FILE * input_open (const char * file, bool * plain);
+
+/**
+ * \brief Wait for the decompressions to end, once their streams are closed.
+ */
+void input_finish (void);
+
+#endif /* __INPUT_H__ */
@@ -0,0 +1,89 @@
+/**
+ * \file json.h
+ * \brief JSON output of the decoded packets.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * Packets are printed as newline delimited JSON: one object per packet, with
+ * one nested object per layer ("ethernet", "arp", "ipv4", "ipv6", "tcp",
+ * "udp", "icmp", "icmpv6", "bootp" or "application"). The verbose mode level
+ * chooses the details:
+ * - 0 (raw): the timestamp, lengths and captured bytes only.
+ * - 1 (concise) and 2 (synthetic): addresses, ports, protocols, the DHCP
+ *   message type and the first line of the application data.
+ * - 3 (complete): every header field, the captured bytes, the BOOTP options
+ *   and the application data.
+ * - 4 (statistics only): nothing.
+ *
+ * The repetition and flow limit summaries are printed as objects too, with a
+ * "repeated" or "limited" member.
+ *
+ * Objects are built in a fixed buffer, straight from the decoded packet: no
+ * memory is allocated and no printf format is parsed per packet.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __JSON_H__
+#define __JSON_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "wiredolphin/packet.h"
+#include "wiredolphin/callback.h"
+
+/**
+ * \brief Print the packets as JSON instead of text.
+ * \param enabled Whether to.
+ */
+void json_set_enabled (bool enabled);
+
+/**
+ * \brief Check whether the packets are printed as JSON.
+ * \retval true If they are.
+ * \retval false otherwise.
+ */
+bool json_enabled (void);
+
+/**
+ * \brief Print a packet.
+ * \param stream Output stream.
+ * \param info Decoded packet.
+ * \param level Verbose mode level.
+ */
+void json_packet (FILE * stream, const packet_info * info,
+        callback_level level);
+
+/**
+ * \brief Print a repetition record (see repeat.h).
+ * \param stream Output stream.
+ * \param repeats Repeats.
+ * \param src_mac Source MAC address (NULL for the last printed message).
+ * \param dest_mac Destination MAC address.
+ * \param flow Flow.
+ */
+void json_repeat (FILE * stream, u_int64_t repeats, const u_int8_t * src_mac,
+        const u_int8_t * dest_mac, const packet_flow * flow);
+
+/**
+ * \brief Print the summary of a flow over its limit (see limit.h).
+ * \param stream Output stream.
+ * \param flow Flow.
+ * \param packets Packets.
+ * \param bytes Bytes.
+ * \param hidden Packets not shown.
+ * \param duration Duration (s).
+ * \param reason Reason of the summary.
+ */
+void json_limit (FILE * stream, const packet_flow * flow, u_int64_t packets,
+        u_int64_t bytes, u_int64_t hidden, double duration,
+        const char * reason);
+
+#endif /* __JSON_H__ */
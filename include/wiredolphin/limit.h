@@ -0,0 +1,73 @@
+/**
+ * \file limit.h
+ * \brief Per-flow output limit.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * Only the first packets (or bytes) of each flow are printed, the following
+ * ones only update counters. A summary line is printed when a limited flow
+ * ends (TCP FIN from both sides or RST, idle timeout, eviction from the flow
+ * table or end of the capture).
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __LIMIT_H__
+#define __LIMIT_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "wiredolphin/packet.h"
+#include "wiredolphin/flow.h"
+
+#define LIMIT_FLOWS_DEFAULT     65536   /**< Default flow table capacity. */
+#define LIMIT_TIMEOUT_DEFAULT   60      /**< Default idle timeout (s). */
+
+/**
+ * \brief Set the number of packets printed per flow.
+ * \param packets Packets (0 for no limit).
+ */
+void limit_set_packets (unsigned int packets);
+
+/**
+ * \brief Set the number of bytes printed per flow.
+ * \param bytes Bytes (0 for no limit).
+ */
+void limit_set_bytes (unsigned int bytes);
+
+/**
+ * \brief Set the flow table capacity.
+ * \param flows Maximum number of tracked flows.
+ */
+void limit_set_flows (unsigned int flows);
+
+/**
+ * \brief Check whether a per-flow limit is set.
+ * \retval true If a limit is set.
+ * \retval false otherwise.
+ */
+bool limit_enabled (void);
+
+/**
+ * \brief Account for a packet and decide whether it is printed.
+ * \param stream Output stream for the flow summaries.
+ * \param info Decoded packet.
+ * \retval true If the packet should be printed.
+ * \retval false otherwise.
+ */
+bool limit_accept (FILE * stream, const packet_info * info);
+
+/**
+ * \brief End every flow, printing their summaries.
+ * \param stream Output stream.
+ */
+void limit_finish (FILE * stream);
+
+#endif /* __LIMIT_H__ */
@@ -0,0 +1,71 @@
+/**
+ * \file merge.h
+ * \brief Time-ordered merge of offline captures.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * Several capture files are read at once and their packets returned in
+ * timestamp order (k-way merge on a min-heap of the files' next packets).
+ * Each file only holds its next packet and a read-ahead buffer: memory does
+ * not depend on the size of the files.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __MERGE_H__
+#define __MERGE_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include <pcap/pcap.h>
+
+/**
+ * \brief Merge of capture files.
+ */
+typedef struct merge merge;
+
+/**
+ * \brief Open capture files.
+ * \param files Files.
+ * \param count Number of files.
+ * \param filter Filter, applied to each file.
+ * \return Merge, NULL on failure.
+ *
+ * The files must have the same link type.
+ */
+merge * merge_open (char * const * files, size_t count, const char * filter);
+
+/**
+ * \brief Get the capture of the first file (link type, snapshot length).
+ * \param sources Merge.
+ * \return Capture.
+ */
+pcap_t * merge_capture (const merge * sources);
+
+/**
+ * \brief Get the next packet, in timestamp order.
+ * \param sources Merge.
+ * \param header pcap header.
+ * \param bytes Data.
+ * \retval true On success.
+ * \retval false At the end of every file.
+ *
+ * The packet is valid until the next call.
+ */
+bool merge_next (merge * sources, const struct pcap_pkthdr ** header,
+        const u_char ** bytes);
+
+/**
+ * \brief Close the files.
+ * \param sources Merge.
+ */
+void merge_close (merge * sources);
+
+#endif /* __MERGE_H__ */
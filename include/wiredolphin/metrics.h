@@ -0,0 +1,60 @@
+/**
+ * \file metrics.h
+ * \brief Prometheus metrics endpoint.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * A small HTTP server, on its own thread, serving the statistics in the
+ * Prometheus text exposition format (GET /metrics): packets and bytes per
+ * interface, packet type, IP protocol and application, decode errors, kernel
+ * and writer drops, and, in profiling builds, per stage latency histograms.
+ *
+ * The server renders the snapshots the capture thread publishes (see
+ * shared.h): the capture path takes no lock for it.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "wiredolphin/shared.h"
+
+/**
+ * \brief Set the listening address.
+ * \param address <host>:<port>, [<IPv6 host>]:<port> or :<port> (localhost).
+ * \retval true On success.
+ * \retval false If the address is invalid.
+ */
+bool metrics_set_listen (const char * address);
+
+/**
+ * \brief Check whether the metrics are served.
+ * \retval true If an address is set.
+ * \retval false otherwise.
+ */
+bool metrics_enabled (void);
+
+/**
+ * \brief Listen and start the server thread.
+ * \param segment Statistics to serve.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+bool metrics_open (const shared_segment * segment);
+
+/**
+ * \brief Stop the server thread.
+ */
+void metrics_close (void);
+
+#endif /* __METRICS_H__ */
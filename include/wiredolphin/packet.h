@@ -0,0 +1,185 @@
+/**
+ * \file packet.h
+ * \brief Packets.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * Decode a captured frame once, and keep pointers to its layers along with
+ * its 5-tuple.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __PACKET_H__
+#define __PACKET_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <pcap/pcap.h>
+
+#include "wiredolphin/headers.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Flows.
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * \brief 5-tuple of a packet.
+ *
+ * IPv4 addresses are stored in the first 4 bytes of the address fields, MAC
+ * addresses in the first 6 bytes for non IP packets. Unused bytes are zeroed
+ * so that flows can be hashed and compared with memcmp.
+ */
+typedef struct packet_flow
+{
+    u_int16_t packet_type;          /**< Ethernet packet type. */
+    u_int8_t protocol;              /**< IP protocol (0 if not IP). */
+    u_int8_t unused;                /**< Unused. */
+    u_int16_t src_port;             /**< Source port (0 if none). */
+    u_int16_t dest_port;            /**< Destination port (0 if none). */
+    struct in6_addr src_addr;       /**< Source address. */
+    struct in6_addr dest_addr;      /**< Destination address. */
+} packet_flow;
+
+/**
+ * \brief Hash a flow.
+ * \param flow Flow.
+ * \return Hash.
+ */
+u_int64_t packet_flow_hash (const packet_flow * flow);
+
+/**
+ * \brief Compare two flows.
+ * \param a Flow.
+ * \param b Flow.
+ * \retval true If the flows are the same.
+ * \retval false otherwise.
+ */
+bool packet_flow_equal (const packet_flow * a, const packet_flow * b);
+
+/**
+ * \brief Put a flow in its canonical (direction independent) form.
+ * \param flow Flow.
+ * \retval true If the endpoints were swapped.
+ * \retval false otherwise.
+ */
+bool packet_flow_canonical (packet_flow * flow);
+
+/**
+ * \brief Convert one of the addresses of a flow into a string.
+ * \param flow Flow.
+ * \param source Whether to convert the source or the destination address.
+ * \param buffer Buffer.
+ * \return buffer.
+ */
+const char * packet_flow_address (const packet_flow * flow, bool source,
+        char buffer[INET6_ADDRSTRLEN]);
+
+/**
+ * \brief Print a flow.
+ * \param stream Output stream.
+ * \param flow Flow.
+ *
+ * <source>:<port> -> <destination>:<port>, <protocol>
+ */
+void packet_flow_print (FILE * stream, const packet_flow * flow);
+
+/**
+ * \brief Name a flow, for use in file names and on the command line.
+ * \param flow Flow.
+ * \param buffer Buffer.
+ * \param size Buffer size.
+ *
+ * <protocol>_<source>_<port>_<destination>_<port> for IP flows (such as
+ * tcp_10.0.0.1_51234_10.0.0.2_80), arp_<source>_<destination> for ARP and
+ * 0x<type>_<source>_<destination> otherwise.
+ */
+void packet_flow_name (const packet_flow * flow, char * buffer, size_t size);
+
+/**
+ * \brief Parse the name of an IP flow.
+ * \param name Name, as produced by packet_flow_name.
+ * \param flow Flow.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+bool packet_flow_parse (const char * name, packet_flow * flow);
+
+////////////////////////////////////////////////////////////////////////////////
+// Applications.
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * \brief Applications recognized by their port.
+ */
+typedef enum packet_application
+{
+    PACKET_APP_NONE = 0,
+    PACKET_APP_FTP_DATA,
+    PACKET_APP_FTP_CONTROL,
+    PACKET_APP_SMTP,
+    PACKET_APP_BOOTP,
+    PACKET_APP_HTTP,
+    PACKET_APP_POP,
+    PACKET_APP_IMAP,
+    PACKET_APP_HTTPS,
+    PACKET_APP_SMTPS,
+    PACKET_APP_IMAPS,
+    PACKET_APP_POPS,
+    PACKET_APP_DNS,
+    PACKET_APP_COUNT,
+} packet_application;
+
+/**
+ * \brief Convert an application into a string.
+ * \param application Application.
+ * \return String.
+ */
+const char * packet_application_string (packet_application application);
+
+////////////////////////////////////////////////////////////////////////////////
+// Packets.
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * \brief Decoded packet.
+ *
+ * Layer pointers are NULL when the layer is absent or truncated.
+ */
+typedef struct packet_info
+{
+    const struct pcap_pkthdr * header;  /**< pcap header. */
+    const u_char * frame;               /**< Ethernet frame. */
+    const u_char * limit;               /**< Byte following the last byte. */
+    const u_char * network;             /**< Network header. */
+    const u_char * transport;           /**< Transport header. */
+    const u_char * data;                /**< Application data. */
+    packet_application application;     /**< Application. */
+    packet_flow flow;                   /**< 5-tuple. */
+    unsigned int interface;             /**< Interface number. */
+    bool malformed;                     /**< Truncated or invalid headers. */
+    bool tagged;                        /**< 802.1Q tagged frame. */
+    u_int16_t vlan;                     /**< VLAN ID of the outermost tag. */
+} packet_info;
+
+/**
+ * \brief Decode a packet.
+ * \param header pcap header.
+ * \param bytes Data.
+ * \param info Decoded packet.
+ *
+ * 802.1Q and 802.1ad tags are skipped: the flow holds the encapsulated packet
+ * type.
+ */
+void packet_decode (const struct pcap_pkthdr * header, const u_char * bytes,
+        packet_info * info);
+
+#endif /* __PACKET_H__ */
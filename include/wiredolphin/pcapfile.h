@@ -0,0 +1,54 @@
+/**
+ * \file pcapfile.h
+ * \brief pcap file format.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * Helpers to build pcap files without pcap_dump, for writers managing their
+ * own buffers and descriptors.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __PCAPFILE_H__
+#define __PCAPFILE_H__
+
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include <pcap/pcap.h>
+
+#define PCAPFILE_MAGIC  0xa1b2c3d4  /**< Microsecond resolution magic. */
+
+/**
+ * \brief Record header, as stored in a file.
+ */
+typedef struct pcapfile_record
+{
+    u_int32_t seconds;          /**< Timestamp (seconds). */
+    u_int32_t microseconds;     /**< Timestamp (microseconds). */
+    u_int32_t caplen;           /**< Captured length. */
+    u_int32_t len;              /**< Original length. */
+} pcapfile_record;
+
+/**
+ * \brief Build the file header matching a capture.
+ * \param capture Capture.
+ * \param header File header.
+ */
+void pcapfile_header (pcap_t * capture, struct pcap_file_header * header);
+
+/**
+ * \brief Build the record header of a packet.
+ * \param header pcap header.
+ * \param record Record header.
+ */
+void pcapfile_record_header (const struct pcap_pkthdr * header,
+        pcapfile_record * record);
+
+#endif /* __PCAPFILE_H__ */
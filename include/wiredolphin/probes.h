@@ -0,0 +1,65 @@
+/**
+ * \file probes.h
+ * \brief Static tracepoints.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * USDT probes of the "wiredolphin" provider, for bpftrace, perf or SystemTap.
+ * They are built with sys/sdt.h when WIREDOLPHIN_USDT is defined (make
+ * WITH_USDT=0 leaves them out) and the header is available. A probe is a nop
+ * instruction plus an ELF note: there is no runtime dependency, and next to
+ * no cost while no tracer is attached.
+ *
+ * Probes (arguments):
+ *  - packet__receive (caplen, len, interface): a packet is handed over.
+ *  - packet__decode (ethertype, protocol, source port, destination port,
+ *    application): the packet is decoded.
+ *  - packet__drop (reason): the packet is not printed or not written
+ *    ("sampling", "limit", "repeat", "writer").
+ *  - dissect__entry (port, application name), dissect__return (port): an
+ *    application printer runs.
+ *  - writer__flush (bytes), split__flush (fd, bytes), output__flush: buffered
+ *    data is written.
+ *
+ * See contrib/bpftrace for examples.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __PROBES_H__
+#define __PROBES_H__
+
+#if defined (WIREDOLPHIN_USDT) && defined (__has_include)
+#if __has_include (<sys/sdt.h>)
+#define WIREDOLPHIN_PROBES
+#endif
+#endif
+
+#ifdef WIREDOLPHIN_PROBES
+
+#include <sys/sdt.h>
+
+#define PROBE0(name)                    DTRACE_PROBE (wiredolphin, name)
+#define PROBE1(name, a)                 DTRACE_PROBE1 (wiredolphin, name, a)
+#define PROBE2(name, a, b)              DTRACE_PROBE2 (wiredolphin, name, a, b)
+#define PROBE3(name, a, b, c)           \
+    DTRACE_PROBE3 (wiredolphin, name, a, b, c)
+#define PROBE5(name, a, b, c, d, e)     \
+    DTRACE_PROBE5 (wiredolphin, name, a, b, c, d, e)
+
+#else
+
+#define PROBE0(name)                    do { } while (0)
+#define PROBE1(name, a)                 do { } while (0)
+#define PROBE2(name, a, b)              do { } while (0)
+#define PROBE3(name, a, b, c)           do { } while (0)
+#define PROBE5(name, a, b, c, d, e)     do { } while (0)
+
+#endif /* WIREDOLPHIN_PROBES */
+
+#endif /* __PROBES_H__ */
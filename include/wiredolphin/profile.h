@@ -0,0 +1,113 @@
+/**
+ * \file profile.h
+ * \brief Hot path instrumentation.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * When built with WIREDOLPHIN_PROFILE (make WITH_PROFILE=1), the time spent
+ * per packet in each stage of the capture is recorded into log-linear
+ * latency histograms (32 sub-buckets per power of two, about 3% precision),
+ * read with rdtsc where available, clock_gettime otherwise. The median, 99th
+ * and 99.9th percentiles and the mean per packet are reported at the end of
+ * the capture and on SIGUSR1.
+ *
+ * Otherwise, the macros expand to nothing: the instrumentation costs nothing.
+ *
+ * The histograms are per thread; the capture thread is the only one recording.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/**
+ * \brief Stages of the capture.
+ */
+typedef enum profile_stage
+{
+    PROFILE_WAIT = 0,       /**< Waiting for the packet (libpcap, kernel). */
+    PROFILE_DECODE,         /**< L2-L4 decoding and application detection. */
+    PROFILE_ACCOUNT,        /**< Selection, sampling, statistics, limits. */
+    PROFILE_RECORD,         /**< Trigger, pcap writer, split files. */
+    PROFILE_OUTPUT,         /**< Formatting and printing. */
+    PROFILE_STAGE_COUNT,
+} profile_stage;
+
+/**
+ * \brief Convert a stage into a string.
+ * \param stage Stage.
+ * \return String.
+ */
+const char * profile_stage_string (profile_stage stage);
+
+#ifdef WIREDOLPHIN_PROFILE
+
+/** Calibrate the clock and handle SIGUSR1. */
+#define PROFILE_START()         profile_start ()
+/** A packet is handed over: the time since the previous one was waited. */
+#define PROFILE_ENTER()         profile_enter ()
+/** The time since the previous mark was spent in stage. */
+#define PROFILE_LAP(stage)      profile_lap (stage)
+/** Print the report. */
+#define PROFILE_REPORT(stream)  profile_report (stream)
+/** Copy a histogram out, for the capture thread to publish it. */
+#define PROFILE_EXPORT(stage, bounds, count, below, packets, total)   \
+    profile_export (stage, bounds, count, below, packets, total)
+
+/**
+ * \brief Calibrate the clock and handle SIGUSR1.
+ */
+void profile_start (void);
+
+/**
+ * \brief Account for the previous packet and start the next one.
+ */
+void profile_enter (void);
+
+/**
+ * \brief Add the time since the previous mark to a stage.
+ * \param stage Stage.
+ */
+void profile_lap (profile_stage stage);
+
+/**
+ * \brief Print the report.
+ * \param stream Output stream.
+ */
+void profile_report (FILE * stream);
+
+/**
+ * \brief Summarise the histogram of a stage (from the capture thread).
+ * \param stage Stage.
+ * \param bounds Increasing bounds (ns).
+ * \param count Number of bounds.
+ * \param below Packets at most each bound.
+ * \param packets Packets.
+ * \param total Total time (ns).
+ */
+void profile_export (profile_stage stage, const u_int64_t * bounds,
+        size_t count, u_int64_t * below, u_int64_t * packets,
+        u_int64_t * total);
+
+#else
+
+#define PROFILE_START()         ((void) 0)
+#define PROFILE_ENTER()         ((void) 0)
+#define PROFILE_LAP(stage)      ((void) 0)
+#define PROFILE_REPORT(stream)  ((void) 0)
+#define PROFILE_EXPORT(stage, bounds, count, below, packets, total)   \
+    ((void) 0)
+
+#endif /* WIREDOLPHIN_PROFILE */
+
+#endif /* __PROFILE_H__ */
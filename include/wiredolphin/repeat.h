@@ -0,0 +1,64 @@
+/**
+ * \file repeat.h
+ * \brief Repeated packets collapsing.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * Each packet is fingerprinted from its decoded fields (addresses, ports,
+ * protocol, ARP operation, TCP flags, ICMP type, DHCP message type, first
+ * line of the application data), leaving out timestamps and counters such as
+ * sequence numbers or transaction IDs. A packet whose fingerprint is in the
+ * window of recent fingerprints is not printed (nor formatted). Instead,
+ * "repeated N times" records are printed when a fingerprint leaves the window,
+ * every second of repetition, and at the end of the capture.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __REPEAT_H__
+#define __REPEAT_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "wiredolphin/packet.h"
+#include "wiredolphin/bootp.h"
+
+#define REPEAT_WINDOW_DEFAULT   8   /**< Default window size. */
+#define REPEAT_WINDOW_MAX       64  /**< Maximum window size. */
+
+/**
+ * \brief Set the window size.
+ * \param window Number of recent fingerprints (0 disables collapsing).
+ */
+void repeat_set_window (unsigned int window);
+
+/**
+ * \brief Check whether collapsing is enabled.
+ * \retval true If enabled.
+ * \retval false otherwise.
+ */
+bool repeat_enabled (void);
+
+/**
+ * \brief Decide whether a packet is printed.
+ * \param stream Output stream for the repetition records.
+ * \param info Decoded packet.
+ * \retval true If the packet should be printed.
+ * \retval false If it repeats a recent packet.
+ */
+bool repeat_accept (FILE * stream, const packet_info * info);
+
+/**
+ * \brief Print the pending repetition records.
+ * \param stream Output stream.
+ */
+void repeat_finish (FILE * stream);
+
+#endif /* __REPEAT_H__ */
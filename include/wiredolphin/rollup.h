@@ -0,0 +1,175 @@
+/**
+ * \file rollup.h
+ * \brief Rate history in a fixed size file.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * The packets and bytes of every second are kept in a file, rolled up into
+ * minutes and hours: three rings of buckets (an hour of seconds, a day of
+ * minutes, a year of hours), RRD-style. The file has a fixed size, is mapped
+ * in memory and updated in place; a later capture goes on with the same
+ * file.
+ *
+ * Buckets hold series of packet and byte counters: the total, the first
+ * ROLLUP_INTERFACES interfaces, the packet types, the main IP protocols and
+ * the applications. They are the differences of the counters of the
+ * statistics module (see stats.h), taken when the packet time enters a new
+ * second: a packet costs a comparison, and there is no I/O but the page
+ * writebacks of the kernel. The last seconds without packets get empty
+ * buckets.
+ *
+ * The capture is the only writer. Updates are guarded by a sequence lock, as
+ * in shared.h: readers, such as wiredolphin-query, never block it.
+ *
+ * The layout is that of the host (byte order included), and versioned.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __ROLLUP_H__
+#define __ROLLUP_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include "wiredolphin/stats.h"
+
+#define ROLLUP_MAGIC        0x55524457u /**< "WDRU". */
+#define ROLLUP_VERSION      2           /**< Layout version. */
+#define ROLLUP_INTERFACES   8           /**< Interfaces with their series. */
+#define ROLLUP_NAME_MAX     16          /**< Interface name length. */
+#define ROLLUP_PROTOCOLS    5           /**< TCP, UDP, ICMP, ICMPv6, other. */
+
+/**
+ * \brief Series of a bucket.
+ */
+enum
+{
+    ROLLUP_TOTAL = 0,                                       /**< Total. */
+    ROLLUP_INTERFACE = 1,                                   /**< Interfaces. */
+    ROLLUP_TYPE = ROLLUP_INTERFACE + ROLLUP_INTERFACES,     /**< Types. */
+    ROLLUP_PROTOCOL = ROLLUP_TYPE + STATS_PACKET_TYPE_COUNT,    /**< IP. */
+    ROLLUP_APPLICATION = ROLLUP_PROTOCOL + ROLLUP_PROTOCOLS,    /**< Apps. */
+    ROLLUP_SERIES = ROLLUP_APPLICATION + PACKET_APP_COUNT - 1,  /**< Count. */
+};
+
+/**
+ * \brief Resolutions.
+ */
+typedef enum rollup_resolution
+{
+    ROLLUP_SECOND = 0,
+    ROLLUP_MINUTE,
+    ROLLUP_HOUR,
+    ROLLUP_RESOLUTION_COUNT,
+} rollup_resolution;
+
+/**
+ * \brief Bucket length of each resolution (s).
+ */
+extern const u_int32_t rollup_steps[ROLLUP_RESOLUTION_COUNT];
+
+/**
+ * \brief Buckets of each resolution.
+ */
+extern const u_int32_t rollup_slots[ROLLUP_RESOLUTION_COUNT];
+
+/**
+ * \brief IP protocols with their series (the last one stands for the others).
+ */
+extern const u_int8_t rollup_protocols[ROLLUP_PROTOCOLS - 1];
+
+/**
+ * \brief Bucket.
+ *
+ * Interfaces count the received packets, the other series estimate the
+ * actual traffic when sampling (see stats.h).
+ */
+typedef struct rollup_bucket
+{
+    u_int64_t time;                     /**< Start (s since the epoch). */
+    u_int64_t packets[ROLLUP_SERIES];   /**< Packets per series. */
+    u_int64_t bytes[ROLLUP_SERIES];     /**< Bytes per series. */
+} rollup_bucket;
+
+/**
+ * \brief Rollup file. The rings of buckets follow, finest first.
+ */
+typedef struct rollup_file
+{
+    u_int32_t magic;                    /**< ROLLUP_MAGIC. */
+    u_int32_t version;                  /**< ROLLUP_VERSION. */
+    u_int64_t size;                     /**< File size. */
+    u_int64_t sequence;                 /**< Odd while updating. */
+    u_int64_t last;                     /**< Last second accounted for. */
+    char interfaces[ROLLUP_INTERFACES][ROLLUP_NAME_MAX];    /**< Names. */
+    rollup_bucket buckets[];            /**< Buckets. */
+} rollup_file;
+
+/**
+ * \brief Set the file.
+ * \param path File path (NULL to keep no history).
+ */
+void rollup_set_path (const char * path);
+
+/**
+ * \brief Check whether the history is kept.
+ * \retval true If a file is set.
+ * \retval false otherwise.
+ */
+bool rollup_enabled (void);
+
+/**
+ * \brief Create or reopen the file and map it.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+bool rollup_open (void);
+
+/**
+ * \brief Close the buckets of the seconds before a packet.
+ * \param ts Packet timestamp.
+ *
+ * Called once per packet, before its accounting.
+ */
+void rollup_packet (const struct timeval * ts);
+
+/**
+ * \brief Close the current second and unmap the file.
+ */
+void rollup_close (void);
+
+/**
+ * \brief Map a file, read only.
+ * \param path File path.
+ * \return File, or NULL on error (a message is printed).
+ */
+const rollup_file * rollup_attach (const char * path);
+
+/**
+ * \brief Read a consistent copy of a bucket.
+ * \param file File.
+ * \param resolution Resolution.
+ * \param time Start of the bucket (s since the epoch).
+ * \param bucket Copy.
+ * \retval true If the bucket holds this time.
+ * \retval false If it is empty or holds another time.
+ */
+bool rollup_read (const rollup_file * file, rollup_resolution resolution,
+        u_int64_t time, rollup_bucket * bucket);
+
+/**
+ * \brief Unmap a file.
+ * \param file File.
+ */
+void rollup_detach (const rollup_file * file);
+
+#endif /* __ROLLUP_H__ */
@@ -0,0 +1,99 @@
+/**
+ * \file sampling.h
+ * \brief Sampling.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * Deterministic 1-in-N packet sampling, hash based flow sampling (all the
+ * packets of a sampled flow are kept) and adaptive load shedding.
+ *
+ * In adaptive mode, the capture lag (age of the packet being processed) and
+ * the kernel drops are watched. Under pressure, the verbosity level is lowered
+ * first (complete, then concise, then statistics only), then the sampling rate
+ * is doubled. The steps are undone once the pressure is gone.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __SAMPLING_H__
+#define __SAMPLING_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include <pcap/pcap.h>
+
+#include "wiredolphin/packet.h"
+#include "wiredolphin/callback.h"
+
+/**
+ * \brief Sampling modes.
+ */
+typedef enum sampling_mode
+{
+    SAMPLING_NONE = 0,  /**< Keep every packet. */
+    SAMPLING_PACKETS,   /**< Keep one packet out of N. */
+    SAMPLING_FLOWS,     /**< Keep one flow out of N. */
+} sampling_mode;
+
+/**
+ * \brief Set the sampling mode.
+ * \param mode Sampling mode.
+ * \param rate Keep 1 out of \c rate packets or flows.
+ */
+void sampling_set (sampling_mode mode, unsigned int rate);
+
+/**
+ * \brief Enable or disable adaptive load shedding.
+ * \param adaptive Adaptive.
+ */
+void sampling_set_adaptive (bool adaptive);
+
+/**
+ * \brief Check whether sampling or load shedding is enabled.
+ * \retval true If enabled.
+ * \retval false otherwise.
+ */
+bool sampling_enabled (void);
+
+/**
+ * \brief Decide whether a packet is kept.
+ * \param info Decoded packet.
+ * \retval true If the packet is kept.
+ * \retval false otherwise.
+ */
+bool sampling_accept (const packet_info * info);
+
+/**
+ * \brief Get the current sampling rate.
+ * \return Number of packets a kept packet stands for.
+ */
+unsigned int sampling_rate (void);
+
+/**
+ * \brief Get the verbosity level to use.
+ * \param level Requested verbosity level.
+ * \return Verbosity level, possibly lowered by the load shedding.
+ */
+callback_level sampling_level (callback_level level);
+
+/**
+ * \brief Watch the capture load and adapt.
+ * \param capture Live capture.
+ * \param header Header of the packet being processed.
+ */
+void sampling_update (pcap_t * capture, const struct pcap_pkthdr * header);
+
+/**
+ * \brief Print the sampling state.
+ * \param stream Output stream.
+ */
+void sampling_print (FILE * stream);
+
+#endif /* __SAMPLING_H__ */
@@ -0,0 +1,169 @@
+/**
+ * \file shared.h
+ * \brief Live statistics in shared memory.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * The counters of the capture, the kernel drops and the writer queue depth
+ * are published into a POSIX shared memory segment (/dev/shm/<name>), at
+ * most every SHARED_PERIOD milliseconds while packets flow and at the end of
+ * the capture. The segment is removed when the capture ends.
+ *
+ * The capture thread is the only writer. Updates are guarded by a sequence
+ * lock: the sequence is odd while an update is in progress, and a reader
+ * retries until it copied the statistics between two reads of the same even
+ * sequence. Readers never block the capture.
+ *
+ * The layout is versioned: a reader checks the magic number, the version and
+ * the size before reading.
+ *
+ * Without a name, the statistics are published into private memory, for
+ * readers of this process (the metrics server).
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __SHARED_H__
+#define __SHARED_H__
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include "wiredolphin/stats.h"
+#include "wiredolphin/profile.h"
+
+#define SHARED_MAGIC        0x54534457u /**< "WDST". */
+#define SHARED_VERSION      3           /**< Layout version. */
+#define SHARED_PERIOD       100         /**< Update period (ms). */
+#define SHARED_NAME_MAX     16          /**< Interface name length. */
+#define SHARED_LATENCY_BOUNDS   12      /**< Latency histogram buckets. */
+
+/**
+ * \brief Latency histogram bounds (ns).
+ */
+extern const u_int64_t shared_latency_bounds[SHARED_LATENCY_BOUNDS];
+
+/**
+ * \brief Latency of a stage (profiling builds only).
+ */
+typedef struct shared_latency
+{
+    u_int64_t packets;              /**< Packets. */
+    u_int64_t total;                /**< Total time (ns). */
+    u_int64_t below[SHARED_LATENCY_BOUNDS];     /**< Packets under a bound. */
+} shared_latency;
+
+/**
+ * \brief Capture state, gathered by the capture thread.
+ */
+typedef struct shared_capture
+{
+    u_int64_t kernel_received;      /**< Received by the kernel. */
+    u_int64_t kernel_dropped;       /**< Dropped by the kernel. */
+    u_int64_t interface_dropped;    /**< Dropped by the interfaces. */
+    u_int64_t writer_queued;        /**< Buffers waiting to be written. */
+    u_int64_t writer_dropped;       /**< Packets the writer dropped. */
+    shared_latency latency[PROFILE_STAGE_COUNT];    /**< Per stage. */
+} shared_capture;
+
+/**
+ * \brief Published statistics.
+ */
+typedef struct shared_stats
+{
+    u_int64_t time;                 /**< Update time (ns since the epoch). */
+    stats_counters counters;        /**< Counters. */
+    char interfaces[STATS_INTERFACES_MAX][SHARED_NAME_MAX]; /**< Names. */
+    shared_capture capture;         /**< Capture state. */
+} shared_stats;
+
+/**
+ * \brief Shared memory segment.
+ */
+typedef struct shared_segment
+{
+    u_int32_t magic;                /**< SHARED_MAGIC. */
+    u_int32_t version;              /**< SHARED_VERSION. */
+    u_int32_t size;                 /**< Size of the segment. */
+    u_int32_t pid;                  /**< Publishing process. */
+    u_int64_t sequence;             /**< Odd while updating. */
+    shared_stats stats;             /**< Statistics. */
+} shared_segment;
+
+/**
+ * \brief Set the segment name.
+ * \param name Name (NULL not to publish).
+ */
+void shared_set_name (const char * name);
+
+/**
+ * \brief Check whether the statistics are published.
+ * \retval true If a name is set.
+ * \retval false otherwise.
+ */
+bool shared_enabled (void);
+
+/**
+ * \brief Create the segment.
+ * \param local Whether to publish without a name, for readers in this
+ * process.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+bool shared_open (bool local);
+
+/**
+ * \brief Get the segment of this process.
+ * \return Segment, or NULL if the statistics are not published.
+ */
+const shared_segment * shared_get (void);
+
+/**
+ * \brief Check whether an update is due (called once per packet).
+ * \param ts Packet timestamp.
+ * \retval true If the statistics should be published.
+ * \retval false otherwise.
+ */
+bool shared_due (const struct timeval * ts);
+
+/**
+ * \brief Publish the counters of the statistics module.
+ * \param capture Capture state.
+ */
+void shared_publish (const shared_capture * capture);
+
+/**
+ * \brief Remove the segment.
+ */
+void shared_close (void);
+
+/**
+ * \brief Map the segment of a running capture, read only.
+ * \param name Segment name.
+ * \return Segment, or NULL on error (a message is printed).
+ */
+const shared_segment * shared_attach (const char * name);
+
+/**
+ * \brief Read a consistent copy of the statistics.
+ * \param segment Segment.
+ * \param stats Copy.
+ * \retval true On success.
+ * \retval false If an update never ended (the writer is stuck or died).
+ */
+bool shared_read (const shared_segment * segment, shared_stats * stats);
+
+/**
+ * \brief Unmap a segment.
+ * \param segment Segment.
+ */
+void shared_detach (const shared_segment * segment);
+
+#endif /* __SHARED_H__ */
@@ -0,0 +1,103 @@
+/**
+ * \file sidecar.h
+ * \brief Sidecar index of offline captures.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * The index of a capture file is stored next to it (<file>.wdx). It records
+ * the file offset of every Nth packet, along with time bounds, and the first
+ * and last packets of each flow. It is built by a first pass over the file
+ * (when missing or out of date), then used to start reading at the relevant
+ * offset and to stop as soon as no later packet can be selected.
+ *
+ * Only classic pcap files (not pcapng) can be indexed.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __SIDECAR_H__
+#define __SIDECAR_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/time.h>
+
+#include <pcap/pcap.h>
+
+#include "wiredolphin/packet.h"
+#include "wiredolphin/flow.h"
+#include "wiredolphin/pcapfile.h"
+
+#define SIDECAR_INTERVAL_DEFAULT    4096    /**< Packets between entries. */
+
+/**
+ * \brief Verdict on a packet.
+ */
+typedef enum sidecar_verdict
+{
+    SIDECAR_ACCEPT,     /**< Selected. */
+    SIDECAR_SKIP,       /**< Not selected. */
+    SIDECAR_STOP,       /**< No later packet is selected. */
+} sidecar_verdict;
+
+/**
+ * \brief Only select the packets from a given time.
+ * \param from Time.
+ */
+void sidecar_set_from (const struct timeval * from);
+
+/**
+ * \brief Only select the packets up to a given time.
+ * \param to Time.
+ */
+void sidecar_set_to (const struct timeval * to);
+
+/**
+ * \brief Only select the packets of a flow (both directions).
+ * \param flow Flow.
+ */
+void sidecar_set_flow (const packet_flow * flow);
+
+/**
+ * \brief Set the number of packets between two index entries.
+ * \param interval Number of packets.
+ */
+void sidecar_set_interval (unsigned int interval);
+
+/**
+ * \brief Check whether a selection is set.
+ * \retval true If a selection is set.
+ * \retval false otherwise.
+ */
+bool sidecar_enabled (void);
+
+/**
+ * \brief Load (or build) the index of a file and seek to the first packet
+ * that may be selected.
+ * \param capture Capture of the file.
+ * \param file File.
+ * \param filter Filter, applied by sidecar_accept.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+bool sidecar_open (pcap_t * capture, const char * file, const char * filter);
+
+/**
+ * \brief Decide whether a packet is selected.
+ * \param info Decoded packet.
+ * \return Verdict.
+ */
+sidecar_verdict sidecar_accept (const packet_info * info);
+
+/**
+ * \brief Release the index.
+ */
+void sidecar_close (void);
+
+#endif /* __SIDECAR_H__ */
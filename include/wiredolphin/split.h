@@ -0,0 +1,77 @@
+/**
+ * \file split.h
+ * \brief Split-by-flow pcap writer.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * Each flow (5-tuple, both directions) is written to its own pcap file in a
+ * directory, such as tcp_10.0.0.1_80_10.0.0.2_51234.pcap.
+ *
+ * The open files are kept in a bounded flow table: the least recently used
+ * one is closed to make room, and reopened (appended to) if its flow comes
+ * back. The directory must be empty, so that only this capture is appended
+ * to. The number of open descriptors never exceeds the table capacity.
+ * Packets are batched per file, so that a file sees one write per batch.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __SPLIT_H__
+#define __SPLIT_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include <pcap/pcap.h>
+
+#include "wiredolphin/packet.h"
+#include "wiredolphin/flow.h"
+#include "wiredolphin/pcapfile.h"
+
+#define SPLIT_FILES_DEFAULT 256     /**< Default open files. */
+
+/**
+ * \brief Set the directory of the flow files.
+ * \param directory Directory.
+ */
+void split_set_directory (const char * directory);
+
+/**
+ * \brief Set the maximum number of open files.
+ * \param files Number of open files.
+ */
+void split_set_files (unsigned int files);
+
+/**
+ * \brief Check whether flows are written.
+ * \retval true If a directory is set.
+ * \retval false otherwise.
+ */
+bool split_enabled (void);
+
+/**
+ * \brief Create the directory and the table of open files.
+ * \param capture Capture.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+bool split_open (pcap_t * capture);
+
+/**
+ * \brief Write a packet to the file of its flow.
+ * \param info Decoded packet.
+ */
+void split_packet (const packet_info * info);
+
+/**
+ * \brief Write the pending batches, close the files.
+ */
+void split_close (void);
+
+#endif /* __SPLIT_H__ */
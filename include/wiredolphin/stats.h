@@ -0,0 +1,119 @@
+/**
+ * \file stats.h
+ * \brief Statistics.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * Packet and byte counters per interface, packet type, IP protocol and
+ * application. Counters of sampled packets are scaled by the sampling rate so
+ * that they estimate the actual traffic.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <pcap/pcap.h>
+
+#include "wiredolphin/packet.h"
+
+#define STATS_INTERFACES_MAX    32  /**< Interfaces accounted for apart. */
+
+/**
+ * \brief Packet type classes.
+ */
+typedef enum stats_packet_type
+{
+    STATS_PACKET_TYPE_IPV4 = 0,
+    STATS_PACKET_TYPE_IPV6,
+    STATS_PACKET_TYPE_ARP,
+    STATS_PACKET_TYPE_OTHER,
+    STATS_PACKET_TYPE_COUNT,
+} stats_packet_type;
+
+/**
+ * \brief Counters.
+ */
+typedef struct stats_counters
+{
+    u_int64_t received;                                 /**< Received packets. */
+    u_int64_t received_bytes;                           /**< Received bytes. */
+    u_int64_t malformed;                                /**< Decode errors. */
+    u_int64_t interface_packets[STATS_INTERFACES_MAX];  /**< Per interface. */
+    u_int64_t interface_bytes[STATS_INTERFACES_MAX];    /**< Per interface. */
+    u_int64_t sampled;                                  /**< Sampled packets. */
+    u_int64_t packets;                                  /**< Estimated packets. */
+    u_int64_t bytes;                                    /**< Estimated bytes. */
+    u_int64_t type_packets[STATS_PACKET_TYPE_COUNT];    /**< Per packet type. */
+    u_int64_t type_bytes[STATS_PACKET_TYPE_COUNT];      /**< Per packet type. */
+    u_int64_t protocol_packets[256];                    /**< Per IP protocol. */
+    u_int64_t protocol_bytes[256];                      /**< Per IP protocol. */
+    u_int64_t application_packets[PACKET_APP_COUNT];    /**< Per application. */
+    u_int64_t application_bytes[PACKET_APP_COUNT];      /**< Per application. */
+} stats_counters;
+
+/**
+ * \brief Convert a packet type class into a string.
+ * \param type Packet type class.
+ * \return String.
+ */
+const char * stats_packet_type_string (stats_packet_type type);
+
+/**
+ * \brief Name an interface, to account for its packets apart.
+ * \param interface Interface number.
+ * \param name Interface name.
+ */
+void stats_set_interface (unsigned int interface, const char * name);
+
+/**
+ * \brief Get the name of an interface.
+ * \param interface Interface number.
+ * \return Name, or NULL if the interface is not named.
+ */
+const char * stats_interface (unsigned int interface);
+
+/**
+ * \brief Account for a received packet, sampled or not.
+ * \param info Decoded packet.
+ */
+void stats_receive (const packet_info * info);
+
+/**
+ * \brief Account for a sampled packet.
+ * \param info Decoded packet.
+ * \param weight Number of packets this packet stands for.
+ */
+void stats_account (const packet_info * info, unsigned int weight);
+
+/**
+ * \brief Get the counters.
+ * \return Counters.
+ */
+const stats_counters * stats_get (void);
+
+/**
+ * \brief Print the counters.
+ * \param stream Output stream.
+ */
+void stats_print (FILE * stream);
+
+/**
+ * \brief Print counters.
+ * \param stream Output stream.
+ * \param counters Counters.
+ */
+void stats_print_counters (FILE * stream, const stats_counters * counters);
+
+#endif /* __STATS_H__ */
@@ -0,0 +1,83 @@
+/**
+ * \file tcpflow.h
+ * \brief TCP connection analysis.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * Every received TCP segment updates the state of its connection, kept in a
+ * bounded flow table (both directions together, TCPFLOW_FLOWS connections;
+ * the least recently active one makes room):
+ *
+ * - the handshake round trip time, from the SYN to the ACK of the SYN/ACK,
+ *   and its server part, from the SYN to the SYN/ACK (as seen from the
+ *   capture point);
+ * - the retransmissions and out of order segments of each direction: a
+ *   segment below the next expected sequence number is out of order if it
+ *   fills a hole the capture saw open, within the handshake round trip time
+ *   (TCPFLOW_REORDER without a handshake) of the highest segment, and a
+ *   retransmission otherwise;
+ * - the zero window advertisements (windows closing) and the duplicate ACKs.
+ *
+ * They are accounted per service (the port the SYN is sent to, the lower
+ * port for connections caught after their handshake), and printed at the end
+ * of the capture with the round trip time percentiles.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __TCPFLOW_H__
+#define __TCPFLOW_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "wiredolphin/packet.h"
+
+#define TCPFLOW_FLOWS       65536   /**< Connections tracked. */
+#define TCPFLOW_SERVICES    32      /**< Services accounted for apart. */
+#define TCPFLOW_REORDER     3000    /**< Reordering window (us). */
+
+/**
+ * \brief Analyse the TCP connections.
+ * \param enabled Whether to.
+ */
+void tcpflow_set_enabled (bool enabled);
+
+/**
+ * \brief Check whether the TCP connections are analysed.
+ * \retval true If they are.
+ * \retval false otherwise.
+ */
+bool tcpflow_enabled (void);
+
+/**
+ * \brief Allocate the flow table.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+bool tcpflow_open (void);
+
+/**
+ * \brief Account for a packet.
+ * \param info Decoded packet.
+ */
+void tcpflow_packet (const packet_info * info);
+
+/**
+ * \brief Release the flow table.
+ */
+void tcpflow_close (void);
+
+/**
+ * \brief Print the services.
+ * \param stream Output stream.
+ */
+void tcpflow_print (FILE * stream);
+
+#endif /* __TCPFLOW_H__ */
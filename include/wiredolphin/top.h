@@ -0,0 +1,80 @@
+/**
+ * \file top.h
+ * \brief Live dashboard.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * A thread of its own draws a dashboard on the terminal every TOP_PERIOD
+ * milliseconds: packet and bit rates with their recent history, drops, the
+ * busiest flows and talkers (source hosts) and the protocol mix. 'q' stops
+ * the capture.
+ *
+ * The capture thread counts the packets and bytes of the flows and talkers of
+ * the current period in bounded flow tables, and ranks them once per period:
+ * the ranking costs one pass over the active flows, whatever the packet rate.
+ * The dashboard reads the ranking and the published statistics (see
+ * shared.h) behind sequence locks, and never blocks the capture.
+ *
+ * Frames are drawn into a grid of cells; only the cells that changed since
+ * the previous frame are sent to the terminal.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __TOP_H__
+#define __TOP_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "wiredolphin/packet.h"
+#include "wiredolphin/shared.h"
+
+#define TOP_PERIOD  1000    /**< Refresh period (ms). */
+#define TOP_ROWS    8       /**< Flows and talkers shown. */
+#define TOP_FLOWS   16384   /**< Flows and talkers counted per period. */
+
+/**
+ * \brief Show the dashboard.
+ * \param enabled Whether to.
+ */
+void top_set_enabled (bool enabled);
+
+/**
+ * \brief Check whether the dashboard is shown.
+ * \retval true If it is.
+ * \retval false otherwise.
+ */
+bool top_enabled (void);
+
+/**
+ * \brief Take over the terminal and start the dashboard thread.
+ * \param segment Statistics to show.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+bool top_open (const shared_segment * segment);
+
+/**
+ * \brief Account for a packet.
+ * \param info Decoded packet.
+ */
+void top_packet (const packet_info * info);
+
+/**
+ * \brief Rank the flows and talkers of the period, if it is over.
+ */
+void top_publish (void);
+
+/**
+ * \brief Stop the dashboard thread and give the terminal back.
+ */
+void top_close (void);
+
+#endif /* __TOP_H__ */
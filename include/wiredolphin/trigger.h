@@ -0,0 +1,104 @@
+/**
+ * \file trigger.h
+ * \brief Pre-trigger capture.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * The last packets (up to a duration and a size) are kept in a circular
+ * arena allocated once. When a packet matches the trigger (a filter or a DHCP
+ * message type), the arena and the packets of the following seconds are
+ * written to a timestamped pcap file.
+ *
+ * The arena is written a chunk at a time, as packets come in: the capture
+ * does not stop while the file is being written. Packets received meanwhile
+ * are queued in the arena; the arena is only overwritten once written.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __TRIGGER_H__
+#define __TRIGGER_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include <pcap/pcap.h>
+
+#include "wiredolphin/packet.h"
+#include "wiredolphin/bootp.h"
+
+#define TRIGGER_SIZE_DEFAULT    64                      /**< Arena (MiB). */
+#define TRIGGER_POST_DEFAULT    10                      /**< Post-trigger (s). */
+#define TRIGGER_PREFIX_DEFAULT  "wiredolphin-trigger"   /**< File prefix. */
+
+/**
+ * \brief Set the trigger filter.
+ * \param filter Filter (pcap syntax).
+ */
+void trigger_set_filter (const char * filter);
+
+/**
+ * \brief Set the trigger DHCP message type.
+ * \param type Message type name, such as DHCP_NACK (or NACK).
+ * \retval true If the message type is known.
+ * \retval false otherwise.
+ */
+bool trigger_set_dhcp (const char * type);
+
+/**
+ * \brief Set the duration kept before the trigger.
+ * \param seconds Seconds (0: only limited by the size).
+ */
+void trigger_set_duration (unsigned int seconds);
+
+/**
+ * \brief Set the arena size.
+ * \param megabytes Size (MiB).
+ */
+void trigger_set_size (unsigned int megabytes);
+
+/**
+ * \brief Set the duration written after the trigger.
+ * \param seconds Seconds.
+ */
+void trigger_set_post (unsigned int seconds);
+
+/**
+ * \brief Set the prefix of the written files.
+ * \param prefix Prefix.
+ */
+void trigger_set_prefix (const char * prefix);
+
+/**
+ * \brief Check whether a trigger is set.
+ * \retval true If a trigger is set.
+ * \retval false otherwise.
+ */
+bool trigger_enabled (void);
+
+/**
+ * \brief Allocate the arena and compile the filter.
+ * \param capture Capture.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+bool trigger_open (pcap_t * capture);
+
+/**
+ * \brief Keep a packet, check the trigger, write pending packets.
+ * \param info Decoded packet.
+ */
+void trigger_packet (const packet_info * info);
+
+/**
+ * \brief Write the pending packets and release the arena.
+ */
+void trigger_close (void);
+
+#endif /* __TRIGGER_H__ */
@@ -0,0 +1,69 @@
+/**
+ * \file view.h
+ * \brief Additional views of the capture.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * A view prints the packets matching its own display filter, at its own
+ * verbosity level, to its own output. Packets are captured and decoded once
+ * and handed over to every matching view, instead of running one capture per
+ * output.
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __VIEW_H__
+#define __VIEW_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include <pcap/pcap.h>
+
+#include "wiredolphin/packet.h"
+#include "wiredolphin/callback.h"
+
+#define VIEW_MAX    16  /**< Number of views. */
+
+/**
+ * \brief Add a view.
+ * \param description <level>:<output>[:<filter>], output "-" being stdout.
+ * \retval true On success.
+ * \retval false If the description is invalid, there are too many views or
+ * memory runs out.
+ */
+bool view_add (const char * description);
+
+/**
+ * \brief Check whether a view prints to stdout.
+ * \retval true If a view output is "-".
+ * \retval false otherwise.
+ */
+bool view_stdout (void);
+
+/**
+ * \brief Open the outputs and compile the filters of the views.
+ * \param capture Capture (link type).
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+bool view_open (pcap_t * capture);
+
+/**
+ * \brief Hand a packet over to the matching views.
+ * \param info Decoded packet.
+ */
+void view_packet (const packet_info * info);
+
+/**
+ * \brief Close the outputs and forget the views.
+ */
+void view_close (void);
+
+#endif /* __VIEW_H__ */
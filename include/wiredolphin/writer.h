@@ -0,0 +1,104 @@
+/**
+ * \file writer.h
+ * \brief pcap file writer.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ *
+ * The captured packets are written to a pcap file, rotated by size or time.
+ *
+ * Packets are copied into large aligned buffers, which a background thread
+ * writes to the disk (optionally with O_DIRECT): disk latency never holds a
+ * live capture. When every buffer is waiting for the disk, packets of a live
+ * capture are dropped and counted (offline captures wait). Rotated files can
+ * be compressed (gzip, in a child process).
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#ifndef __WRITER_H__
+#define __WRITER_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include <pcap/pcap.h>
+
+#include "wiredolphin/pcapfile.h"
+
+/**
+ * \brief Set the file to write to.
+ * \param path File path (numbered when rotating).
+ */
+void writer_set_path (const char * path);
+
+/**
+ * \brief Set the size rotation.
+ * \param megabytes Maximum file size (MiB, 0: no limit).
+ */
+void writer_set_size (unsigned int megabytes);
+
+/**
+ * \brief Set the time rotation.
+ * \param seconds Maximum file duration (0: no limit).
+ */
+void writer_set_time (unsigned int seconds);
+
+/**
+ * \brief Set whether to compress the rotated files.
+ * \param compress Whether to compress.
+ */
+void writer_set_compress (bool compress);
+
+/**
+ * \brief Set whether to bypass the page cache (O_DIRECT).
+ * \param direct Whether to bypass the page cache.
+ */
+void writer_set_direct (bool direct);
+
+/**
+ * \brief Check whether packets are written.
+ * \retval true If a file is set.
+ * \retval false otherwise.
+ */
+bool writer_enabled (void);
+
+/**
+ * \brief Allocate the buffers and start the writer thread.
+ * \param capture Capture.
+ * \param live Whether the capture is live.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+bool writer_open (pcap_t * capture, bool live);
+
+/**
+ * \brief Write a packet.
+ * \param header pcap header.
+ * \param bytes Data.
+ */
+void writer_packet (const struct pcap_pkthdr * header, const u_char * bytes);
+
+/**
+ * \brief Get the number of buffers waiting for the writer thread.
+ * \return Queue depth.
+ */
+unsigned int writer_queued (void);
+
+/**
+ * \brief Get the number of packets dropped for want of a buffer.
+ * \return Dropped packets.
+ */
+u_int64_t writer_dropped (void);
+
+/**
+ * \brief Write the pending buffers, stop the writer thread.
+ */
+void writer_close (void);
+
+#endif /* __WRITER_H__ */
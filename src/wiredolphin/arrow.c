@@ -0,0 +1,640 @@
+/**
+ * \file arrow.c
+ * \brief Columnar export of the decoded headers (Arrow IPC stream).
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <endian.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "wiredolphin/arrow.h"
+#include "wiredolphin/bootp.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define ARROW_BUFFER_SIZE   (1024 * 1024)   /**< Output buffer size. */
+#define ARROW_METADATA_SIZE 4096            /**< Largest message metadata. */
+#define ARROW_SLOTS         8               /**< Fields of a table at most. */
+#define ARROW_ALIGNMENT     8               /**< Message and buffer alignment. */
+#define ARROW_CONTINUATION  0xffffffffu     /**< Message prefix. */
+
+/* Message.fbs and Schema.fbs values. */
+#define ARROW_VERSION_V5        4   /**< MetadataVersion.V5. */
+#define ARROW_HEADER_SCHEMA     1   /**< MessageHeader.Schema. */
+#define ARROW_HEADER_BATCH      3   /**< MessageHeader.RecordBatch. */
+#define ARROW_TYPE_INT          2   /**< Type.Int. */
+#define ARROW_TYPE_TIMESTAMP    10  /**< Type.Timestamp. */
+#define ARROW_TYPE_FIXED        15  /**< Type.FixedSizeBinary. */
+#define ARROW_MICROSECOND       2   /**< TimeUnit.MICROSECOND. */
+
+/**
+ * \brief Column types.
+ */
+typedef enum __arrow_type
+{
+    __ARROW_TIMESTAMP,              /**< Microseconds since the epoch. */
+    __ARROW_UINT,                   /**< Unsigned integer. */
+    __ARROW_FIXED,                  /**< Fixed size binary. */
+} __arrow_type;
+
+/**
+ * \brief Columns.
+ */
+enum
+{
+    __ARROW_TIME,
+    __ARROW_INTERFACE,
+    __ARROW_LENGTH,
+    __ARROW_PACKET_TYPE,
+    __ARROW_VLAN,
+    __ARROW_SRC_ADDR,
+    __ARROW_DEST_ADDR,
+    __ARROW_PROTOCOL,
+    __ARROW_SRC_PORT,
+    __ARROW_DEST_PORT,
+    __ARROW_TCP_FLAGS,
+    __ARROW_DHCP_TYPE,
+    __ARROW_COLUMN_COUNT,
+};
+
+/**
+ * \brief Column.
+ */
+typedef struct __arrow_column
+{
+    const char * name;              /**< Name. */
+    __arrow_type type;              /**< Type. */
+    size_t width;                   /**< Value size. */
+    bool nullable;                  /**< Whether values can be null. */
+    u_char * values;                /**< Values of the batch. */
+    u_char * validity;              /**< Validity bitmap of the batch. */
+    size_t nulls;                   /**< Null values in the batch. */
+} __arrow_column;
+
+/**
+ * \brief Field of a flatbuffer table.
+ */
+typedef struct __arrow_field
+{
+    unsigned int slot;              /**< Field number in the schema. */
+    size_t size;                    /**< Scalar or offset size. */
+    u_int64_t value;                /**< Scalar value. */
+    size_t position;                /**< Position, once written. */
+} __arrow_field;
+
+static __arrow_column __columns[__ARROW_COLUMN_COUNT] =
+{
+    [__ARROW_TIME]          = { "time", __ARROW_TIMESTAMP, 8, false, },
+    [__ARROW_INTERFACE]     = { "interface", __ARROW_UINT, 1, false, },
+    [__ARROW_LENGTH]        = { "length", __ARROW_UINT, 4, false, },
+    [__ARROW_PACKET_TYPE]   = { "packet_type", __ARROW_UINT, 2, false, },
+    [__ARROW_VLAN]          = { "vlan", __ARROW_UINT, 2, true, },
+    [__ARROW_SRC_ADDR]      = { "src_addr", __ARROW_FIXED, 16, true, },
+    [__ARROW_DEST_ADDR]     = { "dest_addr", __ARROW_FIXED, 16, true, },
+    [__ARROW_PROTOCOL]      = { "protocol", __ARROW_UINT, 1, true, },
+    [__ARROW_SRC_PORT]      = { "src_port", __ARROW_UINT, 2, true, },
+    [__ARROW_DEST_PORT]     = { "dest_port", __ARROW_UINT, 2, true, },
+    [__ARROW_TCP_FLAGS]     = { "tcp_flags", __ARROW_UINT, 1, true, },
+    [__ARROW_DHCP_TYPE]     = { "dhcp_type", __ARROW_UINT, 1, true, },
+};
+
+static const char * __path = NULL;  /**< Output file. */
+static FILE * __stream = NULL;      /**< Output. */
+static u_char * __memory = NULL;    /**< Column buffers. */
+static size_t __rows = 0;           /**< Packets in the current batch. */
+
+static u_char __metadata[ARROW_METADATA_SIZE];  /**< Message metadata. */
+static size_t __length = 0;                     /**< Metadata length. */
+
+/**
+ * \brief Set a value of the current row.
+ * \param column Column.
+ * \param value Value (width bytes, host byte order).
+ */
+static inline void __arrow_set (unsigned int column, const void * value);
+
+/**
+ * \brief Set a value of the current row to null.
+ * \param column Column.
+ */
+static inline void __arrow_null (unsigned int column);
+
+/**
+ * \brief Write the current batch, if any, and start a new one.
+ */
+static void __arrow_batch (void);
+
+/**
+ * \brief Write the schema.
+ */
+static void __arrow_schema (void);
+
+/**
+ * \brief Start the metadata of a message.
+ * \param type Header type.
+ * \param body Body length.
+ * \return Position of the header offset.
+ */
+static inline size_t __arrow_message (u_int8_t type, u_int64_t body);
+
+/**
+ * \brief Write the metadata of a message.
+ */
+static inline void __arrow_message_write (void);
+
+/**
+ * \brief Write the type table of a column.
+ * \param column Column.
+ * \return Table position.
+ */
+static inline size_t __arrow_type_table (const __arrow_column * column);
+
+/**
+ * \brief Write a flatbuffer table and its vtable.
+ * \param fields Fields, largest first (their position is set).
+ * \param count Field count.
+ * \return Table position.
+ */
+static inline size_t __arrow_table (__arrow_field * fields, size_t count);
+
+/**
+ * \brief Start a flatbuffer vector.
+ * \param count Element count.
+ * \param alignment Element alignment.
+ * \return Vector position.
+ */
+static inline size_t __arrow_vector (size_t count, size_t alignment);
+
+/**
+ * \brief Write a flatbuffer string.
+ * \param string String.
+ * \return String position.
+ */
+static inline size_t __arrow_string (const char * string);
+
+/**
+ * \brief Point a flatbuffer offset to an object.
+ * \param position Offset position.
+ * \param target Object position.
+ */
+static inline void __arrow_link (size_t position, size_t target);
+
+/**
+ * \brief Append a little endian scalar to the metadata.
+ * \param value Value.
+ * \param size Size.
+ * \return Position.
+ */
+static inline size_t __arrow_put (u_int64_t value, size_t size);
+
+/**
+ * \brief Pad the metadata with zeros.
+ * \param alignment Alignment.
+ * \param extra Bytes that have to follow before the alignment is reached.
+ */
+static inline void __arrow_pad (size_t alignment, size_t extra);
+
+/**
+ * \brief Write a buffer and its padding.
+ * \param bytes Buffer.
+ * \param size Size.
+ */
+static inline void __arrow_write (const void * bytes, size_t size);
+
+/**
+ * \brief Round a size up to the alignment.
+ * \param size Size.
+ * \return Aligned size.
+ */
+static inline size_t __arrow_align (size_t size);
+
+////////////////////////////////////////////////////////////////////////////////
+// Export.
+////////////////////////////////////////////////////////////////////////////////
+
+void arrow_set_path (const char * const path)
+{
+    __path = path;
+}
+
+bool arrow_enabled (void)
+{
+    return __path != NULL;
+}
+
+bool arrow_open (void)
+{
+    if (! arrow_enabled ())
+        return true;
+
+    size_t size = 0;
+    for (unsigned int i = 0; i < __ARROW_COLUMN_COUNT; ++i)
+        size += ARROW_BATCH_ROWS * __columns[i].width
+            + (__columns[i].nullable ? ARROW_BATCH_ROWS / 8 : 0);
+    __memory = calloc (1, size);
+    if (__memory == NULL)
+    {
+        fprintf (stderr, "Error: Could not allocate the columns.\n");
+        return false;
+    }
+
+    u_char * next = __memory;
+    for (unsigned int i = 0; i < __ARROW_COLUMN_COUNT; ++i)
+    {
+        __arrow_column * column = & __columns[i];
+        column->values = next;
+        next += ARROW_BATCH_ROWS * column->width;
+        column->validity = column->nullable ? next : NULL;
+        next += column->nullable ? ARROW_BATCH_ROWS / 8 : 0;
+        column->nulls = 0;
+    }
+
+    __stream = strcmp (__path, "-") ? fopen (__path, "wb") : stdout;
+    if (__stream == NULL)
+    {
+        fprintf (stderr, "Error: Could not open %s: %s.\n", __path,
+                strerror (errno));
+        free (__memory);
+        __memory = NULL;
+        return false;
+    }
+    setvbuf (__stream, NULL, _IOFBF, ARROW_BUFFER_SIZE);
+
+    __rows = 0;
+    __arrow_schema ();
+
+    return true;
+}
+
+void arrow_packet (const packet_info * const info)
+{
+    if (__stream == NULL)
+        return;
+
+    const struct pcap_pkthdr * header = info->header;
+    const packet_flow * flow = & info->flow;
+    u_int64_t time = (u_int64_t) header->ts.tv_sec * 1000000u
+        + (u_int64_t) header->ts.tv_usec;
+    u_int8_t interface = (u_int8_t) info->interface;
+
+    __arrow_set (__ARROW_TIME, & time);
+    __arrow_set (__ARROW_INTERFACE, & interface);
+    __arrow_set (__ARROW_LENGTH, & header->len);
+    __arrow_set (__ARROW_PACKET_TYPE, & flow->packet_type);
+
+    if (info->tagged)
+        __arrow_set (__ARROW_VLAN, & info->vlan);
+    else
+        __arrow_null (__ARROW_VLAN);
+
+    if (info->network != NULL && flow->packet_type == ETHERTYPE_IP)
+    {
+        struct in6_addr address = { .s6_addr = { [10] = 0xff, [11] = 0xff, }, };
+        memcpy (address.s6_addr + 12, & flow->src_addr, sizeof (struct in_addr));
+        __arrow_set (__ARROW_SRC_ADDR, & address);
+        memcpy (address.s6_addr + 12, & flow->dest_addr,
+                sizeof (struct in_addr));
+        __arrow_set (__ARROW_DEST_ADDR, & address);
+        __arrow_set (__ARROW_PROTOCOL, & flow->protocol);
+    }
+    else if (info->network != NULL && flow->packet_type == ETHERTYPE_IPV6)
+    {
+        __arrow_set (__ARROW_SRC_ADDR, & flow->src_addr);
+        __arrow_set (__ARROW_DEST_ADDR, & flow->dest_addr);
+        __arrow_set (__ARROW_PROTOCOL, & flow->protocol);
+    }
+    else
+    {
+        __arrow_null (__ARROW_SRC_ADDR);
+        __arrow_null (__ARROW_DEST_ADDR);
+        __arrow_null (__ARROW_PROTOCOL);
+    }
+
+    bool tcp = info->transport != NULL && flow->protocol == IPPROTO_TCP;
+    if (tcp || (info->transport != NULL && flow->protocol == IPPROTO_UDP))
+    {
+        __arrow_set (__ARROW_SRC_PORT, & flow->src_port);
+        __arrow_set (__ARROW_DEST_PORT, & flow->dest_port);
+    }
+    else
+    {
+        __arrow_null (__ARROW_SRC_PORT);
+        __arrow_null (__ARROW_DEST_PORT);
+    }
+
+    if (tcp)
+        __arrow_set (__ARROW_TCP_FLAGS, info->transport + 13);
+    else
+        __arrow_null (__ARROW_TCP_FLAGS);
+
+    dhcp_message_type type = 0;
+    if (info->application == PACKET_APP_BOOTP && info->data != NULL
+            && info->limit - info->data
+                > (ptrdiff_t) offsetof (bootp_header, vendor_specific))
+        type = dhcp_message_type_get (info->data, info->limit);
+    u_int8_t dhcp_type = (u_int8_t) type;
+    if (dhcp_type != 0)
+        __arrow_set (__ARROW_DHCP_TYPE, & dhcp_type);
+    else
+        __arrow_null (__ARROW_DHCP_TYPE);
+
+    if (++__rows == ARROW_BATCH_ROWS)
+        __arrow_batch ();
+}
+
+void arrow_close (void)
+{
+    if (__stream == NULL)
+        return;
+
+    __arrow_batch ();
+
+    /* End of stream: an empty message. */
+    u_int32_t end[2] = { htole32 (ARROW_CONTINUATION), 0, };
+    fwrite (end, sizeof end, 1, __stream);
+
+    if ((__stream != stdout ? fclose (__stream) : fflush (__stream)) == EOF)
+        fprintf (stderr, "Error: Could not write %s: %s.\n", __path,
+                strerror (errno));
+    __stream = NULL;
+    free (__memory);
+    __memory = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+void __arrow_set (unsigned int column, const void * const value)
+{
+    __arrow_column * current = & __columns[column];
+    memcpy (current->values + __rows * current->width, value, current->width);
+    if (current->nullable)
+        current->validity[__rows / 8] |= (u_char) (1u << (__rows % 8));
+}
+
+void __arrow_null (unsigned int column)
+{
+    __arrow_column * current = & __columns[column];
+    memset (current->values + __rows * current->width, 0, current->width);
+    ++current->nulls;
+}
+
+void __arrow_batch (void)
+{
+    if (__rows == 0)
+        return;
+
+    /* Each column has a validity bitmap, empty without nulls, and values. */
+    u_int64_t buffers[2 * __ARROW_COLUMN_COUNT][2];
+    u_int64_t body = 0;
+    for (unsigned int i = 0; i < __ARROW_COLUMN_COUNT; ++i)
+    {
+        const __arrow_column * column = & __columns[i];
+        buffers[2 * i][0] = body;
+        buffers[2 * i][1] = column->nulls > 0 ? (__rows + 7) / 8 : 0;
+        body += __arrow_align ((size_t) buffers[2 * i][1]);
+        buffers[2 * i + 1][0] = body;
+        buffers[2 * i + 1][1] = __rows * column->width;
+        body += __arrow_align ((size_t) buffers[2 * i + 1][1]);
+    }
+
+    size_t header = __arrow_message (ARROW_HEADER_BATCH, body);
+    __arrow_field batch[] =
+    {
+        { .slot = 0, .size = 8, .value = __rows, },     /* length */
+        { .slot = 1, .size = 4, },                      /* nodes */
+        { .slot = 2, .size = 4, },                      /* buffers */
+    };
+    __arrow_link (header, __arrow_table (batch, 3));
+
+    __arrow_link (batch[1].position,
+            __arrow_vector (__ARROW_COLUMN_COUNT, ARROW_ALIGNMENT));
+    for (unsigned int i = 0; i < __ARROW_COLUMN_COUNT; ++i)
+    {
+        __arrow_put (__rows, 8);
+        __arrow_put (__columns[i].nulls, 8);
+    }
+
+    __arrow_link (batch[2].position,
+            __arrow_vector (2 * __ARROW_COLUMN_COUNT, ARROW_ALIGNMENT));
+    for (unsigned int i = 0; i < 2 * __ARROW_COLUMN_COUNT; ++i)
+    {
+        __arrow_put (buffers[i][0], 8);
+        __arrow_put (buffers[i][1], 8);
+    }
+
+    __arrow_message_write ();
+    for (unsigned int i = 0; i < __ARROW_COLUMN_COUNT; ++i)
+    {
+        __arrow_column * column = & __columns[i];
+        __arrow_write (column->validity, (size_t) buffers[2 * i][1]);
+        __arrow_write (column->values, (size_t) buffers[2 * i + 1][1]);
+
+        if (column->nullable)
+            memset (column->validity, 0, (__rows + 7) / 8);
+        column->nulls = 0;
+    }
+
+    __rows = 0;
+}
+
+void __arrow_schema (void)
+{
+    size_t header = __arrow_message (ARROW_HEADER_SCHEMA, 0);
+    __arrow_field schema[] =
+    {
+        { .slot = 1, .size = 4, },                      /* fields */
+        { .slot = 0, .size = 2,                         /* endianness */
+            .value = __BYTE_ORDER == __LITTLE_ENDIAN ? 0 : 1, },
+    };
+    __arrow_link (header, __arrow_table (schema, 2));
+
+    size_t fields = __arrow_vector (__ARROW_COLUMN_COUNT, sizeof (u_int32_t));
+    __arrow_link (schema[0].position, fields);
+    fields += sizeof (u_int32_t);
+    for (unsigned int i = 0; i < __ARROW_COLUMN_COUNT; ++i)
+        __arrow_put (0, sizeof (u_int32_t));
+
+    for (unsigned int i = 0; i < __ARROW_COLUMN_COUNT; ++i)
+    {
+        const __arrow_column * column = & __columns[i];
+        __arrow_field field[] =
+        {
+            { .slot = 0, .size = 4, },                  /* name */
+            { .slot = 3, .size = 4, },                  /* type */
+            { .slot = 5, .size = 4, },                  /* children */
+            { .slot = 1, .size = 1, .value = column->nullable, },
+            { .slot = 2, .size = 1,                     /* type_type */
+                .value = column->type == __ARROW_TIMESTAMP
+                    ? ARROW_TYPE_TIMESTAMP : column->type == __ARROW_UINT
+                    ? ARROW_TYPE_INT : ARROW_TYPE_FIXED, },
+        };
+        __arrow_link (fields + i * sizeof (u_int32_t),
+                __arrow_table (field, 5));
+        __arrow_link (field[0].position, __arrow_string (column->name));
+        __arrow_link (field[1].position, __arrow_type_table (column));
+        __arrow_link (field[2].position, __arrow_vector (0, sizeof (u_int32_t)));
+    }
+
+    __arrow_message_write ();
+}
+
+size_t __arrow_message (u_int8_t type, u_int64_t body)
+{
+    __length = 0;
+    size_t root = __arrow_put (0, sizeof (u_int32_t));
+    __arrow_field message[] =
+    {
+        { .slot = 3, .size = 8, .value = body, },       /* bodyLength */
+        { .slot = 2, .size = 4, },                      /* header */
+        { .slot = 0, .size = 2, .value = ARROW_VERSION_V5, },
+        { .slot = 1, .size = 1, .value = type, },       /* header_type */
+    };
+    __arrow_link (root, __arrow_table (message, 4));
+
+    return message[1].position;
+}
+
+void __arrow_message_write (void)
+{
+    __arrow_pad (ARROW_ALIGNMENT, 0);
+    u_int32_t prefix[2] =
+    {
+        htole32 (ARROW_CONTINUATION),
+        htole32 ((u_int32_t) __length),
+    };
+    fwrite (prefix, sizeof prefix, 1, __stream);
+    fwrite (__metadata, 1, __length, __stream);
+}
+
+size_t __arrow_type_table (const __arrow_column * const column)
+{
+    size_t table;
+    if (column->type == __ARROW_TIMESTAMP)
+    {
+        __arrow_field timestamp[] =
+        {
+            { .slot = 1, .size = 4, },                  /* timezone */
+            { .slot = 0, .size = 2, .value = ARROW_MICROSECOND, },
+        };
+        table = __arrow_table (timestamp, 2);
+        __arrow_link (timestamp[0].position, __arrow_string ("UTC"));
+    }
+    else if (column->type == __ARROW_UINT)
+    {
+        __arrow_field integer[] =
+        {
+            { .slot = 0, .size = 4, .value = 8 * column->width, },
+            { .slot = 1, .size = 1, .value = false, },  /* is_signed */
+        };
+        table = __arrow_table (integer, 2);
+    }
+    else
+    {
+        __arrow_field fixed[] =
+        {
+            { .slot = 0, .size = 4, .value = column->width, },
+        };
+        table = __arrow_table (fixed, 1);
+    }
+
+    return table;
+}
+
+size_t __arrow_table (__arrow_field * const fields, size_t count)
+{
+    /* The table follows its vtable, at an aligned position, so that the
+     * offsets computed here are the aligned positions of the fields. */
+    u_int16_t vtable[2 + ARROW_SLOTS] = { 0, };
+    size_t slots = 0;
+    size_t size = sizeof (int32_t);
+    for (size_t i = 0; i < count; ++i)
+    {
+        size = (size + fields[i].size - 1) / fields[i].size * fields[i].size;
+        vtable[2 + fields[i].slot] = (u_int16_t) size;
+        size += fields[i].size;
+        if (fields[i].slot >= slots)
+            slots = fields[i].slot + 1;
+    }
+    vtable[0] = (u_int16_t) ((2 + slots) * sizeof (u_int16_t));
+    vtable[1] = (u_int16_t) size;
+
+    __arrow_pad (ARROW_ALIGNMENT, vtable[0]);
+    for (size_t i = 0; i < 2 + slots; ++i)
+        __arrow_put (vtable[i], sizeof (u_int16_t));
+
+    size_t table = __arrow_put (vtable[0], sizeof (int32_t));
+    for (size_t i = 0; i < count; ++i)
+    {
+        __arrow_pad (fields[i].size, 0);
+        fields[i].position = __arrow_put (fields[i].value, fields[i].size);
+    }
+
+    return table;
+}
+
+size_t __arrow_vector (size_t count, size_t alignment)
+{
+    __arrow_pad (alignment, sizeof (u_int32_t));
+    return __arrow_put (count, sizeof (u_int32_t));
+}
+
+size_t __arrow_string (const char * const string)
+{
+    size_t length = strlen (string);
+    __arrow_pad (sizeof (u_int32_t), 0);
+    size_t position = __arrow_put (length, sizeof (u_int32_t));
+    memcpy (__metadata + __length, string, length + 1);
+    __length += length + 1;
+
+    return position;
+}
+
+void __arrow_link (size_t position, size_t target)
+{
+    u_int32_t offset = htole32 ((u_int32_t) (target - position));
+    memcpy (__metadata + position, & offset, sizeof offset);
+}
+
+size_t __arrow_put (u_int64_t value, size_t size)
+{
+    /* The low order bytes come first. */
+    u_int64_t little = htole64 (value);
+    size_t position = __length;
+    memcpy (__metadata + __length, & little, size);
+    __length += size;
+
+    return position;
+}
+
+void __arrow_pad (size_t alignment, size_t extra)
+{
+    while ((__length + extra) % alignment != 0)
+        __metadata[__length++] = 0;
+}
+
+void __arrow_write (const void * const bytes, size_t size)
+{
+    static const u_char zeros[ARROW_ALIGNMENT] = { 0, };
+    fwrite (bytes, 1, size, __stream);
+    fwrite (zeros, 1, __arrow_align (size) - size, __stream);
+}
+
+size_t __arrow_align (size_t size)
+{
+    return (size + ARROW_ALIGNMENT - 1) / ARROW_ALIGNMENT * ARROW_ALIGNMENT;
+}
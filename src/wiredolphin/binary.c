@@ -0,0 +1,278 @@
+/**
+ * \file binary.c
+ * \brief Binary records of the decoded packets.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "wiredolphin/binary.h"
+#include "wiredolphin/bootp.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define BINARY_BUFFER_SIZE  (1024 * 1024)   /**< Output buffer size. */
+
+static const char * __path = NULL;  /**< Output file. */
+static FILE * __stream = NULL;      /**< Output. */
+static bool __started = false;      /**< A record was written. */
+static u_int64_t __time = 0;        /**< Timestamp of the last record (us). */
+
+/**
+ * \brief Get the offset of a header in a frame.
+ * \param info Decoded packet.
+ * \param header Header (or NULL).
+ * \return Offset, 0 if there is no header or it is too far.
+ */
+static inline u_int16_t __binary_offset (const packet_info * info,
+        const u_char * header);
+
+/**
+ * \brief Get a timestamp in microseconds.
+ * \param ts Timestamp.
+ * \return Microseconds.
+ */
+static inline u_int64_t __binary_time (const struct timeval * ts);
+
+////////////////////////////////////////////////////////////////////////////////
+// Writing.
+////////////////////////////////////////////////////////////////////////////////
+
+void binary_set_path (const char * const path)
+{
+    __path = path;
+}
+
+bool binary_enabled (void)
+{
+    return __path != NULL;
+}
+
+bool binary_open (pcap_t * const capture)
+{
+    if (! binary_enabled ())
+        return true;
+
+    __stream = strcmp (__path, "-") ? fopen (__path, "wb") : stdout;
+    if (__stream == NULL)
+    {
+        fprintf (stderr, "Error: Could not open %s: %s.\n", __path,
+                strerror (errno));
+        return false;
+    }
+    setvbuf (__stream, NULL, _IOFBF, BINARY_BUFFER_SIZE);
+
+    binary_file_header header =
+    {
+        .magic = BINARY_MAGIC,
+        .version = BINARY_VERSION,
+        .record_size = sizeof (binary_record),
+        .linktype = (u_int32_t) pcap_datalink (capture),
+        .snaplen = (u_int32_t) pcap_snapshot (capture),
+    };
+    fwrite (& header, sizeof header, 1, __stream);
+    __started = false;
+
+    return true;
+}
+
+void binary_packet (const packet_info * const info, callback_level level)
+{
+    if (__stream == NULL)
+        return;
+
+    const struct pcap_pkthdr * header = info->header;
+    u_int64_t time = __binary_time (& header->ts);
+    binary_record record;
+    memset (& record, 0, sizeof record);
+
+    /* Deltas only go forward: merged or multiple sources may not. */
+    bool absolute = ! __started || time < __time
+        || time - __time > UINT32_MAX;
+    record.length = (u_int32_t) (sizeof record
+        + (absolute ? sizeof time : 0) + header->caplen);
+    record.delta = absolute ? 0 : (u_int32_t) (time - __time);
+    record.flags = (u_int8_t) ((absolute ? BINARY_ABSOLUTE : 0)
+        | (info->malformed ? BINARY_MALFORMED : 0));
+    record.len = header->len;
+    record.caplen = header->caplen;
+    record.level = (u_int8_t) level;
+    record.interface = (u_int8_t) info->interface;
+
+    record.packet_type = info->flow.packet_type;
+    record.protocol = info->flow.protocol;
+    record.src_port = info->flow.src_port;
+    record.dest_port = info->flow.dest_port;
+    record.src_addr = info->flow.src_addr;
+    record.dest_addr = info->flow.dest_addr;
+    record.application = (u_int8_t) info->application;
+    if (header->caplen >= sizeof (struct ether_header))
+    {
+        const struct ether_header * ethernet =
+            (const struct ether_header *) info->frame;
+        memcpy (record.src_mac, ethernet->ether_shost, ETH_ALEN);
+        memcpy (record.dest_mac, ethernet->ether_dhost, ETH_ALEN);
+    }
+
+    record.network = __binary_offset (info, info->network);
+    record.transport = __binary_offset (info, info->transport);
+    record.data = __binary_offset (info, info->data);
+    if (info->flow.protocol == IPPROTO_TCP && info->transport != NULL)
+        record.tcp_flags = info->transport[13];
+    if (info->application == PACKET_APP_BOOTP && info->data != NULL
+            && info->limit - info->data
+                > (ptrdiff_t) offsetof (bootp_header, vendor_specific))
+        record.options = __binary_offset (info,
+                info->data + offsetof (bootp_header, vendor_specific));
+
+    fwrite (& record, sizeof record, 1, __stream);
+    if (absolute)
+        fwrite (& time, sizeof time, 1, __stream);
+    fwrite (info->frame, 1, header->caplen, __stream);
+
+    __started = true;
+    __time = time;
+}
+
+void binary_close (void)
+{
+    if (__stream == NULL)
+        return;
+
+    if ((__stream != stdout ? fclose (__stream) : fflush (__stream)) == EOF)
+        fprintf (stderr, "Error: Could not write %s: %s.\n", __path,
+                strerror (errno));
+    __stream = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reading.
+////////////////////////////////////////////////////////////////////////////////
+
+bool binary_reader_open (binary_reader * const reader, FILE * const stream)
+{
+    memset (reader, 0, sizeof (binary_reader));
+    reader->stream = stream;
+
+    binary_file_header * header = & reader->header;
+    if (fread (header, sizeof (binary_file_header), 1, stream) != 1)
+    {
+        fprintf (stderr, "Error: Truncated binary record file.\n");
+        return false;
+    }
+    if (header->magic == __builtin_bswap32 (BINARY_MAGIC))
+    {
+        fprintf (stderr, "Error: The records were written on a machine of "
+                "another byte order.\n");
+        return false;
+    }
+    if (header->magic != BINARY_MAGIC || header->version != BINARY_VERSION
+            || header->record_size != sizeof (binary_record))
+    {
+        fprintf (stderr, "Error: Not a binary record file (version %u).\n",
+                BINARY_VERSION);
+        return false;
+    }
+
+    return true;
+}
+
+bool binary_reader_next (binary_reader * const reader,
+        binary_record * const record, struct pcap_pkthdr * const header,
+        const u_char ** const bytes)
+{
+    size_t count = fread (record, 1, sizeof (binary_record), reader->stream);
+    if (count != sizeof (binary_record))
+    {
+        reader->failed = count > 0 || ferror (reader->stream);
+        if (reader->failed)
+            fprintf (stderr, "Error: Truncated record.\n");
+        return false;
+    }
+
+    bool absolute = record->flags & BINARY_ABSOLUTE;
+    size_t expected = sizeof (binary_record)
+        + (absolute ? sizeof (u_int64_t) : 0) + record->caplen;
+    if (record->length < expected)
+    {
+        fprintf (stderr, "Error: Invalid record.\n");
+        reader->failed = true;
+        return false;
+    }
+
+    u_int64_t time = reader->time + record->delta;
+    if (absolute && fread (& time, sizeof time, 1, reader->stream) != 1)
+    {
+        fprintf (stderr, "Error: Truncated record.\n");
+        reader->failed = true;
+        return false;
+    }
+
+    /* Unknown trailing fields of later versions are skipped. */
+    size_t size = record->length - sizeof (binary_record)
+        - (absolute ? sizeof time : 0);
+    if (size > reader->size)
+    {
+        u_char * grown = realloc (reader->bytes, size);
+        if (grown == NULL)
+        {
+            fprintf (stderr, "Error: Could not allocate a record.\n");
+            return false;
+        }
+        reader->bytes = grown;
+        reader->size = size;
+    }
+    if (fread (reader->bytes, 1, size, reader->stream) != size)
+    {
+        fprintf (stderr, "Error: Truncated record.\n");
+        reader->failed = true;
+        return false;
+    }
+
+    reader->time = time;
+    header->ts.tv_sec = (time_t) (time / 1000000u);
+    header->ts.tv_usec = (suseconds_t) (time % 1000000u);
+    header->caplen = record->caplen;
+    header->len = record->len;
+    * bytes = reader->bytes;
+
+    return true;
+}
+
+void binary_reader_close (binary_reader * const reader)
+{
+    free (reader->bytes);
+    reader->bytes = NULL;
+    reader->size = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+u_int16_t __binary_offset (const packet_info * const info,
+        const u_char * const header)
+{
+    if (header == NULL || header - info->frame > UINT16_MAX)
+        return 0;
+
+    return (u_int16_t) (header - info->frame);
+}
+
+u_int64_t __binary_time (const struct timeval * const ts)
+{
+    return (u_int64_t) ts->tv_sec * 1000000u + (u_int64_t) ts->tv_usec;
+}
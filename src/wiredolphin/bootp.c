@@ -164,3 +164,34 @@ const char * dhcp_message_type_string (dhcp_message_type type)
 
     return dhcp_message_strings[type > 0 && type <= DHCP_RELEASE ? type : 0];
 }
+
+dhcp_message_type dhcp_message_type_get (const u_int8_t * bytes,
+        const u_int8_t * const limit)
+{
+    const bootp_header * header = (const bootp_header *) bytes;
+
+    /* The options start after the magic cookie. */
+    bytes = header->vendor_specific + 4;
+    if (bytes > limit || ntohl (* (const u_int32_t *) header->vendor_specific)
+            != BOOTP_MAGIC_COOKIE)
+        return 0;
+
+    while (bytes + 2 <= limit && bytes[0] != 255)
+    {
+        /* Pad option. */
+        if (bytes[0] == 0)
+        {
+            ++bytes;
+            continue;
+        }
+
+        bootp_tlv tlv = bootp_extract_tlv (bytes);
+        if (tlv.next > limit)
+            break;
+        if (tlv.type == BOOTP_DHCP_MESSAGE && tlv.length >= 1)
+            return tlv.value[0];
+        bytes = tlv.next;
+    }
+
+    return 0;
+}
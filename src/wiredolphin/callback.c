@@ -13,6 +13,7 @@
  */
 
 #include "wiredolphin/callback.h"
+#include "wiredolphin/probes.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // Static utilities.
@@ -52,28 +53,47 @@ static inline void __print_bytes (FILE * stream, const u_char * bytes,
 static inline void __print_bytes_start (FILE * stream, const u_char * bytes,
         const u_char * limit);
 
+/**
+ * \brief Get the output stream of a callback.
+ * \param user Additional user parameters: output stream (or NULL).
+ * \return Output stream, stdout by default.
+ */
+static inline FILE * __callback_stream (u_char * user);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Callbacks.
 ////////////////////////////////////////////////////////////////////////////////
 
+pcap_handler callback_handler (callback_level level)
+{
+    static const pcap_handler handlers[CALLBACK_LEVEL_COUNT] =
+    {
+        [CALLBACK_RAW]          = callback_raw_packet,
+        [CALLBACK_CONCISE]      = callback_info_concise,
+        [CALLBACK_SYNTHETIC]    = callback_info_synthetic,
+        [CALLBACK_COMPLETE]     = callback_info_complete,
+        [CALLBACK_STATS]        = callback_stats,
+    };
+
+    return handlers[level < CALLBACK_LEVEL_COUNT ? level : CALLBACK_COMPLETE];
+}
+
 void callback_raw_packet (u_char * user, const struct pcap_pkthdr * header,
     const u_char * bytes)
 {
-    /* Ignore user. */
-    (void) user;
+    FILE * stream = __callback_stream (user);
 
     /* Print the packet. */
-    __raw_packet_print (stdout, bytes, header->caplen);
+    __raw_packet_print (stream, bytes, header->caplen);
 }
 
 void callback_info_concise (u_char * user, const struct pcap_pkthdr * header,
     const u_char * bytes)
 {
-    (void) user;
-
+    FILE * stream = __callback_stream (user);
     const u_char * limit = bytes + header->caplen;
 
-    header_ethernet_print_synthetic (stdout, bytes);
+    header_ethernet_print_synthetic (stream, bytes);
 
     uint16_t packet_type = header_ethernet_packet_type (bytes);
     bytes = header_ethernet_data (bytes);
@@ -177,7 +197,7 @@ void callback_info_concise (u_char * user, const struct pcap_pkthdr * header,
             inet_ntop (AF_INET6, & src_addr, buffer_1, INET6_ADDRSTRLEN);
             inet_ntop (AF_INET6, & dest_addr, buffer_2, INET6_ADDRSTRLEN);
         }
-        fprintf (stdout, "; %s:%u -> %s:%u, %s",
+        fprintf (stream, "; %s:%u -> %s:%u, %s",
                 buffer_1, source_port,
                 buffer_2, dest_port,
                 protocol);
@@ -188,13 +208,16 @@ void callback_info_concise (u_char * user, const struct pcap_pkthdr * header,
         #define __application(port,name) \
             if (source_port == (port) || dest_port == (port)) \
             { \
-                fprintf (stdout, "; %s: ", (name)); \
-                __print_bytes_start (stdout, bytes, limit); \
+                PROBE2 (dissect__entry, (port), (name)); \
+                fprintf (stream, "; %s: ", (name)); \
+                __print_bytes_start (stream, bytes, limit); \
+                PROBE1 (dissect__return, (port)); \
             }
 
         __application (20, "FTP data");
         __application (21, "FTP control");
         __application (25, "SMTP");
+        __application (53, "DNS");
         __application (67, "BOOTP");
         __application (68, "BOOTP");
         __application (80, "HTTP");
@@ -208,23 +231,22 @@ void callback_info_concise (u_char * user, const struct pcap_pkthdr * header,
         #undef __application
     }
 
-    fprintf (stdout, "\n\n");
+    fprintf (stream, "\n\n");
 
 }
 
 void callback_info_synthetic (u_char * user, const struct pcap_pkthdr * header,
     const u_char * bytes)
 {
-    (void) user;
-
+    FILE * stream = __callback_stream (user);
     const u_char * limit = bytes + header->caplen;
 
-    fprintf (stdout,
+    fprintf (stream,
             "*****************************************************************"
             "***************\n\n");
 
-    header_ethernet_print_synthetic (stdout, bytes);
-    fprintf (stdout, "\n");
+    header_ethernet_print_synthetic (stream, bytes);
+    fprintf (stream, "\n");
 
     uint16_t packet_type = header_ethernet_packet_type (bytes);
     bytes = header_ethernet_data (bytes);
@@ -299,7 +321,7 @@ void callback_info_synthetic (u_char * user, const struct pcap_pkthdr * header,
             inet_ntop (AF_INET6, & src_addr, buffer_1, INET6_ADDRSTRLEN);
             inet_ntop (AF_INET6, & dest_addr, buffer_2, INET6_ADDRSTRLEN);
         }
-        fprintf (stdout, "%s:%u -> %s:%u, %s\n",
+        fprintf (stream, "%s:%u -> %s:%u, %s\n",
                 buffer_1, source_port,
                 buffer_2, dest_port,
                 protocol);
@@ -310,14 +332,17 @@ void callback_info_synthetic (u_char * user, const struct pcap_pkthdr * header,
         #define __application(port,name) \
             if (source_port == (port) || dest_port == (port)) \
             { \
-                fprintf (stdout, "%s: ", (name)); \
-                __print_bytes_start (stdout, bytes, limit); \
-                fprintf (stdout, "\n"); \
+                PROBE2 (dissect__entry, (port), (name)); \
+                fprintf (stream, "%s: ", (name)); \
+                __print_bytes_start (stream, bytes, limit); \
+                fprintf (stream, "\n"); \
+                PROBE1 (dissect__return, (port)); \
             }
 
         __application (20, "FTP data");
         __application (21, "FTP control");
         __application (25, "SMTP");
+        __application (53, "DNS");
         __application (67, "BOOTP");
         __application (68, "BOOTP");
         __application (80, "HTTP");
@@ -331,27 +356,26 @@ void callback_info_synthetic (u_char * user, const struct pcap_pkthdr * header,
         #undef __application
     }
 
-    fprintf (stdout, "\n");
+    fprintf (stream, "\n");
 }
 
 void callback_info_complete (u_char * user, const struct pcap_pkthdr * header,
     const u_char * bytes)
 {
-    /* Ignore user. */
-    (void) user;
+    FILE * stream = __callback_stream (user);
 
     const u_char * limit = bytes + header->caplen;
 
-    fprintf (stdout,
+    fprintf (stream,
             "*****************************************************************"
             "***************\n\n");
 
     /* Print the raw packet. */
-    __raw_packet_print (stdout, bytes, header->caplen);
+    __raw_packet_print (stream, bytes, header->caplen);
 
     /* Print the ethernet header. */
-    header_ethernet_print_complete (stdout, bytes);
-    fprintf (stdout, "\n");
+    header_ethernet_print_complete (stream, bytes);
+    fprintf (stream, "\n");
 
     uint8_t next_protocol = 0;
 
@@ -362,16 +386,16 @@ void callback_info_complete (u_char * user, const struct pcap_pkthdr * header,
     {
         case ETHERTYPE_IP:
             next_protocol = header_ipv4_protocol (bytes);
-            header_ipv4_print_complete (stdout, bytes);
+            header_ipv4_print_complete (stream, bytes);
             bytes = header_ipv4_data (bytes);
             break;
         case ETHERTYPE_ARP:
-            header_arp_print_complete (stdout, bytes);
+            header_arp_print_complete (stream, bytes);
             bytes = NULL;
             break;
         case ETHERTYPE_IPV6:
             next_protocol = header_ipv6_protocol (bytes);
-            header_ipv6_print_complete (stdout, bytes);
+            header_ipv6_print_complete (stream, bytes);
             bytes = header_ipv6_data (bytes);
             break;
         default:
@@ -386,23 +410,23 @@ void callback_info_complete (u_char * user, const struct pcap_pkthdr * header,
         switch (next_protocol)
         {
             case 1: /* ICMP */
-                header_icmp4_print_complete (stdout, bytes);
+                header_icmp4_print_complete (stream, bytes);
                 bytes = NULL;
                 break;
             case 6: /* TCP */
-                header_tcp4_print_complete (stdout, bytes);
+                header_tcp4_print_complete (stream, bytes);
                 source_port = header_tcp4_source_port (bytes);
                 dest_port = header_tcp4_dest_port (bytes);
                 bytes = header_tcp4_data (bytes);
                 break;
             case 17: /* UDP */
-                header_udp4_print_complete (stdout, bytes);
+                header_udp4_print_complete (stream, bytes);
                 source_port = header_udp4_source_port (bytes);
                 dest_port = header_udp4_dest_port (bytes);
                 bytes = header_udp4_data (bytes);
                 break;
             case 58: /* ICMP v6 */
-                header_icmp6_print_complete (stdout, bytes);
+                header_icmp6_print_complete (stream, bytes);
                 bytes = NULL;
                 break;
             default:
@@ -414,16 +438,20 @@ void callback_info_complete (u_char * user, const struct pcap_pkthdr * header,
         #define __text_application(port,name) \
             if (source_port == (port) || dest_port == (port)) \
             { \
-                __print_name (stdout, (name)); \
-                __print_bytes (stdout, bytes, limit); \
-                fprintf (stdout, "\n\n"); \
+                PROBE2 (dissect__entry, (port), (name)); \
+                __print_name (stream, (name)); \
+                __print_bytes (stream, bytes, limit); \
+                fprintf (stream, "\n\n"); \
+                PROBE1 (dissect__return, (port)); \
             }
 
         #define __encrypted_text_application(port,name) \
             if (source_port == (port) || dest_port == (port)) \
             { \
-                __print_name (stdout, (name)); \
-                __raw_packet_print (stdout, bytes, (size_t) (limit - bytes)); \
+                PROBE2 (dissect__entry, (port), (name)); \
+                __print_name (stream, (name)); \
+                __raw_packet_print (stream, bytes, (size_t) (limit - bytes)); \
+                PROBE1 (dissect__return, (port)); \
             }
 
         __text_application (20, "FTP data");
@@ -440,13 +468,32 @@ void callback_info_complete (u_char * user, const struct pcap_pkthdr * header,
 
         if (source_port == 67 || dest_port == 67 || source_port == 68
                 || dest_port == 68)
-            bootp_print (stdout, (const bootp_header *) bytes);
+        {
+            PROBE2 (dissect__entry, 67, "BOOTP");
+            bootp_print (stream, (const bootp_header *) bytes);
+            PROBE1 (dissect__return, 67);
+        }
+
+        /* Over TCP, messages follow their 2 bytes length. */
+        if ((source_port == 53 || dest_port == 53)
+                && (next_protocol != 6 || limit - bytes >= 2))
+        {
+            PROBE2 (dissect__entry, 53, "DNS");
+            dns_print (stream, next_protocol == 6 ? bytes + 2 : bytes, limit);
+            PROBE1 (dissect__return, 53);
+        }
 
         #undef __text_application
         #undef __encrypted_text_application
     }
 }
 
+void callback_stats (u_char * user, const struct pcap_pkthdr * header,
+    const u_char * bytes)
+{
+    (void) user; (void) header; (void) bytes;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Misc.
 ////////////////////////////////////////////////////////////////////////////////
@@ -512,3 +559,8 @@ void __print_bytes_start (FILE * const stream, const u_char * bytes,
                     (* bytes) > 31 && (* bytes) < 127 ? * bytes : '.');
     }
 }
+
+FILE * __callback_stream (u_char * const user)
+{
+    return user != NULL ? (FILE *) user : stdout;
+}
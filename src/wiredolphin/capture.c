@@ -12,9 +12,128 @@
  * http://www.wtfpl.net/ for more details.
  */
 
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
 #include "wiredolphin/capture.h"
 
-static pcap_handler wiredolphin_callback = callback_info_complete;
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * \brief Requested verbosity level.
+ */
+static callback_level __level = CALLBACK_COMPLETE;
+
+/**
+ * \brief Current capture.
+ */
+static pcap_t * __capture = NULL;
+
+/**
+ * \brief Whether the current capture is live.
+ */
+static bool __live = false;
+
+/**
+ * \brief Whether to print the statistics at the end of the capture.
+ */
+static bool __statistics = false;
+
+/**
+ * \brief Whether the capture was interrupted.
+ */
+static volatile sig_atomic_t __interrupted = 0;
+
+#define CAPTURE_TIMEOUT     100     /**< Delivery timeout of interfaces (ms). */
+#define CAPTURE_BATCH       64      /**< Packets read from an interface at once. */
+
+/**
+ * \brief Interfaces captured at once.
+ */
+typedef struct __capture_interfaces
+{
+    pcap_t * captures[STATS_INTERFACES_MAX];    /**< Captures. */
+    char * const * names;                       /**< Interface names. */
+    size_t count;                               /**< Number of interfaces. */
+} __capture_interfaces;
+
+/**
+ * \brief Interfaces of the current capture, if several.
+ */
+static const __capture_interfaces * __interfaces = NULL;
+
+/**
+ * \brief Interface of the packet being handled.
+ */
+static unsigned int __interface = 0;
+
+/**
+ * \brief Function reading the packets of a source other than a capture.
+ */
+typedef void (* __capture_loop) (void * sources);
+
+/**
+ * \brief Handle a packet: select it, keep it for the trigger, write it,
+ * sample it, account for it and hand it over to the callback (or record it).
+ * \param user Additional user parameters.
+ * \param header pcap header.
+ * \param bytes Data.
+ */
+static void __capture_packet (u_char * user, const struct pcap_pkthdr * header,
+        const u_char * bytes);
+
+/**
+ * \brief Run a capture until its end or an interruption.
+ * \param capture Capture.
+ * \param live Whether the capture is live.
+ * \param loop Function reading the packets instead of capture (or NULL).
+ * \param sources Source read by loop.
+ */
+static inline void __capture_run (pcap_t * capture, bool live,
+        __capture_loop loop, void * sources);
+
+/**
+ * \brief Read merged files until their end or an interruption.
+ * \param sources Merge.
+ */
+static void __capture_loop_merge (void * sources);
+
+/**
+ * \brief Read a followed file until an error or an interruption.
+ * \param sources Followed file.
+ */
+static void __capture_loop_follow (void * sources);
+
+/**
+ * \brief Read several interfaces as they become ready, until an
+ * interruption or the loss of every interface.
+ * \param sources Interfaces.
+ */
+static void __capture_loop_interfaces (void * sources);
+
+/**
+ * \brief Stop the current capture (signal handler).
+ * \param signal_number Signal number.
+ */
+static void __capture_interrupt (int signal_number);
+
+/**
+ * \brief Publish the statistics into shared memory.
+ */
+static void __capture_publish (void);
+
+/**
+ * \brief Print the end of capture reports.
+ */
+static inline void __capture_report (void);
+
+////////////////////////////////////////////////////////////////////////////////
+// Capture.
+////////////////////////////////////////////////////////////////////////////////
 
 bool check_interface (const char * interface)
 {
@@ -48,7 +167,8 @@ void monitor_interface (const char * interface, const char * filter)
         {
             pcap_compile (capture, & compiled_filter, filter, 0, 0);
             pcap_setfilter (capture, & compiled_filter);
-            pcap_loop (capture, -1, wiredolphin_callback, NULL);
+            __capture_run (capture, true, NULL, NULL);
+            pcap_close (capture);
         }
         else
             fprintf (stderr, "Error: Could not open capture.\n");
@@ -57,31 +177,495 @@ void monitor_interface (const char * interface, const char * filter)
         fprintf (stderr, "Error: interface %s not found.\n", interface);
 }
 
-void monitor_file (const char * file, const char * filter)
+void monitor_interfaces (char * const * const names, size_t count,
+        const char * const filter)
 {
     char error_buffer[PCAP_ERRBUF_SIZE];
     struct bpf_program compiled_filter;
+    __capture_interfaces interfaces = { .names = names, .count = 0, };
 
-    pcap_t * capture = pcap_open_offline (file, error_buffer);
-    if (capture != NULL)
+    if (count > STATS_INTERFACES_MAX)
     {
+        fprintf (stderr, "Error: At most %u interfaces can be monitored.\n",
+                STATS_INTERFACES_MAX);
+        return;
+    }
+
+    bool success = true;
+    for (size_t i = 0; success && i < count; ++i)
+    {
+        if (! check_interface (names[i]))
+        {
+            fprintf (stderr, "Error: interface %s not found.\n", names[i]);
+            success = false;
+            break;
+        }
+
+        pcap_t * capture = pcap_open_live (names[i], 65535, 0, CAPTURE_TIMEOUT,
+                error_buffer);
+        if (capture == NULL)
+        {
+            fprintf (stderr, "Error: Could not open %s: %s.\n", names[i],
+                    error_buffer);
+            success = false;
+            break;
+        }
+        interfaces.captures[interfaces.count++] = capture;
+
+        if (pcap_setnonblock (capture, 1, error_buffer)
+                || pcap_get_selectable_fd (capture) < 0)
+        {
+            fprintf (stderr, "Error: %s can not be polled.\n", names[i]);
+            success = false;
+        }
+        else if (pcap_datalink (capture)
+                != pcap_datalink (interfaces.captures[0]))
+        {
+            fprintf (stderr, "Error: %s: Link type differs from %s.\n",
+                    names[i], names[0]);
+            success = false;
+        }
+
         pcap_compile (capture, & compiled_filter, filter, 0, 0);
         pcap_setfilter (capture, & compiled_filter);
-        pcap_loop (capture, -1, wiredolphin_callback, NULL);
+        stats_set_interface ((unsigned int) i, names[i]);
+    }
+
+    if (success)
+    {
+        __interfaces = & interfaces;
+        __capture_run (interfaces.captures[0], true, __capture_loop_interfaces,
+                & interfaces);
+        __interfaces = NULL;
+    }
+
+    for (size_t i = 0; i < interfaces.count; ++i)
+        pcap_close (interfaces.captures[i]);
+}
+
+void monitor_file (const char * file, const char * filter)
+{
+    char error_buffer[PCAP_ERRBUF_SIZE];
+    struct bpf_program compiled_filter;
+
+    bool plain;
+    FILE * stream = input_open (file, & plain);
+    if (stream == NULL)
+    {
+        fprintf (stderr, "Error: Could not open %s: %s.\n", file,
+                strerror (errno));
+        return;
+    }
+
+    pcap_t * capture = pcap_fopen_offline (stream, error_buffer);
+    if (capture == NULL)
+    {
+        fprintf (stderr, "Error: Could not open capture: %s.\n", error_buffer);
+        fclose (stream);
+    }
+    else if (sidecar_enabled () && ! plain)
+    {
+        fprintf (stderr, "Error: --from, --to and --flow need an uncompressed "
+                "file.\n");
+        pcap_close (capture);
     }
     else
-        fprintf (stderr, "Error: Could not open capture.\n");
+    {
+        /* With an index, the filter is applied after the selection. */
+        if (! sidecar_enabled ())
+        {
+            pcap_compile (capture, & compiled_filter, filter, 0, 0);
+            pcap_setfilter (capture, & compiled_filter);
+        }
+        if (sidecar_open (capture, file, filter))
+            __capture_run (capture, false, NULL, NULL);
+        sidecar_close ();
+        pcap_close (capture);
+    }
+
+    input_finish ();
+}
+
+void monitor_files (char * const * const files, size_t count,
+        const char * const filter)
+{
+    if (sidecar_enabled ())
+    {
+        fprintf (stderr, "Error: --from, --to and --flow need a single file.\n");
+        return;
+    }
+
+    merge * sources = merge_open (files, count, filter);
+    if (sources != NULL)
+    {
+        __capture_run (merge_capture (sources), false, __capture_loop_merge,
+                sources);
+        merge_close (sources);
+    }
+    input_finish ();
+}
+
+void monitor_follow (const char * const file, const char * const filter)
+{
+    if (sidecar_enabled ())
+    {
+        fprintf (stderr, "Error: --from, --to and --flow need a complete file.\n");
+        return;
+    }
+
+    follow * followed = follow_open (file, filter, & __interrupted);
+    if (followed != NULL)
+    {
+        __capture_run (follow_capture (followed), false, __capture_loop_follow,
+                followed);
+        follow_close (followed);
+    }
 }
 
 void set_callback (unsigned int id)
 {
-    static pcap_handler callbacks[] =
+    __level = id < CALLBACK_LEVEL_COUNT ? id : CALLBACK_COMPLETE;
+}
+
+void set_statistics (bool statistics)
+{
+    __statistics = statistics;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+void __capture_packet (u_char * user, const struct pcap_pkthdr * header,
+        const u_char * bytes)
+{
+    PROFILE_ENTER ();
+    PROBE3 (packet__receive, header->caplen, header->len, __interface);
+
+    packet_info info;
+    packet_decode (header, bytes, & info);
+    info.interface = __interface;
+    PROBE5 (packet__decode, info.flow.packet_type, info.flow.protocol,
+            info.flow.src_port, info.flow.dest_port, info.application);
+    PROFILE_LAP (PROFILE_DECODE);
+
+    if (shared_due (& header->ts))
+        __capture_publish ();
+
+    switch (sidecar_accept (& info))
+    {
+        case SIDECAR_SKIP:
+            return;
+        case SIDECAR_STOP:
+            pcap_breakloop (__capture);
+            return;
+        default:
+            break;
+    }
+
+    rollup_packet (& header->ts);
+    stats_receive (& info);
+    top_packet (& info);
+    distribution_packet (& info);
+    tcpflow_packet (& info);
+    dnsstat_packet (& info);
+    if (__live)
+        sampling_update (__capture, header);
+    PROFILE_LAP (PROFILE_ACCOUNT);
+
+    trigger_packet (& info);
+    writer_packet (header, bytes);
+    split_packet (& info);
+    arrow_packet (& info);
+    PROFILE_LAP (PROFILE_RECORD);
+
+    if (! sampling_accept (& info))
+    {
+        PROBE1 (packet__drop, "sampling");
+        return;
+    }
+
+    stats_account (& info, sampling_rate ());
+    callback_level level = sampling_level (__level);
+    PROFILE_LAP (PROFILE_ACCOUNT);
+    view_packet (& info);
+    PROFILE_LAP (PROFILE_OUTPUT);
+
+    /* Records are rendered as text later, if ever: keep them all. */
+    if (binary_enabled ())
+    {
+        binary_packet (& info, level);
+        PROFILE_LAP (PROFILE_OUTPUT);
+        return;
+    }
+
+    if (! limit_accept (stdout, & info))
+    {
+        PROBE1 (packet__drop, "limit");
+        return;
+    }
+
+    if (level != CALLBACK_STATS && ! repeat_accept (stdout, & info))
+    {
+        PROBE1 (packet__drop, "repeat");
+        return;
+    }
+    PROFILE_LAP (PROFILE_ACCOUNT);
+
+    if (json_enabled ())
+        json_packet (stdout, & info, level);
+    else
+        callback_handler (level) (user, header, bytes);
+    PROFILE_LAP (PROFILE_OUTPUT);
+}
+
+void __capture_run (pcap_t * const capture, bool live,
+        __capture_loop loop, void * const sources)
+{
+    if (! trigger_open (capture))
+        return;
+    if (! writer_open (capture, live))
+        goto close_trigger;
+    if (! split_open (capture))
+        goto close_writer;
+    if (! view_open (capture))
+        goto close_split;
+    if (! binary_open (capture))
+        goto close_view;
+    if (! arrow_open ())
+        goto close_binary;
+    if (! rollup_open ())
+        goto close_arrow;
+    if (! distribution_open ())
+        goto close_rollup;
+    if (! tcpflow_open ())
+        goto close_distribution;
+    if (! dnsstat_open ())
+        goto close_tcpflow;
+    if (! shared_open (metrics_enabled () || top_enabled ())
+            || ! metrics_open (shared_get ()) || ! top_open (shared_get ()))
+        goto close_shared;
+
+    struct sigaction action;
+    memset (& action, 0, sizeof action);
+    action.sa_handler = __capture_interrupt;
+    sigemptyset (& action.sa_mask);
+
+    __capture = capture;
+    __live = live;
+    sigaction (SIGINT, & action, NULL);
+    sigaction (SIGTERM, & action, NULL);
+
+    __interrupted = 0;
+    PROFILE_START ();
+    if (loop == NULL)
+        pcap_loop (capture, -1, __capture_packet, NULL);
+    else
+        loop (sources);
+
+    action.sa_handler = SIG_DFL;
+    sigaction (SIGINT, & action, NULL);
+    sigaction (SIGTERM, & action, NULL);
+
+    trigger_close ();
+    writer_close ();
+    split_close ();
+    view_close ();
+    binary_close ();
+    arrow_close ();
+    rollup_close ();
+    distribution_close ();
+    tcpflow_close ();
+    dnsstat_close ();
+    __capture_publish ();
+    top_close ();
+    metrics_close ();
+    shared_close ();
+    repeat_finish (stdout);
+    limit_finish (stdout);
+    fflush (stdout);
+    PROBE0 (output__flush);
+    __capture_report ();
+    if (distribution_enabled ())
+        distribution_print (stderr);
+    if (tcpflow_enabled ())
+        tcpflow_print (stderr);
+    if (dnsstat_enabled ())
+        dnsstat_print (stderr);
+    PROFILE_REPORT (stderr);
+    __capture = NULL;
+    return;
+
+    /* Failure: close what is open, in reverse order. */
+close_shared:
+    metrics_close ();
+    shared_close ();
+    dnsstat_close ();
+close_tcpflow:
+    tcpflow_close ();
+close_distribution:
+    distribution_close ();
+close_rollup:
+    rollup_close ();
+close_arrow:
+    arrow_close ();
+close_binary:
+    binary_close ();
+close_view:
+    view_close ();
+close_split:
+    split_close ();
+close_writer:
+    writer_close ();
+close_trigger:
+    trigger_close ();
+}
+
+void __capture_loop_merge (void * const sources)
+{
+    const struct pcap_pkthdr * header;
+    const u_char * bytes;
+
+    while (! __interrupted && merge_next (sources, & header, & bytes))
+        __capture_packet (NULL, header, bytes);
+}
+
+void __capture_loop_follow (void * const sources)
+{
+    const struct pcap_pkthdr * header;
+    const u_char * bytes;
+
+    while (! __interrupted && follow_next (sources, & header, & bytes))
+        __capture_packet (NULL, header, bytes);
+}
+
+void __capture_loop_interfaces (void * const sources)
+{
+    const __capture_interfaces * interfaces = sources;
+    struct epoll_event events[STATS_INTERFACES_MAX];
+
+    int poller = epoll_create1 (EPOLL_CLOEXEC);
+    if (poller < 0)
+    {
+        fprintf (stderr, "Error: Could not poll the interfaces: %s.\n",
+                strerror (errno));
+        return;
+    }
+
+    size_t active = 0;
+    for (unsigned int i = 0; i < interfaces->count; ++i)
+    {
+        struct epoll_event event = { .events = EPOLLIN, .data.u32 = i, };
+        if (! epoll_ctl (poller, EPOLL_CTL_ADD,
+                    pcap_get_selectable_fd (interfaces->captures[i]), & event))
+            ++active;
+    }
+
+    while (! __interrupted && active > 0)
     {
-        [0] = callback_raw_packet,
-        [1] = callback_info_concise,
-        [2] = callback_info_synthetic,
-        [3] = callback_info_complete,
-    };
+        int ready = epoll_wait (poller, events, STATS_INTERFACES_MAX, -1);
+
+        for (int i = 0; i < ready && ! __interrupted; ++i)
+        {
+            /* Batches keep a busy interface from starving the others. */
+            __interface = events[i].data.u32;
+            pcap_t * capture = interfaces->captures[__interface];
+            int count = pcap_dispatch (capture, CAPTURE_BATCH,
+                    __capture_packet, NULL);
+
+            bool lost = count == 0
+                && (events[i].events & (EPOLLHUP | EPOLLERR));
+            if (count == PCAP_ERROR)
+                fprintf (stderr, "Error: %s: %s.\n",
+                        interfaces->names[__interface], pcap_geterr (capture));
+            if (lost || count == PCAP_ERROR)
+            {
+                epoll_ctl (poller, EPOLL_CTL_DEL,
+                        pcap_get_selectable_fd (capture), NULL);
+                --active;
+            }
+        }
+    }
 
-    wiredolphin_callback = callbacks[id < 4 ? id : 3];
+    close (poller);
+    __interface = 0;
+}
+
+void __capture_interrupt (int signal_number)
+{
+    (void) signal_number;
+
+    __interrupted = 1;
+    if (__capture != NULL)
+        pcap_breakloop (__capture);
+}
+
+void __capture_publish (void)
+{
+    shared_capture capture;
+    struct pcap_stat capture_stats;
+
+    memset (& capture, 0, sizeof capture);
+    if (__live && __interfaces != NULL)
+    {
+        for (size_t i = 0; i < __interfaces->count; ++i)
+            if (pcap_stats (__interfaces->captures[i], & capture_stats) == 0)
+            {
+                capture.kernel_received += capture_stats.ps_recv;
+                capture.kernel_dropped += capture_stats.ps_drop;
+                capture.interface_dropped += capture_stats.ps_ifdrop;
+            }
+    }
+    else if (__live && pcap_stats (__capture, & capture_stats) == 0)
+    {
+        capture.kernel_received = capture_stats.ps_recv;
+        capture.kernel_dropped = capture_stats.ps_drop;
+        capture.interface_dropped = capture_stats.ps_ifdrop;
+    }
+    capture.writer_queued = writer_queued ();
+    capture.writer_dropped = writer_dropped ();
+
+    for (unsigned int i = 0; i < PROFILE_STAGE_COUNT; ++i)
+        PROFILE_EXPORT (i, shared_latency_bounds, SHARED_LATENCY_BOUNDS,
+                capture.latency[i].below, & capture.latency[i].packets,
+                & capture.latency[i].total);
+
+    top_publish ();
+    shared_publish (& capture);
+}
+
+void __capture_report (void)
+{
+    if (! __statistics && ! sampling_enabled ()
+            && __level != CALLBACK_STATS)
+        return;
+
+    stats_print (stderr);
+
+    if (sampling_enabled ())
+        sampling_print (stderr);
+
+    struct pcap_stat capture_stats;
+    if (__live && __interfaces != NULL)
+    {
+        fprintf (stderr, "Capture\n=======\n");
+        for (size_t i = 0; i < __interfaces->count; ++i)
+            if (pcap_stats (__interfaces->captures[i], & capture_stats) == 0)
+                fprintf (stderr, "%-24s\t%u received by the kernel, %u dropped "
+                        "by the kernel, %u by the interface\n",
+                        __interfaces->names[i], capture_stats.ps_recv,
+                        capture_stats.ps_drop, capture_stats.ps_ifdrop);
+        fprintf (stderr, "\n");
+    }
+    else if (__live && pcap_stats (__capture, & capture_stats) == 0)
+    {
+        fprintf (stderr, "Capture\n=======\n");
+        fprintf (stderr, "%-24s\t%u\n", "Received by the kernel:",
+                capture_stats.ps_recv);
+        fprintf (stderr, "%-24s\t%u\n", "Dropped by the kernel:",
+                capture_stats.ps_drop);
+        fprintf (stderr, "%-24s\t%u\n", "Dropped by the interface:",
+                capture_stats.ps_ifdrop);
+        fprintf (stderr, "\n");
+    }
 }
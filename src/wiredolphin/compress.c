@@ -0,0 +1,332 @@
+/**
+ * \file compress.c
+ * \brief Compression of the standard output.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+/* pipe2, F_SETPIPE_SZ. */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef WIREDOLPHIN_ZSTD
+#include <zstd.h>
+#endif
+#ifdef WIREDOLPHIN_LZ4
+#include <lz4frame.h>
+#endif
+
+#include "wiredolphin/compress.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define COMPRESS_PIPE_SIZE  (1024 * 1024)   /**< Pipe buffer size. */
+#define COMPRESS_TIMEOUT    1000            /**< Partial frame delay (ms). */
+
+/**
+ * \brief Compression methods.
+ */
+typedef enum __compress_method
+{
+    COMPRESS_NONE,          /**< No compression. */
+    COMPRESS_ZSTD,          /**< zstd frames. */
+    COMPRESS_LZ4,           /**< lz4 frames. */
+} __compress_method;
+
+static __compress_method __method = COMPRESS_NONE;  /**< Method. */
+static bool __running = false;              /**< Thread started. */
+static pthread_t __worker;                  /**< Compression thread. */
+static int __input = -1;                    /**< Read end of the pipe. */
+static int __output = -1;                   /**< Original standard output. */
+static char * __frame = NULL;               /**< Frame being filled. */
+static char * __compressed = NULL;          /**< Compressed frame. */
+static size_t __compressed_size = 0;        /**< Compressed frame capacity. */
+
+#ifdef WIREDOLPHIN_ZSTD
+static ZSTD_CCtx * __zstd = NULL;           /**< zstd context. */
+#endif
+
+/**
+ * \brief Compression thread.
+ * \param user Unused.
+ * \return NULL.
+ */
+static void * __compress_run (void * user);
+
+/**
+ * \brief Compress a frame and write it (compression thread).
+ * \param length Frame length.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+static inline bool __compress_frame (size_t length);
+
+/**
+ * \brief Write bytes to the original standard output (compression thread).
+ * \param bytes Bytes.
+ * \param length Number of bytes.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+static inline bool __compress_write (const char * bytes, size_t length);
+
+/**
+ * \brief Free the buffers and the context.
+ */
+static inline void __compress_free (void);
+
+////////////////////////////////////////////////////////////////////////////////
+// Compression of the standard output.
+////////////////////////////////////////////////////////////////////////////////
+
+bool compress_set_method (const char * method)
+{
+#ifdef WIREDOLPHIN_ZSTD
+    if (! strcmp (method, "zstd"))
+    {
+        __method = COMPRESS_ZSTD;
+        return true;
+    }
+#endif
+#ifdef WIREDOLPHIN_LZ4
+    if (! strcmp (method, "lz4"))
+    {
+        __method = COMPRESS_LZ4;
+        return true;
+    }
+#endif
+    (void) method;
+    return false;
+}
+
+const char * compress_methods (void)
+{
+#if defined (WIREDOLPHIN_ZSTD) && defined (WIREDOLPHIN_LZ4)
+    return "zstd, lz4";
+#elif defined (WIREDOLPHIN_ZSTD)
+    return "zstd";
+#elif defined (WIREDOLPHIN_LZ4)
+    return "lz4";
+#else
+    return "none";
+#endif
+}
+
+bool compress_open (void)
+{
+    if (__method == COMPRESS_NONE)
+        return true;
+
+#ifdef WIREDOLPHIN_ZSTD
+    if (__method == COMPRESS_ZSTD)
+    {
+        __compressed_size = ZSTD_compressBound (COMPRESS_FRAME_SIZE);
+        __zstd = ZSTD_createCCtx ();
+    }
+#endif
+#ifdef WIREDOLPHIN_LZ4
+    if (__method == COMPRESS_LZ4)
+        __compressed_size = LZ4F_compressFrameBound (COMPRESS_FRAME_SIZE,
+                NULL);
+#endif
+    __frame = malloc (COMPRESS_FRAME_SIZE);
+    __compressed = malloc (__compressed_size);
+    if (__frame == NULL || __compressed == NULL
+#ifdef WIREDOLPHIN_ZSTD
+            || (__method == COMPRESS_ZSTD && __zstd == NULL)
+#endif
+       )
+    {
+        fprintf (stderr, "Error: Could not allocate the compression buffers.\n");
+        __compress_free ();
+        return false;
+    }
+
+    int ends[2];
+    fflush (stdout);
+    if (pipe2 (ends, O_CLOEXEC))
+    {
+        fprintf (stderr, "Error: Could not create the compression pipe: %s.\n",
+                strerror (errno));
+        __compress_free ();
+        return false;
+    }
+    /* Fewer wake ups; the default size is fine too. */
+    fcntl (ends[1], F_SETPIPE_SZ, COMPRESS_PIPE_SIZE);
+
+    __output = fcntl (STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+    if (__output < 0 || dup2 (ends[1], STDOUT_FILENO) < 0)
+    {
+        fprintf (stderr, "Error: Could not redirect the standard output: %s.\n",
+                strerror (errno));
+        if (__output >= 0)
+            close (__output);
+        close (ends[0]);
+        close (ends[1]);
+        __compress_free ();
+        return false;
+    }
+    close (ends[1]);
+    __input = ends[0];
+
+    /* Signals are for the capture thread. */
+    sigset_t all, previous;
+    sigfillset (& all);
+    pthread_sigmask (SIG_SETMASK, & all, & previous);
+    __running = ! pthread_create (& __worker, NULL, __compress_run, NULL);
+    pthread_sigmask (SIG_SETMASK, & previous, NULL);
+
+    if (! __running)
+    {
+        fprintf (stderr, "Error: Could not start the compression thread.\n");
+        dup2 (__output, STDOUT_FILENO);
+        close (__output);
+        close (__input);
+        __compress_free ();
+    }
+
+    return __running;
+}
+
+void compress_close (void)
+{
+    if (! __running)
+        return;
+
+    /* Closing the last write end of the pipe ends the thread. */
+    fflush (stdout);
+    dup2 (__output, STDOUT_FILENO);
+    pthread_join (__worker, NULL);
+    __running = false;
+
+    close (__output);
+    close (__input);
+    __compress_free ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+void * __compress_run (void * user)
+{
+    (void) user;
+
+    struct pollfd input = { .fd = __input, .events = POLLIN, };
+    size_t length = 0;
+    bool failed = false;
+
+    for (;;)
+    {
+        /* A partial frame is written after a while, for tail -f readers. */
+        int ready = poll (& input, 1, length > 0 ? COMPRESS_TIMEOUT : -1);
+        if (ready < 0 && errno == EINTR)
+            continue;
+
+        if (ready == 0)
+        {
+            failed = failed || ! __compress_frame (length);
+            length = 0;
+            continue;
+        }
+
+        ssize_t bytes = read (__input, __frame + length,
+                COMPRESS_FRAME_SIZE - length);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes <= 0)
+            break;
+
+        length += (size_t) bytes;
+        if (length == COMPRESS_FRAME_SIZE)
+        {
+            failed = failed || ! __compress_frame (length);
+            length = 0;
+        }
+    }
+
+    if (length > 0 && ! failed)
+        __compress_frame (length);
+
+    return NULL;
+}
+
+bool __compress_frame (size_t length)
+{
+    size_t size = 0;
+
+#ifdef WIREDOLPHIN_ZSTD
+    if (__method == COMPRESS_ZSTD)
+    {
+        size = ZSTD_compressCCtx (__zstd, __compressed, __compressed_size,
+                __frame, length, ZSTD_CLEVEL_DEFAULT);
+        if (ZSTD_isError (size))
+        {
+            fprintf (stderr, "Error: zstd: %s.\n", ZSTD_getErrorName (size));
+            return false;
+        }
+    }
+#endif
+#ifdef WIREDOLPHIN_LZ4
+    if (__method == COMPRESS_LZ4)
+    {
+        size = LZ4F_compressFrame (__compressed, __compressed_size, __frame,
+                length, NULL);
+        if (LZ4F_isError (size))
+        {
+            fprintf (stderr, "Error: lz4: %s.\n", LZ4F_getErrorName (size));
+            return false;
+        }
+    }
+#endif
+    (void) length;
+
+    return __compress_write (__compressed, size);
+}
+
+bool __compress_write (const char * bytes, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write (__output, bytes, length);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written < 0)
+        {
+            fprintf (stderr, "Error: Could not write the compressed output: "
+                    "%s.\n", strerror (errno));
+            return false;
+        }
+        bytes += written;
+        length -= (size_t) written;
+    }
+
+    return true;
+}
+
+void __compress_free (void)
+{
+#ifdef WIREDOLPHIN_ZSTD
+    ZSTD_freeCCtx (__zstd);
+    __zstd = NULL;
+#endif
+    free (__frame);
+    free (__compressed);
+    __frame = __compressed = NULL;
+}
@@ -0,0 +1,207 @@
+/**
+ * \file distribution.c
+ * \brief Frame size, inter-arrival and burst distributions.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "wiredolphin/distribution.h"
+#include "wiredolphin/histogram.h"
+#include "wiredolphin/flow.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * \brief Distributions.
+ */
+typedef enum __distribution_kind
+{
+    __DISTRIBUTION_SIZE = 0,    /**< Frame sizes. */
+    __DISTRIBUTION_GAP,         /**< Inter-arrival gaps. */
+    __DISTRIBUTION_BURST,       /**< Burst lengths. */
+    __DISTRIBUTION_COUNT,
+} __distribution_kind;
+
+/**
+ * \brief Per-flow state.
+ */
+typedef struct __distribution_flow
+{
+    u_int64_t last;                     /**< Last packet time (us). */
+    u_int64_t burst;                    /**< Packets of the current burst. */
+    packet_application application;     /**< Application. */
+} __distribution_flow;
+
+static bool __enabled = false;                      /**< Recording. */
+static u_int64_t __gap = DISTRIBUTION_GAP_DEFAULT;  /**< Burst gap. */
+static flow_table * __table = NULL;                 /**< Flows. */
+
+/** Histograms, per application. */
+static histogram __histograms[__DISTRIBUTION_COUNT][PACKET_APP_COUNT];
+
+static const char * const __titles[__DISTRIBUTION_COUNT] =
+{
+    [__DISTRIBUTION_SIZE]   = "Frame sizes (bytes)",
+    [__DISTRIBUTION_GAP]    = "Inter-arrival gaps per flow (us)",
+    [__DISTRIBUTION_BURST]  = "Bursts per flow (packets)",
+};
+
+/**
+ * \brief End the burst of a flow leaving the table.
+ * \param flow Flow.
+ * \param value Flow state.
+ * \param user Unused.
+ */
+static void __distribution_release (const packet_flow * flow, void * value,
+        void * user);
+
+/**
+ * \brief Print a row of percentiles.
+ * \param stream Output stream.
+ * \param name Row name.
+ * \param values Histogram.
+ */
+static inline void __distribution_row (FILE * stream, const char * name,
+        const histogram * values);
+
+////////////////////////////////////////////////////////////////////////////////
+// Distributions.
+////////////////////////////////////////////////////////////////////////////////
+
+void distribution_set_gap (unsigned int gap)
+{
+    __enabled = true;
+    __gap = gap;
+}
+
+bool distribution_enabled (void)
+{
+    return __enabled;
+}
+
+bool distribution_open (void)
+{
+    if (! __enabled)
+        return true;
+
+    __table = flow_table_create (DISTRIBUTION_FLOWS,
+            sizeof (__distribution_flow), __distribution_release, NULL);
+    if (__table == NULL)
+    {
+        fprintf (stderr, "Error: Could not allocate the flow table.\n");
+        return false;
+    }
+
+    return true;
+}
+
+void distribution_packet (const packet_info * const info)
+{
+    if (__table == NULL)
+        return;
+
+    u_int64_t time = (u_int64_t) info->header->ts.tv_sec * 1000000u
+        + (u_int64_t) info->header->ts.tv_usec;
+    histogram_record (& __histograms[__DISTRIBUTION_SIZE][info->application],
+            info->header->len);
+
+    bool created;
+    __distribution_flow * flow = flow_table_lookup (__table, & info->flow,
+            & created);
+    if (! created)
+    {
+        /* Late packets (merged files) count as simultaneous. */
+        u_int64_t gap = time > flow->last ? time - flow->last : 0;
+        histogram_record (& __histograms[__DISTRIBUTION_GAP]
+                [flow->application], gap);
+        if (gap > __gap)
+        {
+            histogram_record (& __histograms[__DISTRIBUTION_BURST]
+                    [flow->application], flow->burst);
+            flow->burst = 0;
+        }
+    }
+
+    ++flow->burst;
+    if (time > flow->last)
+        flow->last = time;
+    flow->application = info->application;
+}
+
+void distribution_close (void)
+{
+    flow_table_destroy (__table);
+    __table = NULL;
+}
+
+void distribution_print (FILE * const stream)
+{
+    fprintf (stream, "Distributions\n=============\n");
+    for (unsigned int i = 0; i < __DISTRIBUTION_COUNT; ++i)
+    {
+        histogram all;
+        memset (& all, 0, sizeof all);
+        for (unsigned int j = 0; j < PACKET_APP_COUNT; ++j)
+            histogram_merge (& all, & __histograms[i][j]);
+        if (! all.count)
+            continue;
+
+        fprintf (stream, "%s\n", __titles[i]);
+        for (size_t j = strlen (__titles[i]); j > 0; --j)
+            fputc ('-', stream);
+        fprintf (stream, "\n%-24s\t%10s %10s %10s %10s %10s %10s %10s %10s\n",
+                "", "count", "mean", "min", "p50", "p90", "p99", "p99.9",
+                "max");
+
+        __distribution_row (stream, "All", & all);
+        for (unsigned int j = PACKET_APP_NONE + 1; j < PACKET_APP_COUNT; ++j)
+            __distribution_row (stream, packet_application_string (j),
+                    & __histograms[i][j]);
+        __distribution_row (stream, "Other",
+                & __histograms[i][PACKET_APP_NONE]);
+        fprintf (stream, "\n");
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+void __distribution_release (const packet_flow * const flow,
+        void * const value, void * const user)
+{
+    (void) flow;
+    (void) user;
+
+    const __distribution_flow * state = value;
+    histogram_record (& __histograms[__DISTRIBUTION_BURST]
+            [state->application], state->burst);
+}
+
+void __distribution_row (FILE * const stream, const char * const name,
+        const histogram * const values)
+{
+    if (! values->count)
+        return;
+
+    fprintf (stream, "%-24s\t%10" PRIu64 " %10.1f %10" PRIu64 " %10" PRIu64
+            " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n",
+            name, values->count,
+            (double) values->total / (double) values->count,
+            values->min, histogram_percentile (values, 0.5),
+            histogram_percentile (values, 0.9),
+            histogram_percentile (values, 0.99),
+            histogram_percentile (values, 0.999), values->max);
+}
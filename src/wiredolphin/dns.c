@@ -0,0 +1,371 @@
+/**
+ * \file dns.c
+ * \brief DNS.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "wiredolphin/dns.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define DNS_TYPE_A          1       /**< IPv4 address. */
+#define DNS_TYPE_NS         2       /**< Name server. */
+#define DNS_TYPE_CNAME      5       /**< Canonical name. */
+#define DNS_TYPE_PTR        12      /**< Pointer. */
+#define DNS_TYPE_MX         15      /**< Mail exchange. */
+#define DNS_TYPE_AAAA       28      /**< IPv6 address. */
+
+/**
+ * \brief Read a 16 bits integer in network byte order.
+ * \param bytes Bytes.
+ * \return Integer.
+ */
+static inline u_int16_t __dns_u16 (const u_char * bytes);
+
+/**
+ * \brief Get the number of records of a section.
+ * \param header Header.
+ * \param section Section.
+ * \return Number of records.
+ */
+static inline unsigned int __dns_count (const dns_header * header,
+        dns_section section);
+
+/**
+ * \brief Skip a name in place, without following pointers.
+ * \param name Name.
+ * \param limit Byte following the message.
+ * \return Byte following the name, NULL if it is malformed.
+ */
+static inline const u_char * __dns_name_skip (const u_char * name,
+        const u_char * limit);
+
+/**
+ * \brief Print a record.
+ * \param stream Output stream.
+ * \param message Message.
+ * \param record Record.
+ */
+static inline void __dns_print_record (FILE * stream,
+        const dns_message * message, const dns_record * record);
+
+////////////////////////////////////////////////////////////////////////////////
+// DNS.
+////////////////////////////////////////////////////////////////////////////////
+
+bool dns_open (dns_message * const message, const u_char * const start,
+        const u_char * const limit)
+{
+    if (start > limit || (size_t) (limit - start) < sizeof (dns_header))
+        return false;
+
+    message->start = start;
+    message->limit = limit;
+    message->cursor = start + sizeof (dns_header);
+    message->section = DNS_QUESTION;
+    message->remaining = __dns_count (dns_get_header (message), DNS_QUESTION);
+
+    return true;
+}
+
+const dns_header * dns_get_header (const dns_message * const message)
+{
+    return (const dns_header *) message->start;
+}
+
+bool dns_next (dns_message * const message, dns_record * const record)
+{
+    if (message->cursor == NULL)
+        return false;
+
+    while (message->remaining == 0)
+    {
+        if (message->section >= DNS_ADDITIONAL)
+        {
+            message->section = DNS_SECTION_COUNT;
+            return false;
+        }
+        message->section = (dns_section) (message->section + 1);
+        message->remaining = __dns_count (dns_get_header (message),
+                message->section);
+    }
+
+    const u_char * fields = __dns_name_skip (message->cursor,
+            message->limit);
+    size_t size = message->section == DNS_QUESTION ? 4 : 10;
+    if (fields == NULL || (size_t) (message->limit - fields) < size)
+    {
+        message->cursor = NULL;
+        return false;
+    }
+
+    record->section = message->section;
+    record->name = message->cursor;
+    record->type = __dns_u16 (fields);
+    record->class = __dns_u16 (fields + 2);
+    record->ttl = 0;
+    record->length = 0;
+    record->data = NULL;
+    message->cursor = fields + size;
+
+    if (message->section != DNS_QUESTION)
+    {
+        record->ttl = (u_int32_t) __dns_u16 (fields + 4) << 16
+            | __dns_u16 (fields + 6);
+        record->length = __dns_u16 (fields + 8);
+        if ((size_t) (message->limit - message->cursor) < record->length)
+        {
+            message->cursor = NULL;
+            return false;
+        }
+        record->data = message->cursor;
+        message->cursor += record->length;
+    }
+
+    --message->remaining;
+    return true;
+}
+
+bool dns_name_format (const dns_message * const message,
+        const u_char * name, char * const buffer, size_t size)
+{
+    size_t length = 0;
+    size_t wire = 0;
+
+    while (name < message->limit)
+    {
+        u_int8_t label = * name;
+        if (label == 0)
+        {
+            if (length == 0 && size > 1)
+                buffer[length++] = '.';
+            buffer[length] = '\0';
+            return true;
+        }
+
+        if ((label & 0xc0) == 0xc0)
+        {
+            /* Pointers go backwards: no loops. */
+            if (message->limit - name < 2)
+                break;
+            const u_char * target = message->start
+                + (((label & 0x3f) << 8) | name[1]);
+            if (target >= name)
+                break;
+            name = target;
+            continue;
+        }
+
+        wire += (size_t) label + 1;
+        if ((label & 0xc0) != 0 || wire > DNS_NAME_MAX
+                || message->limit - name <= label
+                || length + label + 2 > size)
+            break;
+
+        if (length > 0)
+            buffer[length++] = '.';
+        for (unsigned int i = 1; i <= label; ++i)
+            buffer[length++] = name[i] > ' ' && name[i] < 0x7f
+                ? (char) name[i] : '?';
+        name += label + 1;
+    }
+
+    if (size > 1)
+    {
+        buffer[0] = '?';
+        buffer[1] = '\0';
+    }
+    return false;
+}
+
+const char * dns_type_string (u_int16_t type)
+{
+    switch (type)
+    {
+        case 1:     return "A";
+        case 2:     return "NS";
+        case 5:     return "CNAME";
+        case 6:     return "SOA";
+        case 12:    return "PTR";
+        case 15:    return "MX";
+        case 16:    return "TXT";
+        case 28:    return "AAAA";
+        case 33:    return "SRV";
+        case 41:    return "OPT";
+        case 43:    return "DS";
+        case 46:    return "RRSIG";
+        case 47:    return "NSEC";
+        case 48:    return "DNSKEY";
+        case 64:    return "SVCB";
+        case 65:    return "HTTPS";
+        case 255:   return "ANY";
+        default:    return NULL;
+    }
+}
+
+const char * dns_rcode_string (u_int8_t rcode)
+{
+    static const char * rcode_strings[] =
+    {
+        [0] = "NOERROR",
+        [1] = "FORMERR",
+        [2] = "SERVFAIL",
+        [3] = "NXDOMAIN",
+        [4] = "NOTIMP",
+        [5] = "REFUSED",
+        [6] = "YXDOMAIN",
+        [7] = "YXRRSET",
+        [8] = "NXRRSET",
+        [9] = "NOTAUTH",
+        [10] = "NOTZONE",
+    };
+
+    return rcode <= 10 ? rcode_strings[rcode] : NULL;
+}
+
+void dns_print (FILE * const stream, const u_char * const start,
+        const u_char * const limit)
+{
+    dns_message message;
+    if (! dns_open (& message, start, limit))
+        return;
+
+    const dns_header * header = dns_get_header (& message);
+    u_int16_t flags = ntohs (header->flags);
+    const char * rcode = dns_rcode_string (DNS_RCODE (flags));
+
+    fprintf (stream, "DNS header\n==========\n");
+    fprintf (stream, "%-24s\t0x%04x\n", "Transaction ID:", ntohs (header->id));
+    fprintf (stream, "%-24s\t%s%s%s%s%s\n", "Flags:",
+            flags & DNS_FLAG_QR ? "Response" : "Query",
+            flags & DNS_FLAG_AA ? ", Authoritative" : "",
+            flags & DNS_FLAG_TC ? ", Truncated" : "",
+            flags & DNS_FLAG_RD ? ", Recursion desired" : "",
+            flags & DNS_FLAG_RA ? ", Recursion available" : "");
+    fprintf (stream, "%-24s\t%u\n", "Opcode:", DNS_OPCODE (flags));
+    if (rcode != NULL)
+        fprintf (stream, "%-24s\t%s\n", "Response code:", rcode);
+    else
+        fprintf (stream, "%-24s\t%u\n", "Response code:", DNS_RCODE (flags));
+    fprintf (stream, "%-24s\t%u\n", "Questions:", ntohs (header->questions));
+    fprintf (stream, "%-24s\t%u\n", "Answers:", ntohs (header->answers));
+    fprintf (stream, "%-24s\t%u\n", "Authority records:",
+            ntohs (header->authorities));
+    fprintf (stream, "%-24s\t%u\n", "Additional records:",
+            ntohs (header->additionals));
+
+    dns_record record;
+    while (dns_next (& message, & record))
+        __dns_print_record (stream, & message, & record);
+    if (message.cursor == NULL)
+        fprintf (stream, "%-24s\t%s\n", "Malformed:", "yes");
+
+    fprintf (stream, "\n");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+u_int16_t __dns_u16 (const u_char * const bytes)
+{
+    return (u_int16_t) (bytes[0] << 8 | bytes[1]);
+}
+
+unsigned int __dns_count (const dns_header * const header,
+        dns_section section)
+{
+    switch (section)
+    {
+        case DNS_QUESTION:      return ntohs (header->questions);
+        case DNS_ANSWER:        return ntohs (header->answers);
+        case DNS_AUTHORITY:     return ntohs (header->authorities);
+        case DNS_ADDITIONAL:    return ntohs (header->additionals);
+        default:                return 0;
+    }
+}
+
+const u_char * __dns_name_skip (const u_char * name,
+        const u_char * const limit)
+{
+    size_t wire = 0;
+
+    while (name < limit)
+    {
+        u_int8_t label = * name;
+        if (label == 0)
+            return name + 1;
+        if ((label & 0xc0) == 0xc0)
+            return limit - name >= 2 ? name + 2 : NULL;
+
+        wire += (size_t) label + 1;
+        if ((label & 0xc0) != 0 || wire > DNS_NAME_MAX)
+            return NULL;
+        name += label + 1;
+    }
+
+    return NULL;
+}
+
+void __dns_print_record (FILE * const stream, const dns_message * const message,
+        const dns_record * const record)
+{
+    static const char * const sections[DNS_SECTION_COUNT] =
+    {
+        [DNS_QUESTION]      = "Question:",
+        [DNS_ANSWER]        = "Answer:",
+        [DNS_AUTHORITY]     = "Authority:",
+        [DNS_ADDITIONAL]    = "Additional:",
+    };
+
+    char name[DNS_NAME_MAX + 1];
+    char type[16];
+    const char * type_name = dns_type_string (record->type);
+    if (type_name != NULL)
+        snprintf (type, sizeof type, "%s", type_name);
+    else
+        snprintf (type, sizeof type, "TYPE%u", record->type);
+
+    dns_name_format (message, record->name, name, sizeof name);
+    fprintf (stream, "%-24s\t%s %s", sections[record->section], name, type);
+    if (record->section == DNS_QUESTION)
+    {
+        fprintf (stream, "\n");
+        return;
+    }
+    fprintf (stream, " %u ", record->ttl);
+
+    char address[INET6_ADDRSTRLEN];
+    if (record->type == DNS_TYPE_A && record->length == 4)
+        fprintf (stream, "%s\n", inet_ntop (AF_INET, record->data, address,
+                    sizeof address));
+    else if (record->type == DNS_TYPE_AAAA && record->length == 16)
+        fprintf (stream, "%s\n", inet_ntop (AF_INET6, record->data, address,
+                    sizeof address));
+    else if (record->type == DNS_TYPE_NS || record->type == DNS_TYPE_CNAME
+            || record->type == DNS_TYPE_PTR)
+    {
+        dns_name_format (message, record->data, name, sizeof name);
+        fprintf (stream, "%s\n", name);
+    }
+    else if (record->type == DNS_TYPE_MX && record->length > 2)
+    {
+        dns_name_format (message, record->data + 2, name, sizeof name);
+        fprintf (stream, "%u %s\n", __dns_u16 (record->data), name);
+    }
+    else
+        fprintf (stream, "(%u bytes)\n", record->length);
+}
@@ -0,0 +1,390 @@
+/**
+ * \file dnsstat.c
+ * \brief DNS transaction analysis.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "wiredolphin/dnsstat.h"
+#include "wiredolphin/dns.h"
+#include "wiredolphin/histogram.h"
+#include "wiredolphin/flow.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define DNSSTAT_TYPES       11      /**< Query types accounted for apart. */
+#define DNSSTAT_RCODES      16      /**< Response codes. */
+
+/**
+ * \brief Pending transaction.
+ */
+typedef struct __dnsstat_transaction
+{
+    u_int64_t time;         /**< First query time (us). */
+    u_int8_t server;        /**< Server. */
+    u_int8_t type;          /**< Query type. */
+} __dnsstat_transaction;
+
+/**
+ * \brief Server or query type.
+ */
+typedef struct __dnsstat_counters
+{
+    u_int64_t queries;      /**< Queries, retransmissions included. */
+    u_int64_t responses;    /**< Matched responses. */
+    u_int64_t timeouts;     /**< Transactions timed out. */
+    histogram latency;      /**< Query to response (us). */
+} __dnsstat_counters;
+
+/**
+ * \brief Server.
+ */
+typedef struct __dnsstat_server
+{
+    packet_flow flow;               /**< Address (destination) only. */
+    __dnsstat_counters counters;    /**< Counters. */
+} __dnsstat_server;
+
+/** Query types accounted for apart. */
+static const u_int16_t __dnsstat_type_values[DNSSTAT_TYPES] =
+{
+    1, 2, 5, 6, 12, 15, 16, 28, 33, 65, 255,
+};
+
+static bool __enabled = false;          /**< Analysing. */
+static flow_table * __table = NULL;     /**< Pending transactions. */
+
+/** Servers, then the others. */
+static __dnsstat_server __servers[DNSSTAT_SERVERS + 1];
+static unsigned int __server_count = 0;     /**< Servers in use. */
+
+/** Query types, then the others. */
+static __dnsstat_counters __types[DNSSTAT_TYPES + 1];
+
+static u_int64_t __rcodes[DNSSTAT_RCODES];  /**< Responses per code. */
+static u_int64_t __unmatched = 0;   /**< Responses without a query. */
+static u_int64_t __truncated = 0;   /**< Truncated responses. */
+static u_int64_t __malformed = 0;   /**< Messages not read. */
+static u_int64_t __evicted = 0;     /**< Transactions making room. */
+static u_int64_t __pending = 0;     /**< Transactions left at the end. */
+
+/**
+ * \brief Find the server of an address, add it if needed.
+ * \param info Decoded query.
+ * \return Server.
+ */
+static inline u_int8_t __dnsstat_server_find (const packet_info * info);
+
+/**
+ * \brief Find the query type of a question type.
+ * \param type Question type.
+ * \return Query type.
+ */
+static inline u_int8_t __dnsstat_type_find (u_int16_t type);
+
+/**
+ * \brief Time out the transactions older than DNSSTAT_TIMEOUT.
+ * \param time Current time (us).
+ */
+static inline void __dnsstat_expire (u_int64_t time);
+
+/**
+ * \brief Print a row of counters.
+ * \param stream Output stream.
+ * \param name Row name.
+ * \param counters Counters.
+ */
+static inline void __dnsstat_print_counters (FILE * stream, const char * name,
+        const __dnsstat_counters * counters);
+
+/**
+ * \brief Order servers by decreasing number of queries (qsort).
+ * \param a Server index.
+ * \param b Server index.
+ * \return Comparison.
+ */
+static int __dnsstat_compare (const void * a, const void * b);
+
+////////////////////////////////////////////////////////////////////////////////
+// Analysis.
+////////////////////////////////////////////////////////////////////////////////
+
+void dnsstat_set_enabled (bool enabled)
+{
+    __enabled = enabled;
+}
+
+bool dnsstat_enabled (void)
+{
+    return __enabled;
+}
+
+bool dnsstat_open (void)
+{
+    if (! __enabled)
+        return true;
+
+    __table = flow_table_create (DNSSTAT_PENDING,
+            sizeof (__dnsstat_transaction), NULL, NULL);
+    if (__table == NULL)
+    {
+        fprintf (stderr, "Error: Could not allocate the flow table.\n");
+        return false;
+    }
+
+    return true;
+}
+
+void dnsstat_packet (const packet_info * const info)
+{
+    if (__table == NULL)
+        return;
+
+    u_int64_t time = (u_int64_t) info->header->ts.tv_sec * 1000000u
+        + (u_int64_t) info->header->ts.tv_usec;
+    __dnsstat_expire (time);
+
+    if (info->application != PACKET_APP_DNS || info->data == NULL
+            || info->data == info->limit)
+        return;
+
+    /* Frames can be padded: bound messages by their own length. Over TCP,
+     * messages follow their 2 bytes length. */
+    const u_char * start = info->data;
+    size_t length;
+    if (info->flow.protocol == IPPROTO_TCP)
+    {
+        if (info->limit - start < 2)
+            return;
+        length = (size_t) (start[0] << 8 | start[1]);
+        start += 2;
+        if (length < sizeof (dns_header))
+            return;
+    }
+    else
+    {
+        const struct udphdr * udp = (const struct udphdr *) info->transport;
+        length = ntohs (udp->uh_ulen);
+        if (length < sizeof * udp)
+            length = sizeof * udp;
+        length -= sizeof * udp;
+    }
+    const u_char * limit = (size_t) (info->limit - start) < length
+        ? info->limit : start + length;
+
+    dns_message message;
+    dns_record question;
+    if (! dns_open (& message, start, limit))
+    {
+        ++__malformed;
+        return;
+    }
+    const dns_header * header = dns_get_header (& message);
+    u_int16_t flags = ntohs (header->flags);
+    bool response = flags & DNS_FLAG_QR;
+    if (DNS_OPCODE (flags) != 0
+            || (response ? info->flow.src_port : info->flow.dest_port)
+                != DNS_PORT)
+        return;
+    if (! dns_next (& message, & question) && message.cursor == NULL)
+    {
+        ++__malformed;
+        return;
+    }
+
+    /* The client, its port and the transaction ID. */
+    packet_flow key;
+    memset (& key, 0, sizeof key);
+    key.packet_type = info->flow.packet_type;
+    key.protocol = info->flow.protocol;
+    key.src_addr = response ? info->flow.dest_addr : info->flow.src_addr;
+    key.src_port = response ? info->flow.dest_port : info->flow.src_port;
+    key.dest_port = ntohs (header->id);
+
+    if (! response)
+    {
+        if (flow_table_size (__table) == DNSSTAT_PENDING
+                && flow_table_find (__table, & key) == NULL)
+        {
+            flow_table_remove (__table, flow_table_oldest (__table));
+            ++__evicted;
+        }
+
+        bool created;
+        __dnsstat_transaction * transaction = flow_table_lookup (__table,
+                & key, & created);
+        if (created)
+        {
+            transaction->time = time;
+            transaction->server = __dnsstat_server_find (info);
+            transaction->type = __dnsstat_type_find (
+                    message.section == DNS_QUESTION ? question.type : 0);
+        }
+        ++__servers[transaction->server].counters.queries;
+        ++__types[transaction->type].queries;
+        return;
+    }
+
+    ++__rcodes[DNS_RCODE (flags)];
+    if (flags & DNS_FLAG_TC)
+        ++__truncated;
+
+    __dnsstat_transaction * transaction = flow_table_find (__table, & key);
+    if (transaction == NULL)
+    {
+        ++__unmatched;
+        return;
+    }
+
+    u_int64_t latency = time > transaction->time ? time - transaction->time
+        : 0;
+    __dnsstat_counters * server = & __servers[transaction->server].counters;
+    __dnsstat_counters * type = & __types[transaction->type];
+    ++server->responses;
+    ++type->responses;
+    histogram_record (& server->latency, latency);
+    histogram_record (& type->latency, latency);
+    flow_table_remove (__table, transaction);
+}
+
+void dnsstat_close (void)
+{
+    if (__table != NULL)
+        __pending = flow_table_size (__table);
+    flow_table_destroy (__table);
+    __table = NULL;
+}
+
+void dnsstat_print (FILE * const stream)
+{
+    unsigned int order[DNSSTAT_SERVERS + 1];
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < __server_count; ++i)
+        order[count++] = i;
+    qsort (order, count, sizeof * order, __dnsstat_compare);
+    if (__servers[DNSSTAT_SERVERS].counters.queries)
+        order[count++] = DNSSTAT_SERVERS;
+
+    char name[INET6_ADDRSTRLEN];
+    fprintf (stream, "DNS servers (us)\n----------------\n");
+    fprintf (stream, "%-24s\t%10s %10s %10s %10s %10s %10s\n", "", "queries",
+            "responses", "timeouts", "p50", "p90", "p99");
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        const __dnsstat_server * server = & __servers[order[i]];
+        if (order[i] == DNSSTAT_SERVERS)
+            snprintf (name, sizeof name, "Other");
+        else
+            packet_flow_address (& server->flow, false, name);
+        __dnsstat_print_counters (stream, name, & server->counters);
+    }
+    fprintf (stream, "\n");
+
+    fprintf (stream, "DNS query types (us)\n--------------------\n");
+    fprintf (stream, "%-24s\t%10s %10s %10s %10s %10s %10s\n", "", "queries",
+            "responses", "timeouts", "p50", "p90", "p99");
+    for (unsigned int i = 0; i <= DNSSTAT_TYPES; ++i)
+        if (__types[i].queries)
+            __dnsstat_print_counters (stream, i == DNSSTAT_TYPES ? "Other"
+                    : dns_type_string (__dnsstat_type_values[i]), & __types[i]);
+    fprintf (stream, "\n");
+
+    fprintf (stream, "DNS responses\n-------------\n");
+    for (unsigned int i = 0; i < DNSSTAT_RCODES; ++i)
+    {
+        if (! __rcodes[i])
+            continue;
+        const char * rcode = dns_rcode_string ((u_int8_t) i);
+        if (rcode != NULL)
+            snprintf (name, sizeof name, "%s:", rcode);
+        else
+            snprintf (name, sizeof name, "Code %u:", i);
+        fprintf (stream, "%-24s\t%" PRIu64 "\n", name, __rcodes[i]);
+    }
+    fprintf (stream, "%-24s\t%" PRIu64 "\n", "Truncated:", __truncated);
+    fprintf (stream, "%-24s\t%" PRIu64 "\n", "Unmatched:", __unmatched);
+    fprintf (stream, "%-24s\t%" PRIu64 "\n", "Malformed:", __malformed);
+    fprintf (stream, "%-24s\t%" PRIu64 "\n", "Evicted:", __evicted);
+    fprintf (stream, "%-24s\t%" PRIu64 "\n", "Pending at the end:",
+            __pending);
+    fprintf (stream, "\n");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+u_int8_t __dnsstat_server_find (const packet_info * const info)
+{
+    packet_flow flow;
+    memset (& flow, 0, sizeof flow);
+    flow.packet_type = info->flow.packet_type;
+    flow.dest_addr = info->flow.dest_addr;
+
+    for (unsigned int i = 0; i < __server_count; ++i)
+        if (packet_flow_equal (& __servers[i].flow, & flow))
+            return (u_int8_t) i;
+
+    if (__server_count == DNSSTAT_SERVERS)
+        return DNSSTAT_SERVERS;
+
+    __servers[__server_count].flow = flow;
+    return (u_int8_t) __server_count++;
+}
+
+u_int8_t __dnsstat_type_find (u_int16_t type)
+{
+    for (unsigned int i = 0; i < DNSSTAT_TYPES; ++i)
+        if (__dnsstat_type_values[i] == type)
+            return (u_int8_t) i;
+
+    return DNSSTAT_TYPES;
+}
+
+void __dnsstat_expire (u_int64_t time)
+{
+    __dnsstat_transaction * transaction;
+
+    while ((transaction = flow_table_oldest (__table)) != NULL
+            && time > transaction->time + DNSSTAT_TIMEOUT)
+    {
+        ++__servers[transaction->server].counters.timeouts;
+        ++__types[transaction->type].timeouts;
+        flow_table_remove (__table, transaction);
+    }
+}
+
+void __dnsstat_print_counters (FILE * const stream, const char * const name,
+        const __dnsstat_counters * const counters)
+{
+    fprintf (stream, "%-24s\t%10" PRIu64 " %10" PRIu64 " %10" PRIu64
+            " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n", name,
+            counters->queries, counters->responses, counters->timeouts,
+            histogram_percentile (& counters->latency, 0.5),
+            histogram_percentile (& counters->latency, 0.9),
+            histogram_percentile (& counters->latency, 0.99));
+}
+
+int __dnsstat_compare (const void * const a, const void * const b)
+{
+    const __dnsstat_counters * counters_a =
+        & __servers[* (const unsigned int *) a].counters;
+    const __dnsstat_counters * counters_b =
+        & __servers[* (const unsigned int *) b].counters;
+
+    if (counters_a->queries != counters_b->queries)
+        return counters_a->queries > counters_b->queries ? -1 : 1;
+    return * (const unsigned int *) a < * (const unsigned int *) b ? -1 : 1;
+}
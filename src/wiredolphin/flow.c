@@ -0,0 +1,312 @@
+/**
+ * \file flow.c
+ * \brief Flow tables.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include "wiredolphin/flow.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define FLOW_NONE ((u_int32_t) -1) /**< No entry. */
+
+/**
+ * \brief Flow table entry. The value follows the entry.
+ */
+typedef struct __flow_entry
+{
+    packet_flow flow;       /**< Flow. */
+    u_int64_t hash;         /**< Hash of the flow. */
+    u_int32_t older;        /**< Previous entry in LRU order. */
+    u_int32_t newer;        /**< Next entry in LRU order (or next free). */
+} __flow_entry;
+
+struct flow_table
+{
+    u_char * entries;               /**< Entries. */
+    size_t entry_size;              /**< Size of an entry and its value. */
+    size_t value_size;              /**< Size of a value. */
+    size_t capacity;                /**< Maximum number of entries. */
+    size_t size;                    /**< Number of entries. */
+    u_int32_t * index;              /**< Hash index (entry + 1, 0 if empty). */
+    size_t mask;                    /**< Hash index size - 1. */
+    u_int32_t oldest;               /**< Least recently used entry. */
+    u_int32_t newest;               /**< Most recently used entry. */
+    u_int32_t free;                 /**< First free entry. */
+    flow_table_release release;     /**< Release function. */
+    void * user;                    /**< Release function parameter. */
+};
+
+/**
+ * \brief Get an entry.
+ * \param table Flow table.
+ * \param id Entry number.
+ * \return Entry.
+ */
+static inline __flow_entry * __flow_entry_get (const flow_table * table,
+        u_int32_t id);
+
+/**
+ * \brief Get the number of an entry.
+ * \param table Flow table.
+ * \param entry Entry.
+ * \return Entry number.
+ */
+static inline u_int32_t __flow_entry_id (const flow_table * table,
+        const __flow_entry * entry);
+
+/**
+ * \brief Unlink an entry from the LRU list.
+ * \param table Flow table.
+ * \param entry Entry.
+ */
+static inline void __flow_entry_unlink (flow_table * table,
+        __flow_entry * entry);
+
+/**
+ * \brief Link an entry as the most recently used one.
+ * \param table Flow table.
+ * \param entry Entry.
+ */
+static inline void __flow_entry_link (flow_table * table, __flow_entry * entry);
+
+////////////////////////////////////////////////////////////////////////////////
+// Flow tables.
+////////////////////////////////////////////////////////////////////////////////
+
+flow_table * flow_table_create (size_t capacity, size_t value_size,
+        flow_table_release release, void * user)
+{
+    if (capacity == 0 || capacity >= FLOW_NONE / 2)
+        return NULL;
+
+    flow_table * table = calloc (1, sizeof (flow_table));
+    if (table == NULL)
+        return NULL;
+
+    /* Keep the load factor at or below 1/2. */
+    size_t index_size = 1;
+    while (index_size < capacity * 2)
+        index_size *= 2;
+
+    table->entry_size = (sizeof (__flow_entry) + value_size + 7) & ~ (size_t) 7;
+    table->value_size = value_size;
+    table->capacity = capacity;
+    table->mask = index_size - 1;
+    table->entries = malloc (table->entry_size * capacity);
+    table->index = calloc (index_size, sizeof (u_int32_t));
+    table->oldest = FLOW_NONE;
+    table->newest = FLOW_NONE;
+    table->release = release;
+    table->user = user;
+
+    if (table->entries == NULL || table->index == NULL)
+    {
+        free (table->entries);
+        free (table->index);
+        free (table);
+        return NULL;
+    }
+
+    /* Chain the free entries. */
+    for (u_int32_t id = 0; id < capacity; ++id)
+        __flow_entry_get (table, id)->newer =
+            id + 1 < capacity ? id + 1 : FLOW_NONE;
+    table->free = 0;
+
+    return table;
+}
+
+void flow_table_destroy (flow_table * table)
+{
+    if (table == NULL)
+        return;
+
+    flow_table_clear (table);
+    free (table->entries);
+    free (table->index);
+    free (table);
+}
+
+void * flow_table_lookup (flow_table * const table,
+        const packet_flow * const flow, bool * const created)
+{
+    u_int64_t hash = packet_flow_hash (flow);
+    size_t slot = hash & table->mask;
+
+    for ( ; table->index[slot]; slot = (slot + 1) & table->mask)
+    {
+        __flow_entry * entry = __flow_entry_get (table,
+                table->index[slot] - 1);
+        if (entry->hash == hash && packet_flow_equal (& entry->flow, flow))
+        {
+            __flow_entry_unlink (table, entry);
+            __flow_entry_link (table, entry);
+            if (created != NULL)
+                * created = false;
+            return entry + 1;
+        }
+    }
+
+    if (table->size == table->capacity)
+    {
+        /* Evicting moves index slots around: probe again. */
+        flow_table_remove (table, __flow_entry_get (table, table->oldest) + 1);
+        for (slot = hash & table->mask; table->index[slot];
+                slot = (slot + 1) & table->mask)
+            continue;
+    }
+
+    u_int32_t id = table->free;
+    __flow_entry * entry = __flow_entry_get (table, id);
+    table->free = entry->newer;
+
+    entry->flow = * flow;
+    entry->hash = hash;
+    memset (entry + 1, 0, table->value_size);
+    table->index[slot] = id + 1;
+    __flow_entry_link (table, entry);
+    ++table->size;
+
+    if (created != NULL)
+        * created = true;
+
+    return entry + 1;
+}
+
+void * flow_table_find (const flow_table * const table,
+        const packet_flow * const flow)
+{
+    u_int64_t hash = packet_flow_hash (flow);
+
+    for (size_t slot = hash & table->mask; table->index[slot];
+            slot = (slot + 1) & table->mask)
+    {
+        __flow_entry * entry = __flow_entry_get (table,
+                table->index[slot] - 1);
+        if (entry->hash == hash && packet_flow_equal (& entry->flow, flow))
+            return entry + 1;
+    }
+
+    return NULL;
+}
+
+void flow_table_remove (flow_table * const table, void * const value)
+{
+    __flow_entry * entry = ((__flow_entry *) value) - 1;
+    u_int32_t id = __flow_entry_id (table, entry);
+
+    if (table->release != NULL)
+        table->release (& entry->flow, value, table->user);
+
+    /* Find the slot, then shift the following entries back (no tombstones). */
+    size_t slot = entry->hash & table->mask;
+    while (table->index[slot] != id + 1)
+        slot = (slot + 1) & table->mask;
+
+    for (size_t next = (slot + 1) & table->mask; table->index[next];
+            next = (next + 1) & table->mask)
+    {
+        size_t home = __flow_entry_get (table, table->index[next] - 1)->hash
+            & table->mask;
+        bool movable = slot <= next ? (home <= slot || home > next)
+            : (home <= slot && home > next);
+        if (movable)
+        {
+            table->index[slot] = table->index[next];
+            slot = next;
+        }
+    }
+    table->index[slot] = 0;
+
+    __flow_entry_unlink (table, entry);
+    entry->newer = table->free;
+    table->free = id;
+    --table->size;
+}
+
+void * flow_table_oldest (const flow_table * const table)
+{
+    return table->oldest != FLOW_NONE ?
+        __flow_entry_get (table, table->oldest) + 1 : NULL;
+}
+
+void * flow_table_next (const flow_table * const table,
+        const void * const value)
+{
+    const __flow_entry * entry = ((const __flow_entry *) value) - 1;
+
+    return entry->newer != FLOW_NONE ?
+        __flow_entry_get (table, entry->newer) + 1 : NULL;
+}
+
+const packet_flow * flow_table_flow (const void * const value)
+{
+    return & (((const __flow_entry *) value) - 1)->flow;
+}
+
+size_t flow_table_size (const flow_table * const table)
+{
+    return table->size;
+}
+
+void flow_table_clear (flow_table * const table)
+{
+    void * value;
+    while ((value = flow_table_oldest (table)) != NULL)
+        flow_table_remove (table, value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+__flow_entry * __flow_entry_get (const flow_table * const table, u_int32_t id)
+{
+    return (__flow_entry *) (table->entries + table->entry_size * id);
+}
+
+u_int32_t __flow_entry_id (const flow_table * const table,
+        const __flow_entry * const entry)
+{
+    return (u_int32_t) (((const u_char *) entry - table->entries)
+            / (long) table->entry_size);
+}
+
+void __flow_entry_unlink (flow_table * const table, __flow_entry * const entry)
+{
+    if (entry->older != FLOW_NONE)
+        __flow_entry_get (table, entry->older)->newer = entry->newer;
+    else
+        table->oldest = entry->newer;
+
+    if (entry->newer != FLOW_NONE)
+        __flow_entry_get (table, entry->newer)->older = entry->older;
+    else
+        table->newest = entry->older;
+}
+
+void __flow_entry_link (flow_table * const table, __flow_entry * const entry)
+{
+    u_int32_t id = __flow_entry_id (table, entry);
+
+    entry->older = table->newest;
+    entry->newer = FLOW_NONE;
+
+    if (table->newest != FLOW_NONE)
+        __flow_entry_get (table, table->newest)->newer = id;
+    else
+        table->oldest = id;
+
+    table->newest = id;
+}
@@ -0,0 +1,402 @@
+/**
+ * \file follow.c
+ * \brief Growing capture files.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "wiredolphin/follow.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define FOLLOW_BUFFER       (1024 * 1024)   /**< Read buffer size. */
+#define FOLLOW_NAME_MAX     4096            /**< File name length. */
+
+/** File events. */
+#define FOLLOW_FILE_EVENTS  (IN_MODIFY | IN_CLOSE_WRITE | IN_MOVE_SELF \
+        | IN_DELETE_SELF)
+
+/** Directory events. */
+#define FOLLOW_DIRECTORY_EVENTS (IN_CREATE | IN_MOVED_TO)
+
+struct follow
+{
+    char path[FOLLOW_NAME_MAX];         /**< Current file. */
+    char directory[FOLLOW_NAME_MAX];    /**< Directory of the files. */
+    int fd;                             /**< Current file. */
+    int notify;                         /**< inotify instance. */
+    int file_watch;                     /**< Current file watch. */
+    u_char * buffer;                    /**< Read buffer. */
+    size_t start;                       /**< First unread byte. */
+    size_t end;                         /**< Byte following the data. */
+    bool swapped;                       /**< Byte order differs. */
+    bool nano;                          /**< Nanosecond timestamps. */
+    int linktype;                       /**< Link type. */
+    pcap_t * capture;                   /**< Capture matching the files. */
+    bool filtered;                      /**< program is set. */
+    struct bpf_program program;         /**< Filter. */
+    struct pcap_pkthdr header;          /**< Last packet header. */
+    volatile sig_atomic_t * interrupted;    /**< Interruption flag. */
+};
+
+/**
+ * \brief Open a file of the series and read its header.
+ * \param followed Followed file.
+ * \param path File.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+static inline bool __follow_file_open (follow * followed, const char * path);
+
+/**
+ * \brief Read more data.
+ * \param followed Followed file.
+ * \return Number of bytes read, -1 on error.
+ */
+static inline ssize_t __follow_read (follow * followed);
+
+/**
+ * \brief Wait for the file or its directory to change.
+ * \param followed Followed file.
+ * \retval true On change.
+ * \retval false On error or interruption.
+ */
+static inline bool __follow_wait (follow * followed);
+
+/**
+ * \brief Find the file following the current one, if it was rotated.
+ * \param followed Followed file.
+ * \param next Next file.
+ * \retval true If the current file was rotated.
+ * \retval false otherwise.
+ */
+static inline bool __follow_rotated (const follow * followed,
+        char next[FOLLOW_NAME_MAX]);
+
+/**
+ * \brief Swap the bytes of a 32 bits word if need be.
+ * \param followed Followed file.
+ * \param word Word.
+ * \return Word.
+ */
+static inline u_int32_t __follow_word (const follow * followed,
+        u_int32_t word);
+
+////////////////////////////////////////////////////////////////////////////////
+// Growing capture files.
+////////////////////////////////////////////////////////////////////////////////
+
+follow * follow_open (const char * const file, const char * const filter,
+        volatile sig_atomic_t * const interrupted)
+{
+    follow * followed = calloc (1, sizeof (follow));
+    if (followed == NULL)
+        return NULL;
+
+    followed->fd = -1;
+    followed->file_watch = -1;
+    followed->linktype = -1;
+    followed->interrupted = interrupted;
+    followed->buffer = malloc (FOLLOW_BUFFER);
+    followed->notify = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+
+    char copy[FOLLOW_NAME_MAX];
+    snprintf (copy, sizeof copy, "%s", file);
+    snprintf (followed->directory, sizeof followed->directory, "%s",
+            dirname (copy));
+
+    if (followed->buffer == NULL || followed->notify < 0
+            || inotify_add_watch (followed->notify, followed->directory,
+                FOLLOW_DIRECTORY_EVENTS) < 0)
+    {
+        fprintf (stderr, "Error: Could not watch %s: %s.\n",
+                followed->directory, strerror (errno));
+        follow_close (followed);
+        return NULL;
+    }
+
+    if (! __follow_file_open (followed, file))
+    {
+        follow_close (followed);
+        return NULL;
+    }
+
+    /* Filters are compiled for the link type of the files. */
+    followed->capture = pcap_open_dead (followed->linktype, 65535);
+    if (followed->capture == NULL)
+    {
+        follow_close (followed);
+        return NULL;
+    }
+    followed->filtered = filter != NULL && ! pcap_compile (followed->capture,
+            & followed->program, filter, 1, 0);
+
+    return followed;
+}
+
+pcap_t * follow_capture (const follow * const followed)
+{
+    return followed->capture;
+}
+
+bool follow_next (follow * const followed, const struct pcap_pkthdr ** header,
+        const u_char ** bytes)
+{
+    char next[FOLLOW_NAME_MAX];
+
+    for (;;)
+    {
+        size_t available = followed->end - followed->start;
+        if (available >= sizeof (pcapfile_record))
+        {
+            pcapfile_record record;
+            memcpy (& record, followed->buffer + followed->start, sizeof record);
+            u_int32_t caplen = __follow_word (followed, record.caplen);
+
+            if (caplen > FOLLOW_BUFFER - sizeof record)
+            {
+                fprintf (stderr, "Error: %s: Invalid record.\n", followed->path);
+                return false;
+            }
+
+            if (available >= sizeof record + caplen)
+            {
+                u_int32_t fraction = __follow_word (followed, record.microseconds);
+                followed->header.ts.tv_sec =
+                    (time_t) __follow_word (followed, record.seconds);
+                followed->header.ts.tv_usec =
+                    (suseconds_t) (followed->nano ? fraction / 1000 : fraction);
+                followed->header.caplen = caplen;
+                followed->header.len = __follow_word (followed, record.len);
+
+                const u_char * data =
+                    followed->buffer + followed->start + sizeof record;
+                followed->start += sizeof record + caplen;
+
+                if (followed->filtered && ! pcap_offline_filter (
+                            & followed->program, & followed->header, data))
+                    continue;
+
+                * header = & followed->header;
+                * bytes = data;
+                return true;
+            }
+        }
+
+        ssize_t count = __follow_read (followed);
+        if (count > 0)
+            continue;
+        if (count < 0)
+            return false;
+
+        /* End of the data: the file was rotated, or is still being written. */
+        if (__follow_rotated (followed, next))
+        {
+            /* Drain what was written before the next file was created. */
+            count = __follow_read (followed);
+            if (count > 0)
+                continue;
+            if (count < 0)
+                return false;
+
+            if (followed->end > followed->start)
+                fprintf (stderr, "Warning: %s: Incomplete last record.\n",
+                        followed->path);
+            if (! __follow_file_open (followed, next))
+                return false;
+        }
+        else if (! __follow_wait (followed))
+            return false;
+    }
+}
+
+void follow_close (follow * const followed)
+{
+    if (followed == NULL)
+        return;
+
+    if (followed->filtered)
+        pcap_freecode (& followed->program);
+    if (followed->capture != NULL)
+        pcap_close (followed->capture);
+    if (followed->fd >= 0)
+        close (followed->fd);
+    if (followed->notify >= 0)
+        close (followed->notify);
+    free (followed->buffer);
+    free (followed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+bool __follow_file_open (follow * const followed, const char * const path)
+{
+    if (followed->fd >= 0)
+        close (followed->fd);
+    if (followed->file_watch >= 0)
+        inotify_rm_watch (followed->notify, followed->file_watch);
+
+    snprintf (followed->path, sizeof followed->path, "%s", path);
+    followed->start = followed->end = 0;
+    followed->file_watch = inotify_add_watch (followed->notify, path,
+            FOLLOW_FILE_EVENTS);
+    followed->fd = open (path, O_RDONLY | O_CLOEXEC);
+    if (followed->fd < 0 || followed->file_watch < 0)
+    {
+        fprintf (stderr, "Error: Could not open %s: %s.\n", path,
+                strerror (errno));
+        return false;
+    }
+
+    /* The header may not be written yet. */
+    while (followed->end < sizeof (struct pcap_file_header))
+    {
+        ssize_t count = __follow_read (followed);
+        if (count < 0 || (count == 0 && ! __follow_wait (followed)))
+            return false;
+    }
+
+    struct pcap_file_header header;
+    memcpy (& header, followed->buffer, sizeof header);
+    followed->start = sizeof header;
+
+    switch (header.magic)
+    {
+        case 0xa1b2c3d4: followed->swapped = false; followed->nano = false; break;
+        case 0xd4c3b2a1: followed->swapped = true; followed->nano = false; break;
+        case 0xa1b23c4d: followed->swapped = false; followed->nano = true; break;
+        case 0x4d3cb2a1: followed->swapped = true; followed->nano = true; break;
+        default:
+            fprintf (stderr, "Error: %s: Only pcap files can be followed.\n",
+                    path);
+            return false;
+    }
+
+    int linktype = (int) __follow_word (followed, header.linktype);
+    if (followed->linktype >= 0 && linktype != followed->linktype)
+    {
+        fprintf (stderr, "Error: %s: Link type changed.\n", path);
+        return false;
+    }
+    followed->linktype = linktype;
+
+    return true;
+}
+
+ssize_t __follow_read (follow * const followed)
+{
+    if (followed->start > 0)
+    {
+        memmove (followed->buffer, followed->buffer + followed->start,
+                followed->end - followed->start);
+        followed->end -= followed->start;
+        followed->start = 0;
+    }
+
+    ssize_t count;
+    do
+        count = read (followed->fd, followed->buffer + followed->end,
+                FOLLOW_BUFFER - followed->end);
+    while (count < 0 && errno == EINTR && ! * followed->interrupted);
+
+    if (count < 0)
+    {
+        if (! * followed->interrupted)
+            fprintf (stderr, "Error: Could not read %s: %s.\n", followed->path,
+                    strerror (errno));
+        return -1;
+    }
+
+    followed->end += (size_t) count;
+
+    return count;
+}
+
+bool __follow_wait (follow * const followed)
+{
+    struct pollfd descriptor = { .fd = followed->notify, .events = POLLIN, };
+
+    while (poll (& descriptor, 1, -1) < 0)
+        if (errno != EINTR || * followed->interrupted)
+            return false;
+
+    /* Events only wake the reader up: the state is checked again. */
+    char events[4096];
+    while (read (followed->notify, events, sizeof events) > 0)
+        continue;
+
+    return ! * followed->interrupted;
+}
+
+bool __follow_rotated (const follow * const followed,
+        char next[FOLLOW_NAME_MAX])
+{
+    /* A new file at the same path. */
+    struct stat current, named;
+    if (fstat (followed->fd, & current))
+        return false;
+    if (! stat (followed->path, & named) && named.st_ino != current.st_ino)
+    {
+        snprintf (next, FOLLOW_NAME_MAX, "%s", followed->path);
+        return true;
+    }
+
+    /* The next number of the series: name<n> after name or name<n - 1>. */
+    char copy[FOLLOW_NAME_MAX];
+    snprintf (copy, sizeof copy, "%s", followed->path);
+    const char * name = basename (copy);
+    size_t base = strlen (name);
+    while (base > 0 && isdigit ((unsigned char) name[base - 1]))
+        --base;
+    long number = name[base] != '\0' ? strtol (name + base, NULL, 10) : -1;
+
+    DIR * directory = opendir (followed->directory);
+    if (directory == NULL)
+        return false;
+
+    long best = -1;
+    struct dirent * entry;
+    while ((entry = readdir (directory)) != NULL)
+    {
+        const char * suffix = entry->d_name + base;
+        if (strncmp (entry->d_name, name, base) || * suffix == '\0'
+                || strspn (suffix, "0123456789") != strlen (suffix))
+            continue;
+
+        long value = strtol (suffix, NULL, 10);
+        if (value > number && (best < 0 || value < best)
+                && snprintf (next, FOLLOW_NAME_MAX, "%s/%s",
+                    followed->directory, entry->d_name) < FOLLOW_NAME_MAX)
+            best = value;
+    }
+    closedir (directory);
+
+    return best >= 0;
+}
+
+u_int32_t __follow_word (const follow * const followed, u_int32_t word)
+{
+    return followed->swapped ? __builtin_bswap32 (word) : word;
+}
@@ -548,6 +548,14 @@ struct in_addr header_ipv4_dest (const u_char * bytes)
     return (struct in_addr) { header->daddr };
 }
 
+const char * header_ip_protocol_string (u_int8_t protocol)
+{
+    if (protocol >= 143 && protocol <= 252)
+        return "UNASSIGNED";
+    else
+        return __IP_PROTOCOLS[protocol];
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // IPv6 headers.
 ////////////////////////////////////////////////////////////////////////////////
@@ -881,10 +889,7 @@ void __header_ipv4_print_flags (FILE * const stream, u_short flags_and_offset)
 void __header_ip_print_protocol (FILE * const stream,
         u_short protocol)
 {
-    if (protocol >= 143 && protocol <= 252)
-        fprintf (stream, "UNASSIGNED");
-    else
-        fprintf (stream, "%s", __IP_PROTOCOLS[protocol]);
+    fprintf (stream, "%s", header_ip_protocol_string ((u_int8_t) protocol));
 }
 
 void __header_arp_print_opcode (FILE * const stream,
@@ -0,0 +1,93 @@
+/**
+ * \file histogram.c
+ * \brief Log-linear histograms.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include "wiredolphin/histogram.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Histograms.
+////////////////////////////////////////////////////////////////////////////////
+
+void histogram_record (histogram * const values, u_int64_t value)
+{
+    ++values->counts[histogram_bucket (value)];
+    if (! values->count || value < values->min)
+        values->min = value;
+    if (value > values->max)
+        values->max = value;
+    ++values->count;
+    values->total += value;
+}
+
+void histogram_merge (histogram * const into, const histogram * const from)
+{
+    if (! from->count)
+        return;
+
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i)
+        into->counts[i] += from->counts[i];
+    if (! into->count || from->min < into->min)
+        into->min = from->min;
+    if (from->max > into->max)
+        into->max = from->max;
+    into->count += from->count;
+    into->total += from->total;
+}
+
+u_int64_t histogram_percentile (const histogram * const values,
+        double fraction)
+{
+    if (! values->count)
+        return 0;
+
+    u_int64_t rank = (u_int64_t) ((double) values->count * fraction);
+    u_int64_t seen = 0;
+    u_int64_t value = values->max;
+
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i)
+    {
+        seen += values->counts[i];
+        if (seen > rank)
+        {
+            value = histogram_value (i);
+            break;
+        }
+    }
+
+    /* The middle of the first and last buckets may lie beyond the values. */
+    if (value < values->min)
+        return values->min;
+    return value > values->max ? values->max : value;
+}
+
+size_t histogram_bucket (u_int64_t value)
+{
+    if (value < HISTOGRAM_SUB)
+        return (size_t) value;
+
+    /* Power of two, then the next HISTOGRAM_SUB_BITS bits. */
+    unsigned int shift = (unsigned int) (63 - __builtin_clzll (value))
+        - HISTOGRAM_SUB_BITS;
+    return (size_t) (shift + 1) * HISTOGRAM_SUB
+        + (size_t) ((value >> shift) & (HISTOGRAM_SUB - 1));
+}
+
+u_int64_t histogram_value (size_t bucket)
+{
+    if (bucket < HISTOGRAM_SUB)
+        return bucket;
+
+    unsigned int shift = (unsigned int) (bucket / HISTOGRAM_SUB) - 1;
+    u_int64_t low = (HISTOGRAM_SUB + bucket % HISTOGRAM_SUB) << shift;
+    return low + ((1ull << shift) >> 1);
+}
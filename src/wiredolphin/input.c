@@ -0,0 +1,570 @@
+/**
+ * \file input.c
+ * \brief Capture file input.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+/* tee, F_SETPIPE_SZ, fopencookie. */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#ifdef WIREDOLPHIN_ZSTD
+#include <zstd.h>
+#endif
+
+#include "wiredolphin/input.h"
+
+extern char ** environ;
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define INPUT_MAGIC_MAX     4               /**< Magic number length. */
+#define INPUT_PIPE_SIZE     (1024 * 1024)   /**< Decompressed data in flight. */
+#define INPUT_BUFFER_SIZE   (256 * 1024)    /**< Decompressed buffer size. */
+#define INPUT_BUFFERS       8               /**< Decompressed buffers. */
+
+/**
+ * \brief Compression format.
+ */
+typedef struct __input_format
+{
+    const char * magic;         /**< Magic number. */
+    size_t length;              /**< Magic number length. */
+    char * program;             /**< Decompression program. */
+    FILE * (* open) (int fd);   /**< Built-in decompression (may be NULL). */
+} __input_format;
+
+/**
+ * \brief File decompressed by a reader thread into a ring of buffers.
+ *
+ * Filled buffers are announced through an eventfd rather than a condition,
+ * so that signals interrupt the capture waiting for them, as with a pipe.
+ */
+typedef struct __input_stream
+{
+    int fd;                                 /**< Compressed file. */
+    pthread_t reader;                       /**< Reader thread. */
+    pthread_mutex_t lock;                   /**< Protects the fields below. */
+    int filled;                             /**< A buffer was filled. */
+    pthread_cond_t emptied;                 /**< A buffer was read. */
+    u_char * buffers[INPUT_BUFFERS];        /**< Buffers. */
+    size_t lengths[INPUT_BUFFERS];          /**< Decompressed lengths. */
+    unsigned int head;                      /**< First filled buffer. */
+    unsigned int count;                     /**< Filled buffers. */
+    size_t offset;                          /**< Bytes read from the head. */
+    bool done;                              /**< Nothing more to fill. */
+    bool quit;                              /**< Stream closed. */
+    int error;                              /**< Error (errno), 0 if none. */
+} __input_stream;
+
+#ifdef WIREDOLPHIN_ZSTD
+/**
+ * \brief Decompress a zstd file on a reader thread.
+ * \param fd File, closed with the stream.
+ * \return Stream, NULL on failure (errno is set).
+ */
+static FILE * __input_zstd_open (int fd);
+
+/**
+ * \brief Reader thread: decompress a zstd file into the buffers.
+ * \param argument Stream.
+ * \return NULL.
+ */
+static void * __input_zstd_run (void * argument);
+
+/**
+ * \brief Release the decompression context of a reader thread.
+ * \param argument Context.
+ */
+static void __input_zstd_release (void * argument);
+#endif
+
+/**
+ * \brief Known compression formats.
+ */
+static const __input_format __formats[] =
+{
+    { "\x1f\x8b", 2, "gzip", NULL, },
+#ifdef WIREDOLPHIN_ZSTD
+    { "\x28\xb5\x2f\xfd", 4, "zstd", __input_zstd_open, },
+#else
+    { "\x28\xb5\x2f\xfd", 4, "zstd", NULL, },
+#endif
+    { "\x04\x22\x4d\x18", 4, "lz4", NULL, },
+};
+
+static pid_t * __children = NULL;           /**< Decompressions. */
+static size_t __children_count = 0;         /**< Running decompressions. */
+
+/**
+ * \brief Read the first bytes of a file without consuming them.
+ * \param fd File.
+ * \param magic Bytes.
+ * \return Number of bytes read, 0 if the file can not be peeked at.
+ */
+static inline size_t __input_peek (int fd, u_char magic[INPUT_MAGIC_MAX]);
+
+/**
+ * \brief Run a decompression program on a file.
+ * \param fd File, closed.
+ * \param format Compression format.
+ * \return Decompressed data, -1 on failure (errno is set).
+ */
+static inline int __input_decompress (int fd, const __input_format * format);
+
+/**
+ * \brief Allocate a stream decompressed by a reader thread.
+ * \param fd Compressed file.
+ * \param run Reader thread.
+ * \return Stream, NULL on failure (errno is set, fd is left open).
+ */
+static inline FILE * __input_stream_open (int fd, void * (* run) (void *));
+
+/**
+ * \brief Read decompressed bytes (fopencookie).
+ * \param cookie Stream.
+ * \param buffer Buffer.
+ * \param size Buffer size.
+ * \return Number of bytes read, 0 at the end, -1 on error.
+ */
+static ssize_t __input_stream_read (void * cookie, char * buffer, size_t size);
+
+/**
+ * \brief Stop the reader thread and release a stream (fopencookie).
+ * \param cookie Stream.
+ * \return 0.
+ */
+static int __input_stream_close (void * cookie);
+
+/**
+ * \brief Wake up the capture waiting for a buffer.
+ * \param stream Stream.
+ */
+static inline void __input_stream_notify (__input_stream * stream);
+
+/**
+ * \brief Release the buffers and the file of a stream.
+ * \param stream Stream.
+ */
+static inline void __input_stream_free (__input_stream * stream);
+
+////////////////////////////////////////////////////////////////////////////////
+// Input.
+////////////////////////////////////////////////////////////////////////////////
+
+FILE * input_open (const char * const file, bool * const plain)
+{
+    int fd = strcmp (file, "-") ? open (file, O_RDONLY | O_CLOEXEC)
+        : STDIN_FILENO;
+    if (fd < 0)
+        return NULL;
+
+    u_char magic[INPUT_MAGIC_MAX];
+    size_t length = __input_peek (fd, magic);
+
+    const __input_format * format = NULL;
+    for (size_t i = 0; format == NULL
+            && i < sizeof __formats / sizeof __formats[0]; ++i)
+        if (length >= __formats[i].length
+                && ! memcmp (magic, __formats[i].magic, __formats[i].length))
+            format = & __formats[i];
+
+    if (plain != NULL)
+    {
+        struct stat status;
+        * plain = format == NULL && fd != STDIN_FILENO && ! fstat (fd, & status)
+            && S_ISREG (status.st_mode);
+    }
+
+    /* The external programs remain the fallback. */
+    if (format != NULL && format->open != NULL)
+    {
+        FILE * stream = format->open (fd);
+        if (stream != NULL)
+            return stream;
+    }
+
+    if (format != NULL && (fd = __input_decompress (fd, format)) < 0)
+        return NULL;
+
+    FILE * stream = fdopen (fd, "rb");
+    if (stream == NULL)
+    {
+        int error = errno;
+        close (fd);
+        errno = error;
+    }
+
+    return stream;
+}
+
+void input_finish (void)
+{
+    for (size_t i = 0; i < __children_count; ++i)
+    {
+        int status;
+        /* Streams closed early end their decompression with SIGPIPE. */
+        if (waitpid (__children[i], & status, 0) == __children[i]
+                && WIFEXITED (status) && WEXITSTATUS (status) != 0)
+            fprintf (stderr, "Warning: Decompression failed (status %d).\n",
+                    WEXITSTATUS (status));
+    }
+
+    free (__children);
+    __children = NULL;
+    __children_count = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+size_t __input_peek (int fd, u_char magic[INPUT_MAGIC_MAX])
+{
+    struct stat status;
+    if (fstat (fd, & status))
+        return 0;
+
+    ssize_t count = 0;
+    if (S_ISREG (status.st_mode))
+    {
+        off_t offset = lseek (fd, 0, SEEK_CUR);
+        count = offset < 0 ? 0 : pread (fd, magic, INPUT_MAGIC_MAX, offset);
+    }
+    else if (S_ISSOCK (status.st_mode))
+        count = recv (fd, magic, INPUT_MAGIC_MAX, MSG_PEEK | MSG_WAITALL);
+    else if (S_ISFIFO (status.st_mode))
+    {
+        /* The first write into a pipe normally holds the whole magic number. */
+        int copy[2];
+        if (pipe2 (copy, O_CLOEXEC))
+            return 0;
+        count = tee (fd, copy[1], INPUT_MAGIC_MAX, 0);
+        if (count > 0)
+            count = read (copy[0], magic, (size_t) count);
+        close (copy[0]);
+        close (copy[1]);
+    }
+
+    return count > 0 ? (size_t) count : 0;
+}
+
+int __input_decompress (int fd, const __input_format * const format)
+{
+    int output[2];
+    if (pipe2 (output, O_CLOEXEC))
+    {
+        int error = errno;
+        close (fd);
+        errno = error;
+        return -1;
+    }
+
+    /* A larger pipe lets the decompression run further ahead. */
+    fcntl (output[0], F_SETPIPE_SZ, INPUT_PIPE_SIZE);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init (& actions);
+    posix_spawn_file_actions_adddup2 (& actions, fd, STDIN_FILENO);
+    posix_spawn_file_actions_adddup2 (& actions, output[1], STDOUT_FILENO);
+
+    pid_t * children = realloc (__children,
+            (__children_count + 1) * sizeof (pid_t));
+    char * arguments[] = { format->program, "-dc", NULL };
+    pid_t child;
+    int error = children == NULL ? ENOMEM : posix_spawnp (& child,
+            format->program, & actions, NULL, arguments, environ);
+
+    posix_spawn_file_actions_destroy (& actions);
+    close (fd);
+    close (output[1]);
+
+    if (children != NULL)
+        __children = children;
+    if (error)
+    {
+        fprintf (stderr, "Error: Could not run %s.\n", format->program);
+        close (output[0]);
+        errno = error;
+        return -1;
+    }
+    __children[__children_count++] = child;
+
+    return output[0];
+}
+
+FILE * __input_stream_open (int fd, void * (* run) (void *))
+{
+    __input_stream * stream = calloc (1, sizeof * stream);
+    if (stream == NULL)
+        return NULL;
+
+    stream->fd = fd;
+    stream->filled = -1;
+    for (unsigned int i = 0; i < INPUT_BUFFERS; ++i)
+        if ((stream->buffers[i] = malloc (INPUT_BUFFER_SIZE)) == NULL)
+        {
+            stream->fd = -1;
+            __input_stream_free (stream);
+            errno = ENOMEM;
+            return NULL;
+        }
+    stream->filled = eventfd (0, EFD_CLOEXEC);
+    if (stream->filled < 0)
+    {
+        int error = errno;
+        stream->fd = -1;
+        __input_stream_free (stream);
+        errno = error;
+        return NULL;
+    }
+    pthread_mutex_init (& stream->lock, NULL);
+    pthread_cond_init (& stream->emptied, NULL);
+
+    /* Signals are for the capture thread. */
+    sigset_t all, previous;
+    sigfillset (& all);
+    pthread_sigmask (SIG_SETMASK, & all, & previous);
+    int error = pthread_create (& stream->reader, NULL, run, stream);
+    pthread_sigmask (SIG_SETMASK, & previous, NULL);
+
+    if (error)
+    {
+        pthread_cond_destroy (& stream->emptied);
+        pthread_mutex_destroy (& stream->lock);
+        stream->fd = -1;
+        __input_stream_free (stream);
+        errno = error;
+        return NULL;
+    }
+
+    cookie_io_functions_t functions =
+    {
+        .read = __input_stream_read,
+        .write = NULL,
+        .seek = NULL,
+        .close = __input_stream_close,
+    };
+    FILE * file = fopencookie (stream, "rb", functions);
+    if (file == NULL)
+    {
+        error = errno;
+        stream->fd = -1;
+        __input_stream_close (stream);
+        errno = error;
+    }
+
+    return file;
+}
+
+ssize_t __input_stream_read (void * const cookie, char * const buffer,
+        size_t size)
+{
+    __input_stream * stream = cookie;
+
+    unsigned int head;
+    bool empty;
+    int error;
+    for (;;)
+    {
+        pthread_mutex_lock (& stream->lock);
+        head = stream->head;
+        empty = stream->count == 0;
+        error = stream->error;
+        bool done = stream->done;
+        pthread_mutex_unlock (& stream->lock);
+        if (! empty || done)
+            break;
+
+        /* Interrupted by a signal: errno is EINTR. */
+        u_int64_t events;
+        if (read (stream->filled, & events, sizeof events) < 0
+                && errno == EINTR)
+            return -1;
+    }
+
+    if (empty)
+    {
+        errno = error;
+        return error ? -1 : 0;
+    }
+
+    /* The reader thread leaves the filled buffers alone. */
+    size_t left = stream->lengths[head] - stream->offset;
+    size_t length = size < left ? size : left;
+    memcpy (buffer, stream->buffers[head] + stream->offset, length);
+    stream->offset += length;
+
+    if (stream->offset == stream->lengths[head])
+    {
+        pthread_mutex_lock (& stream->lock);
+        stream->head = (stream->head + 1) % INPUT_BUFFERS;
+        --stream->count;
+        stream->offset = 0;
+        pthread_cond_signal (& stream->emptied);
+        pthread_mutex_unlock (& stream->lock);
+    }
+
+    return (ssize_t) length;
+}
+
+int __input_stream_close (void * const cookie)
+{
+    __input_stream * stream = cookie;
+
+    pthread_mutex_lock (& stream->lock);
+    stream->quit = true;
+    pthread_cond_signal (& stream->emptied);
+    pthread_mutex_unlock (& stream->lock);
+
+    /* The reader may be waiting for input (standard input, pipes). */
+    pthread_cancel (stream->reader);
+    pthread_join (stream->reader, NULL);
+
+    pthread_cond_destroy (& stream->emptied);
+    pthread_mutex_destroy (& stream->lock);
+    __input_stream_free (stream);
+
+    return 0;
+}
+
+void __input_stream_notify (__input_stream * const stream)
+{
+    u_int64_t event = 1;
+    while (write (stream->filled, & event, sizeof event) < 0
+            && errno == EINTR)
+        continue;
+}
+
+void __input_stream_free (__input_stream * const stream)
+{
+    for (unsigned int i = 0; i < INPUT_BUFFERS; ++i)
+        free (stream->buffers[i]);
+    if (stream->fd >= 0)
+        close (stream->fd);
+    if (stream->filled >= 0)
+        close (stream->filled);
+    free (stream);
+}
+
+#ifdef WIREDOLPHIN_ZSTD
+FILE * __input_zstd_open (int fd)
+{
+    return __input_stream_open (fd, __input_zstd_run);
+}
+
+void * __input_zstd_run (void * const argument)
+{
+    __input_stream * stream = argument;
+
+    /* Only the reads can be cancelled, when the stream is closed. */
+    int state;
+    pthread_setcancelstate (PTHREAD_CANCEL_DISABLE, & state);
+
+    ZSTD_DCtx * context = ZSTD_createDCtx ();
+    size_t input_size = ZSTD_DStreamInSize ();
+    u_char * input_bytes = malloc (input_size);
+    ZSTD_inBuffer input = { input_bytes, 0, 0, };
+    size_t result = 0;
+    int error = context == NULL || input_bytes == NULL ? ENOMEM : 0;
+    bool end = error != 0;
+    bool eof = false;
+
+    pthread_cleanup_push (free, input_bytes);
+    pthread_cleanup_push (__input_zstd_release, context);
+
+    while (! end)
+    {
+        pthread_mutex_lock (& stream->lock);
+        while (stream->count == INPUT_BUFFERS && ! stream->quit)
+            pthread_cond_wait (& stream->emptied, & stream->lock);
+        bool quit = stream->quit;
+        unsigned int slot = (stream->head + stream->count) % INPUT_BUFFERS;
+        pthread_mutex_unlock (& stream->lock);
+        if (quit)
+            break;
+
+        ZSTD_outBuffer output = { stream->buffers[slot], INPUT_BUFFER_SIZE,
+            0, };
+        while (! end && output.pos < output.size)
+        {
+            if (input.pos == input.size)
+            {
+                pthread_setcancelstate (PTHREAD_CANCEL_ENABLE, & state);
+                ssize_t count = read (stream->fd, input_bytes, input_size);
+                pthread_setcancelstate (PTHREAD_CANCEL_DISABLE, & state);
+                if (count < 0 && errno == EINTR)
+                    continue;
+                if (count <= 0)
+                {
+                    error = count < 0 ? errno : 0;
+                    eof = count == 0;
+                    end = true;
+                    break;
+                }
+                input.size = (size_t) count;
+                input.pos = 0;
+            }
+
+            result = ZSTD_decompressStream (context, & output, & input);
+            if (ZSTD_isError (result))
+            {
+                fprintf (stderr, "Error: zstd: %s.\n",
+                        ZSTD_getErrorName (result));
+                error = EIO;
+                end = true;
+            }
+        }
+
+        pthread_mutex_lock (& stream->lock);
+        if (output.pos > 0)
+        {
+            stream->lengths[slot] = output.pos;
+            ++stream->count;
+        }
+        pthread_mutex_unlock (& stream->lock);
+        __input_stream_notify (stream);
+    }
+
+    /* A frame left halfway: the file is truncated. */
+    if (eof && result != 0)
+        fprintf (stderr, "Warning: Decompression failed (truncated file).\n");
+
+    pthread_cleanup_pop (1);
+    pthread_cleanup_pop (1);
+
+    pthread_mutex_lock (& stream->lock);
+    stream->error = error;
+    stream->done = true;
+    pthread_mutex_unlock (& stream->lock);
+    __input_stream_notify (stream);
+
+    return NULL;
+}
+
+void __input_zstd_release (void * const argument)
+{
+    ZSTD_freeDCtx (argument);
+}
+#endif
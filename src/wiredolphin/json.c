@@ -0,0 +1,836 @@
+/**
+ * \file json.c
+ * \brief JSON output of the decoded packets.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "wiredolphin/json.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define JSON_BUFFER_SIZE    (64 * 1024) /**< Output buffer size. */
+#define JSON_CHUNK          4096        /**< Bytes copied at once. */
+
+/**
+ * \brief Append a string literal.
+ * \param literal String literal.
+ */
+#define __json_literal(literal) __json_raw ((literal), sizeof (literal) - 1)
+
+static bool __enabled = false;              /**< JSON output. */
+static char __buffer[JSON_BUFFER_SIZE];     /**< Object being built. */
+static size_t __length = 0;                 /**< Bytes in the buffer. */
+static FILE * __stream = NULL;              /**< Output stream. */
+static bool __first = true;                 /**< No member written yet. */
+
+/**
+ * \brief Print the layers of a packet.
+ * \param info Decoded packet.
+ * \param complete Whether to print every field.
+ */
+static inline void __json_layers (const packet_info * info, bool complete);
+
+/**
+ * \brief Print the network layer of a packet.
+ * \param info Decoded packet.
+ * \param complete Whether to print every field.
+ */
+static inline void __json_network (const packet_info * info, bool complete);
+
+/**
+ * \brief Print the transport layer of a packet.
+ * \param info Decoded packet.
+ * \param complete Whether to print every field.
+ */
+static inline void __json_transport (const packet_info * info, bool complete);
+
+/**
+ * \brief Print the application layer of a packet.
+ * \param info Decoded packet.
+ * \param complete Whether to print every field.
+ */
+static inline void __json_application (const packet_info * info,
+        bool complete);
+
+/**
+ * \brief Print a BOOTP message.
+ * \param info Decoded packet.
+ * \param complete Whether to print every field.
+ */
+static inline void __json_bootp (const packet_info * info, bool complete);
+
+/**
+ * \brief Print a DNS message.
+ * \param info Decoded packet.
+ * \param complete Whether to print every field.
+ */
+static inline void __json_dns (const packet_info * info, bool complete);
+
+/**
+ * \brief Print a flow.
+ * \param key Key.
+ * \param flow Flow.
+ */
+static inline void __json_flow (const char * key, const packet_flow * flow);
+
+/**
+ * \brief Start an object.
+ * \param key Key (NULL in arrays and at the top level).
+ */
+static inline void __json_object (const char * key);
+
+/**
+ * \brief Start an array.
+ * \param key Key.
+ */
+static inline void __json_array (const char * key);
+
+/**
+ * \brief End an object or an array.
+ * \param character '}' or ']'.
+ */
+static inline void __json_end (char character);
+
+/**
+ * \brief Start a member (or an array element).
+ * \param key Key (NULL for array elements).
+ */
+static inline void __json_key (const char * key);
+
+/**
+ * \brief Print an unsigned integer member.
+ * \param key Key.
+ * \param value Value.
+ */
+static inline void __json_unsigned (const char * key, u_int64_t value);
+
+/**
+ * \brief Print a boolean member.
+ * \param key Key.
+ * \param value Value.
+ */
+static inline void __json_bool (const char * key, bool value);
+
+/**
+ * \brief Print a string member.
+ * \param key Key.
+ * \param value Value.
+ */
+static inline void __json_string (const char * key, const char * value);
+
+/**
+ * \brief Print bytes as a string member.
+ * \param key Key.
+ * \param bytes First byte.
+ * \param limit Byte following the last byte.
+ */
+static inline void __json_text (const char * key, const u_char * bytes,
+        const u_char * limit);
+
+/**
+ * \brief Print bytes as a hexadecimal string member.
+ * \param key Key.
+ * \param bytes First byte.
+ * \param limit Byte following the last byte.
+ */
+static inline void __json_hex (const char * key, const u_char * bytes,
+        const u_char * limit);
+
+/**
+ * \brief Print a MAC address member.
+ * \param key Key.
+ * \param address Address.
+ */
+static inline void __json_mac (const char * key, const u_int8_t * address);
+
+/**
+ * \brief Print an IPv4 address member.
+ * \param key Key.
+ * \param address Address (network byte order).
+ */
+static inline void __json_ipv4 (const char * key, const void * address);
+
+/**
+ * \brief Print an IPv6 address member.
+ * \param key Key.
+ * \param address Address.
+ */
+static inline void __json_ipv6 (const char * key, const void * address);
+
+/**
+ * \brief Append the escaped bytes of a string.
+ * \param bytes First byte.
+ * \param limit Byte following the last byte.
+ */
+static inline void __json_escape (const u_char * bytes, const u_char * limit);
+
+/**
+ * \brief Append the decimal digits of an unsigned integer.
+ * \param value Value.
+ * \param width Minimal digit count (zero padded).
+ */
+static inline void __json_digits (u_int64_t value, size_t width);
+
+/**
+ * \brief Append bytes.
+ * \param bytes Bytes.
+ * \param size Size.
+ */
+static inline void __json_raw (const char * bytes, size_t size);
+
+/**
+ * \brief Make room in the buffer, writing it out if needed.
+ * \param size Bytes about to be appended (at most JSON_BUFFER_SIZE).
+ */
+static inline void __json_reserve (size_t size);
+
+/**
+ * \brief Start a line.
+ * \param stream Output stream.
+ */
+static inline void __json_start (FILE * stream);
+
+/**
+ * \brief End a line and write it out.
+ */
+static inline void __json_finish (void);
+
+////////////////////////////////////////////////////////////////////////////////
+// Output.
+////////////////////////////////////////////////////////////////////////////////
+
+void json_set_enabled (bool enabled)
+{
+    __enabled = enabled;
+}
+
+bool json_enabled (void)
+{
+    return __enabled;
+}
+
+void json_packet (FILE * const stream, const packet_info * const info,
+        callback_level level)
+{
+    if (level >= CALLBACK_STATS)
+        return;
+
+    const struct pcap_pkthdr * header = info->header;
+    bool complete = level == CALLBACK_COMPLETE;
+
+    __json_start (stream);
+    __json_key ("time");
+    __json_digits ((u_int64_t) header->ts.tv_sec, 1);
+    __json_literal (".");
+    __json_digits ((u_int64_t) header->ts.tv_usec, 6);
+    __json_unsigned ("interface", info->interface);
+    __json_unsigned ("length", header->len);
+    __json_unsigned ("caplen", header->caplen);
+    if (info->malformed)
+        __json_bool ("malformed", true);
+    if (level == CALLBACK_RAW || complete)
+        __json_hex ("bytes", info->frame, info->limit);
+    if (level != CALLBACK_RAW)
+        __json_layers (info, complete);
+    __json_finish ();
+}
+
+void json_repeat (FILE * const stream, u_int64_t repeats,
+        const u_int8_t * const src_mac, const u_int8_t * const dest_mac,
+        const packet_flow * const flow)
+{
+    __json_start (stream);
+    __json_unsigned ("repeated", repeats);
+    if (src_mac != NULL)
+    {
+        __json_object ("ethernet");
+        __json_mac ("src", src_mac);
+        __json_mac ("dst", dest_mac);
+        __json_end ('}');
+        if (flow->packet_type == ETHERTYPE_IP
+                || flow->packet_type == ETHERTYPE_IPV6)
+            __json_flow ("flow", flow);
+    }
+    __json_finish ();
+}
+
+void json_limit (FILE * const stream, const packet_flow * const flow,
+        u_int64_t packets, u_int64_t bytes, u_int64_t hidden, double duration,
+        const char * const reason)
+{
+    char buffer[32];
+    int length = snprintf (buffer, sizeof buffer, "%.3f", duration);
+
+    __json_start (stream);
+    __json_bool ("limited", true);
+    __json_flow ("flow", flow);
+    __json_unsigned ("packets", packets);
+    __json_unsigned ("bytes", bytes);
+    __json_unsigned ("hidden", hidden);
+    __json_key ("duration");
+    __json_raw (buffer, length > 0 ? (size_t) length : 0);
+    __json_string ("reason", reason);
+    __json_finish ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+void __json_layers (const packet_info * const info, bool complete)
+{
+    if (info->limit - info->frame < (ptrdiff_t) sizeof (struct ether_header))
+        return;
+
+    const struct ether_header * ethernet =
+        (const struct ether_header *) info->frame;
+    __json_object ("ethernet");
+    __json_mac ("src", ethernet->ether_shost);
+    __json_mac ("dst", ethernet->ether_dhost);
+    __json_unsigned ("type", info->flow.packet_type);
+    if (info->tagged)
+        __json_unsigned ("vlan", info->vlan);
+    __json_end ('}');
+
+    __json_network (info, complete);
+    __json_transport (info, complete);
+    __json_application (info, complete);
+}
+
+void __json_network (const packet_info * const info, bool complete)
+{
+    const u_char * network = info->network;
+    if (network == NULL)
+        return;
+
+    if (info->flow.packet_type == ETHERTYPE_IP)
+    {
+        const struct iphdr * header = (const struct iphdr *) network;
+        __json_object ("ipv4");
+        __json_ipv4 ("src", & header->saddr);
+        __json_ipv4 ("dst", & header->daddr);
+        __json_unsigned ("protocol", header->protocol);
+        if (complete)
+        {
+            u_int16_t fragment = ntohs (header->frag_off);
+            __json_unsigned ("ihl", header->ihl);
+            __json_unsigned ("tos", header->tos);
+            __json_unsigned ("total_length", ntohs (header->tot_len));
+            __json_unsigned ("id", ntohs (header->id));
+            __json_bool ("dont_fragment", fragment & IP_DF);
+            __json_bool ("more_fragments", fragment & IP_MF);
+            __json_unsigned ("fragment_offset", fragment & IP_OFFMASK);
+            __json_unsigned ("ttl", header->ttl);
+            __json_unsigned ("checksum", ntohs (header->check));
+        }
+        __json_end ('}');
+    }
+    else if (info->flow.packet_type == ETHERTYPE_IPV6)
+    {
+        const struct ip6_hdr * header = (const struct ip6_hdr *) network;
+        __json_object ("ipv6");
+        __json_ipv6 ("src", & header->ip6_src);
+        __json_ipv6 ("dst", & header->ip6_dst);
+        __json_unsigned ("next_header", header->ip6_nxt);
+        if (complete)
+        {
+            u_int32_t flow = ntohl (header->ip6_flow);
+            __json_unsigned ("traffic_class", (flow >> 20) & 0xff);
+            __json_unsigned ("flow_label", flow & 0xfffff);
+            __json_unsigned ("payload_length", ntohs (header->ip6_plen));
+            __json_unsigned ("hop_limit", header->ip6_hlim);
+        }
+        __json_end ('}');
+    }
+    else if (info->flow.packet_type == ETHERTYPE_ARP
+            && info->limit - network >= (ptrdiff_t) sizeof (struct ether_arp))
+    {
+        const struct ether_arp * header = (const struct ether_arp *) network;
+        __json_object ("arp");
+        __json_unsigned ("operation", ntohs (header->ea_hdr.ar_op));
+        if (header->ea_hdr.ar_hln == ETH_ALEN && header->ea_hdr.ar_pln == 4)
+        {
+            __json_mac ("sender_mac", header->arp_sha);
+            __json_ipv4 ("sender_ip", header->arp_spa);
+            __json_mac ("target_mac", header->arp_tha);
+            __json_ipv4 ("target_ip", header->arp_tpa);
+        }
+        if (complete)
+        {
+            __json_unsigned ("hardware_type", ntohs (header->ea_hdr.ar_hrd));
+            __json_unsigned ("protocol_type", ntohs (header->ea_hdr.ar_pro));
+        }
+        __json_end ('}');
+    }
+}
+
+void __json_transport (const packet_info * const info, bool complete)
+{
+    const u_char * transport = info->transport;
+    if (transport == NULL)
+        return;
+
+    switch (info->flow.protocol)
+    {
+        case IPPROTO_TCP:
+        {
+            const struct tcphdr * header = (const struct tcphdr *) transport;
+            __json_object ("tcp");
+            __json_unsigned ("src_port", info->flow.src_port);
+            __json_unsigned ("dst_port", info->flow.dest_port);
+            __json_unsigned ("flags", header->th_flags);
+            if (complete)
+            {
+                __json_unsigned ("seq", ntohl (header->th_seq));
+                __json_unsigned ("ack", ntohl (header->th_ack));
+                __json_unsigned ("data_offset", header->th_off);
+                __json_unsigned ("window", ntohs (header->th_win));
+                __json_unsigned ("checksum", ntohs (header->th_sum));
+                __json_unsigned ("urgent", ntohs (header->th_urp));
+            }
+            __json_end ('}');
+            break;
+        }
+        case IPPROTO_UDP:
+        {
+            const struct udphdr * header = (const struct udphdr *) transport;
+            __json_object ("udp");
+            __json_unsigned ("src_port", info->flow.src_port);
+            __json_unsigned ("dst_port", info->flow.dest_port);
+            if (complete)
+            {
+                __json_unsigned ("length", ntohs (header->uh_ulen));
+                __json_unsigned ("checksum", ntohs (header->uh_sum));
+            }
+            __json_end ('}');
+            break;
+        }
+        case IPPROTO_ICMP:
+        case IPPROTO_ICMPV6:
+            /* Type, code and checksum are common to both. */
+            if (info->limit - transport < 4)
+                break;
+            __json_object (info->flow.protocol == IPPROTO_ICMP ? "icmp"
+                    : "icmpv6");
+            __json_unsigned ("type", transport[0]);
+            __json_unsigned ("code", transport[1]);
+            if (complete)
+                __json_unsigned ("checksum",
+                        ntohs (* (const u_int16_t *) (transport + 2)));
+            __json_end ('}');
+            break;
+        default:
+            break;
+    }
+}
+
+void __json_application (const packet_info * const info, bool complete)
+{
+    const u_char * data = info->data;
+    if (info->application == PACKET_APP_NONE || data == NULL)
+        return;
+
+    if (info->application == PACKET_APP_BOOTP)
+    {
+        __json_bootp (info, complete);
+        return;
+    }
+    if (info->application == PACKET_APP_DNS)
+    {
+        __json_dns (info, complete);
+        return;
+    }
+    if (data == info->limit)
+        return;
+
+    bool encrypted = info->application == PACKET_APP_HTTPS
+        || info->application == PACKET_APP_SMTPS
+        || info->application == PACKET_APP_IMAPS
+        || info->application == PACKET_APP_POPS;
+
+    __json_object ("application");
+    __json_string ("name", packet_application_string (info->application));
+    if (complete && encrypted)
+        __json_hex ("payload", data, info->limit);
+    else if (complete)
+        __json_text ("payload", data, info->limit);
+    else if (! encrypted)
+    {
+        const u_char * end = data;
+        while (end < info->limit && * end != '\r' && * end != '\n')
+            ++end;
+        __json_text ("line", data, end);
+    }
+    __json_end ('}');
+}
+
+void __json_bootp (const packet_info * const info, bool complete)
+{
+    const u_char * limit = info->limit;
+    if (limit - info->data < (ptrdiff_t) offsetof (bootp_header,
+                vendor_specific))
+        return;
+
+    const bootp_header * header = (const bootp_header *) info->data;
+    __json_object ("bootp");
+    __json_unsigned ("opcode", header->opcode);
+    __json_unsigned ("transaction_id", ntohl (header->transaction_id));
+    __json_ipv4 ("client", & header->client_addr);
+    __json_ipv4 ("your", & header->your_addr);
+    __json_ipv4 ("server", & header->server_addr);
+    __json_ipv4 ("gateway", & header->gateway_addr);
+    if (header->hw_addr_len == ETH_ALEN)
+        __json_mac ("hw_addr", header->hw_addr);
+
+    dhcp_message_type type = dhcp_message_type_get (info->data, limit);
+    if (type != 0)
+        __json_string ("dhcp_type", dhcp_message_type_string (type));
+
+    if (complete)
+    {
+        const u_char * end;
+        __json_unsigned ("hw_type", header->hw_type);
+        __json_unsigned ("hops", header->hop_count);
+        __json_unsigned ("seconds", ntohs (header->seconds_count));
+        end = memchr (header->server_hostname, '\0', BOOTP_HOSTNAME_LEN);
+        __json_text ("server_hostname", header->server_hostname, end != NULL
+                ? end : header->server_hostname + BOOTP_HOSTNAME_LEN);
+        end = memchr (header->boot_filename, '\0', BOOTP_FILENAME_LEN);
+        __json_text ("boot_filename", header->boot_filename, end != NULL
+                ? end : header->boot_filename + BOOTP_FILENAME_LEN);
+
+        /* Options, as in dhcp_message_type_get. */
+        const u_int8_t * bytes = header->vendor_specific + 4;
+        if (bytes <= limit && ntohl (* (const u_int32_t *)
+                    header->vendor_specific) == BOOTP_MAGIC_COOKIE)
+        {
+            __json_array ("options");
+            while (bytes + 2 <= limit && bytes[0] != 255)
+            {
+                if (bytes[0] == 0)
+                {
+                    ++bytes;
+                    continue;
+                }
+
+                bootp_tlv tlv = bootp_extract_tlv (bytes);
+                if (tlv.next > limit)
+                    break;
+                __json_object (NULL);
+                __json_unsigned ("type", tlv.type);
+                __json_hex ("value", tlv.value, tlv.next);
+                __json_end ('}');
+                bytes = tlv.next;
+            }
+            __json_end (']');
+        }
+    }
+    __json_end ('}');
+}
+
+void __json_dns (const packet_info * const info, bool complete)
+{
+    /* Over TCP, messages follow their 2 bytes length. */
+    const u_char * start = info->data;
+    if (info->flow.protocol == IPPROTO_TCP)
+    {
+        if (info->limit - start < 2)
+            return;
+        start += 2;
+    }
+
+    dns_message message;
+    if (! dns_open (& message, start, info->limit))
+        return;
+
+    const dns_header * header = dns_get_header (& message);
+    u_int16_t flags = ntohs (header->flags);
+    __json_object ("dns");
+    __json_unsigned ("id", ntohs (header->id));
+    __json_unsigned ("flags", flags);
+    __json_unsigned ("rcode", DNS_RCODE (flags));
+
+    dns_record record;
+    if (dns_next (& message, & record) && record.section == DNS_QUESTION)
+    {
+        char name[DNS_NAME_MAX + 1];
+        dns_name_format (& message, record.name, name, sizeof name);
+        __json_string ("qname", name);
+        __json_unsigned ("qtype", record.type);
+    }
+
+    if (complete)
+    {
+        __json_unsigned ("questions", ntohs (header->questions));
+        __json_unsigned ("answers", ntohs (header->answers));
+        __json_unsigned ("authorities", ntohs (header->authorities));
+        __json_unsigned ("additionals", ntohs (header->additionals));
+    }
+    __json_end ('}');
+}
+
+void __json_flow (const char * const key, const packet_flow * const flow)
+{
+    __json_object (key);
+    if (flow->packet_type == ETHERTYPE_IP)
+    {
+        __json_ipv4 ("src", & flow->src_addr);
+        __json_ipv4 ("dst", & flow->dest_addr);
+    }
+    else if (flow->packet_type == ETHERTYPE_IPV6)
+    {
+        __json_ipv6 ("src", & flow->src_addr);
+        __json_ipv6 ("dst", & flow->dest_addr);
+    }
+    else
+    {
+        __json_unsigned ("type", flow->packet_type);
+        __json_mac ("src", flow->src_addr.s6_addr);
+        __json_mac ("dst", flow->dest_addr.s6_addr);
+    }
+
+    if (flow->packet_type == ETHERTYPE_IP
+            || flow->packet_type == ETHERTYPE_IPV6)
+    {
+        __json_unsigned ("protocol", flow->protocol);
+        if (flow->protocol == IPPROTO_TCP || flow->protocol == IPPROTO_UDP)
+        {
+            __json_unsigned ("src_port", flow->src_port);
+            __json_unsigned ("dst_port", flow->dest_port);
+        }
+    }
+    __json_end ('}');
+}
+
+void __json_object (const char * const key)
+{
+    __json_key (key);
+    __json_literal ("{");
+    __first = true;
+}
+
+void __json_array (const char * const key)
+{
+    __json_key (key);
+    __json_literal ("[");
+    __first = true;
+}
+
+void __json_end (char character)
+{
+    __json_raw (& character, 1);
+    __first = false;
+}
+
+void __json_key (const char * const key)
+{
+    if (! __first)
+        __json_literal (",");
+    __first = false;
+
+    if (key != NULL)
+    {
+        __json_literal ("\"");
+        __json_raw (key, strlen (key));
+        __json_literal ("\":");
+    }
+}
+
+void __json_unsigned (const char * const key, u_int64_t value)
+{
+    __json_key (key);
+    __json_digits (value, 1);
+}
+
+void __json_bool (const char * const key, bool value)
+{
+    __json_key (key);
+    if (value)
+        __json_literal ("true");
+    else
+        __json_literal ("false");
+}
+
+void __json_string (const char * const key, const char * const value)
+{
+    __json_text (key, (const u_char *) value,
+            (const u_char *) value + strlen (value));
+}
+
+void __json_text (const char * const key, const u_char * const bytes,
+        const u_char * const limit)
+{
+    __json_key (key);
+    __json_literal ("\"");
+    __json_escape (bytes, limit);
+    __json_literal ("\"");
+}
+
+void __json_hex (const char * const key, const u_char * bytes,
+        const u_char * const limit)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    __json_key (key);
+    __json_literal ("\"");
+    while (bytes < limit)
+    {
+        size_t size = (size_t) (limit - bytes);
+        if (size > JSON_CHUNK)
+            size = JSON_CHUNK;
+
+        __json_reserve (2 * size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            __buffer[__length++] = digits[bytes[i] >> 4];
+            __buffer[__length++] = digits[bytes[i] & 0x0f];
+        }
+        bytes += size;
+    }
+    __json_literal ("\"");
+}
+
+void __json_mac (const char * const key, const u_int8_t * const address)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    __json_key (key);
+    __json_reserve (3 * ETH_ALEN + 1);
+    __buffer[__length++] = '"';
+    for (size_t i = 0; i < ETH_ALEN; ++i)
+    {
+        __buffer[__length++] = digits[address[i] >> 4];
+        __buffer[__length++] = digits[address[i] & 0x0f];
+        __buffer[__length++] = i + 1 < ETH_ALEN ? ':' : '"';
+    }
+}
+
+void __json_ipv4 (const char * const key, const void * const address)
+{
+    const u_int8_t * bytes = address;
+
+    __json_key (key);
+    __json_literal ("\"");
+    for (size_t i = 0; i < 4; ++i)
+    {
+        __json_digits (bytes[i], 1);
+        if (i < 3)
+            __json_literal (".");
+    }
+    __json_literal ("\"");
+}
+
+void __json_ipv6 (const char * const key, const void * const address)
+{
+    char buffer[INET6_ADDRSTRLEN];
+    inet_ntop (AF_INET6, address, buffer, sizeof buffer);
+    __json_string (key, buffer);
+}
+
+void __json_escape (const u_char * bytes, const u_char * const limit)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    while (bytes < limit)
+    {
+        /* Copy the characters that need no escaping at once. */
+        const u_char * start = bytes;
+        while (bytes < limit && bytes - start < JSON_CHUNK && * bytes >= 0x20
+                && * bytes < 0x7f && * bytes != '"' && * bytes != '\\')
+            ++bytes;
+        __json_raw ((const char *) start, (size_t) (bytes - start));
+
+        if (bytes == limit || bytes - start == JSON_CHUNK)
+            continue;
+
+        /* Bytes outside of ASCII are taken as Latin-1 characters, so that
+         * the output is valid UTF-8 whatever the payload. */
+        __json_reserve (6);
+        __buffer[__length++] = '\\';
+        switch (* bytes)
+        {
+            case '"':
+            case '\\':
+                __buffer[__length++] = (char) * bytes;
+                break;
+            case '\n':
+                __buffer[__length++] = 'n';
+                break;
+            case '\r':
+                __buffer[__length++] = 'r';
+                break;
+            case '\t':
+                __buffer[__length++] = 't';
+                break;
+            default:
+                __buffer[__length++] = 'u';
+                __buffer[__length++] = '0';
+                __buffer[__length++] = '0';
+                __buffer[__length++] = digits[* bytes >> 4];
+                __buffer[__length++] = digits[* bytes & 0x0f];
+                break;
+        }
+        ++bytes;
+    }
+}
+
+void __json_digits (u_int64_t value, size_t width)
+{
+    char digits[20];
+    size_t count = 0;
+
+    do
+    {
+        digits[count++] = (char) ('0' + value % 10);
+        value /= 10;
+    }
+    while (value != 0 || count < width);
+
+    __json_reserve (count);
+    while (count > 0)
+        __buffer[__length++] = digits[--count];
+}
+
+void __json_raw (const char * const bytes, size_t size)
+{
+    __json_reserve (size);
+    memcpy (__buffer + __length, bytes, size);
+    __length += size;
+}
+
+void __json_reserve (size_t size)
+{
+    if (__length + size > JSON_BUFFER_SIZE)
+    {
+        fwrite (__buffer, 1, __length, __stream);
+        __length = 0;
+    }
+}
+
+void __json_start (FILE * const stream)
+{
+    __stream = stream;
+    __length = 0;
+    __first = true;
+    __json_object (NULL);
+}
+
+void __json_finish (void)
+{
+    __json_literal ("}\n");
+    fwrite (__buffer, 1, __length, __stream);
+    __length = 0;
+}
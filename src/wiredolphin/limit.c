@@ -0,0 +1,193 @@
+/**
+ * \file limit.c
+ * \brief Per-flow output limit.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <inttypes.h>
+
+#include "wiredolphin/limit.h"
+#include "wiredolphin/json.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * \brief Per-flow state.
+ */
+typedef struct __limit_flow
+{
+    u_int64_t packets;          /**< Packets. */
+    u_int64_t bytes;            /**< Bytes. */
+    u_int64_t shown_packets;    /**< Printed packets. */
+    u_int64_t shown_bytes;      /**< Printed bytes. */
+    struct timeval first;       /**< First packet time. */
+    struct timeval last;        /**< Last packet time. */
+    u_int8_t fin;               /**< FIN seen (1: forward, 2: backward). */
+} __limit_flow;
+
+static unsigned int __packets = 0;                      /**< Packets limit. */
+static unsigned int __bytes = 0;                        /**< Bytes limit. */
+static unsigned int __flows = LIMIT_FLOWS_DEFAULT;      /**< Table capacity. */
+static flow_table * __table = NULL;                     /**< Flow table. */
+static FILE * __stream = NULL;                          /**< Summaries stream. */
+static const char * __reason = "evicted";               /**< End of flow reason. */
+
+/**
+ * \brief Print the summary of a flow leaving the table.
+ * \param flow Flow.
+ * \param value Flow state.
+ * \param user Unused.
+ */
+static void __limit_release (const packet_flow * flow, void * value,
+        void * user);
+
+/**
+ * \brief Remove a flow from the table, with a reason.
+ * \param value Flow state.
+ * \param reason Reason.
+ */
+static inline void __limit_end (__limit_flow * value, const char * reason);
+
+////////////////////////////////////////////////////////////////////////////////
+// Per-flow limit.
+////////////////////////////////////////////////////////////////////////////////
+
+void limit_set_packets (unsigned int packets)
+{
+    __packets = packets;
+}
+
+void limit_set_bytes (unsigned int bytes)
+{
+    __bytes = bytes;
+}
+
+void limit_set_flows (unsigned int flows)
+{
+    __flows = flows > 0 ? flows : LIMIT_FLOWS_DEFAULT;
+}
+
+bool limit_enabled (void)
+{
+    return __packets > 0 || __bytes > 0;
+}
+
+bool limit_accept (FILE * const stream, const packet_info * const info)
+{
+    if (! limit_enabled ())
+        return true;
+
+    if (__table == NULL)
+    {
+        __table = flow_table_create (__flows, sizeof (__limit_flow),
+                __limit_release, NULL);
+        if (__table == NULL)
+        {
+            fprintf (stderr, "Error: Could not allocate the flow table.\n");
+            __packets = __bytes = 0;
+            return true;
+        }
+    }
+    __stream = stream;
+
+    /* Expire idle flows, oldest first. */
+    const struct timeval * now = & info->header->ts;
+    __limit_flow * oldest;
+    while ((oldest = flow_table_oldest (__table)) != NULL
+            && now->tv_sec - oldest->last.tv_sec > LIMIT_TIMEOUT_DEFAULT)
+        __limit_end (oldest, "idle");
+
+    packet_flow flow = info->flow;
+    bool backward = packet_flow_canonical (& flow);
+    bool created;
+    __reason = "evicted";
+    __limit_flow * state = flow_table_lookup (__table, & flow, & created);
+
+    if (created)
+        state->first = * now;
+    state->last = * now;
+    ++state->packets;
+    state->bytes += info->header->len;
+
+    bool accept = (__packets == 0 || state->shown_packets < __packets)
+        && (__bytes == 0 || state->shown_bytes < __bytes);
+    if (accept)
+    {
+        ++state->shown_packets;
+        state->shown_bytes += info->header->len;
+    }
+
+    if (info->transport != NULL && info->flow.protocol == IPPROTO_TCP)
+    {
+        const struct tcphdr * tcp = (const struct tcphdr *) info->transport;
+        if (tcp->th_flags & TH_FIN)
+            state->fin |= backward ? 2 : 1;
+
+        if (tcp->th_flags & TH_RST)
+            __limit_end (state, "RST");
+        else if (state->fin == 3)
+            __limit_end (state, "FIN");
+    }
+
+    return accept;
+}
+
+void limit_finish (FILE * const stream)
+{
+    if (__table == NULL)
+        return;
+
+    __stream = stream;
+    __reason = "end of capture";
+    flow_table_destroy (__table);
+    __table = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+void __limit_release (const packet_flow * const flow, void * const value,
+        void * const user)
+{
+    (void) user;
+    const __limit_flow * state = value;
+
+    /* Flows under the limit have been printed entirely. */
+    if (state->packets > state->shown_packets)
+    {
+        double duration = (double) (state->last.tv_sec - state->first.tv_sec)
+            + (double) (state->last.tv_usec - state->first.tv_usec) / 1e6;
+
+        if (json_enabled ())
+            json_limit (__stream, flow, state->packets, state->bytes,
+                    state->packets - state->shown_packets, duration,
+                    __reason);
+        else
+        {
+            fprintf (__stream, "Flow ");
+            packet_flow_print (__stream, flow);
+            fprintf (__stream, ": %" PRIu64 " packets, %" PRIu64 " bytes, "
+                    "%" PRIu64 " packets not shown, %.3f s (%s)\n\n",
+                    state->packets, state->bytes,
+                    state->packets - state->shown_packets, duration,
+                    __reason);
+        }
+    }
+}
+
+void __limit_end (__limit_flow * const value, const char * const reason)
+{
+    __reason = reason;
+    flow_table_remove (__table, value);
+}
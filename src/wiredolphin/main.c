@@ -12,11 +12,17 @@
  * http://www.wtfpl.net/ for more details.
  */
 
+/* strptime. */
+#define _GNU_SOURCE
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include <sysexits.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <glob.h>
 
 #include "wiredolphin/capture.h"
 #include "wiredolphin/version.h"
@@ -26,9 +32,14 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 /**
- * \brief Interface to monitor.
+ * \brief Interfaces to monitor.
  */
-static char * __interface = "lo";
+static char * __interfaces[STATS_INTERFACES_MAX] = { "lo", };
+
+/**
+ * \brief Number of interfaces given.
+ */
+static unsigned int __interface_count = 0;
 
 /**
  * \brief Filter to use.
@@ -36,9 +47,74 @@ static char * __interface = "lo";
 static char * __filter = "any";
 
 /**
- * \brief Offline capture file to monitor.
+ * \brief Offline capture files to monitor (patterns expanded).
+ */
+static glob_t __offline = { .gl_pathc = 0, };
+
+/**
+ * \brief Whether to follow the offline capture file as it grows.
+ */
+static bool __follow = false;
+
+/**
+ * \brief Whether the Arrow stream goes to stdout.
+ */
+static bool __arrow_stdout = false;
+
+/**
+ * \brief Whether the binary records go to stdout.
+ */
+static bool __binary_stdout = false;
+
+/**
+ * \brief Long options without a short equivalent.
+ */
+enum
+{
+    OPTION_SAMPLE = 256,
+    OPTION_SAMPLE_FLOWS,
+    OPTION_ADAPTIVE,
+    OPTION_PER_FLOW_LIMIT,
+    OPTION_PER_FLOW_BYTES,
+    OPTION_PER_FLOW_TABLE,
+    OPTION_COLLAPSE,
+    OPTION_TRIGGER,
+    OPTION_TRIGGER_DHCP,
+    OPTION_PRE_TRIGGER,
+    OPTION_PRE_TRIGGER_SIZE,
+    OPTION_POST_TRIGGER,
+    OPTION_TRIGGER_PREFIX,
+    OPTION_ROTATE_SIZE,
+    OPTION_ROTATE_TIME,
+    OPTION_ROTATE_COMPRESS,
+    OPTION_DIRECT,
+    OPTION_SPLIT_FLOWS,
+    OPTION_SPLIT_FILES,
+    OPTION_FROM,
+    OPTION_TO,
+    OPTION_FLOW,
+    OPTION_INDEX_INTERVAL,
+    OPTION_FOLLOW,
+    OPTION_VIEW,
+    OPTION_SHM,
+    OPTION_METRICS_LISTEN,
+    OPTION_BINARY_OUT,
+    OPTION_ARROW_OUT,
+    OPTION_FORMAT,
+    OPTION_COMPRESS,
+    OPTION_TOP,
+    OPTION_ROLLUP,
+    OPTION_DISTRIBUTIONS,
+    OPTION_TCP_ANALYSIS,
+    OPTION_DNS_ANALYSIS,
+};
+
+/**
+ * \brief Parse an unsigned integer argument, exit on failure.
+ * \param argument Argument.
+ * \return Value.
  */
-static char * __offline = NULL;
+static inline unsigned int __parse_unsigned (const char * argument);
 
 /**
  * \brief Parse command line arguments.
@@ -47,6 +123,20 @@ static char * __offline = NULL;
  */
 static inline void __parse_args (int argc, char ** argv);
 
+/**
+ * \brief Parse a time argument, exit on failure.
+ * \param argument Seconds since the Epoch, or YYYY-mm-dd HH:MM:SS (local).
+ * \param time Time.
+ */
+static inline void __parse_time (const char * argument, struct timeval * time);
+
+/**
+ * \brief Parse a flow argument, exit on failure.
+ * \param argument Flow name, such as tcp_10.0.0.1_51234_10.0.0.2_80.
+ * \param flow Flow.
+ */
+static inline void __parse_flow (const char * argument, packet_flow * flow);
+
 /**
  * \brief Print the help.
  */
@@ -75,10 +165,50 @@ int main (int argc, char ** argv)
         WIREDOLPHIN_VERSION_MAJOR, WIREDOLPHIN_VERSION_MINOR,
         WIREDOLPHIN_VERSION_PATCH);
 
-    if (__offline)
-        monitor_file (__offline, __filter);
+    if (__follow && __offline.gl_pathc != 1)
+    {
+        fprintf (stderr, "Error: --follow needs a single offline file.\n");
+        exit (EX_USAGE);
+    }
+
+    /* The Arrow stream owns stdout. */
+    if (__arrow_stdout && (__binary_stdout || view_stdout ()))
+    {
+        fprintf (stderr, "Error: --binary-out and the views cannot print to "
+                "stdout along with --arrow-out -.\n");
+        exit (EX_USAGE);
+    }
+    if (__arrow_stdout && (limit_enabled () || repeat_enabled ()))
+    {
+        fprintf (stderr, "Error: --per-flow-limit, --per-flow-bytes and "
+                "--collapse print to stdout: use --arrow-out <file>.\n");
+        exit (EX_USAGE);
+    }
+    if (__arrow_stdout && ! binary_enabled ())
+        set_callback (CALLBACK_STATS);
+
+    /* The dashboard owns the terminal. */
+    if (top_enabled () && isatty (STDOUT_FILENO))
+        set_callback (CALLBACK_STATS);
+
+    if (! compress_open ())
+        exit (EX_OSERR);
+
+    if (__follow)
+        monitor_follow (__offline.gl_pathv[0], __filter);
+    else if (__offline.gl_pathc == 1)
+        monitor_file (__offline.gl_pathv[0], __filter);
+    else if (__offline.gl_pathc > 1)
+        monitor_files (__offline.gl_pathv, __offline.gl_pathc, __filter);
+    else if (__interface_count > 1)
+        monitor_interfaces (__interfaces, __interface_count, __filter);
     else
-        monitor_interface (__interface, __filter);
+        monitor_interface (__interfaces[0], __filter);
+
+    if (__offline.gl_pathc > 0)
+        globfree (& __offline);
+
+    compress_close ();
 
     exit (EXIT_SUCCESS);
 }
@@ -95,37 +225,230 @@ void __parse_args (int argc, char ** argv)
         { "offline",    required_argument, NULL, 'o', },
         { "filter",     required_argument, NULL, 'f', },
         { "verbose",    required_argument, NULL, 'v', },
+        { "statistics", no_argument, NULL, 's', },
+        { "write",      required_argument, NULL, 'w', },
+        { "sample",     required_argument, NULL, OPTION_SAMPLE, },
+        { "sample-flows", required_argument, NULL, OPTION_SAMPLE_FLOWS, },
+        { "adaptive",   no_argument, NULL, OPTION_ADAPTIVE, },
+        { "per-flow-limit", required_argument, NULL, OPTION_PER_FLOW_LIMIT, },
+        { "per-flow-bytes", required_argument, NULL, OPTION_PER_FLOW_BYTES, },
+        { "per-flow-table", required_argument, NULL, OPTION_PER_FLOW_TABLE, },
+        { "collapse",   optional_argument, NULL, OPTION_COLLAPSE, },
+        { "trigger",    required_argument, NULL, OPTION_TRIGGER, },
+        { "trigger-dhcp", required_argument, NULL, OPTION_TRIGGER_DHCP, },
+        { "pre-trigger", required_argument, NULL, OPTION_PRE_TRIGGER, },
+        { "pre-trigger-size", required_argument, NULL, OPTION_PRE_TRIGGER_SIZE, },
+        { "post-trigger", required_argument, NULL, OPTION_POST_TRIGGER, },
+        { "trigger-prefix", required_argument, NULL, OPTION_TRIGGER_PREFIX, },
+        { "rotate-size", required_argument, NULL, OPTION_ROTATE_SIZE, },
+        { "rotate-time", required_argument, NULL, OPTION_ROTATE_TIME, },
+        { "rotate-compress", no_argument, NULL, OPTION_ROTATE_COMPRESS, },
+        { "direct",     no_argument, NULL, OPTION_DIRECT, },
+        { "split-flows", required_argument, NULL, OPTION_SPLIT_FLOWS, },
+        { "split-files", required_argument, NULL, OPTION_SPLIT_FILES, },
+        { "from",       required_argument, NULL, OPTION_FROM, },
+        { "to",         required_argument, NULL, OPTION_TO, },
+        { "flow",       required_argument, NULL, OPTION_FLOW, },
+        { "index-interval", required_argument, NULL, OPTION_INDEX_INTERVAL, },
+        { "follow", no_argument, NULL, OPTION_FOLLOW, },
+        { "view", required_argument, NULL, OPTION_VIEW, },
+        { "shm",        required_argument, NULL, OPTION_SHM, },
+        { "metrics-listen", required_argument, NULL, OPTION_METRICS_LISTEN, },
+        { "binary-out", required_argument, NULL, OPTION_BINARY_OUT, },
+        { "arrow-out",  required_argument, NULL, OPTION_ARROW_OUT, },
+        { "format",     required_argument, NULL, OPTION_FORMAT, },
+        { "compress",   required_argument, NULL, OPTION_COMPRESS, },
+        { "top",        no_argument, NULL, OPTION_TOP, },
+        { "rollup",     required_argument, NULL, OPTION_ROLLUP, },
+        { "distributions", optional_argument, NULL, OPTION_DISTRIBUTIONS, },
+        { "tcp-analysis", no_argument, NULL, OPTION_TCP_ANALYSIS, },
+        { "dns-analysis", no_argument, NULL, OPTION_DNS_ANALYSIS, },
         { "help",       no_argument, NULL, 'h', },
         { 0, 0, 0, 0, },
     };
 
     int val = 1;
     unsigned int verbose_mode = 3;
+    struct timeval time;
+    packet_flow flow;
 
     do
     {
         int longindex;
-        val = getopt_long (argc, argv, "i:o:f:v:h", wiredolphin_options,
+        val = getopt_long (argc, argv, "i:o:f:v:sw:h", wiredolphin_options,
                 & longindex);
 
         switch (val)
         {
             case 'i':
-                __interface = optarg;
+                if (__interface_count == STATS_INTERFACES_MAX)
+                {
+                    fprintf (stderr, "Error: At most %u interfaces can be "
+                            "monitored.\n", STATS_INTERFACES_MAX);
+                    exit (EX_USAGE);
+                }
+                __interfaces[__interface_count++] = optarg;
                 break;
             case 'o':
-                __offline = optarg;
+                /* Unmatched patterns are kept, to report them as missing. */
+                glob (optarg, GLOB_NOCHECK
+                        | (__offline.gl_pathc ? GLOB_APPEND : 0), NULL,
+                        & __offline);
                 break;
             case 'f':
                 __filter = optarg;
                 break;
             case 'v':
-                if (sscanf (optarg, "%u", & verbose_mode) != 1)
+                verbose_mode = __parse_unsigned (optarg);
+                set_callback (verbose_mode);
+                break;
+            case 's':
+                set_statistics (true);
+                break;
+            case 'w':
+                writer_set_path (optarg);
+                break;
+            case OPTION_SAMPLE:
+                sampling_set (SAMPLING_PACKETS, __parse_unsigned (optarg));
+                break;
+            case OPTION_SAMPLE_FLOWS:
+                sampling_set (SAMPLING_FLOWS, __parse_unsigned (optarg));
+                break;
+            case OPTION_ADAPTIVE:
+                sampling_set_adaptive (true);
+                break;
+            case OPTION_PER_FLOW_LIMIT:
+                limit_set_packets (__parse_unsigned (optarg));
+                break;
+            case OPTION_PER_FLOW_BYTES:
+                limit_set_bytes (__parse_unsigned (optarg));
+                break;
+            case OPTION_PER_FLOW_TABLE:
+                limit_set_flows (__parse_unsigned (optarg));
+                break;
+            case OPTION_COLLAPSE:
+                repeat_set_window (optarg ? __parse_unsigned (optarg)
+                        : REPEAT_WINDOW_DEFAULT);
+                break;
+            case OPTION_TRIGGER:
+                trigger_set_filter (optarg);
+                break;
+            case OPTION_TRIGGER_DHCP:
+                if (! trigger_set_dhcp (optarg))
                 {
-                    perror ("sscanf");
+                    fprintf (stderr, "Error: Unknown DHCP message type "
+                            "\"%s\".\n", optarg);
+                    exit (EX_USAGE);
+                }
+                break;
+            case OPTION_PRE_TRIGGER:
+                trigger_set_duration (__parse_unsigned (optarg));
+                break;
+            case OPTION_PRE_TRIGGER_SIZE:
+                trigger_set_size (__parse_unsigned (optarg));
+                break;
+            case OPTION_POST_TRIGGER:
+                trigger_set_post (__parse_unsigned (optarg));
+                break;
+            case OPTION_TRIGGER_PREFIX:
+                trigger_set_prefix (optarg);
+                break;
+            case OPTION_ROTATE_SIZE:
+                writer_set_size (__parse_unsigned (optarg));
+                break;
+            case OPTION_ROTATE_TIME:
+                writer_set_time (__parse_unsigned (optarg));
+                break;
+            case OPTION_ROTATE_COMPRESS:
+                writer_set_compress (true);
+                break;
+            case OPTION_DIRECT:
+                writer_set_direct (true);
+                break;
+            case OPTION_SPLIT_FLOWS:
+                split_set_directory (optarg);
+                break;
+            case OPTION_SPLIT_FILES:
+                split_set_files (__parse_unsigned (optarg));
+                break;
+            case OPTION_FROM:
+                __parse_time (optarg, & time);
+                sidecar_set_from (& time);
+                break;
+            case OPTION_TO:
+                __parse_time (optarg, & time);
+                sidecar_set_to (& time);
+                break;
+            case OPTION_FLOW:
+                __parse_flow (optarg, & flow);
+                sidecar_set_flow (& flow);
+                break;
+            case OPTION_INDEX_INTERVAL:
+                sidecar_set_interval (__parse_unsigned (optarg));
+                break;
+            case OPTION_FOLLOW:
+                __follow = true;
+                break;
+            case OPTION_VIEW:
+                if (! view_add (optarg))
+                {
+                    fprintf (stderr, "Error: invalid view \"%s\" (at most %u "
+                            "views).\n", optarg, VIEW_MAX);
+                    exit (EX_USAGE);
+                }
+                break;
+            case OPTION_SHM:
+                shared_set_name (optarg);
+                break;
+            case OPTION_BINARY_OUT:
+                binary_set_path (optarg);
+                __binary_stdout = ! strcmp (optarg, "-");
+                break;
+            case OPTION_ARROW_OUT:
+                arrow_set_path (optarg);
+                __arrow_stdout = ! strcmp (optarg, "-");
+                break;
+            case OPTION_FORMAT:
+                if (strcmp (optarg, "text") && strcmp (optarg, "json"))
+                {
+                    fprintf (stderr, "Error: \"%s\" is not a valid format "
+                            "(text or json).\n", optarg);
+                    exit (EX_USAGE);
+                }
+                json_set_enabled (! strcmp (optarg, "json"));
+                break;
+            case OPTION_TOP:
+                top_set_enabled (true);
+                break;
+            case OPTION_ROLLUP:
+                rollup_set_path (optarg);
+                break;
+            case OPTION_DISTRIBUTIONS:
+                distribution_set_gap (optarg ? __parse_unsigned (optarg)
+                        : DISTRIBUTION_GAP_DEFAULT);
+                break;
+            case OPTION_TCP_ANALYSIS:
+                tcpflow_set_enabled (true);
+                break;
+            case OPTION_DNS_ANALYSIS:
+                dnsstat_set_enabled (true);
+                break;
+            case OPTION_COMPRESS:
+                if (! compress_set_method (optarg))
+                {
+                    fprintf (stderr, "Error: \"%s\" is not a valid "
+                            "compression (built with: %s).\n", optarg,
+                            compress_methods ());
+                    exit (EX_USAGE);
+                }
+                break;
+            case OPTION_METRICS_LISTEN:
+                if (! metrics_set_listen (optarg))
+                {
+                    fprintf (stderr, "Error: invalid address \"%s\" "
+                            "(<host>:<port>).\n", optarg);
                     exit (EX_USAGE);
                 }
-                set_callback (verbose_mode);
                 break;
             case 'h':
                 __print_help ();
@@ -146,6 +469,56 @@ void __parse_args (int argc, char ** argv)
     while (val != - 1);
 }
 
+unsigned int __parse_unsigned (const char * argument)
+{
+    unsigned int value;
+
+    if (sscanf (argument, "%u", & value) != 1)
+    {
+        fprintf (stderr, "Error: \"%s\" is not a valid number.\n", argument);
+        exit (EX_USAGE);
+    }
+
+    return value;
+}
+
+void __parse_time (const char * argument, struct timeval * time)
+{
+    char * end;
+    double seconds = strtod (argument, & end);
+
+    if (end != argument && * end == '\0')
+    {
+        time->tv_sec = (time_t) seconds;
+        time->tv_usec = (suseconds_t) ((seconds - (double) time->tv_sec) * 1e6);
+        return;
+    }
+
+    struct tm local;
+    memset (& local, 0, sizeof local);
+    end = strptime (argument, "%Y-%m-%d %H:%M:%S", & local);
+    if (end == NULL)
+        end = strptime (argument, "%Y-%m-%dT%H:%M:%S", & local);
+    if (end == NULL || * end != '\0')
+    {
+        fprintf (stderr, "Error: \"%s\" is not a valid time.\n", argument);
+        exit (EX_USAGE);
+    }
+
+    local.tm_isdst = -1;
+    time->tv_sec = mktime (& local);
+    time->tv_usec = 0;
+}
+
+void __parse_flow (const char * argument, packet_flow * flow)
+{
+    if (! packet_flow_parse (argument, flow))
+    {
+        fprintf (stderr, "Error: \"%s\" is not a valid flow.\n", argument);
+        exit (EX_USAGE);
+    }
+}
+
 void __print_help (void)
 {
     fprintf (stderr, "wiredolphin [OPTIONS]\n\n");
@@ -158,10 +531,51 @@ void __print_help (void)
     fprintf (stderr, "\t\tPrint this help.\n");
 
     fprintf (stderr, "\t-i, --interface <interface_name>\n");
-    fprintf (stderr, "\t\tMonitor the interface <interface_name>.\n");
+    fprintf (stderr, "\t\tMonitor the interface <interface_name>. Several "
+            "interfaces are\n\t\tmonitored at once.\n");
 
     fprintf (stderr, "\t-o, --offline <file>\n");
-    fprintf (stderr, "\t\tMonitor the offline capture file <file>.\n");
+    fprintf (stderr, "\t\tMonitor the offline capture file <file>. Several "
+            "files (or patterns)\n\t\tare merged in timestamp order. \"-\" reads "
+            "the standard input.\n\t\tgzip, zstd and lz4 files are "
+            "decompressed.\n");
+
+    fprintf (stderr, "\t-s, --statistics\n");
+    fprintf (stderr, "\t\tPrint statistics at the end of the capture.\n");
+
+    fprintf (stderr, "\t--shm <name>\n");
+    fprintf (stderr, "\t\tPublish live statistics in the shared memory "
+            "segment <name>,\n\t\tread by wiredolphin-stat.\n");
+
+    fprintf (stderr, "\t--metrics-listen <host>:<port>\n");
+    fprintf (stderr, "\t\tServe Prometheus metrics on <host>:<port> "
+            "(:<port> for\n\t\tlocalhost).\n");
+
+    fprintf (stderr, "\t--top\n");
+    fprintf (stderr, "\t\tShow a live dashboard: rates, drops, top flows "
+            "and talkers,\n\t\tprotocol mix. Packets are only printed when "
+            "the standard\n\t\toutput is not the terminal.\n");
+
+    fprintf (stderr, "\t--rollup <file>\n");
+    fprintf (stderr, "\t\tKeep the packet and byte rates per second, "
+            "minute and hour\n\t\tin <file>, a fixed size file a later "
+            "capture goes on with.\n\t\tRead by wiredolphin-query.\n");
+
+    fprintf (stderr, "\t--distributions[=<gap>]\n");
+    fprintf (stderr, "\t\tPrint the percentiles of the frame sizes, and of "
+            "the gaps and\n\t\tbursts (packets less than <gap> us apart, "
+            "default: %u)\n\t\tof the flows, per application.\n",
+            DISTRIBUTION_GAP_DEFAULT);
+
+    fprintf (stderr, "\t--tcp-analysis\n");
+    fprintf (stderr, "\t\tPrint the handshake round trip times, "
+            "retransmissions, out of\n\t\torder segments, zero windows and "
+            "duplicate ACKs of the TCP\n\t\tconnections, per service.\n");
+
+    fprintf (stderr, "\t--dns-analysis\n");
+    fprintf (stderr, "\t\tMatch the DNS responses to their queries and "
+            "print the\n\t\tlatencies per server and per query type, the "
+            "response codes\n\t\tand the unanswered queries.\n");
 
     fprintf (stderr, "\t-v, --verbose <level>\n");
     fprintf (stderr, "\t\tSet the verbose mode level.\n");
@@ -169,6 +583,120 @@ void __print_help (void)
     fprintf (stderr, "\t\t1: Concise.\n");
     fprintf (stderr, "\t\t2: Synthetic.\n");
     fprintf (stderr, "\t\t3: Complete.\n");
+    fprintf (stderr, "\t\t4: Statistics only.\n");
+
+    fprintf (stderr, "\t--format <text|json>\n");
+    fprintf (stderr, "\t\tPrint the packets as text (default) or as one JSON "
+            "object per\n\t\tline.\n");
+
+    fprintf (stderr, "\t--compress <zstd|lz4>\n");
+    fprintf (stderr, "\t\tCompress the standard output, in independent "
+            "frames, on a\n\t\tthread of its own.\n");
+
+    fprintf (stderr, "\t--view <level>:<output>[:<filter>]\n");
+    fprintf (stderr, "\t\tAlso print the packets matching <filter> at "
+            "<level> to <output>\n\t\t(- for stdout). Can be given several "
+            "times.\n");
+
+    fprintf (stderr, "\t--binary-out <file>\n");
+    fprintf (stderr, "\t\tRecord the decoded packets to <file> (- for "
+            "stdout) instead of\n\t\tprinting them. See "
+            "wiredolphin-render.\n");
+
+    fprintf (stderr, "\t--arrow-out <file>\n");
+    fprintf (stderr, "\t\tAlso export the decoded headers to <file> (- for "
+            "stdout) as an\n\t\tArrow IPC stream.\n");
+
+    fprintf (stderr, "\t-w, --write <file>\n");
+    fprintf (stderr, "\t\tAlso write the packets to the pcap file <file>.\n");
+
+    fprintf (stderr, "\t--sample <n>\n");
+    fprintf (stderr, "\t\tOnly count and print one packet out of <n>.\n");
+
+    fprintf (stderr, "\t--sample-flows <n>\n");
+    fprintf (stderr, "\t\tOnly count and print one flow out of <n>.\n");
+
+    fprintf (stderr, "\t--adaptive\n");
+    fprintf (stderr, "\t\tLower the verbose mode level, then the sampling "
+            "rate, under load.\n");
+
+    fprintf (stderr, "\t--per-flow-limit <n>\n");
+    fprintf (stderr, "\t\tOnly print the first <n> packets of each flow.\n");
+
+    fprintf (stderr, "\t--per-flow-bytes <k>\n");
+    fprintf (stderr, "\t\tOnly print the first <k> bytes of each flow.\n");
+
+    fprintf (stderr, "\t--per-flow-table <n>\n");
+    fprintf (stderr, "\t\tTrack at most <n> flows (default: %u).\n",
+            LIMIT_FLOWS_DEFAULT);
+
+    fprintf (stderr, "\t--collapse[=<n>]\n");
+    fprintf (stderr, "\t\tCollapse packets repeating one of the last <n> "
+            "(default: %u).\n", REPEAT_WINDOW_DEFAULT);
+
+    fprintf (stderr, "\t--trigger <filter>\n");
+    fprintf (stderr, "\t\tWrite the recent packets to a file when a packet "
+            "matches <filter>.\n");
+
+    fprintf (stderr, "\t--trigger-dhcp <type>\n");
+    fprintf (stderr, "\t\tWrite the recent packets to a file on a DHCP "
+            "message of type <type>.\n");
+
+    fprintf (stderr, "\t--pre-trigger <s>\n");
+    fprintf (stderr, "\t\tKeep the packets of the last <s> seconds "
+            "(default: no limit).\n");
+
+    fprintf (stderr, "\t--pre-trigger-size <m>\n");
+    fprintf (stderr, "\t\tKeep at most <m> MiB of packets (default: %u).\n",
+            TRIGGER_SIZE_DEFAULT);
+
+    fprintf (stderr, "\t--post-trigger <s>\n");
+    fprintf (stderr, "\t\tKeep writing for <s> seconds after the trigger "
+            "(default: %u).\n", TRIGGER_POST_DEFAULT);
+
+    fprintf (stderr, "\t--trigger-prefix <prefix>\n");
+    fprintf (stderr, "\t\tPrefix of the written files (default: %s).\n",
+            TRIGGER_PREFIX_DEFAULT);
+
+    fprintf (stderr, "\t--rotate-size <m>\n");
+    fprintf (stderr, "\t\tStart a new file every <m> MiB.\n");
+
+    fprintf (stderr, "\t--rotate-time <s>\n");
+    fprintf (stderr, "\t\tStart a new file every <s> seconds.\n");
+
+    fprintf (stderr, "\t--rotate-compress\n");
+    fprintf (stderr, "\t\tCompress the files (gzip) once complete.\n");
+
+    fprintf (stderr, "\t--direct\n");
+    fprintf (stderr, "\t\tWrite the files with O_DIRECT.\n");
+
+    fprintf (stderr, "\t--split-flows <directory>\n");
+    fprintf (stderr, "\t\tWrite each flow to its own pcap file in "
+            "<directory>.\n");
+
+    fprintf (stderr, "\t--split-files <n>\n");
+    fprintf (stderr, "\t\tKeep at most <n> flow files open (default: %u).\n",
+            SPLIT_FILES_DEFAULT);
+
+    fprintf (stderr, "\t--from <time>\n");
+    fprintf (stderr, "\t\tOnly read the packets from <time> (offline, "
+            "indexed).\n");
+
+    fprintf (stderr, "\t--to <time>\n");
+    fprintf (stderr, "\t\tOnly read the packets up to <time> (offline, "
+            "indexed).\n");
+
+    fprintf (stderr, "\t--flow <flow>\n");
+    fprintf (stderr, "\t\tOnly read the packets of <flow>, such as "
+            "tcp_10.0.0.1_51234_10.0.0.2_80\n\t\t(offline, indexed).\n");
+
+    fprintf (stderr, "\t--index-interval <n>\n");
+    fprintf (stderr, "\t\tIndex every <n>th packet (default: %u).\n",
+            SIDECAR_INTERVAL_DEFAULT);
+
+    fprintf (stderr, "\t--follow\n");
+    fprintf (stderr, "\t\tKeep reading the offline file as it grows, and its "
+            "rotated\n\t\tsuccessors, until interrupted.\n");
 
     fprintf (stderr, "\n");
 
@@ -0,0 +1,231 @@
+/**
+ * \file merge.c
+ * \brief Time-ordered merge of offline captures.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "wiredolphin/merge.h"
+#include "wiredolphin/input.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define MERGE_READ_AHEAD    (256 * 1024)    /**< Read buffer per file. */
+
+/**
+ * \brief Capture file.
+ */
+typedef struct __merge_source
+{
+    pcap_t * capture;                   /**< Capture. */
+    char * buffer;                      /**< Read-ahead buffer. */
+    struct pcap_pkthdr * header;        /**< Next packet header. */
+    const u_char * bytes;               /**< Next packet data. */
+} __merge_source;
+
+struct merge
+{
+    __merge_source * sources;   /**< Files. */
+    size_t count;               /**< Number of files. */
+    size_t * heap;              /**< Files with a next packet, earliest first. */
+    size_t size;                /**< Heap size. */
+    bool returned;              /**< The heap top was returned. */
+};
+
+/**
+ * \brief Read the next packet of a file.
+ * \param source File.
+ * \retval true On success.
+ * \retval false At the end of the file.
+ */
+static inline bool __merge_read (__merge_source * source);
+
+/**
+ * \brief Compare the next packets of two files.
+ * \param sources Merge.
+ * \param a File number.
+ * \param b File number.
+ * \retval true If a comes before b.
+ * \retval false otherwise.
+ */
+static inline bool __merge_before (const merge * sources, size_t a, size_t b);
+
+/**
+ * \brief Move a heap element down to its place.
+ * \param sources Merge.
+ * \param position Position.
+ */
+static inline void __merge_sift_down (merge * sources, size_t position);
+
+////////////////////////////////////////////////////////////////////////////////
+// Merge.
+////////////////////////////////////////////////////////////////////////////////
+
+merge * merge_open (char * const * const files, size_t count,
+        const char * const filter)
+{
+    char error_buffer[PCAP_ERRBUF_SIZE];
+    struct bpf_program compiled_filter;
+
+    merge * sources = calloc (1, sizeof (merge));
+    if (sources == NULL)
+        return NULL;
+
+    sources->sources = calloc (count, sizeof (__merge_source));
+    sources->heap = calloc (count, sizeof (size_t));
+    if (sources->sources == NULL || sources->heap == NULL)
+    {
+        merge_close (sources);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        __merge_source * source = & sources->sources[i];
+
+        /* The read-ahead buffer must be set before the first read. */
+        FILE * stream = input_open (files[i], NULL);
+        source->buffer = malloc (MERGE_READ_AHEAD);
+        if (stream != NULL && source->buffer != NULL)
+            setvbuf (stream, source->buffer, _IOFBF, MERGE_READ_AHEAD);
+        if (stream != NULL)
+            source->capture = pcap_fopen_offline (stream, error_buffer);
+
+        if (source->capture == NULL)
+        {
+            fprintf (stderr, "Error: Could not open %s: %s.\n", files[i],
+                    stream != NULL ? error_buffer : strerror (errno));
+            if (stream != NULL)
+                fclose (stream);
+            sources->count = i + 1;
+            merge_close (sources);
+            return NULL;
+        }
+        sources->count = i + 1;
+
+        if (pcap_datalink (source->capture)
+                != pcap_datalink (sources->sources[0].capture))
+        {
+            fprintf (stderr, "Error: %s: Link type differs from %s.\n",
+                    files[i], files[0]);
+            merge_close (sources);
+            return NULL;
+        }
+
+        pcap_compile (source->capture, & compiled_filter, filter, 0, 0);
+        pcap_setfilter (source->capture, & compiled_filter);
+
+        if (__merge_read (source))
+            sources->heap[sources->size++] = i;
+    }
+
+    for (size_t position = sources->size / 2; position > 0; --position)
+        __merge_sift_down (sources, position - 1);
+
+    return sources;
+}
+
+pcap_t * merge_capture (const merge * const sources)
+{
+    return sources->sources[0].capture;
+}
+
+bool merge_next (merge * const sources, const struct pcap_pkthdr ** header,
+        const u_char ** bytes)
+{
+    /* The packet returned last time is only replaced now. */
+    if (sources->returned)
+    {
+        sources->returned = false;
+        if (! __merge_read (& sources->sources[sources->heap[0]]))
+            sources->heap[0] = sources->heap[--sources->size];
+        __merge_sift_down (sources, 0);
+    }
+
+    if (sources->size == 0)
+        return false;
+
+    const __merge_source * source = & sources->sources[sources->heap[0]];
+    * header = source->header;
+    * bytes = source->bytes;
+    sources->returned = true;
+
+    return true;
+}
+
+void merge_close (merge * const sources)
+{
+    if (sources == NULL)
+        return;
+
+    for (size_t i = 0; sources->sources != NULL && i < sources->count; ++i)
+    {
+        if (sources->sources[i].capture != NULL)
+            pcap_close (sources->sources[i].capture);
+        free (sources->sources[i].buffer);
+    }
+
+    free (sources->sources);
+    free (sources->heap);
+    free (sources);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+bool __merge_read (__merge_source * const source)
+{
+    return pcap_next_ex (source->capture, & source->header, & source->bytes) == 1;
+}
+
+bool __merge_before (const merge * const sources, size_t a, size_t b)
+{
+    const struct timeval * time_a = & sources->sources[a].header->ts;
+    const struct timeval * time_b = & sources->sources[b].header->ts;
+
+    /* Ties go to the file given first. */
+    if (time_a->tv_sec != time_b->tv_sec)
+        return time_a->tv_sec < time_b->tv_sec;
+    if (time_a->tv_usec != time_b->tv_usec)
+        return time_a->tv_usec < time_b->tv_usec;
+    return a < b;
+}
+
+void __merge_sift_down (merge * const sources, size_t position)
+{
+    size_t * heap = sources->heap;
+
+    for (;;)
+    {
+        size_t earliest = position;
+        size_t left = 2 * position + 1;
+        size_t right = left + 1;
+
+        if (left < sources->size
+                && __merge_before (sources, heap[left], heap[earliest]))
+            earliest = left;
+        if (right < sources->size
+                && __merge_before (sources, heap[right], heap[earliest]))
+            earliest = right;
+        if (earliest == position)
+            return;
+
+        size_t swap = heap[position];
+        heap[position] = heap[earliest];
+        heap[earliest] = swap;
+        position = earliest;
+    }
+}
@@ -0,0 +1,481 @@
+/**
+ * \file metrics.c
+ * \brief Prometheus metrics endpoint.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "wiredolphin/metrics.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define METRICS_HOST_MAX    256     /**< Host length. */
+#define METRICS_PORT_MAX    16      /**< Port length. */
+#define METRICS_REQUEST_MAX 4096    /**< Request length. */
+#define METRICS_POLL        200     /**< Stop check period (ms). */
+#define METRICS_TIMEOUT     2       /**< Client timeout (s). */
+
+static char __host[METRICS_HOST_MAX];   /**< Listening host. */
+static char __port[METRICS_PORT_MAX];   /**< Listening port. */
+static bool __enabled = false;          /**< Address set. */
+
+static int __socket = -1;               /**< Listening socket. */
+static bool __running = false;          /**< Thread started. */
+static bool __quit = false;             /**< Stop the thread (atomic). */
+static pthread_t __server;              /**< Server thread. */
+static const shared_segment * __segment = NULL;     /**< Statistics. */
+
+/**
+ * \brief Accept and serve clients until __quit.
+ * \param user Unused.
+ * \return NULL.
+ */
+static void * __metrics_run (void * user);
+
+/**
+ * \brief Answer a client.
+ * \param client Client socket.
+ */
+static void __metrics_serve (int client);
+
+/**
+ * \brief Render the metrics.
+ * \param stream Output stream.
+ * \param stats Statistics.
+ */
+static void __metrics_render (FILE * stream, const shared_stats * stats);
+
+/**
+ * \brief Print the help and type of a metric family.
+ * \param stream Output stream.
+ * \param name Name.
+ * \param type counter, gauge or histogram.
+ * \param help Description.
+ */
+static inline void __metrics_family (FILE * stream, const char * name,
+        const char * type, const char * help);
+
+/**
+ * \brief Print a label value, escaped.
+ * \param stream Output stream.
+ * \param value Value.
+ */
+static inline void __metrics_label (FILE * stream, const char * value);
+
+/**
+ * \brief Send a whole buffer.
+ * \param client Client socket.
+ * \param bytes Data.
+ * \param length Data length.
+ */
+static inline void __metrics_send (int client, const char * bytes,
+        size_t length);
+
+////////////////////////////////////////////////////////////////////////////////
+// Server.
+////////////////////////////////////////////////////////////////////////////////
+
+bool metrics_set_listen (const char * const address)
+{
+    const char * colon = strrchr (address, ':');
+    if (colon == NULL || colon[1] == '\0'
+            || strlen (colon + 1) >= METRICS_PORT_MAX)
+        return false;
+
+    const char * host = address;
+    size_t length = (size_t) (colon - address);
+    if (length >= 2 && host[0] == '[' && host[length - 1] == ']')
+    {
+        ++host;
+        length -= 2;
+    }
+    if (length >= METRICS_HOST_MAX)
+        return false;
+
+    /* Only localhost unless told otherwise. */
+    if (length == 0)
+        strcpy (__host, "127.0.0.1");
+    else
+    {
+        memcpy (__host, host, length);
+        __host[length] = '\0';
+    }
+    strcpy (__port, colon + 1);
+    __enabled = true;
+
+    return true;
+}
+
+bool metrics_enabled (void)
+{
+    return __enabled;
+}
+
+bool metrics_open (const shared_segment * const segment)
+{
+    if (! metrics_enabled ())
+        return true;
+
+    struct addrinfo hints;
+    memset (& hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+
+    struct addrinfo * addresses;
+    int error = getaddrinfo (__host, __port, & hints, & addresses);
+    if (error)
+    {
+        fprintf (stderr, "Error: Invalid metrics address %s:%s: %s.\n", __host,
+                __port, gai_strerror (error));
+        return false;
+    }
+
+    int reuse = 1;
+    __socket = socket (addresses->ai_family, addresses->ai_socktype
+            | SOCK_CLOEXEC, addresses->ai_protocol);
+    if (__socket < 0
+            || setsockopt (__socket, SOL_SOCKET, SO_REUSEADDR, & reuse,
+                sizeof reuse)
+            || bind (__socket, addresses->ai_addr, addresses->ai_addrlen)
+            || listen (__socket, 16))
+    {
+        fprintf (stderr, "Error: Could not listen on %s:%s: %s.\n", __host,
+                __port, strerror (errno));
+        freeaddrinfo (addresses);
+        if (__socket >= 0)
+            close (__socket);
+        __socket = -1;
+        return false;
+    }
+    freeaddrinfo (addresses);
+
+    __segment = segment;
+    __quit = false;
+    __running = ! pthread_create (& __server, NULL, __metrics_run, NULL);
+    if (! __running)
+    {
+        fprintf (stderr, "Error: Could not start the metrics server.\n");
+        close (__socket);
+        __socket = -1;
+    }
+
+    return __running;
+}
+
+void metrics_close (void)
+{
+    if (! __running)
+        return;
+
+    __atomic_store_n (& __quit, true, __ATOMIC_RELAXED);
+    pthread_join (__server, NULL);
+    close (__socket);
+    __socket = -1;
+    __running = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+void * __metrics_run (void * user)
+{
+    (void) user;
+
+    while (! __atomic_load_n (& __quit, __ATOMIC_RELAXED))
+    {
+        struct pollfd listening = { .fd = __socket, .events = POLLIN, };
+        if (poll (& listening, 1, METRICS_POLL) <= 0)
+            continue;
+
+        int client = accept (__socket, NULL, NULL);
+        if (client < 0)
+            continue;
+
+        /* A slow client must not keep the others waiting for long. */
+        struct timeval timeout = { .tv_sec = METRICS_TIMEOUT, };
+        setsockopt (client, SOL_SOCKET, SO_RCVTIMEO, & timeout, sizeof timeout);
+        setsockopt (client, SOL_SOCKET, SO_SNDTIMEO, & timeout, sizeof timeout);
+        __metrics_serve (client);
+        close (client);
+    }
+
+    return NULL;
+}
+
+void __metrics_serve (int client)
+{
+    char request[METRICS_REQUEST_MAX];
+    size_t length = 0;
+
+    /* Only the request line matters, but the headers are read as well. */
+    while (length < sizeof request - 1)
+    {
+        ssize_t count = recv (client, request + length,
+                sizeof request - 1 - length, 0);
+        if (count <= 0)
+            break;
+        length += (size_t) count;
+        request[length] = '\0';
+        if (strstr (request, "\r\n\r\n") != NULL
+                || strstr (request, "\n\n") != NULL)
+            break;
+    }
+    request[length] = '\0';
+
+    static const char not_found[] = "HTTP/1.0 404 Not Found\r\n"
+        "Content-Type: text/plain\r\nContent-Length: 10\r\n"
+        "Connection: close\r\n\r\nNot found\n";
+    static const char unavailable[] = "HTTP/1.0 503 Service Unavailable\r\n"
+        "Content-Length: 0\r\nConnection: close\r\n\r\n";
+    static const char bad_method[] = "HTTP/1.0 405 Method Not Allowed\r\n"
+        "Allow: GET\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+    if (strncmp (request, "GET ", 4))
+    {
+        __metrics_send (client, bad_method, sizeof bad_method - 1);
+        return;
+    }
+
+    const char * path = request + 4;
+    size_t path_length = strcspn (path, " ?\r\n");
+    if (! (path_length == 8 && ! strncmp (path, "/metrics", 8))
+            && ! (path_length == 1 && * path == '/'))
+    {
+        __metrics_send (client, not_found, sizeof not_found - 1);
+        return;
+    }
+
+    static shared_stats stats;
+    if (! shared_read (__segment, & stats))
+    {
+        __metrics_send (client, unavailable, sizeof unavailable - 1);
+        return;
+    }
+
+    char * body = NULL;
+    size_t body_length = 0;
+    FILE * stream = open_memstream (& body, & body_length);
+    if (stream == NULL)
+        return;
+    __metrics_render (stream, & stats);
+    fclose (stream);
+
+    char header[256];
+    int header_length = snprintf (header, sizeof header, "HTTP/1.0 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+            "Content-Length: %zu\r\nConnection: close\r\n\r\n", body_length);
+    if (header_length > 0 && (size_t) header_length < sizeof header)
+    {
+        __metrics_send (client, header, (size_t) header_length);
+        __metrics_send (client, body, body_length);
+    }
+    free (body);
+}
+
+void __metrics_render (FILE * const stream, const shared_stats * const stats)
+{
+    const stats_counters * counters = & stats->counters;
+    const shared_capture * capture = & stats->capture;
+
+    __metrics_family (stream, "wiredolphin_received_packets_total", "counter",
+            "Packets received.");
+    fprintf (stream, "wiredolphin_received_packets_total %" PRIu64 "\n",
+            counters->received);
+    __metrics_family (stream, "wiredolphin_received_bytes_total", "counter",
+            "Bytes received.");
+    fprintf (stream, "wiredolphin_received_bytes_total %" PRIu64 "\n",
+            counters->received_bytes);
+    __metrics_family (stream, "wiredolphin_malformed_packets_total", "counter",
+            "Packets with truncated or invalid headers.");
+    fprintf (stream, "wiredolphin_malformed_packets_total %" PRIu64 "\n",
+            counters->malformed);
+    __metrics_family (stream, "wiredolphin_sampled_packets_total", "counter",
+            "Packets kept by the sampling.");
+    fprintf (stream, "wiredolphin_sampled_packets_total %" PRIu64 "\n",
+            counters->sampled);
+
+    __metrics_family (stream, "wiredolphin_interface_packets_total", "counter",
+            "Packets received per interface.");
+    for (unsigned int i = 0; i < STATS_INTERFACES_MAX; ++i)
+        if (stats->interfaces[i][0] != '\0')
+        {
+            fprintf (stream, "wiredolphin_interface_packets_total{interface=");
+            __metrics_label (stream, stats->interfaces[i]);
+            fprintf (stream, "} %" PRIu64 "\n", counters->interface_packets[i]);
+        }
+    __metrics_family (stream, "wiredolphin_interface_bytes_total", "counter",
+            "Bytes received per interface.");
+    for (unsigned int i = 0; i < STATS_INTERFACES_MAX; ++i)
+        if (stats->interfaces[i][0] != '\0')
+        {
+            fprintf (stream, "wiredolphin_interface_bytes_total{interface=");
+            __metrics_label (stream, stats->interfaces[i]);
+            fprintf (stream, "} %" PRIu64 "\n", counters->interface_bytes[i]);
+        }
+
+    /* Estimated counters: scaled by the sampling rate. */
+    __metrics_family (stream, "wiredolphin_type_packets_total", "counter",
+            "Estimated packets per packet type.");
+    for (unsigned int i = 0; i < STATS_PACKET_TYPE_COUNT; ++i)
+        fprintf (stream, "wiredolphin_type_packets_total{type=\"%s\"} %"
+                PRIu64 "\n", stats_packet_type_string (i),
+                counters->type_packets[i]);
+    __metrics_family (stream, "wiredolphin_type_bytes_total", "counter",
+            "Estimated bytes per packet type.");
+    for (unsigned int i = 0; i < STATS_PACKET_TYPE_COUNT; ++i)
+        fprintf (stream, "wiredolphin_type_bytes_total{type=\"%s\"} %"
+                PRIu64 "\n", stats_packet_type_string (i),
+                counters->type_bytes[i]);
+
+    /* Label by number: several protocols share a name (e.g. UNASSIGNED). */
+    __metrics_family (stream, "wiredolphin_protocol_packets_total", "counter",
+            "Estimated packets per IP protocol.");
+    for (unsigned int i = 0; i < 256; ++i)
+        if (counters->protocol_packets[i])
+        {
+            fprintf (stream, "wiredolphin_protocol_packets_total"
+                    "{protocol=\"%u\",name=", i);
+            __metrics_label (stream, header_ip_protocol_string ((u_int8_t) i));
+            fprintf (stream, "} %" PRIu64 "\n", counters->protocol_packets[i]);
+        }
+    __metrics_family (stream, "wiredolphin_protocol_bytes_total", "counter",
+            "Estimated bytes per IP protocol.");
+    for (unsigned int i = 0; i < 256; ++i)
+        if (counters->protocol_packets[i])
+        {
+            fprintf (stream, "wiredolphin_protocol_bytes_total"
+                    "{protocol=\"%u\",name=", i);
+            __metrics_label (stream, header_ip_protocol_string ((u_int8_t) i));
+            fprintf (stream, "} %" PRIu64 "\n", counters->protocol_bytes[i]);
+        }
+
+    __metrics_family (stream, "wiredolphin_application_packets_total",
+            "counter", "Estimated packets per application (port).");
+    for (unsigned int i = PACKET_APP_NONE + 1; i < PACKET_APP_COUNT; ++i)
+        fprintf (stream, "wiredolphin_application_packets_total"
+                "{application=\"%s\"} %" PRIu64 "\n",
+                packet_application_string (i),
+                counters->application_packets[i]);
+    __metrics_family (stream, "wiredolphin_application_bytes_total",
+            "counter", "Estimated bytes per application (port).");
+    for (unsigned int i = PACKET_APP_NONE + 1; i < PACKET_APP_COUNT; ++i)
+        fprintf (stream, "wiredolphin_application_bytes_total"
+                "{application=\"%s\"} %" PRIu64 "\n",
+                packet_application_string (i),
+                counters->application_bytes[i]);
+
+    __metrics_family (stream, "wiredolphin_kernel_received_packets_total",
+            "counter", "Packets received by the kernel.");
+    fprintf (stream, "wiredolphin_kernel_received_packets_total %" PRIu64
+            "\n", capture->kernel_received);
+    __metrics_family (stream, "wiredolphin_kernel_dropped_packets_total",
+            "counter", "Packets dropped by the kernel.");
+    fprintf (stream, "wiredolphin_kernel_dropped_packets_total %" PRIu64
+            "\n", capture->kernel_dropped);
+    __metrics_family (stream, "wiredolphin_interface_dropped_packets_total",
+            "counter", "Packets dropped by the interfaces.");
+    fprintf (stream, "wiredolphin_interface_dropped_packets_total %" PRIu64
+            "\n", capture->interface_dropped);
+    __metrics_family (stream, "wiredolphin_writer_queue_buffers", "gauge",
+            "Buffers waiting to be written.");
+    fprintf (stream, "wiredolphin_writer_queue_buffers %" PRIu64 "\n",
+            capture->writer_queued);
+    __metrics_family (stream, "wiredolphin_writer_dropped_packets_total",
+            "counter", "Packets the writer dropped for want of a buffer.");
+    fprintf (stream, "wiredolphin_writer_dropped_packets_total %" PRIu64
+            "\n", capture->writer_dropped);
+
+    bool profiled = false;
+    for (unsigned int i = 0; i < PROFILE_STAGE_COUNT; ++i)
+        profiled = profiled || capture->latency[i].packets > 0;
+    if (profiled)
+    {
+        __metrics_family (stream, "wiredolphin_stage_latency_seconds",
+                "histogram", "Time spent per packet in each stage.");
+        for (unsigned int i = 0; i < PROFILE_STAGE_COUNT; ++i)
+        {
+            const shared_latency * latency = & capture->latency[i];
+            for (unsigned int j = 0; j < SHARED_LATENCY_BOUNDS; ++j)
+                fprintf (stream, "wiredolphin_stage_latency_seconds_bucket"
+                        "{stage=\"%s\",le=\"%g\"} %" PRIu64 "\n",
+                        profile_stage_string (i),
+                        (double) shared_latency_bounds[j] / 1e9,
+                        latency->below[j]);
+            fprintf (stream, "wiredolphin_stage_latency_seconds_bucket"
+                    "{stage=\"%s\",le=\"+Inf\"} %" PRIu64 "\n",
+                    profile_stage_string (i), latency->packets);
+            fprintf (stream, "wiredolphin_stage_latency_seconds_sum"
+                    "{stage=\"%s\"} %.9f\n", profile_stage_string (i),
+                    (double) latency->total / 1e9);
+            fprintf (stream, "wiredolphin_stage_latency_seconds_count"
+                    "{stage=\"%s\"} %" PRIu64 "\n", profile_stage_string (i),
+                    latency->packets);
+        }
+    }
+
+    __metrics_family (stream, "wiredolphin_last_update_seconds", "gauge",
+            "Time of the last published snapshot.");
+    fprintf (stream, "wiredolphin_last_update_seconds %.3f\n",
+            (double) stats->time / 1e9);
+}
+
+void __metrics_family (FILE * const stream, const char * const name,
+        const char * const type, const char * const help)
+{
+    fprintf (stream, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void __metrics_label (FILE * const stream, const char * value)
+{
+    fputc ('"', stream);
+    for (; * value != '\0'; ++value)
+        switch (* value)
+        {
+            case '\\':
+                fputs ("\\\\", stream);
+                break;
+            case '"':
+                fputs ("\\\"", stream);
+                break;
+            case '\n':
+                fputs ("\\n", stream);
+                break;
+            default:
+                fputc (* value, stream);
+                break;
+        }
+    fputc ('"', stream);
+}
+
+void __metrics_send (int client, const char * bytes, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t count = send (client, bytes, length, MSG_NOSIGNAL);
+        if (count <= 0)
+            return;
+        bytes += count;
+        length -= (size_t) count;
+    }
+}
@@ -0,0 +1,414 @@
+/**
+ * \file packet.c
+ * \brief Packets.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <ctype.h>
+
+#include "wiredolphin/packet.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define PACKET_ETHERTYPE_QINQ   0x88a8  /**< 802.1ad service tag. */
+#define PACKET_VLAN_LENGTH      4       /**< Tag control and packet type. */
+#define PACKET_VLAN_TAGS        2       /**< Tags skipped at most. */
+
+/**
+ * \brief Mix a 64 bits word into a hash.
+ * \param hash Hash.
+ * \param word Word.
+ * \return New hash.
+ */
+static inline u_int64_t __packet_hash_mix (u_int64_t hash, u_int64_t word);
+
+/**
+ * \brief Find the application of a port pair.
+ * \param source_port Source port.
+ * \param dest_port Destination port.
+ * \return Application.
+ */
+static inline packet_application __packet_application (u_int16_t source_port,
+        u_int16_t dest_port);
+
+/**
+ * \brief Name an IP protocol with letters, digits and dashes only.
+ * \param protocol IP protocol.
+ * \param buffer Buffer.
+ * \param size Buffer size.
+ * \return buffer.
+ */
+static inline const char * __packet_protocol_name (u_int8_t protocol,
+        char * buffer, size_t size);
+
+////////////////////////////////////////////////////////////////////////////////
+// Flows.
+////////////////////////////////////////////////////////////////////////////////
+
+u_int64_t packet_flow_hash (const packet_flow * const flow)
+{
+    u_int64_t words[sizeof (packet_flow) / sizeof (u_int64_t)];
+    memcpy (words, flow, sizeof words);
+
+    u_int64_t hash = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < sizeof words / sizeof words[0]; ++i)
+        hash = __packet_hash_mix (hash, words[i]);
+
+    return hash;
+}
+
+bool packet_flow_equal (const packet_flow * const a, const packet_flow * const b)
+{
+    return memcmp (a, b, sizeof (packet_flow)) == 0;
+}
+
+bool packet_flow_canonical (packet_flow * const flow)
+{
+    int order = memcmp (& flow->src_addr, & flow->dest_addr,
+            sizeof (struct in6_addr));
+    bool swap = order > 0 || (order == 0 && flow->src_port > flow->dest_port);
+
+    if (swap)
+    {
+        struct in6_addr addr = flow->src_addr;
+        flow->src_addr = flow->dest_addr;
+        flow->dest_addr = addr;
+
+        u_int16_t port = flow->src_port;
+        flow->src_port = flow->dest_port;
+        flow->dest_port = port;
+    }
+
+    return swap;
+}
+
+const char * packet_flow_address (const packet_flow * const flow, bool source,
+        char buffer[INET6_ADDRSTRLEN])
+{
+    const struct in6_addr * addr = source ? & flow->src_addr : & flow->dest_addr;
+
+    switch (flow->packet_type)
+    {
+        case ETHERTYPE_IP:
+            inet_ntop (AF_INET, addr, buffer, INET_ADDRSTRLEN);
+            break;
+        case ETHERTYPE_IPV6:
+            inet_ntop (AF_INET6, addr, buffer, INET6_ADDRSTRLEN);
+            break;
+        default:
+            ether_ntoa_r ((const struct ether_addr *) addr, buffer);
+            break;
+    }
+
+    return buffer;
+}
+
+void packet_flow_print (FILE * const stream, const packet_flow * const flow)
+{
+    char buffer_1[INET6_ADDRSTRLEN];
+    char buffer_2[INET6_ADDRSTRLEN];
+
+    packet_flow_address (flow, true, buffer_1);
+    packet_flow_address (flow, false, buffer_2);
+
+    if (flow->packet_type == ETHERTYPE_IP
+            || flow->packet_type == ETHERTYPE_IPV6)
+        fprintf (stream, "%s:%u -> %s:%u, %s", buffer_1, flow->src_port,
+                buffer_2, flow->dest_port,
+                header_ip_protocol_string (flow->protocol));
+    else if (flow->packet_type == ETHERTYPE_ARP)
+        fprintf (stream, "%s -> %s, ARP", buffer_1, buffer_2);
+    else
+        fprintf (stream, "%s -> %s, 0x%.4x", buffer_1, buffer_2,
+                flow->packet_type);
+}
+
+void packet_flow_name (const packet_flow * const flow, char * const buffer,
+        size_t size)
+{
+    char buffer_1[INET6_ADDRSTRLEN];
+    char buffer_2[INET6_ADDRSTRLEN];
+    char protocol[32];
+
+    packet_flow_address (flow, true, buffer_1);
+    packet_flow_address (flow, false, buffer_2);
+
+    if (flow->packet_type == ETHERTYPE_IP
+            || flow->packet_type == ETHERTYPE_IPV6)
+        snprintf (buffer, size, "%s_%s_%u_%s_%u",
+                __packet_protocol_name (flow->protocol, protocol,
+                    sizeof protocol),
+                buffer_1, flow->src_port, buffer_2, flow->dest_port);
+    else if (flow->packet_type == ETHERTYPE_ARP)
+        snprintf (buffer, size, "arp_%s_%s", buffer_1, buffer_2);
+    else
+        snprintf (buffer, size, "0x%.4x_%s_%s", flow->packet_type,
+                buffer_1, buffer_2);
+}
+
+bool packet_flow_parse (const char * const name, packet_flow * const flow)
+{
+    char copy[256];
+    char * fields[5];
+    char * save = NULL;
+    unsigned int count = 0;
+
+    snprintf (copy, sizeof copy, "%s", name);
+    for (char * field = strtok_r (copy, "_", & save); field != NULL && count < 5;
+            field = strtok_r (NULL, "_", & save))
+        fields[count++] = field;
+    if (count != 5 || strtok_r (NULL, "_", & save) != NULL)
+        return false;
+
+    memset (flow, 0, sizeof (packet_flow));
+
+    /* Protocol: name or number. */
+    char * end;
+    unsigned long protocol = strtoul (fields[0], & end, 10);
+    if (* end != '\0' || protocol > 255)
+    {
+        char buffer[32];
+        for (protocol = 0; protocol < 256
+                && strcmp (fields[0], __packet_protocol_name ((u_int8_t) protocol,
+                        buffer, sizeof buffer)); ++protocol)
+            continue;
+        if (protocol == 256)
+            return false;
+    }
+    flow->protocol = (u_int8_t) protocol;
+
+    if (inet_pton (AF_INET, fields[1], & flow->src_addr) == 1
+            && inet_pton (AF_INET, fields[3], & flow->dest_addr) == 1)
+        flow->packet_type = ETHERTYPE_IP;
+    else if (inet_pton (AF_INET6, fields[1], & flow->src_addr) == 1
+            && inet_pton (AF_INET6, fields[3], & flow->dest_addr) == 1)
+        flow->packet_type = ETHERTYPE_IPV6;
+    else
+        return false;
+
+    unsigned long src_port = strtoul (fields[2], & end, 10);
+    if (* end != '\0' || src_port > 65535)
+        return false;
+    unsigned long dest_port = strtoul (fields[4], & end, 10);
+    if (* end != '\0' || dest_port > 65535)
+        return false;
+    flow->src_port = (u_int16_t) src_port;
+    flow->dest_port = (u_int16_t) dest_port;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Applications.
+////////////////////////////////////////////////////////////////////////////////
+
+const char * packet_application_string (packet_application application)
+{
+    static const char * application_strings[] =
+    {
+        [PACKET_APP_NONE]           = "None",
+        [PACKET_APP_FTP_DATA]       = "FTP data",
+        [PACKET_APP_FTP_CONTROL]    = "FTP control",
+        [PACKET_APP_SMTP]           = "SMTP",
+        [PACKET_APP_BOOTP]          = "BOOTP",
+        [PACKET_APP_HTTP]           = "HTTP",
+        [PACKET_APP_POP]            = "POP",
+        [PACKET_APP_IMAP]           = "IMAP",
+        [PACKET_APP_HTTPS]          = "HTTPS",
+        [PACKET_APP_SMTPS]          = "Encrypted SMTP",
+        [PACKET_APP_IMAPS]          = "Encrypted IMAP",
+        [PACKET_APP_POPS]           = "Encrypted POP",
+        [PACKET_APP_DNS]            = "DNS",
+    };
+
+    return application_strings[application < PACKET_APP_COUNT ?
+        application : PACKET_APP_NONE];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Packets.
+////////////////////////////////////////////////////////////////////////////////
+
+void packet_decode (const struct pcap_pkthdr * const header,
+        const u_char * const bytes, packet_info * const info)
+{
+    memset (info, 0, sizeof (packet_info));
+    info->header = header;
+    info->frame = bytes;
+    info->limit = bytes + header->caplen;
+
+    if (header->caplen < sizeof (struct ether_header))
+    {
+        info->malformed = true;
+        return;
+    }
+
+    const struct ether_header * ethernet = (const struct ether_header *) bytes;
+    info->flow.packet_type = header_ethernet_packet_type (bytes);
+
+    const u_char * network = header_ethernet_data (bytes);
+    for (unsigned int tags = 0; tags < PACKET_VLAN_TAGS
+            && (info->flow.packet_type == ETHERTYPE_VLAN
+                || info->flow.packet_type == PACKET_ETHERTYPE_QINQ); ++tags)
+    {
+        if (info->limit - network < PACKET_VLAN_LENGTH)
+        {
+            info->malformed = true;
+            return;
+        }
+        if (! info->tagged)
+            info->vlan = (u_int16_t) (ntohs (* (const u_int16_t *) network)
+                & 0x0fff);
+        info->tagged = true;
+        info->flow.packet_type = ntohs (* (const u_int16_t *) (network + 2));
+        network += PACKET_VLAN_LENGTH;
+    }
+
+    size_t available = (size_t) (info->limit - network);
+    const u_char * transport = NULL;
+    struct in_addr addr;
+    size_t length;
+
+    switch (info->flow.packet_type)
+    {
+        case ETHERTYPE_IP:
+            length = available < sizeof (struct iphdr) ? 0
+                : (size_t) (header_ipv4_data (network) - network);
+            info->malformed = length < sizeof (struct iphdr)
+                || length > available;
+            if (info->malformed)
+                break;
+            info->network = network;
+            info->flow.protocol = header_ipv4_protocol (network);
+            addr = header_ipv4_src (network);
+            memcpy (& info->flow.src_addr, & addr, sizeof addr);
+            addr = header_ipv4_dest (network);
+            memcpy (& info->flow.dest_addr, & addr, sizeof addr);
+            transport = header_ipv4_data (network);
+            break;
+        case ETHERTYPE_IPV6:
+            info->malformed = available < sizeof (struct ip6_hdr);
+            if (info->malformed)
+                break;
+            info->network = network;
+            info->flow.protocol = header_ipv6_protocol (network);
+            info->flow.src_addr = header_ipv6_src (network);
+            info->flow.dest_addr = header_ipv6_dest (network);
+            transport = header_ipv6_data (network);
+            break;
+        case ETHERTYPE_ARP:
+        default:
+            if (available > 0)
+                info->network = network;
+            memcpy (& info->flow.src_addr, ethernet->ether_shost, ETH_ALEN);
+            memcpy (& info->flow.dest_addr, ethernet->ether_dhost, ETH_ALEN);
+            break;
+    }
+
+    if (transport == NULL)
+        return;
+
+    available = (size_t) (info->limit - transport);
+    switch (info->flow.protocol)
+    {
+        case IPPROTO_TCP:
+            length = available < sizeof (struct tcphdr) ? 0
+                : (size_t) (header_tcp4_data (transport) - transport);
+            info->malformed = length < sizeof (struct tcphdr)
+                || length > available;
+            if (info->malformed)
+                break;
+            info->transport = transport;
+            info->flow.src_port = header_tcp4_source_port (transport);
+            info->flow.dest_port = header_tcp4_dest_port (transport);
+            info->data = header_tcp4_data (transport);
+            break;
+        case IPPROTO_UDP:
+            info->malformed = available < sizeof (struct udphdr);
+            if (info->malformed)
+                break;
+            info->transport = transport;
+            info->flow.src_port = header_udp4_source_port (transport);
+            info->flow.dest_port = header_udp4_dest_port (transport);
+            info->data = header_udp4_data (transport);
+            break;
+        default:
+            if (available > 0)
+                info->transport = transport;
+            break;
+    }
+
+    if (info->data != NULL)
+        info->application = __packet_application (info->flow.src_port,
+                info->flow.dest_port);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+u_int64_t __packet_hash_mix (u_int64_t hash, u_int64_t word)
+{
+    /* splitmix64 finalizer. */
+    hash ^= word + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+
+    return hash;
+}
+
+packet_application __packet_application (u_int16_t source_port,
+        u_int16_t dest_port)
+{
+    /* Same order as the callbacks. */
+    static const struct
+    {
+        u_int16_t port;
+        packet_application application;
+    } ports[] =
+    {
+        { 20,   PACKET_APP_FTP_DATA,    },
+        { 21,   PACKET_APP_FTP_CONTROL, },
+        { 25,   PACKET_APP_SMTP,        },
+        { 53,   PACKET_APP_DNS,         },
+        { 67,   PACKET_APP_BOOTP,       },
+        { 68,   PACKET_APP_BOOTP,       },
+        { 80,   PACKET_APP_HTTP,        },
+        { 110,  PACKET_APP_POP,         },
+        { 143,  PACKET_APP_IMAP,        },
+        { 443,  PACKET_APP_HTTPS,       },
+        { 465,  PACKET_APP_SMTPS,       },
+        { 993,  PACKET_APP_IMAPS,       },
+        { 995,  PACKET_APP_POPS,        },
+    };
+
+    for (size_t i = 0; i < sizeof ports / sizeof ports[0]; ++i)
+        if (source_port == ports[i].port || dest_port == ports[i].port)
+            return ports[i].application;
+
+    return PACKET_APP_NONE;
+}
+
+const char * __packet_protocol_name (u_int8_t protocol, char * const buffer,
+        size_t size)
+{
+    snprintf (buffer, size, "%s", header_ip_protocol_string (protocol));
+    for (char * c = buffer; * c != '\0'; ++c)
+        * c = isalnum ((unsigned char) * c) ?
+            (char) tolower ((unsigned char) * c) : '-';
+
+    return buffer;
+}
@@ -0,0 +1,41 @@
+/**
+ * \file pcapfile.c
+ * \brief pcap file format.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <string.h>
+
+#include "wiredolphin/pcapfile.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// pcap file format.
+////////////////////////////////////////////////////////////////////////////////
+
+void pcapfile_header (pcap_t * const capture,
+        struct pcap_file_header * const header)
+{
+    memset (header, 0, sizeof (struct pcap_file_header));
+    header->magic = PCAPFILE_MAGIC;
+    header->version_major = PCAP_VERSION_MAJOR;
+    header->version_minor = PCAP_VERSION_MINOR;
+    header->snaplen = (bpf_u_int32) pcap_snapshot (capture);
+    header->linktype = (bpf_u_int32) pcap_datalink (capture);
+}
+
+void pcapfile_record_header (const struct pcap_pkthdr * const header,
+        pcapfile_record * const record)
+{
+    record->seconds = (u_int32_t) header->ts.tv_sec;
+    record->microseconds = (u_int32_t) header->ts.tv_usec;
+    record->caplen = header->caplen;
+    record->len = header->len;
+}
@@ -0,0 +1,237 @@
+/**
+ * \file profile.c
+ * \brief Hot path instrumentation.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <inttypes.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+
+#if defined (__x86_64__) || defined (__i386__)
+#include <x86intrin.h>
+#define PROFILE_RDTSC
+#endif
+
+#include "wiredolphin/profile.h"
+#include "wiredolphin/histogram.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef WIREDOLPHIN_PROFILE
+
+static __thread histogram __histograms[PROFILE_STAGE_COUNT];   /**< In ns. */
+static __thread u_int64_t __current[PROFILE_STAGE_COUNT];   /**< This packet. */
+static __thread unsigned int __touched = 0;     /**< Stages of this packet. */
+static __thread u_int64_t __last = 0;           /**< Last mark. */
+
+static double __ns_per_tick = 1;                /**< Clock calibration. */
+static volatile sig_atomic_t __requested = 0;   /**< Report requested. */
+
+/**
+ * \brief Read the clock.
+ * \return Ticks.
+ */
+static inline u_int64_t __profile_now (void);
+
+/**
+ * \brief Read the monotonic clock.
+ * \return Nanoseconds.
+ */
+static inline u_int64_t __profile_clock (void);
+
+/**
+ * \brief Record a time.
+ * \param stage Stage.
+ * \param ticks Ticks.
+ */
+static inline void __profile_record (profile_stage stage, u_int64_t ticks);
+
+/**
+ * \brief Record the stages of the current packet.
+ */
+static inline void __profile_flush (void);
+
+/**
+ * \brief Request a report (signal handler).
+ * \param signal_number Signal number.
+ */
+static void __profile_request (int signal_number);
+
+#endif /* WIREDOLPHIN_PROFILE */
+
+////////////////////////////////////////////////////////////////////////////////
+// Stages.
+////////////////////////////////////////////////////////////////////////////////
+
+const char * profile_stage_string (profile_stage stage)
+{
+    static const char * stage_strings[PROFILE_STAGE_COUNT] =
+    {
+        [PROFILE_WAIT]      = "wait",
+        [PROFILE_DECODE]    = "decode",
+        [PROFILE_ACCOUNT]   = "account",
+        [PROFILE_RECORD]    = "record",
+        [PROFILE_OUTPUT]    = "output",
+    };
+
+    return stage < PROFILE_STAGE_COUNT ? stage_strings[stage] : "unknown";
+}
+
+#ifdef WIREDOLPHIN_PROFILE
+
+////////////////////////////////////////////////////////////////////////////////
+// Instrumentation.
+////////////////////////////////////////////////////////////////////////////////
+
+void profile_start (void)
+{
+#ifdef PROFILE_RDTSC
+    /* Ticks per nanosecond, measured over 20 ms. */
+    struct timespec pause = { .tv_sec = 0, .tv_nsec = 20000000, };
+    u_int64_t clock_start = __profile_clock ();
+    u_int64_t ticks_start = __profile_now ();
+    nanosleep (& pause, NULL);
+    u_int64_t ticks = __profile_now () - ticks_start;
+    u_int64_t nanoseconds = __profile_clock () - clock_start;
+    if (ticks > 0)
+        __ns_per_tick = (double) nanoseconds / (double) ticks;
+#endif
+
+    struct sigaction action;
+    memset (& action, 0, sizeof action);
+    action.sa_handler = __profile_request;
+    action.sa_flags = SA_RESTART;
+    sigemptyset (& action.sa_mask);
+    sigaction (SIGUSR1, & action, NULL);
+
+    __last = 0;
+}
+
+void profile_enter (void)
+{
+    u_int64_t now = __profile_now ();
+
+    __profile_flush ();
+    if (__last != 0)
+        __profile_record (PROFILE_WAIT, now - __last);
+    __last = now;
+
+    /* Reports are printed between packets, not from the signal handler. */
+    if (__requested)
+    {
+        __requested = 0;
+        profile_report (stderr);
+        __last = __profile_now ();
+    }
+}
+
+void profile_lap (profile_stage stage)
+{
+    u_int64_t now = __profile_now ();
+
+    __current[stage] += now - __last;
+    __touched |= 1u << stage;
+    __last = now;
+}
+
+void profile_report (FILE * const stream)
+{
+    __profile_flush ();
+
+    fprintf (stream, "Profile\n=======\n");
+    for (unsigned int i = 0; i < PROFILE_STAGE_COUNT; ++i)
+    {
+        const histogram * values = & __histograms[i];
+        if (! values->count)
+            continue;
+
+        fprintf (stream, "%-24s\t%" PRIu64 " packets, %.1f ns/packet, p50 %"
+                PRIu64 " ns, p99 %" PRIu64 " ns, p99.9 %" PRIu64 " ns\n",
+                profile_stage_string (i), values->count,
+                (double) values->total / (double) values->count,
+                histogram_percentile (values, 0.5),
+                histogram_percentile (values, 0.99),
+                histogram_percentile (values, 0.999));
+    }
+    fprintf (stream, "\n");
+}
+
+void profile_export (profile_stage stage, const u_int64_t * const bounds,
+        size_t count, u_int64_t * const below, u_int64_t * const packets,
+        u_int64_t * const total)
+{
+    const histogram * values = & __histograms[stage];
+    size_t bound = 0;
+    u_int64_t seen = 0;
+
+    /* The packet in progress is left out: it is recorded once complete. */
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS && bound < count; ++i)
+    {
+        while (bound < count && histogram_value (i) > bounds[bound])
+            below[bound++] = seen;
+        seen += values->counts[i];
+    }
+    while (bound < count)
+        below[bound++] = seen;
+
+    * packets = values->count;
+    * total = values->total;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+u_int64_t __profile_now (void)
+{
+#ifdef PROFILE_RDTSC
+    return __rdtsc ();
+#else
+    return __profile_clock ();
+#endif
+}
+
+u_int64_t __profile_clock (void)
+{
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, & now);
+    return (u_int64_t) now.tv_sec * 1000000000u + (u_int64_t) now.tv_nsec;
+}
+
+void __profile_record (profile_stage stage, u_int64_t ticks)
+{
+    u_int64_t nanoseconds = (u_int64_t) ((double) ticks * __ns_per_tick);
+    histogram_record (& __histograms[stage], nanoseconds);
+}
+
+void __profile_flush (void)
+{
+    for (unsigned int i = 0; __touched && i < PROFILE_STAGE_COUNT; ++i)
+        if (__touched & (1u << i))
+        {
+            __profile_record (i, __current[i]);
+            __current[i] = 0;
+        }
+    __touched = 0;
+}
+
+void __profile_request (int signal_number)
+{
+    (void) signal_number;
+    __requested = 1;
+}
+
+#endif /* WIREDOLPHIN_PROFILE */
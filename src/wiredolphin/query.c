@@ -0,0 +1,294 @@
+/**
+ * \file query.c
+ * \brief wiredolphin-query: print the rate history of a rollup file as CSV.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+/* strptime. */
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sysexits.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "wiredolphin/rollup.h"
+#include "wiredolphin/version.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * \brief Resolution.
+ */
+static rollup_resolution __resolution = ROLLUP_SECOND;
+
+/**
+ * \brief First time (s since the epoch).
+ */
+static u_int64_t __from = 0;
+
+/**
+ * \brief Last time (s since the epoch).
+ */
+static u_int64_t __to = UINT64_MAX;
+
+/**
+ * \brief Rollup file.
+ */
+static const char * __file = NULL;
+
+/**
+ * \brief Parse command line arguments.
+ * \param argc Argument count.
+ * \param argv Argument values.
+ */
+static inline void __parse_args (int argc, char ** argv);
+
+/**
+ * \brief Parse a time argument, exit on failure.
+ * \param argument Seconds since the epoch, or local "YYYY-MM-DD HH:MM:SS".
+ * \return Seconds since the epoch.
+ */
+static inline u_int64_t __parse_time (const char * argument);
+
+/**
+ * \brief Print the names of the columns of a series.
+ * \param name Series name.
+ * \param prefix Name prefix.
+ */
+static inline void __print_column (const char * name, const char * prefix);
+
+/**
+ * \brief Print the CSV header.
+ * \param file Rollup file.
+ */
+static inline void __print_header (const rollup_file * file);
+
+/**
+ * \brief Print a bucket as a CSV row.
+ * \param file Rollup file.
+ * \param bucket Bucket.
+ */
+static inline void __print_bucket (const rollup_file * file,
+        const rollup_bucket * bucket);
+
+/**
+ * \brief Print the help.
+ */
+static inline void __print_help (void);
+
+////////////////////////////////////////////////////////////////////////////////
+// Main.
+////////////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char ** argv)
+{
+    __parse_args (argc, argv);
+
+    const rollup_file * file = rollup_attach (__file);
+    if (file == NULL)
+        exit (EX_NOINPUT);
+
+    __print_header (file);
+
+    /* The ring holds the buckets up to the last second. */
+    u_int64_t step = rollup_steps[__resolution];
+    u_int64_t last = __atomic_load_n (& file->last, __ATOMIC_ACQUIRE);
+    last -= last % step;
+    u_int64_t span = (rollup_slots[__resolution] - 1) * step;
+    u_int64_t first = last > span ? last - span : 0;
+    if (first < __from)
+        first = __from - __from % step;
+    if (last > __to)
+        last = __to - __to % step;
+
+    rollup_bucket bucket;
+    for (u_int64_t time = first; last != 0 && time <= last; time += step)
+        if (rollup_read (file, __resolution, time, & bucket))
+            __print_bucket (file, & bucket);
+
+    rollup_detach (file);
+    fflush (stdout);
+    exit (EXIT_SUCCESS);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+void __parse_args (int argc, char ** argv)
+{
+    static struct option long_options[] =
+    {
+        { "resolution", required_argument, NULL, 'r', },
+        { "from",       required_argument, NULL, 'f', },
+        { "to",         required_argument, NULL, 't', },
+        { "help",       no_argument, NULL, 'h', },
+        { 0, 0, 0, 0, },
+    };
+
+    int val;
+    opterr = 0;
+
+    while ((val = getopt_long (argc, argv, ":r:f:t:h", long_options, NULL))
+            != -1)
+    {
+        switch (val)
+        {
+            case 'r':
+                if (! strcmp (optarg, "second") || ! strcmp (optarg, "1s"))
+                    __resolution = ROLLUP_SECOND;
+                else if (! strcmp (optarg, "minute") || ! strcmp (optarg, "1m"))
+                    __resolution = ROLLUP_MINUTE;
+                else if (! strcmp (optarg, "hour") || ! strcmp (optarg, "1h"))
+                    __resolution = ROLLUP_HOUR;
+                else
+                {
+                    fprintf (stderr, "Error: \"%s\" is not a valid resolution "
+                            "(second, minute or hour).\n", optarg);
+                    exit (EX_USAGE);
+                }
+                break;
+            case 'f':
+                __from = __parse_time (optarg);
+                break;
+            case 't':
+                __to = __parse_time (optarg);
+                break;
+            case 'h':
+                __print_help ();
+                exit (EXIT_SUCCESS);
+                break;
+            case ':':
+                fprintf (stderr, "Error: missing argument for \"%s\".\n",
+                        argv[optind-1]);
+                exit (EX_USAGE);
+            case '?':
+                fprintf (stderr, "Error: Unknown option \"%s\".\n",
+                        argv[optind-1]);
+                exit (EX_USAGE);
+            default:
+                break;
+        }
+    }
+
+    if (optind != argc - 1)
+    {
+        fprintf (stderr, "Usage: %s [-r <resolution>] [--from <time>] "
+                "[--to <time>] <file>\n", * argv);
+        exit (EX_USAGE);
+    }
+    __file = argv[optind];
+}
+
+u_int64_t __parse_time (const char * argument)
+{
+    char * end;
+    unsigned long long seconds = strtoull (argument, & end, 10);
+
+    if (end != argument && * end == '\0')
+        return seconds;
+
+    struct tm local;
+    memset (& local, 0, sizeof local);
+    end = strptime (argument, "%Y-%m-%d %H:%M:%S", & local);
+    if (end == NULL)
+        end = strptime (argument, "%Y-%m-%dT%H:%M:%S", & local);
+    if (end == NULL || * end != '\0')
+    {
+        fprintf (stderr, "Error: \"%s\" is not a valid time.\n", argument);
+        exit (EX_USAGE);
+    }
+
+    local.tm_isdst = -1;
+    return (u_int64_t) mktime (& local);
+}
+
+void __print_column (const char * name, const char * prefix)
+{
+    /* Lower case, without spaces: "FTP data" becomes ftp_data. */
+    char column[64];
+    size_t length = 0;
+    for (; * name != '\0' && length < sizeof column - 1; ++name)
+        column[length++] = * name == ' ' ? '_'
+            : (char) tolower ((unsigned char) * name);
+    column[length] = '\0';
+
+    printf (",%s%s_packets,%s%s_bytes", prefix, column, prefix, column);
+}
+
+void __print_header (const rollup_file * const file)
+{
+    static const char * const protocols[ROLLUP_PROTOCOLS] =
+    {
+        "TCP", "UDP", "ICMP", "ICMPv6", "other",
+    };
+
+    printf ("time");
+    __print_column ("total", "");
+    for (unsigned int i = 0; i < ROLLUP_INTERFACES; ++i)
+        if (file->interfaces[i][0] != '\0')
+            __print_column (file->interfaces[i], "if_");
+    for (unsigned int i = 0; i < STATS_PACKET_TYPE_COUNT; ++i)
+        __print_column (stats_packet_type_string (i), "");
+    for (unsigned int i = 0; i < ROLLUP_PROTOCOLS; ++i)
+        __print_column (protocols[i], "ip_");
+    for (unsigned int i = PACKET_APP_NONE + 1; i < PACKET_APP_COUNT; ++i)
+        __print_column (packet_application_string (i), "");
+    printf ("\n");
+}
+
+void __print_bucket (const rollup_file * const file,
+        const rollup_bucket * const bucket)
+{
+    printf ("%" PRIu64, bucket->time);
+    for (unsigned int i = 0; i < ROLLUP_SERIES; ++i)
+    {
+        /* Unnamed interfaces have no column. */
+        if (i >= ROLLUP_INTERFACE && i < ROLLUP_TYPE
+                && file->interfaces[i - ROLLUP_INTERFACE][0] == '\0')
+            continue;
+        printf (",%" PRIu64 ",%" PRIu64, bucket->packets[i],
+                bucket->bytes[i]);
+    }
+    printf ("\n");
+}
+
+void __print_help (void)
+{
+    fprintf (stderr, "wiredolphin-query version %u.%u.%u, 2014-2015\n\n",
+        WIREDOLPHIN_VERSION_MAJOR, WIREDOLPHIN_VERSION_MINOR,
+        WIREDOLPHIN_VERSION_PATCH);
+    fprintf (stderr, "Usage: wiredolphin-query [-r <resolution>] "
+            "[--from <time>] [--to <time>] <file>\n\n");
+    fprintf (stderr, "Print the rate history a capture keeps with "
+            "wiredolphin --rollup <file>,\nas CSV.\n\n");
+
+    fprintf (stderr, "\t-h, --help\n");
+    fprintf (stderr, "\t\tPrint this help.\n");
+
+    fprintf (stderr, "\t-r, --resolution <second|minute|hour>\n");
+    fprintf (stderr, "\t\tBucket length (default: second). The file keeps "
+            "an hour of\n\t\tseconds, a day of minutes and a year of "
+            "hours.\n");
+
+    fprintf (stderr, "\t-f, --from <time>\n");
+    fprintf (stderr, "\t-t, --to <time>\n");
+    fprintf (stderr, "\t\tOnly print the buckets in this range: seconds "
+            "since the epoch,\n\t\tor local \"YYYY-MM-DD HH:MM:SS\".\n");
+}
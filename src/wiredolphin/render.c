@@ -0,0 +1,173 @@
+/**
+ * \file render.c
+ * \brief wiredolphin-render: print binary records as text.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sysexits.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "wiredolphin/binary.h"
+#include "wiredolphin/input.h"
+#include "wiredolphin/version.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * \brief Verbose mode level (CALLBACK_LEVEL_COUNT: the recorded one).
+ */
+static unsigned int __level = CALLBACK_LEVEL_COUNT;
+
+/**
+ * \brief Record file.
+ */
+static const char * __file = NULL;
+
+/**
+ * \brief Parse command line arguments.
+ * \param argc Argument count.
+ * \param argv Argument values.
+ */
+static inline void __parse_args (int argc, char ** argv);
+
+/**
+ * \brief Print the help.
+ */
+static inline void __print_help (void);
+
+////////////////////////////////////////////////////////////////////////////////
+// Main.
+////////////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char ** argv)
+{
+    __parse_args (argc, argv);
+
+    bool plain;
+    FILE * stream = input_open (__file, & plain);
+    if (stream == NULL)
+    {
+        fprintf (stderr, "Error: Could not open %s: %s.\n", __file,
+                strerror (errno));
+        exit (EX_NOINPUT);
+    }
+
+    binary_reader reader;
+    if (! binary_reader_open (& reader, stream))
+    {
+        fclose (stream);
+        input_finish ();
+        exit (EX_DATAERR);
+    }
+
+    binary_record record;
+    struct pcap_pkthdr header;
+    const u_char * bytes;
+    while (binary_reader_next (& reader, & record, & header, & bytes))
+    {
+        unsigned int level = __level < CALLBACK_LEVEL_COUNT ? __level
+            : record.level;
+        if (level < CALLBACK_LEVEL_COUNT)
+            callback_handler (level) (NULL, & header, bytes);
+    }
+
+    bool failed = reader.failed;
+    binary_reader_close (& reader);
+    fclose (stream);
+    input_finish ();
+    fflush (stdout);
+
+    exit (failed ? EX_DATAERR : EXIT_SUCCESS);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+void __parse_args (int argc, char ** argv)
+{
+    static struct option long_options[] =
+    {
+        { "verbose",    required_argument, NULL, 'v', },
+        { "help",       no_argument, NULL, 'h', },
+        { 0, 0, 0, 0, },
+    };
+
+    int val;
+    opterr = 0;
+
+    while ((val = getopt_long (argc, argv, ":v:h", long_options, NULL)) != -1)
+    {
+        switch (val)
+        {
+            case 'v':
+                if (sscanf (optarg, "%u", & __level) != 1
+                        || __level >= CALLBACK_LEVEL_COUNT)
+                {
+                    fprintf (stderr, "Error: \"%s\" is not a valid level.\n",
+                            optarg);
+                    exit (EX_USAGE);
+                }
+                break;
+            case 'h':
+                __print_help ();
+                exit (EXIT_SUCCESS);
+                break;
+            case ':':
+                fprintf (stderr, "Error: missing argument for \"%s\".\n",
+                        argv[optind-1]);
+                exit (EX_USAGE);
+            case '?':
+                fprintf (stderr, "Error: Unknown option \"%s\".\n",
+                        argv[optind-1]);
+                exit (EX_USAGE);
+            default:
+                break;
+        }
+    }
+
+    if (optind != argc - 1)
+    {
+        fprintf (stderr, "Usage: %s [-v <level>] <file>\n", * argv);
+        exit (EX_USAGE);
+    }
+    __file = argv[optind];
+}
+
+void __print_help (void)
+{
+    fprintf (stderr, "wiredolphin-render version %u.%u.%u, 2014-2015\n\n",
+        WIREDOLPHIN_VERSION_MAJOR, WIREDOLPHIN_VERSION_MINOR,
+        WIREDOLPHIN_VERSION_PATCH);
+    fprintf (stderr, "Usage: wiredolphin-render [-v <level>] <file>\n\n");
+    fprintf (stderr, "Print the records written by wiredolphin --binary-out "
+            "as text. <file>\ncan be \"-\" (standard input) and "
+            "compressed.\n\n");
+
+    fprintf (stderr, "\t-h, --help\n");
+    fprintf (stderr, "\t\tPrint this help.\n");
+
+    fprintf (stderr, "\t-v, --verbose <level>\n");
+    fprintf (stderr, "\t\tSet the verbose mode level (default: the level of "
+            "each record).\n");
+    fprintf (stderr, "\t\t0: Raw.\n");
+    fprintf (stderr, "\t\t1: Concise.\n");
+    fprintf (stderr, "\t\t2: Synthetic.\n");
+    fprintf (stderr, "\t\t3: Complete.\n");
+    fprintf (stderr, "\t\t4: Statistics only.\n");
+}
@@ -0,0 +1,277 @@
+/**
+ * \file repeat.c
+ * \brief Repeated packets collapsing.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <inttypes.h>
+
+#include "wiredolphin/repeat.h"
+#include "wiredolphin/json.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define REPEAT_INTERVAL     1       /**< Seconds between two records. */
+#define REPEAT_LINE_MAX     256     /**< Data bytes taken into account. */
+
+/**
+ * \brief Fingerprint of a packet.
+ */
+typedef struct __repeat_fingerprint
+{
+    u_int8_t ether_src[ETH_ALEN];   /**< Source MAC address. */
+    u_int8_t ether_dest[ETH_ALEN];  /**< Destination MAC address. */
+    u_int16_t detail;               /**< Protocol specific detail. */
+    u_int16_t unused;               /**< Unused. */
+    u_int64_t data;                 /**< Hash of the relevant data. */
+    packet_flow flow;               /**< 5-tuple. */
+} __repeat_fingerprint;
+
+/**
+ * \brief Window entry.
+ */
+typedef struct __repeat_entry
+{
+    __repeat_fingerprint fingerprint;   /**< Fingerprint. */
+    u_int64_t repeats;                  /**< Repeats not reported yet. */
+    struct timeval reported;            /**< Last report time. */
+} __repeat_entry;
+
+/**
+ * \brief Window, most recently seen first.
+ */
+static __repeat_entry __window[REPEAT_WINDOW_MAX];
+
+static unsigned int __window_size = 0;              /**< Window size. */
+static unsigned int __size = 0;                     /**< Entries in use. */
+static __repeat_fingerprint __last;                 /**< Last printed. */
+static bool __last_valid = false;                   /**< __last is valid. */
+
+/**
+ * \brief Fingerprint a packet.
+ * \param info Decoded packet.
+ * \param fingerprint Fingerprint.
+ */
+static inline void __repeat_fingerprint_get (const packet_info * info,
+        __repeat_fingerprint * fingerprint);
+
+/**
+ * \brief Hash bytes, up to the first CRLF.
+ * \param bytes First byte.
+ * \param limit Byte following the last byte.
+ * \param line Whether to stop at the first CRLF.
+ * \return Hash.
+ */
+static inline u_int64_t __repeat_hash (const u_char * bytes,
+        const u_char * limit, bool line);
+
+/**
+ * \brief Print the repetition record of an entry, if any.
+ * \param stream Output stream.
+ * \param entry Entry.
+ * \param now Current time.
+ */
+static inline void __repeat_report (FILE * stream, __repeat_entry * entry,
+        const struct timeval * now);
+
+////////////////////////////////////////////////////////////////////////////////
+// Repeated packets.
+////////////////////////////////////////////////////////////////////////////////
+
+void repeat_set_window (unsigned int window)
+{
+    __window_size = window < REPEAT_WINDOW_MAX ? window : REPEAT_WINDOW_MAX;
+}
+
+bool repeat_enabled (void)
+{
+    return __window_size > 0;
+}
+
+bool repeat_accept (FILE * const stream, const packet_info * const info)
+{
+    if (! repeat_enabled ())
+        return true;
+
+    const struct timeval * now = & info->header->ts;
+    __repeat_fingerprint fingerprint;
+    __repeat_fingerprint_get (info, & fingerprint);
+
+    /* Long repetitions are reported periodically. */
+    for (unsigned int i = 0; i < __size; ++i)
+        if (__window[i].repeats
+                && now->tv_sec - __window[i].reported.tv_sec >= REPEAT_INTERVAL)
+            __repeat_report (stream, & __window[i], now);
+
+    unsigned int i = 0;
+    while (i < __size && memcmp (& __window[i].fingerprint, & fingerprint,
+                sizeof fingerprint))
+        ++i;
+
+    if (i < __size)
+    {
+        /* Repeat: count it and move it to the front. */
+        __repeat_entry entry = __window[i];
+        ++entry.repeats;
+        memmove (& __window[1], & __window[0], i * sizeof (__repeat_entry));
+        __window[0] = entry;
+        return false;
+    }
+
+    /* New packet: the least recently seen entry leaves the window. */
+    if (__size == __window_size)
+        __repeat_report (stream, & __window[--__size], now);
+
+    memmove (& __window[1], & __window[0], __size * sizeof (__repeat_entry));
+    __window[0].fingerprint = fingerprint;
+    __window[0].repeats = 0;
+    __window[0].reported = * now;
+    ++__size;
+
+    __last = fingerprint;
+    __last_valid = true;
+
+    return true;
+}
+
+void repeat_finish (FILE * const stream)
+{
+    for (unsigned int i = __size; i > 0; --i)
+        __repeat_report (stream, & __window[i - 1], NULL);
+
+    __size = 0;
+    __last_valid = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+void __repeat_fingerprint_get (const packet_info * const info,
+        __repeat_fingerprint * const fingerprint)
+{
+    memset (fingerprint, 0, sizeof (__repeat_fingerprint));
+    fingerprint->flow = info->flow;
+
+    if (info->header->caplen >= sizeof (struct ether_header))
+    {
+        const struct ether_header * ethernet =
+            (const struct ether_header *) info->frame;
+        memcpy (fingerprint->ether_src, ethernet->ether_shost, ETH_ALEN);
+        memcpy (fingerprint->ether_dest, ethernet->ether_dhost, ETH_ALEN);
+    }
+
+    if (info->flow.packet_type == ETHERTYPE_ARP && info->network != NULL)
+    {
+        /* Operation and addresses. */
+        fingerprint->data = __repeat_hash (info->network, info->limit, false);
+        return;
+    }
+
+    if (info->transport == NULL)
+        return;
+
+    switch (info->flow.protocol)
+    {
+        case IPPROTO_ICMP:
+        case IPPROTO_ICMPV6:
+            /* Type and code, not the identifier nor the sequence number. */
+            if (info->limit - info->transport >= 2)
+                fingerprint->detail = (u_int16_t) (info->transport[0] << 8
+                        | info->transport[1]);
+            return;
+        case IPPROTO_TCP:
+            /* Flags, not the sequence nor acknowledgement numbers. */
+            fingerprint->detail =
+                ((const struct tcphdr *) info->transport)->th_flags;
+            break;
+        default:
+            break;
+    }
+
+    if (info->application == PACKET_APP_BOOTP
+            && info->limit - info->data >= (long) sizeof (bootp_header))
+    {
+        /* Message type and client, not the transaction ID nor the time. */
+        const bootp_header * bootp = (const bootp_header *) info->data;
+        fingerprint->detail = dhcp_message_type_get (info->data, info->limit);
+        fingerprint->data = __repeat_hash (bootp->hw_addr,
+                bootp->hw_addr + BOOTP_HW_ADDR_LEN, false);
+    }
+    else if (info->data != NULL)
+        fingerprint->data = __repeat_hash (info->data, info->limit, true);
+}
+
+u_int64_t __repeat_hash (const u_char * bytes, const u_char * limit, bool line)
+{
+    /* FNV-1a. */
+    u_int64_t hash = 0xcbf29ce484222325ULL;
+
+    if (limit - bytes > REPEAT_LINE_MAX)
+        limit = bytes + REPEAT_LINE_MAX;
+
+    for ( ; bytes < limit; ++bytes)
+    {
+        if (line && bytes[0] == 0x0d && bytes + 1 < limit && bytes[1] == 0x0a)
+            break;
+        hash = (hash ^ bytes[0]) * 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+void __repeat_report (FILE * const stream, __repeat_entry * const entry,
+        const struct timeval * const now)
+{
+    if (entry->repeats == 0)
+        return;
+
+    const __repeat_fingerprint * fingerprint = & entry->fingerprint;
+    bool last = __last_valid && ! memcmp (& __last, fingerprint,
+            sizeof (__repeat_fingerprint));
+    if (json_enabled ())
+    {
+        json_repeat (stream, entry->repeats,
+                last ? NULL : fingerprint->ether_src, fingerprint->ether_dest,
+                & fingerprint->flow);
+        __last_valid = last;
+    }
+    else if (last)
+        fprintf (stream, "Last message repeated %" PRIu64 " times\n\n",
+                entry->repeats);
+    else
+    {
+        char buffer_1[INET6_ADDRSTRLEN];
+        char buffer_2[INET6_ADDRSTRLEN];
+
+        fprintf (stream, "Message repeated %" PRIu64 " times: %s -> %s",
+                entry->repeats,
+                ether_ntoa_r ((const struct ether_addr *) fingerprint->ether_src,
+                    buffer_1),
+                ether_ntoa_r ((const struct ether_addr *) fingerprint->ether_dest,
+                    buffer_2));
+        if (fingerprint->flow.packet_type == ETHERTYPE_IP
+                || fingerprint->flow.packet_type == ETHERTYPE_IPV6)
+        {
+            fprintf (stream, "; ");
+            packet_flow_print (stream, & fingerprint->flow);
+        }
+        fprintf (stream, "\n\n");
+
+        __last_valid = false;
+    }
+
+    entry->repeats = 0;
+    if (now != NULL)
+        entry->reported = * now;
+}
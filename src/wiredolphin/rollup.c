@@ -0,0 +1,384 @@
+/**
+ * \file rollup.c
+ * \brief Rate history in a fixed size file.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "wiredolphin/rollup.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define ROLLUP_RETRIES      1024    /**< Reads during an update. */
+
+const u_int32_t rollup_steps[ROLLUP_RESOLUTION_COUNT] = { 1, 60, 3600, };
+
+const u_int32_t rollup_slots[ROLLUP_RESOLUTION_COUNT] = { 3600, 1440, 8760, };
+
+const u_int8_t rollup_protocols[ROLLUP_PROTOCOLS - 1] =
+{
+    IPPROTO_TCP, IPPROTO_UDP, IPPROTO_ICMP, IPPROTO_ICMPV6,
+};
+
+static const char * __path = NULL;          /**< File path. */
+static rollup_file * __file = NULL;         /**< Mapped file. */
+static u_int64_t __second = 0;              /**< Current second. */
+static stats_counters __snapshot;           /**< Counters at its start. */
+
+/**
+ * \brief Get the size of a rollup file.
+ * \return Size.
+ */
+static inline size_t __rollup_size (void);
+
+/**
+ * \brief Get a bucket.
+ * \param file File.
+ * \param resolution Resolution.
+ * \param time Time (s since the epoch).
+ * \return Bucket holding the time.
+ */
+static inline rollup_bucket * __rollup_bucket (const rollup_file * file,
+        rollup_resolution resolution, u_int64_t time);
+
+/**
+ * \brief Write the current second and the empty seconds before the next.
+ * \param next Next second.
+ */
+static inline void __rollup_flush (u_int64_t next);
+
+/**
+ * \brief Add counters to the buckets of a second, at every resolution.
+ * \param second Second.
+ * \param packets Packets per series (NULL for an empty second).
+ * \param bytes Bytes per series.
+ */
+static inline void __rollup_add (u_int64_t second, const u_int64_t * packets,
+        const u_int64_t * bytes);
+
+////////////////////////////////////////////////////////////////////////////////
+// Writing.
+////////////////////////////////////////////////////////////////////////////////
+
+void rollup_set_path (const char * const path)
+{
+    __path = path;
+}
+
+bool rollup_enabled (void)
+{
+    return __path != NULL;
+}
+
+bool rollup_open (void)
+{
+    if (! rollup_enabled ())
+        return true;
+
+    int fd = open (__path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    struct stat status;
+    if (fd < 0 || fstat (fd, & status))
+    {
+        fprintf (stderr, "Error: Could not open %s: %s.\n", __path,
+                strerror (errno));
+        if (fd >= 0)
+            close (fd);
+        return false;
+    }
+
+    /* A new file is sparse until written. */
+    size_t size = __rollup_size ();
+    bool created = status.st_size == 0;
+    if ((created && ftruncate (fd, (off_t) size))
+            || (size_t) status.st_size != (created ? 0 : size))
+    {
+        fprintf (stderr, "Error: %s is not a rollup file.\n", __path);
+        close (fd);
+        return false;
+    }
+
+    void * map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf (stderr, "Error: Could not map %s: %s.\n", __path,
+                strerror (errno));
+        return false;
+    }
+
+    __file = map;
+    if (created)
+    {
+        __file->version = ROLLUP_VERSION;
+        __file->size = size;
+        __atomic_store_n (& __file->magic, ROLLUP_MAGIC, __ATOMIC_RELEASE);
+    }
+    else if (__file->magic != ROLLUP_MAGIC
+            || __file->version != ROLLUP_VERSION || __file->size != size)
+    {
+        fprintf (stderr, "Error: %s: unknown rollup layout.\n", __path);
+        munmap (__file, size);
+        __file = NULL;
+        return false;
+    }
+    /* After an interrupted update. */
+    __file->sequence &= ~ (u_int64_t) 1;
+
+    for (unsigned int i = 0; i < ROLLUP_INTERFACES; ++i)
+    {
+        const char * name = stats_interface (i);
+        strncpy (__file->interfaces[i], name != NULL ? name : "",
+                ROLLUP_NAME_MAX - 1);
+        __file->interfaces[i][ROLLUP_NAME_MAX - 1] = '\0';
+    }
+    __second = 0;
+
+    return true;
+}
+
+void rollup_packet (const struct timeval * const ts)
+{
+    if (__file == NULL || (u_int64_t) ts->tv_sec <= __second)
+        return;
+
+    /* Late packets (merged files, clock steps) count in the current second. */
+    if (__second)
+        __rollup_flush ((u_int64_t) ts->tv_sec);
+    else
+        __snapshot = * stats_get ();
+    __second = (u_int64_t) ts->tv_sec;
+}
+
+void rollup_close (void)
+{
+    if (__file == NULL)
+        return;
+
+    if (__second)
+        __rollup_flush (__second + 1);
+    munmap (__file, __rollup_size ());
+    __file = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reading.
+////////////////////////////////////////////////////////////////////////////////
+
+const rollup_file * rollup_attach (const char * const path)
+{
+    int fd = open (path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        fprintf (stderr, "Error: Could not open %s: %s.\n", path,
+                strerror (errno));
+        return NULL;
+    }
+
+    size_t size = __rollup_size ();
+    struct stat status;
+    if (fstat (fd, & status) || (size_t) status.st_size != size)
+    {
+        fprintf (stderr, "Error: %s is not a rollup file.\n", path);
+        close (fd);
+        return NULL;
+    }
+
+    void * map = mmap (NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf (stderr, "Error: Could not map %s: %s.\n", path,
+                strerror (errno));
+        return NULL;
+    }
+
+    const rollup_file * file = map;
+    if (__atomic_load_n (& file->magic, __ATOMIC_ACQUIRE) != ROLLUP_MAGIC
+            || file->version != ROLLUP_VERSION || file->size != size)
+    {
+        fprintf (stderr, "Error: %s: unknown rollup layout.\n", path);
+        rollup_detach (file);
+        return NULL;
+    }
+
+    return file;
+}
+
+bool rollup_read (const rollup_file * const file,
+        rollup_resolution resolution, u_int64_t time,
+        rollup_bucket * const bucket)
+{
+    const rollup_bucket * stored = __rollup_bucket (file, resolution, time);
+
+    for (unsigned int i = 0; i < ROLLUP_RETRIES; ++i)
+    {
+        u_int64_t before = __atomic_load_n (& file->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1)
+            /* Update in progress. */
+            continue;
+
+        memcpy (bucket, stored, sizeof * bucket);
+        __atomic_thread_fence (__ATOMIC_ACQUIRE);
+        if (__atomic_load_n (& file->sequence, __ATOMIC_RELAXED) == before)
+            return bucket->time == time;
+    }
+
+    return false;
+}
+
+void rollup_detach (const rollup_file * const file)
+{
+    munmap ((void *) (uintptr_t) file, __rollup_size ());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+size_t __rollup_size (void)
+{
+    size_t buckets = 0;
+    for (unsigned int i = 0; i < ROLLUP_RESOLUTION_COUNT; ++i)
+        buckets += rollup_slots[i];
+
+    return sizeof (rollup_file) + buckets * sizeof (rollup_bucket);
+}
+
+rollup_bucket * __rollup_bucket (const rollup_file * const file,
+        rollup_resolution resolution, u_int64_t time)
+{
+    size_t first = 0;
+    for (unsigned int i = 0; i < resolution; ++i)
+        first += rollup_slots[i];
+
+    u_int64_t slot = time / rollup_steps[resolution]
+        % rollup_slots[resolution];
+    return (rollup_bucket *) (uintptr_t) & file->buckets[first + slot];
+}
+
+void __rollup_flush (u_int64_t next)
+{
+    const stats_counters * counters = stats_get ();
+    u_int64_t packets[ROLLUP_SERIES];
+    u_int64_t bytes[ROLLUP_SERIES];
+
+    packets[ROLLUP_TOTAL] = counters->packets - __snapshot.packets;
+    bytes[ROLLUP_TOTAL] = counters->bytes - __snapshot.bytes;
+
+    for (unsigned int i = 0; i < ROLLUP_INTERFACES; ++i)
+    {
+        packets[ROLLUP_INTERFACE + i] = counters->interface_packets[i]
+            - __snapshot.interface_packets[i];
+        bytes[ROLLUP_INTERFACE + i] = counters->interface_bytes[i]
+            - __snapshot.interface_bytes[i];
+    }
+
+    for (unsigned int i = 0; i < STATS_PACKET_TYPE_COUNT; ++i)
+    {
+        packets[ROLLUP_TYPE + i] = counters->type_packets[i]
+            - __snapshot.type_packets[i];
+        bytes[ROLLUP_TYPE + i] = counters->type_bytes[i]
+            - __snapshot.type_bytes[i];
+    }
+
+    /* The other protocols: what the listed ones leave. */
+    unsigned int other = ROLLUP_PROTOCOL + ROLLUP_PROTOCOLS - 1;
+    packets[other] = bytes[other] = 0;
+    for (unsigned int i = 0; i < 256; ++i)
+    {
+        packets[other] += counters->protocol_packets[i]
+            - __snapshot.protocol_packets[i];
+        bytes[other] += counters->protocol_bytes[i]
+            - __snapshot.protocol_bytes[i];
+    }
+    for (unsigned int i = 0; i < ROLLUP_PROTOCOLS - 1; ++i)
+    {
+        u_int8_t protocol = rollup_protocols[i];
+        packets[ROLLUP_PROTOCOL + i] = counters->protocol_packets[protocol]
+            - __snapshot.protocol_packets[protocol];
+        bytes[ROLLUP_PROTOCOL + i] = counters->protocol_bytes[protocol]
+            - __snapshot.protocol_bytes[protocol];
+        packets[other] -= packets[ROLLUP_PROTOCOL + i];
+        bytes[other] -= bytes[ROLLUP_PROTOCOL + i];
+    }
+
+    for (unsigned int i = 0; i < PACKET_APP_COUNT - 1; ++i)
+    {
+        packets[ROLLUP_APPLICATION + i] = counters->application_packets[i + 1]
+            - __snapshot.application_packets[i + 1];
+        bytes[ROLLUP_APPLICATION + i] = counters->application_bytes[i + 1]
+            - __snapshot.application_bytes[i + 1];
+    }
+
+    /* Single writer: an odd sequence tells the readers to retry. */
+    u_int64_t sequence = __file->sequence;
+    __atomic_store_n (& __file->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+
+    __rollup_add (__second, packets, bytes);
+
+    /* Only the seconds the ring still holds. */
+    u_int64_t empty = __second + 1;
+    if (next - empty > rollup_slots[ROLLUP_SECOND])
+        empty = next - rollup_slots[ROLLUP_SECOND];
+    for (; empty < next; ++empty)
+        __rollup_add (empty, NULL, NULL);
+
+    /* An older capture fills the buckets the ring still holds. */
+    if (next - 1 > __file->last)
+        __file->last = next - 1;
+    __atomic_store_n (& __file->sequence, sequence + 2, __ATOMIC_RELEASE);
+
+    __snapshot = * counters;
+}
+
+void __rollup_add (u_int64_t second, const u_int64_t * const packets,
+        const u_int64_t * const bytes)
+{
+    for (unsigned int i = 0; i < ROLLUP_RESOLUTION_COUNT; ++i)
+    {
+        u_int64_t start = second - second % rollup_steps[i];
+        u_int64_t span = (u_int64_t) (rollup_slots[i] - 1) * rollup_steps[i];
+
+        /* Older than the ring holds (an older capture, a clock step). */
+        if (start + span < __file->last - __file->last % rollup_steps[i])
+            continue;
+
+        rollup_bucket * bucket = __rollup_bucket (__file, i, start);
+
+        /* Never overwrite a newer bucket. */
+        if (bucket->time > start)
+            continue;
+
+        /* A bucket left from a previous round of the ring. */
+        if (bucket->time != start)
+        {
+            bucket->time = start;
+            memset (bucket->packets, 0, sizeof bucket->packets);
+            memset (bucket->bytes, 0, sizeof bucket->bytes);
+        }
+        if (packets != NULL)
+            for (unsigned int j = 0; j < ROLLUP_SERIES; ++j)
+            {
+                bucket->packets[j] += packets[j];
+                bucket->bytes[j] += bytes[j];
+            }
+    }
+}
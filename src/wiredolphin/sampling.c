@@ -0,0 +1,219 @@
+/**
+ * \file sampling.c
+ * \brief Sampling.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <sys/time.h>
+
+#include "wiredolphin/sampling.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define SAMPLING_UPDATE_PERIOD  64      /**< Packets between two load checks. */
+#define SAMPLING_CHECK_INTERVAL 0.1     /**< Seconds between two load checks. */
+#define SAMPLING_LAG_HIGH       0.25    /**< Lag (s) considered as pressure. */
+#define SAMPLING_LAG_LOW        0.05    /**< Lag (s) considered as calm. */
+#define SAMPLING_HOLD           0.5     /**< Seconds between two sheddings. */
+#define SAMPLING_RECOVERY       2.0     /**< Calm seconds before recovering. */
+#define SAMPLING_RATE_MAX       65536   /**< Maximum sampling rate. */
+
+/**
+ * \brief Shedding steps used to lower the verbosity level.
+ *
+ * Step 1 falls back to the concise level, step 2 to statistics only. Further
+ * steps double the sampling rate.
+ */
+#define SAMPLING_LEVEL_STEPS    2
+
+static sampling_mode __mode = SAMPLING_NONE;    /**< Sampling mode. */
+static unsigned int __rate = 1;                 /**< Requested rate. */
+static bool __adaptive = false;                 /**< Adaptive mode. */
+static unsigned int __shed = 0;                 /**< Current shedding step. */
+static unsigned int __shed_max = 0;             /**< Highest shedding step. */
+static unsigned int __shed_changes = 0;         /**< Shedding step changes. */
+static u_int64_t __packets = 0;                 /**< Packets seen. */
+static u_int64_t __updates = 0;                 /**< Calls to sampling_update. */
+static double __last_check = 0;                 /**< Last load check. */
+static double __last_change = 0;                /**< Last shedding change. */
+static double __calm_since = 0;                 /**< Start of the calm. */
+static unsigned int __last_drops = 0;           /**< Last kernel drops count. */
+
+/**
+ * \brief Convert a timeval into seconds.
+ * \param tv Time.
+ * \return Seconds.
+ */
+static inline double __sampling_seconds (const struct timeval * tv);
+
+/**
+ * \brief Change the shedding step.
+ * \param step New shedding step.
+ * \param now Current time.
+ */
+static inline void __sampling_shed (unsigned int step, double now);
+
+////////////////////////////////////////////////////////////////////////////////
+// Sampling.
+////////////////////////////////////////////////////////////////////////////////
+
+void sampling_set (sampling_mode mode, unsigned int rate)
+{
+    __mode = rate > 1 ? mode : SAMPLING_NONE;
+    __rate = rate > 1 ? rate : 1;
+}
+
+void sampling_set_adaptive (bool adaptive)
+{
+    __adaptive = adaptive;
+}
+
+bool sampling_enabled (void)
+{
+    return __mode != SAMPLING_NONE || __adaptive;
+}
+
+bool sampling_accept (const packet_info * const info)
+{
+    unsigned int rate = sampling_rate ();
+    u_int64_t index = __packets++;
+
+    if (rate <= 1)
+        return true;
+
+    if (__mode == SAMPLING_FLOWS)
+    {
+        /* h % 2N == 0 implies h % N == 0: doubling the rate keeps a subset of
+         * the flows, so no flow is picked up halfway. */
+        packet_flow flow = info->flow;
+        packet_flow_canonical (& flow);
+        return packet_flow_hash (& flow) % rate == 0;
+    }
+
+    return index % rate == 0;
+}
+
+unsigned int sampling_rate (void)
+{
+    unsigned int rate = __rate;
+
+    for (unsigned int step = SAMPLING_LEVEL_STEPS; step < __shed
+            && rate < SAMPLING_RATE_MAX; ++step)
+        rate *= 2;
+
+    return rate;
+}
+
+callback_level sampling_level (callback_level level)
+{
+    if (__shed >= 2)
+        return CALLBACK_STATS;
+    else if (__shed == 1 && level != CALLBACK_STATS)
+        return CALLBACK_CONCISE;
+    else
+        return level;
+}
+
+void sampling_update (pcap_t * const capture,
+        const struct pcap_pkthdr * const header)
+{
+    if (! __adaptive || (++__updates % SAMPLING_UPDATE_PERIOD))
+        return;
+
+    struct timeval tv;
+    gettimeofday (& tv, NULL);
+    double now = __sampling_seconds (& tv);
+
+    if (now - __last_check < SAMPLING_CHECK_INTERVAL)
+        return;
+    __last_check = now;
+
+    /* The age of the packet being processed tells how far behind the
+     * kernel buffer we are. */
+    double lag = now - __sampling_seconds (& header->ts);
+
+    unsigned int drops = 0;
+    struct pcap_stat capture_stats;
+    if (pcap_stats (capture, & capture_stats) == 0)
+    {
+        drops = capture_stats.ps_drop - __last_drops;
+        __last_drops = capture_stats.ps_drop;
+    }
+
+    if (lag > SAMPLING_LAG_HIGH || drops > 0)
+    {
+        __calm_since = now;
+        if (now - __last_change >= SAMPLING_HOLD
+                && sampling_rate () < SAMPLING_RATE_MAX)
+            __sampling_shed (__shed + 1, now);
+    }
+    else if (lag < SAMPLING_LAG_LOW)
+    {
+        if (__shed > 0 && now - __calm_since >= SAMPLING_RECOVERY)
+        {
+            __sampling_shed (__shed - 1, now);
+            __calm_since = now;
+        }
+    }
+    else
+        __calm_since = now;
+}
+
+void sampling_print (FILE * const stream)
+{
+    static const char * mode_strings[] =
+    {
+        [SAMPLING_NONE]     = "None",
+        [SAMPLING_PACKETS]  = "Packets",
+        [SAMPLING_FLOWS]    = "Flows",
+    };
+
+    fprintf (stream, "Sampling\n========\n");
+    fprintf (stream, "%-24s\t%s\n", "Mode:", mode_strings[__mode]);
+    fprintf (stream, "%-24s\t1/%u\n", "Requested rate:", __rate);
+    fprintf (stream, "%-24s\t1/%u\n", "Current rate:", sampling_rate ());
+    fprintf (stream, "%-24s\t%s\n", "Adaptive:", __adaptive ? "Yes" : "No");
+    if (__adaptive)
+    {
+        fprintf (stream, "%-24s\t%u\n", "Shedding step:", __shed);
+        fprintf (stream, "%-24s\t%u\n", "Highest shedding step:", __shed_max);
+        fprintf (stream, "%-24s\t%u\n", "Shedding changes:", __shed_changes);
+    }
+    fprintf (stream, "\n");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+double __sampling_seconds (const struct timeval * const tv)
+{
+    return (double) tv->tv_sec + (double) tv->tv_usec / 1e6;
+}
+
+void __sampling_shed (unsigned int step, double now)
+{
+    /* Flow sampling is kept when shedding, packet sampling is used
+     * otherwise. */
+    if (__mode == SAMPLING_NONE && step > SAMPLING_LEVEL_STEPS)
+        __mode = SAMPLING_PACKETS;
+
+    __shed = step;
+    __last_change = now;
+    ++__shed_changes;
+    if (step > __shed_max)
+        __shed_max = step;
+
+    fprintf (stderr, "wiredolphin: load shedding step %u, sampling 1/%u\n",
+            __shed, sampling_rate ());
+}
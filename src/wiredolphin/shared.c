@@ -0,0 +1,305 @@
+/**
+ * \file shared.c
+ * \brief Live statistics in shared memory.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "wiredolphin/shared.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define SHARED_CHECK        64      /**< Packets between clock readings. */
+#define SHARED_PATH_MAX     256     /**< Object name length. */
+#define SHARED_RETRIES      10000   /**< Reads before giving up. */
+
+const u_int64_t shared_latency_bounds[SHARED_LATENCY_BOUNDS] =
+{
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000,
+    1000000,
+};
+
+static const char * __name = NULL;          /**< Segment name. */
+static char __path[SHARED_PATH_MAX];        /**< Object name ("/<name>"). */
+static shared_segment * __segment = NULL;   /**< Mapped segment. */
+static unsigned int __packets = 0;          /**< Packets since the check. */
+static time_t __last_ts = 0;                /**< Packet time of the check. */
+static u_int64_t __next = 0;                /**< Next update (ns). */
+
+/**
+ * \brief Get the object name of a segment.
+ * \param name Segment name.
+ * \param path Object name.
+ * \retval true On success.
+ * \retval false If the name is too long.
+ */
+static inline bool __shared_path (const char * name,
+        char path[SHARED_PATH_MAX]);
+
+/**
+ * \brief Create and map the named segment.
+ * \return Mapping, or MAP_FAILED on error (a message is printed).
+ */
+static void * __shared_create (void);
+
+/**
+ * \brief Read a clock.
+ * \param clock Clock.
+ * \return Nanoseconds.
+ */
+static inline u_int64_t __shared_clock (clockid_t clock);
+
+////////////////////////////////////////////////////////////////////////////////
+// Publishing.
+////////////////////////////////////////////////////////////////////////////////
+
+void shared_set_name (const char * const name)
+{
+    __name = name;
+}
+
+bool shared_enabled (void)
+{
+    return __name != NULL;
+}
+
+bool shared_open (bool local)
+{
+    if (! shared_enabled () && ! local)
+        return true;
+
+    void * map = shared_enabled () ? __shared_create ()
+        : mmap (NULL, sizeof (shared_segment), PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        return false;
+
+    /* The magic number comes last: readers only trust a complete header. */
+    __segment = map;
+    __segment->version = SHARED_VERSION;
+    __segment->size = sizeof (shared_segment);
+    __segment->pid = (u_int32_t) getpid ();
+    __segment->sequence = 0;
+    __atomic_store_n (& __segment->magic, SHARED_MAGIC, __ATOMIC_RELEASE);
+
+    __packets = 0;
+    __last_ts = 0;
+    __next = 0;
+
+    return true;
+}
+
+const shared_segment * shared_get (void)
+{
+    return __segment;
+}
+
+bool shared_due (const struct timeval * const ts)
+{
+    if (__segment == NULL)
+        return false;
+
+    /* The clock is read every SHARED_CHECK packets, or sooner when the
+     * packets themselves show that time went by (slow traffic). */
+    if (++__packets < SHARED_CHECK && ts->tv_sec == __last_ts)
+        return false;
+    __packets = 0;
+    __last_ts = ts->tv_sec;
+
+    u_int64_t now = __shared_clock (CLOCK_MONOTONIC);
+    if (now < __next)
+        return false;
+    __next = now + SHARED_PERIOD * 1000000ull;
+
+    return true;
+}
+
+void shared_publish (const shared_capture * const capture)
+{
+    if (__segment == NULL)
+        return;
+
+    shared_stats * stats = & __segment->stats;
+    u_int64_t sequence = __segment->sequence;
+
+    /* Single writer: an odd sequence tells the readers to retry. */
+    __atomic_store_n (& __segment->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+
+    stats->time = __shared_clock (CLOCK_REALTIME);
+    memcpy (& stats->counters, stats_get (), sizeof stats->counters);
+    for (unsigned int i = 0; i < STATS_INTERFACES_MAX; ++i)
+    {
+        const char * name = stats_interface (i);
+        strncpy (stats->interfaces[i], name != NULL ? name : "",
+                SHARED_NAME_MAX - 1);
+        stats->interfaces[i][SHARED_NAME_MAX - 1] = '\0';
+    }
+    stats->capture = * capture;
+
+    __atomic_store_n (& __segment->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+void shared_close (void)
+{
+    if (__segment == NULL)
+        return;
+
+    munmap (__segment, sizeof (shared_segment));
+    if (shared_enabled ())
+        shm_unlink (__path);
+    __segment = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reading.
+////////////////////////////////////////////////////////////////////////////////
+
+const shared_segment * shared_attach (const char * const name)
+{
+    char path[SHARED_PATH_MAX];
+    if (! __shared_path (name, path))
+    {
+        fprintf (stderr, "Error: Invalid shared memory name %s.\n", name);
+        return NULL;
+    }
+
+    int fd = shm_open (path, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        fprintf (stderr, "Error: Could not open %s: %s.\n", path,
+                strerror (errno));
+        return NULL;
+    }
+
+    struct stat status;
+    if (fstat (fd, & status) || (size_t) status.st_size
+            < sizeof (shared_segment))
+    {
+        fprintf (stderr, "Error: %s is not a statistics segment.\n", path);
+        close (fd);
+        return NULL;
+    }
+
+    void * map = mmap (NULL, sizeof (shared_segment), PROT_READ, MAP_SHARED,
+            fd, 0);
+    close (fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf (stderr, "Error: Could not map %s: %s.\n", path,
+                strerror (errno));
+        return NULL;
+    }
+
+    const shared_segment * segment = map;
+    if (__atomic_load_n (& segment->magic, __ATOMIC_ACQUIRE) != SHARED_MAGIC
+            || segment->version != SHARED_VERSION
+            || segment->size != sizeof (shared_segment))
+    {
+        fprintf (stderr, "Error: %s: unknown statistics layout.\n", path);
+        shared_detach (segment);
+        return NULL;
+    }
+
+    return segment;
+}
+
+bool shared_read (const shared_segment * const segment,
+        shared_stats * const stats)
+{
+    /* A writer dying halfway leaves the sequence number odd for good. */
+    for (unsigned int i = 0; i < SHARED_RETRIES; ++i)
+    {
+        u_int64_t before = __atomic_load_n (& segment->sequence,
+                __ATOMIC_ACQUIRE);
+        if (before & 1)
+        {
+            /* Update in progress. */
+            sched_yield ();
+            continue;
+        }
+        memcpy (stats, & segment->stats, sizeof * stats);
+        __atomic_thread_fence (__ATOMIC_ACQUIRE);
+        if (__atomic_load_n (& segment->sequence, __ATOMIC_RELAXED) == before)
+            return true;
+    }
+
+    return false;
+}
+
+void shared_detach (const shared_segment * const segment)
+{
+    munmap ((void *) (uintptr_t) segment, sizeof (shared_segment));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+void * __shared_create (void)
+{
+    if (! __shared_path (__name, __path))
+    {
+        fprintf (stderr, "Error: Invalid shared memory name %s.\n", __name);
+        return MAP_FAILED;
+    }
+
+    int fd = shm_open (__path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        fprintf (stderr, "Error: Could not create %s: %s.\n", __path,
+                strerror (errno));
+        return MAP_FAILED;
+    }
+
+    void * map = MAP_FAILED;
+    if (ftruncate (fd, sizeof (shared_segment)) == 0)
+        map = mmap (NULL, sizeof (shared_segment), PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        fprintf (stderr, "Error: Could not map %s: %s.\n", __path,
+                strerror (errno));
+        shm_unlink (__path);
+    }
+    close (fd);
+
+    return map;
+}
+
+bool __shared_path (const char * name, char path[SHARED_PATH_MAX])
+{
+    if (* name == '/')
+        ++name;
+    if (* name == '\0' || strchr (name, '/') != NULL)
+        return false;
+
+    int length = snprintf (path, SHARED_PATH_MAX, "/%s", name);
+    return length > 0 && length < SHARED_PATH_MAX;
+}
+
+u_int64_t __shared_clock (clockid_t clock)
+{
+    struct timespec now;
+    clock_gettime (clock, & now);
+    return (u_int64_t) now.tv_sec * 1000000000u + (u_int64_t) now.tv_nsec;
+}
@@ -0,0 +1,542 @@
+/**
+ * \file sidecar.c
+ * \brief Sidecar index of offline captures.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "wiredolphin/sidecar.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define SIDECAR_MAGIC       "WDX1"          /**< Index file magic. */
+#define SIDECAR_SUFFIX      ".wdx"          /**< Index file suffix. */
+#define SIDECAR_FLOWS       65536           /**< Flows tracked at once. */
+#define SIDECAR_BUFFER      (1024 * 1024)   /**< Read buffer size. */
+#define SIDECAR_NAME_MAX    4096            /**< File name length. */
+
+/**
+ * \brief Index file header.
+ */
+typedef struct __sidecar_header
+{
+    char magic[4];          /**< SIDECAR_MAGIC. */
+    u_int32_t interval;     /**< Packets between two entries. */
+    u_int64_t size;         /**< Capture file size. */
+    u_int64_t mtime;        /**< Capture file modification time. */
+    u_int64_t packets;      /**< Packets in the capture. */
+    u_int64_t entries;      /**< Number of entries. */
+    u_int64_t flows;        /**< Number of flows. */
+} __sidecar_header;
+
+/**
+ * \brief Entry, every interval packets. Times are in microseconds.
+ */
+typedef struct __sidecar_entry
+{
+    u_int64_t offset;       /**< Offset of the packet. */
+    u_int64_t before;       /**< Latest time of the previous packets. */
+    u_int64_t after;        /**< Earliest time of this and the next packets. */
+} __sidecar_entry;
+
+/**
+ * \brief Flow, sorted by flow.
+ */
+typedef struct __sidecar_flow
+{
+    packet_flow flow;       /**< Canonical flow. */
+    u_int64_t first;        /**< First packet number. */
+    u_int64_t last;         /**< Last packet number. */
+    u_int64_t offset;       /**< Offset of the first packet. */
+} __sidecar_flow;
+
+/* Selection. */
+static bool __from_set = false;                     /**< --from given. */
+static u_int64_t __from = 0;                        /**< From (us). */
+static bool __to_set = false;                       /**< --to given. */
+static u_int64_t __to = 0;                          /**< To (us). */
+static bool __flow_set = false;                     /**< --flow given. */
+static packet_flow __flow;                          /**< Canonical flow. */
+static unsigned int __interval = SIDECAR_INTERVAL_DEFAULT;
+
+/* Index. */
+static __sidecar_header __header;                   /**< Header. */
+static __sidecar_entry * __entries = NULL;          /**< Entries. */
+static __sidecar_flow * __flows = NULL;             /**< Flows. */
+static size_t __flows_capacity = 0;                 /**< Allocated flows. */
+
+/* Reading. */
+static bool __active = false;                       /**< Index in use. */
+static bool __filtered = false;                     /**< __program is set. */
+static struct bpf_program __program;                /**< Filter. */
+static u_int64_t __remaining = 0;                   /**< Packets to read. */
+
+/**
+ * \brief Convert a time into microseconds.
+ * \param time Time.
+ * \return Microseconds.
+ */
+static inline u_int64_t __sidecar_time (const struct timeval * time);
+
+/**
+ * \brief Load an index, if it matches the capture file.
+ * \param path Index path.
+ * \param status Capture file status.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+static inline bool __sidecar_load (const char * path,
+        const struct stat * status);
+
+/**
+ * \brief Build the index of a capture file, and save it.
+ * \param file Capture file.
+ * \param path Index path.
+ * \param status Capture file status.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+static inline bool __sidecar_build (const char * file, const char * path,
+        const struct stat * status);
+
+/**
+ * \brief Record a flow leaving the table of the index builder.
+ * \param flow Flow.
+ * \param value Flow record.
+ * \param user Unused.
+ */
+static void __sidecar_release (const packet_flow * flow, void * value,
+        void * user);
+
+/**
+ * \brief Compare two flow records (qsort, bsearch).
+ * \param a Flow record.
+ * \param b Flow record.
+ * \return Order.
+ */
+static int __sidecar_compare (const void * a, const void * b);
+
+/**
+ * \brief Swap the bytes of a 32 bits word.
+ * \param word Word.
+ * \param swapped Whether to swap.
+ * \return Word.
+ */
+static inline u_int32_t __sidecar_swap (u_int32_t word, bool swapped);
+
+////////////////////////////////////////////////////////////////////////////////
+// Sidecar index.
+////////////////////////////////////////////////////////////////////////////////
+
+void sidecar_set_from (const struct timeval * from)
+{
+    __from_set = true;
+    __from = __sidecar_time (from);
+}
+
+void sidecar_set_to (const struct timeval * to)
+{
+    __to_set = true;
+    __to = __sidecar_time (to);
+}
+
+void sidecar_set_flow (const packet_flow * flow)
+{
+    __flow_set = true;
+    __flow = * flow;
+    packet_flow_canonical (& __flow);
+}
+
+void sidecar_set_interval (unsigned int interval)
+{
+    __interval = interval > 0 ? interval : SIDECAR_INTERVAL_DEFAULT;
+}
+
+bool sidecar_enabled (void)
+{
+    return __from_set || __to_set || __flow_set;
+}
+
+bool sidecar_open (pcap_t * const capture, const char * const file,
+        const char * const filter)
+{
+    if (! sidecar_enabled ())
+        return true;
+
+    struct stat status;
+    if (stat (file, & status))
+    {
+        fprintf (stderr, "Error: Could not stat %s: %s.\n", file,
+                strerror (errno));
+        return false;
+    }
+
+    char path[SIDECAR_NAME_MAX];
+    snprintf (path, sizeof path, "%s%s", file, SIDECAR_SUFFIX);
+    if (! __sidecar_load (path, & status)
+            && ! __sidecar_build (file, path, & status))
+        return false;
+
+    /* The filter is applied here, so that every packet is counted. */
+    __filtered = filter != NULL && ! pcap_compile (capture, & __program, filter,
+            1, 0);
+
+    /* Start at the last entry before --from... */
+    size_t low = 0;
+    size_t high = __header.entries;
+    while (__from_set && high - low > 1)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (__entries[middle].before < __from)
+            low = middle;
+        else
+            high = middle;
+    }
+    u_int64_t start = low * __header.interval;
+    u_int64_t offset = __header.entries > 0 ? __entries[low].offset : 0;
+
+    /* ...and stop at the first entry after --to. */
+    u_int64_t stop = __header.packets;
+    for (size_t e = low + 1; __to_set && e < __header.entries; ++e)
+        if (__entries[e].after > __to)
+        {
+            stop = e * __header.interval;
+            break;
+        }
+
+    if (__flow_set)
+    {
+        __sidecar_flow key;
+        key.flow = __flow;
+        const __sidecar_flow * flow = bsearch (& key, __flows, __header.flows,
+                sizeof (__sidecar_flow), __sidecar_compare);
+
+        if (flow == NULL)
+            stop = start;
+        else
+        {
+            if (flow->first > start)
+            {
+                start = flow->first;
+                offset = flow->offset;
+            }
+            if (flow->last + 1 < stop)
+                stop = flow->last + 1;
+        }
+    }
+
+    __remaining = stop > start ? stop - start : 0;
+    if (__remaining > 0 && fseeko (pcap_file (capture), (off_t) offset,
+                SEEK_SET))
+    {
+        fprintf (stderr, "Error: Could not seek in %s.\n", file);
+        sidecar_close ();
+        return false;
+    }
+    __active = true;
+
+    return true;
+}
+
+sidecar_verdict sidecar_accept (const packet_info * const info)
+{
+    if (! __active)
+        return SIDECAR_ACCEPT;
+
+    if (__remaining == 0)
+        return SIDECAR_STOP;
+    --__remaining;
+
+    if (__filtered && ! pcap_offline_filter (& __program, info->header,
+                info->frame))
+        return SIDECAR_SKIP;
+
+    u_int64_t time = __sidecar_time (& info->header->ts);
+    if ((__from_set && time < __from) || (__to_set && time > __to))
+        return SIDECAR_SKIP;
+
+    if (__flow_set)
+    {
+        packet_flow flow = info->flow;
+        packet_flow_canonical (& flow);
+        if (! packet_flow_equal (& flow, & __flow))
+            return SIDECAR_SKIP;
+    }
+
+    return SIDECAR_ACCEPT;
+}
+
+void sidecar_close (void)
+{
+    if (__filtered)
+        pcap_freecode (& __program);
+    free (__entries);
+    free (__flows);
+    __entries = NULL;
+    __flows = NULL;
+    __flows_capacity = 0;
+    __filtered = false;
+    __active = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+u_int64_t __sidecar_time (const struct timeval * const time)
+{
+    return (u_int64_t) time->tv_sec * 1000000 + (u_int64_t) time->tv_usec;
+}
+
+bool __sidecar_load (const char * const path, const struct stat * const status)
+{
+    FILE * stream = fopen (path, "rb");
+    if (stream == NULL)
+        return false;
+
+    bool valid = fread (& __header, sizeof __header, 1, stream) == 1
+        && ! memcmp (__header.magic, SIDECAR_MAGIC, 4)
+        && __header.size == (u_int64_t) status->st_size
+        && __header.mtime == (u_int64_t) status->st_mtime
+        && __header.interval > 0;
+
+    if (valid)
+    {
+        __entries = malloc (__header.entries * sizeof (__sidecar_entry) + 1);
+        __flows = malloc (__header.flows * sizeof (__sidecar_flow) + 1);
+        valid = __entries != NULL && __flows != NULL
+            && fread (__entries, sizeof (__sidecar_entry), __header.entries,
+                    stream) == __header.entries
+            && fread (__flows, sizeof (__sidecar_flow), __header.flows,
+                    stream) == __header.flows;
+    }
+    fclose (stream);
+
+    if (! valid)
+    {
+        free (__entries);
+        free (__flows);
+        __entries = NULL;
+        __flows = NULL;
+    }
+
+    return valid;
+}
+
+bool __sidecar_build (const char * const file, const char * const path,
+        const struct stat * const status)
+{
+    FILE * stream = fopen (file, "rb");
+    if (stream == NULL)
+    {
+        fprintf (stderr, "Error: Could not open %s: %s.\n", file,
+                strerror (errno));
+        return false;
+    }
+    setvbuf (stream, NULL, _IOFBF, SIDECAR_BUFFER);
+
+    struct pcap_file_header file_header;
+    if (fread (& file_header, sizeof file_header, 1, stream) != 1)
+    {
+        fclose (stream);
+        return false;
+    }
+
+    bool swapped = false;
+    bool nano = false;
+    switch (file_header.magic)
+    {
+        case 0xa1b2c3d4: break;
+        case 0xd4c3b2a1: swapped = true; break;
+        case 0xa1b23c4d: nano = true; break;
+        case 0x4d3cb2a1: swapped = nano = true; break;
+        default:
+            fprintf (stderr, "Error: %s: Only pcap files can be indexed.\n",
+                    file);
+            fclose (stream);
+            return false;
+    }
+
+    fprintf (stderr, "Index: building %s\n", path);
+
+    flow_table * table = flow_table_create (SIDECAR_FLOWS,
+            sizeof (__sidecar_flow), __sidecar_release, NULL);
+    size_t entries_capacity = 1024;
+    __entries = malloc (entries_capacity * sizeof (__sidecar_entry));
+    size_t bytes_capacity = 65536;
+    u_char * bytes = malloc (bytes_capacity);
+    if (table == NULL || __entries == NULL || bytes == NULL)
+    {
+        fprintf (stderr, "Error: Could not allocate the index.\n");
+        flow_table_destroy (table);
+        free (bytes);
+        sidecar_close ();
+        fclose (stream);
+        return false;
+    }
+
+    memset (& __header, 0, sizeof __header);
+    memcpy (__header.magic, SIDECAR_MAGIC, 4);
+    __header.interval = __interval;
+    __header.size = (u_int64_t) status->st_size;
+    __header.mtime = (u_int64_t) status->st_mtime;
+    __header.flows = 0;
+
+    u_int64_t offset = sizeof file_header;
+    u_int64_t latest = 0;
+    pcapfile_record record;
+
+    while (fread (& record, sizeof record, 1, stream) == 1)
+    {
+        struct pcap_pkthdr header;
+        header.ts.tv_sec = (time_t) __sidecar_swap (record.seconds, swapped);
+        header.ts.tv_usec = (suseconds_t) (__sidecar_swap (record.microseconds,
+                    swapped) / (nano ? 1000 : 1));
+        header.caplen = __sidecar_swap (record.caplen, swapped);
+        header.len = __sidecar_swap (record.len, swapped);
+
+        if (header.caplen > bytes_capacity)
+        {
+            u_char * larger = realloc (bytes, header.caplen);
+            if (larger == NULL)
+                break;
+            bytes = larger;
+            bytes_capacity = header.caplen;
+        }
+        if (fread (bytes, 1, header.caplen, stream) != header.caplen)
+            break;
+
+        u_int64_t time = __sidecar_time (& header.ts);
+        u_int64_t packet = __header.packets++;
+
+        if (packet % __interval == 0)
+        {
+            if (__header.entries == entries_capacity)
+            {
+                __sidecar_entry * larger = realloc (__entries,
+                        2 * entries_capacity * sizeof (__sidecar_entry));
+                if (larger == NULL)
+                    break;
+                __entries = larger;
+                entries_capacity *= 2;
+            }
+            __entries[__header.entries].offset = offset;
+            __entries[__header.entries].before = latest;
+            __entries[__header.entries].after = time;
+            ++__header.entries;
+        }
+        else if (time < __entries[__header.entries - 1].after)
+            __entries[__header.entries - 1].after = time;
+
+        if (time > latest)
+            latest = time;
+
+        packet_info info;
+        packet_decode (& header, bytes, & info);
+        packet_flow flow = info.flow;
+        packet_flow_canonical (& flow);
+
+        bool created;
+        __sidecar_flow * value = flow_table_lookup (table, & flow, & created);
+        if (created)
+        {
+            value->first = packet;
+            value->offset = offset;
+        }
+        value->last = packet;
+
+        offset += sizeof record + header.caplen;
+    }
+
+    fclose (stream);
+    free (bytes);
+    flow_table_destroy (table);
+
+    /* Earliest time from each entry on. */
+    for (size_t e = __header.entries; e > 1; --e)
+        if (__entries[e - 1].after < __entries[e - 2].after)
+            __entries[e - 2].after = __entries[e - 1].after;
+
+    /* Flows evicted from the table and seen again have several records. */
+    qsort (__flows, __header.flows, sizeof (__sidecar_flow), __sidecar_compare);
+    size_t flows = 0;
+    for (size_t f = 0; f < __header.flows; ++f)
+    {
+        if (flows > 0 && packet_flow_equal (& __flows[flows - 1].flow,
+                    & __flows[f].flow))
+        {
+            if (__flows[f].first < __flows[flows - 1].first)
+            {
+                __flows[flows - 1].first = __flows[f].first;
+                __flows[flows - 1].offset = __flows[f].offset;
+            }
+            if (__flows[f].last > __flows[flows - 1].last)
+                __flows[flows - 1].last = __flows[f].last;
+        }
+        else
+            __flows[flows++] = __flows[f];
+    }
+    __header.flows = flows;
+
+    /* Without a saved index, the next run builds it again. */
+    FILE * output = fopen (path, "wb");
+    if (output == NULL
+            || fwrite (& __header, sizeof __header, 1, output) != 1
+            || fwrite (__entries, sizeof (__sidecar_entry), __header.entries,
+                output) != __header.entries
+            || fwrite (__flows, sizeof (__sidecar_flow), __header.flows,
+                output) != __header.flows)
+        fprintf (stderr, "Warning: Could not save %s.\n", path);
+    if (output != NULL)
+        fclose (output);
+
+    return true;
+}
+
+void __sidecar_release (const packet_flow * const flow, void * const value,
+        void * const user)
+{
+    (void) user;
+    __sidecar_flow * record = value;
+
+    if (__header.flows == __flows_capacity)
+    {
+        size_t capacity = __flows_capacity ? __flows_capacity * 2 : 1024;
+        __sidecar_flow * larger = realloc (__flows,
+                capacity * sizeof (__sidecar_flow));
+        if (larger == NULL)
+            return;
+        __flows = larger;
+        __flows_capacity = capacity;
+    }
+
+    record->flow = * flow;
+    __flows[__header.flows++] = * record;
+}
+
+int __sidecar_compare (const void * const a, const void * const b)
+{
+    const __sidecar_flow * flow_a = a;
+    const __sidecar_flow * flow_b = b;
+
+    return memcmp (& flow_a->flow, & flow_b->flow, sizeof (packet_flow));
+}
+
+u_int32_t __sidecar_swap (u_int32_t word, bool swapped)
+{
+    return swapped ? __builtin_bswap32 (word) : word;
+}
@@ -0,0 +1,302 @@
+/**
+ * \file split.c
+ * \brief Split-by-flow pcap writer.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "wiredolphin/split.h"
+#include "wiredolphin/probes.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define SPLIT_BATCH         (16 * 1024)     /**< Batch size per file. */
+#define SPLIT_RESERVED_FDS  32              /**< Descriptors left to others. */
+#define SPLIT_NAME_MAX      4096            /**< File name length. */
+
+/**
+ * \brief Open file.
+ */
+typedef struct __split_file
+{
+    int fd;                         /**< Descriptor (-1: could not open). */
+    size_t length;                  /**< Batched bytes. */
+    u_char batch[SPLIT_BATCH];      /**< Batched records. */
+} __split_file;
+
+static const char * __directory = NULL;             /**< Directory. */
+static unsigned int __files = SPLIT_FILES_DEFAULT;  /**< Open files. */
+static flow_table * __table = NULL;                 /**< Open files. */
+static struct pcap_file_header __header;            /**< File header. */
+static u_int64_t __opened = 0;                      /**< Files opened. */
+static u_int64_t __writes = 0;                      /**< write (2) calls. */
+static u_int64_t __errors = 0;                      /**< Packets not written. */
+
+/**
+ * \brief Flush and close a file leaving the table.
+ * \param flow Flow.
+ * \param value File.
+ * \param user Unused.
+ */
+static void __split_release (const packet_flow * flow, void * value,
+        void * user);
+
+/**
+ * \brief Check that the directory is empty.
+ * \retval true If it is.
+ * \retval false otherwise, or if it cannot be read.
+ */
+static inline bool __split_directory_empty (void);
+
+/**
+ * \brief Open (or reopen) the file of a flow.
+ * \param flow Canonical flow.
+ * \param file File.
+ */
+static inline void __split_file_open (const packet_flow * flow,
+        __split_file * file);
+
+/**
+ * \brief Write the batch of a file.
+ * \param file File.
+ */
+static inline void __split_file_flush (__split_file * file);
+
+/**
+ * \brief Write bytes to a file.
+ * \param file File.
+ * \param bytes Bytes.
+ * \param length Number of bytes.
+ */
+static inline void __split_file_write (__split_file * file,
+        const void * bytes, size_t length);
+
+/**
+ * \brief Build the file name of a flow.
+ * \param flow Canonical flow.
+ * \param buffer Buffer.
+ * \param size Buffer size.
+ */
+static inline void __split_file_name (const packet_flow * flow, char * buffer,
+        size_t size);
+
+////////////////////////////////////////////////////////////////////////////////
+// Split-by-flow writer.
+////////////////////////////////////////////////////////////////////////////////
+
+void split_set_directory (const char * directory)
+{
+    __directory = directory;
+}
+
+void split_set_files (unsigned int files)
+{
+    __files = files > 0 ? files : SPLIT_FILES_DEFAULT;
+}
+
+bool split_enabled (void)
+{
+    return __directory != NULL;
+}
+
+bool split_open (pcap_t * const capture)
+{
+    if (! split_enabled ())
+        return true;
+
+    if (mkdir (__directory, 0755) && errno != EEXIST)
+    {
+        fprintf (stderr, "Error: Could not create %s: %s.\n", __directory,
+                strerror (errno));
+        return false;
+    }
+
+    /* Reopened files are appended to: they must all be from this capture. */
+    if (! __split_directory_empty ())
+    {
+        fprintf (stderr, "Error: %s is not empty.\n", __directory);
+        return false;
+    }
+
+    /* Stay under the descriptor limit. */
+    struct rlimit limit;
+    unsigned int files = __files;
+    if (! getrlimit (RLIMIT_NOFILE, & limit) && limit.rlim_cur != RLIM_INFINITY
+            && limit.rlim_cur < (rlim_t) files + SPLIT_RESERVED_FDS * 2)
+        files = (unsigned int) (limit.rlim_cur > SPLIT_RESERVED_FDS * 2 ?
+                limit.rlim_cur - SPLIT_RESERVED_FDS : limit.rlim_cur / 2);
+
+    __table = flow_table_create (files, sizeof (__split_file), __split_release,
+            NULL);
+    if (__table == NULL)
+    {
+        fprintf (stderr, "Error: Could not allocate the flow table.\n");
+        return false;
+    }
+
+    pcapfile_header (capture, & __header);
+    __opened = __writes = __errors = 0;
+
+    return true;
+}
+
+void split_packet (const packet_info * const info)
+{
+    if (__table == NULL)
+        return;
+
+    packet_flow flow = info->flow;
+    packet_flow_canonical (& flow);
+
+    bool created;
+    __split_file * file = flow_table_lookup (__table, & flow, & created);
+    if (created)
+        __split_file_open (& flow, file);
+
+    if (file->fd < 0)
+    {
+        ++__errors;
+        return;
+    }
+
+    pcapfile_record record;
+    pcapfile_record_header (info->header, & record);
+    __split_file_write (file, & record, sizeof record);
+    __split_file_write (file, info->frame, info->header->caplen);
+}
+
+void split_close (void)
+{
+    if (__table == NULL)
+        return;
+
+    flow_table_destroy (__table);
+    __table = NULL;
+
+    fprintf (stderr, "Split: %" PRIu64 " files opened, %" PRIu64 " writes, "
+            "%" PRIu64 " packets not written\n", __opened, __writes, __errors);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+void __split_release (const packet_flow * const flow, void * const value,
+        void * const user)
+{
+    (void) flow;
+    (void) user;
+    __split_file * file = value;
+
+    if (file->fd < 0)
+        return;
+
+    __split_file_flush (file);
+    close (file->fd);
+}
+
+bool __split_directory_empty (void)
+{
+    DIR * directory = opendir (__directory);
+    if (directory == NULL)
+        return false;
+
+    struct dirent * entry;
+    bool empty = true;
+    while (empty && (entry = readdir (directory)) != NULL)
+        empty = ! strcmp (entry->d_name, ".") || ! strcmp (entry->d_name, "..");
+
+    closedir (directory);
+    return empty;
+}
+
+void __split_file_open (const packet_flow * const flow,
+        __split_file * const file)
+{
+    char name[SPLIT_NAME_MAX];
+    __split_file_name (flow, name, sizeof name);
+
+    file->length = 0;
+    file->fd = open (name, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (file->fd < 0)
+    {
+        fprintf (stderr, "Error: Could not open %s: %s.\n", name,
+                strerror (errno));
+        return;
+    }
+    ++__opened;
+
+    /* A file reopened after making room already has its header. */
+    struct stat status;
+    if (! fstat (file->fd, & status) && status.st_size == 0)
+        __split_file_write (file, & __header, sizeof __header);
+}
+
+void __split_file_flush (__split_file * const file)
+{
+    const u_char * bytes = file->batch;
+    size_t length = file->length;
+
+    while (length > 0)
+    {
+        ssize_t written = write (file->fd, bytes, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            fprintf (stderr, "Error: Could not write: %s.\n", strerror (errno));
+            break;
+        }
+        bytes += written;
+        length -= (size_t) written;
+    }
+
+    ++__writes;
+    PROBE2 (split__flush, file->fd, file->length);
+    file->length = 0;
+}
+
+void __split_file_write (__split_file * const file, const void * const bytes,
+        size_t length)
+{
+    const u_char * source = bytes;
+
+    while (length > 0)
+    {
+        size_t space = SPLIT_BATCH - file->length;
+        size_t chunk = length < space ? length : space;
+        memcpy (file->batch + file->length, source, chunk);
+        file->length += chunk;
+        source += chunk;
+        length -= chunk;
+
+        if (file->length == SPLIT_BATCH)
+            __split_file_flush (file);
+    }
+}
+
+void __split_file_name (const packet_flow * const flow, char * const buffer,
+        size_t size)
+{
+    char name[256];
+    packet_flow_name (flow, name, sizeof name);
+    snprintf (buffer, size, "%s/%s.pcap", __directory, name);
+}
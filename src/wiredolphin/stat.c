@@ -0,0 +1,247 @@
+/**
+ * \file stat.c
+ * \brief wiredolphin-stat: print the live statistics of a capture.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sysexits.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "wiredolphin/shared.h"
+#include "wiredolphin/version.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * \brief Seconds between two prints (0: print once).
+ */
+static unsigned int __interval = 0;
+
+/**
+ * \brief Segment name.
+ */
+static const char * __name = NULL;
+
+/**
+ * \brief Whether the reader was interrupted.
+ */
+static volatile sig_atomic_t __interrupted = 0;
+
+/**
+ * \brief Parse command line arguments.
+ * \param argc Argument count.
+ * \param argv Argument values.
+ */
+static inline void __parse_args (int argc, char ** argv);
+
+/**
+ * \brief Print the statistics.
+ * \param stats Statistics.
+ * \param previous Previous statistics (or NULL).
+ */
+static void __print (const shared_stats * stats,
+        const shared_stats * previous);
+
+/**
+ * \brief Print the help.
+ */
+static inline void __print_help (void);
+
+/**
+ * \brief Stop watching (signal handler).
+ * \param signal_number Signal number.
+ */
+static void __interrupt (int signal_number);
+
+////////////////////////////////////////////////////////////////////////////////
+// Main.
+////////////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char ** argv)
+{
+    __parse_args (argc, argv);
+
+    const shared_segment * segment = shared_attach (__name);
+    if (segment == NULL)
+        exit (EX_NOINPUT);
+
+    static shared_stats stats;
+    static shared_stats previous;
+    if (! shared_read (segment, & stats))
+    {
+        fprintf (stderr, "Error: The statistics are stale: the capture "
+                "stopped in the middle of an update.\n");
+        shared_detach (segment);
+        exit (EX_UNAVAILABLE);
+    }
+    __print (& stats, NULL);
+
+    signal (SIGINT, __interrupt);
+    signal (SIGTERM, __interrupt);
+    pid_t pid = (pid_t) segment->pid;
+
+    while (__interval && ! __interrupted)
+    {
+        sleep (__interval);
+        if (__interrupted)
+            break;
+
+        /* The segment stays mapped once removed: check the capture is on. */
+        if (kill (pid, 0) && errno == ESRCH)
+        {
+            fprintf (stderr, "The capture ended.\n");
+            break;
+        }
+
+        previous = stats;
+        if (! shared_read (segment, & stats))
+        {
+            fprintf (stderr, "Error: The statistics are stale: the capture "
+                    "stopped in the middle of an update.\n");
+            shared_detach (segment);
+            exit (EX_UNAVAILABLE);
+        }
+        __print (& stats, & previous);
+    }
+
+    shared_detach (segment);
+    exit (EXIT_SUCCESS);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+void __parse_args (int argc, char ** argv)
+{
+    static struct option long_options[] =
+    {
+        { "watch",      required_argument, NULL, 'w', },
+        { "help",       no_argument, NULL, 'h', },
+        { 0, 0, 0, 0, },
+    };
+
+    int val;
+    opterr = 0;
+
+    while ((val = getopt_long (argc, argv, ":w:h", long_options, NULL)) != -1)
+    {
+        switch (val)
+        {
+            case 'w':
+                if (sscanf (optarg, "%u", & __interval) != 1 || ! __interval)
+                {
+                    fprintf (stderr, "Error: \"%s\" is not a valid number.\n",
+                            optarg);
+                    exit (EX_USAGE);
+                }
+                break;
+            case 'h':
+                __print_help ();
+                exit (EXIT_SUCCESS);
+                break;
+            case ':':
+                fprintf (stderr, "Error: missing argument for \"%s\".\n",
+                        argv[optind-1]);
+                exit (EX_USAGE);
+            case '?':
+                fprintf (stderr, "Error: Unknown option \"%s\".\n",
+                        argv[optind-1]);
+                exit (EX_USAGE);
+            default:
+                break;
+        }
+    }
+
+    if (optind != argc - 1)
+    {
+        fprintf (stderr, "Usage: %s [-w <seconds>] <name>\n", * argv);
+        exit (EX_USAGE);
+    }
+    __name = argv[optind];
+}
+
+void __print (const shared_stats * const stats,
+        const shared_stats * const previous)
+{
+    char date[32] = "-";
+    time_t seconds = (time_t) (stats->time / 1000000000u);
+    struct tm local;
+    if (stats->time && localtime_r (& seconds, & local) != NULL)
+        strftime (date, sizeof date, "%Y-%m-%d %H:%M:%S", & local);
+
+    for (unsigned int i = 0; i < STATS_INTERFACES_MAX; ++i)
+        stats_set_interface (i, stats->interfaces[i][0] != '\0'
+                ? stats->interfaces[i] : NULL);
+
+    printf ("%-24s\t%s\n", "Updated:", date);
+    if (previous != NULL && stats->time > previous->time)
+    {
+        double elapsed = (double) (stats->time - previous->time) / 1e9;
+        printf ("%-24s\t%.1f packets/s, %.1f bytes/s\n", "Rate:",
+                (double) (stats->counters.received
+                    - previous->counters.received) / elapsed,
+                (double) (stats->counters.received_bytes
+                    - previous->counters.received_bytes) / elapsed);
+    }
+    printf ("\n");
+
+    stats_print_counters (stdout, & stats->counters);
+
+    printf ("Capture\n=======\n");
+    printf ("%-24s\t%" PRIu64 "\n", "Received by the kernel:",
+            stats->capture.kernel_received);
+    printf ("%-24s\t%" PRIu64 "\n", "Dropped by the kernel:",
+            stats->capture.kernel_dropped);
+    printf ("%-24s\t%" PRIu64 "\n", "Dropped by the interface:",
+            stats->capture.interface_dropped);
+    printf ("%-24s\t%" PRIu64 " buffers\n", "Write queue:",
+            stats->capture.writer_queued);
+    printf ("%-24s\t%" PRIu64 "\n", "Dropped by the writer:",
+            stats->capture.writer_dropped);
+    printf ("\n");
+
+    fflush (stdout);
+}
+
+void __print_help (void)
+{
+    fprintf (stderr, "wiredolphin-stat version %u.%u.%u, 2014-2015\n\n",
+        WIREDOLPHIN_VERSION_MAJOR, WIREDOLPHIN_VERSION_MINOR,
+        WIREDOLPHIN_VERSION_PATCH);
+    fprintf (stderr, "Usage: wiredolphin-stat [-w <seconds>] <name>\n\n");
+    fprintf (stderr, "Print the statistics a capture publishes with "
+            "wiredolphin --shm <name>.\n\n");
+
+    fprintf (stderr, "\t-h, --help\n");
+    fprintf (stderr, "\t\tPrint this help.\n");
+
+    fprintf (stderr, "\t-w, --watch <seconds>\n");
+    fprintf (stderr, "\t\tPrint the statistics and the rates every <seconds> "
+            "until the\n\t\tcapture ends.\n");
+}
+
+void __interrupt (int signal_number)
+{
+    (void) signal_number;
+
+    __interrupted = 1;
+}
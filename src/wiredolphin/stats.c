@@ -0,0 +1,194 @@
+/**
+ * \file stats.c
+ * \brief Statistics.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <inttypes.h>
+
+#include "wiredolphin/stats.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * \brief Counters.
+ */
+static stats_counters __counters;
+
+/**
+ * \brief Interface names.
+ */
+static const char * __interfaces[STATS_INTERFACES_MAX];
+
+/**
+ * \brief Get the packet type class of a packet type.
+ * \param packet_type Ethernet packet type.
+ * \return Packet type class.
+ */
+static inline stats_packet_type __stats_packet_type (u_int16_t packet_type);
+
+////////////////////////////////////////////////////////////////////////////////
+// Statistics.
+////////////////////////////////////////////////////////////////////////////////
+
+const char * stats_packet_type_string (stats_packet_type type)
+{
+    static const char * type_strings[] =
+    {
+        [STATS_PACKET_TYPE_IPV4]    = "IPv4",
+        [STATS_PACKET_TYPE_IPV6]    = "IPv6",
+        [STATS_PACKET_TYPE_ARP]     = "ARP",
+        [STATS_PACKET_TYPE_OTHER]   = "Other",
+    };
+
+    return type_strings[type < STATS_PACKET_TYPE_COUNT ?
+        type : STATS_PACKET_TYPE_OTHER];
+}
+
+void stats_set_interface (unsigned int interface, const char * const name)
+{
+    if (interface < STATS_INTERFACES_MAX)
+        __interfaces[interface] = name;
+}
+
+void stats_receive (const packet_info * const info)
+{
+    ++__counters.received;
+    __counters.received_bytes += info->header->len;
+    if (info->malformed)
+        ++__counters.malformed;
+
+    if (info->interface < STATS_INTERFACES_MAX)
+    {
+        ++__counters.interface_packets[info->interface];
+        __counters.interface_bytes[info->interface] += info->header->len;
+    }
+}
+
+void stats_account (const packet_info * const info, unsigned int weight)
+{
+    u_int64_t bytes = (u_int64_t) info->header->len * weight;
+    stats_packet_type type = __stats_packet_type (info->flow.packet_type);
+
+    ++__counters.sampled;
+    __counters.packets += weight;
+    __counters.bytes += bytes;
+
+    __counters.type_packets[type] += weight;
+    __counters.type_bytes[type] += bytes;
+
+    if (info->network != NULL && (type == STATS_PACKET_TYPE_IPV4
+            || type == STATS_PACKET_TYPE_IPV6))
+    {
+        __counters.protocol_packets[info->flow.protocol] += weight;
+        __counters.protocol_bytes[info->flow.protocol] += bytes;
+    }
+
+    if (info->application != PACKET_APP_NONE)
+    {
+        __counters.application_packets[info->application] += weight;
+        __counters.application_bytes[info->application] += bytes;
+    }
+}
+
+const char * stats_interface (unsigned int interface)
+{
+    return interface < STATS_INTERFACES_MAX ? __interfaces[interface] : NULL;
+}
+
+const stats_counters * stats_get (void)
+{
+    return & __counters;
+}
+
+void stats_print (FILE * const stream)
+{
+    stats_print_counters (stream, & __counters);
+}
+
+void stats_print_counters (FILE * const stream,
+        const stats_counters * const counters)
+{
+    fprintf (stream, "Statistics\n==========\n");
+
+    fprintf (stream, "%-24s\t%" PRIu64 " packets, %" PRIu64 " bytes\n",
+            "Received:", counters->received, counters->received_bytes);
+    if (counters->malformed)
+        fprintf (stream, "%-24s\t%" PRIu64 " packets\n", "Malformed:",
+                counters->malformed);
+    fprintf (stream, "%-24s\t%" PRIu64 " packets\n", "Sampled:",
+            counters->sampled);
+    if (counters->sampled)
+        fprintf (stream, "%-24s\t1/%.2f\n", "Effective sampling rate:",
+                (double) counters->received / (double) counters->sampled);
+    fprintf (stream, "%-24s\t%" PRIu64 " packets, %" PRIu64 " bytes\n",
+            "Estimated:", counters->packets, counters->bytes);
+    fprintf (stream, "\n");
+
+    if (__interfaces[0] != NULL)
+    {
+        fprintf (stream, "Interfaces\n----------\n");
+        for (unsigned int i = 0; i < STATS_INTERFACES_MAX; ++i)
+            if (__interfaces[i] != NULL)
+                fprintf (stream, "%-24s\t%" PRIu64 " packets, %" PRIu64
+                        " bytes\n", __interfaces[i],
+                        counters->interface_packets[i],
+                        counters->interface_bytes[i]);
+        fprintf (stream, "\n");
+    }
+
+    fprintf (stream, "Packet types\n------------\n");
+    for (unsigned int i = 0; i < STATS_PACKET_TYPE_COUNT; ++i)
+        if (counters->type_packets[i])
+            fprintf (stream, "%-24s\t%" PRIu64 " packets, %" PRIu64 " bytes\n",
+                    stats_packet_type_string (i), counters->type_packets[i],
+                    counters->type_bytes[i]);
+    fprintf (stream, "\n");
+
+    fprintf (stream, "IP protocols\n------------\n");
+    for (unsigned int i = 0; i < 256; ++i)
+        if (counters->protocol_packets[i])
+            fprintf (stream, "%-24s\t%" PRIu64 " packets, %" PRIu64 " bytes\n",
+                    header_ip_protocol_string ((u_int8_t) i),
+                    counters->protocol_packets[i],
+                    counters->protocol_bytes[i]);
+    fprintf (stream, "\n");
+
+    fprintf (stream, "Applications\n------------\n");
+    for (unsigned int i = PACKET_APP_NONE + 1; i < PACKET_APP_COUNT; ++i)
+        if (counters->application_packets[i])
+            fprintf (stream, "%-24s\t%" PRIu64 " packets, %" PRIu64 " bytes\n",
+                    packet_application_string (i),
+                    counters->application_packets[i],
+                    counters->application_bytes[i]);
+    fprintf (stream, "\n");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+stats_packet_type __stats_packet_type (u_int16_t packet_type)
+{
+    switch (packet_type)
+    {
+        case ETHERTYPE_IP:
+            return STATS_PACKET_TYPE_IPV4;
+        case ETHERTYPE_IPV6:
+            return STATS_PACKET_TYPE_IPV6;
+        case ETHERTYPE_ARP:
+            return STATS_PACKET_TYPE_ARP;
+        default:
+            return STATS_PACKET_TYPE_OTHER;
+    }
+}
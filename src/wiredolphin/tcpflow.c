@@ -0,0 +1,426 @@
+/**
+ * \file tcpflow.c
+ * \brief TCP connection analysis.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "wiredolphin/tcpflow.h"
+#include "wiredolphin/histogram.h"
+#include "wiredolphin/flow.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define TCPFLOW_SEQUENCE    0x01    /**< Next sequence number known. */
+#define TCPFLOW_ACK         0x02    /**< Acknowledgement and window known. */
+#define TCPFLOW_HOLE        0x04    /**< Segments missing before the next. */
+
+/**
+ * \brief Handshake stages.
+ */
+typedef enum __tcpflow_stage
+{
+    __TCPFLOW_NONE = 0,     /**< No SYN seen. */
+    __TCPFLOW_SYN,          /**< SYN seen. */
+    __TCPFLOW_SYNACK,       /**< SYN/ACK seen. */
+    __TCPFLOW_DONE,         /**< ACK of the SYN/ACK seen. */
+} __tcpflow_stage;
+
+/**
+ * \brief State of a direction of a connection.
+ */
+typedef struct __tcpflow_direction
+{
+    u_int64_t highest;      /**< Time of the highest segment (us). */
+    u_int32_t next;         /**< Next expected sequence number. */
+    u_int32_t hole;         /**< First missing sequence number. */
+    u_int32_t ack;          /**< Last acknowledgement number. */
+    u_int16_t window;       /**< Last window. */
+    u_int8_t known;         /**< TCPFLOW_SEQUENCE, _ACK and _HOLE. */
+} __tcpflow_direction;
+
+/**
+ * \brief State of a connection.
+ */
+typedef struct __tcpflow_connection
+{
+    __tcpflow_direction directions[2];  /**< Canonical direction first. */
+    u_int64_t syn;                      /**< Last SYN time (us). */
+    u_int32_t rtt;                      /**< Handshake RTT (us, 0: unknown). */
+    u_int8_t client;                    /**< Direction of the SYN. */
+    u_int8_t service;                   /**< Service. */
+    u_int8_t stage;                     /**< Handshake stage. */
+} __tcpflow_connection;
+
+/**
+ * \brief Service. Counters are indexed by sender: client, then server.
+ */
+typedef struct __tcpflow_service
+{
+    u_int16_t port;                     /**< Server port. */
+    u_int64_t connections;              /**< Connections. */
+    u_int64_t retransmissions[2];       /**< Retransmitted segments. */
+    u_int64_t out_of_order[2];          /**< Out of order segments. */
+    u_int64_t zero_windows[2];          /**< Zero window advertisements. */
+    u_int64_t duplicate_acks[2];        /**< Duplicate ACKs. */
+    histogram handshake;                /**< SYN to ACK (us). */
+    histogram server;                   /**< SYN to SYN/ACK (us). */
+} __tcpflow_service;
+
+static bool __enabled = false;          /**< Analysing. */
+static flow_table * __table = NULL;     /**< Connections. */
+
+/** Services, then the others. */
+static __tcpflow_service __services[TCPFLOW_SERVICES + 1];
+static unsigned int __service_count = 0;    /**< Services in use. */
+
+/**
+ * \brief Find the service of a port, add it if needed.
+ * \param port Server port.
+ * \return Service.
+ */
+static inline u_int8_t __tcpflow_service_find (u_int16_t port);
+
+/**
+ * \brief Get the payload length of a segment, from the IP header.
+ * \param info Decoded packet.
+ * \param tcp TCP header.
+ * \return Length.
+ */
+static inline u_int32_t __tcpflow_payload (const packet_info * info,
+        const struct tcphdr * tcp);
+
+/**
+ * \brief Compare sequence numbers.
+ * \param a Sequence number.
+ * \param b Sequence number.
+ * \retval true If \c a comes before \c b.
+ * \retval false otherwise.
+ */
+static inline bool __tcpflow_before (u_int32_t a, u_int32_t b);
+
+/**
+ * \brief Format the client and server values of a counter.
+ * \param counter Counter.
+ * \param buffer Buffer.
+ * \return buffer.
+ */
+static inline const char * __tcpflow_pair (const u_int64_t counter[2],
+        char buffer[48]);
+
+/**
+ * \brief Order services by decreasing number of connections (qsort).
+ * \param a Service index.
+ * \param b Service index.
+ * \return Comparison.
+ */
+static int __tcpflow_compare (const void * a, const void * b);
+
+////////////////////////////////////////////////////////////////////////////////
+// Analysis.
+////////////////////////////////////////////////////////////////////////////////
+
+void tcpflow_set_enabled (bool enabled)
+{
+    __enabled = enabled;
+}
+
+bool tcpflow_enabled (void)
+{
+    return __enabled;
+}
+
+bool tcpflow_open (void)
+{
+    if (! __enabled)
+        return true;
+
+    __table = flow_table_create (TCPFLOW_FLOWS,
+            sizeof (__tcpflow_connection), NULL, NULL);
+    if (__table == NULL)
+    {
+        fprintf (stderr, "Error: Could not allocate the flow table.\n");
+        return false;
+    }
+
+    return true;
+}
+
+void tcpflow_packet (const packet_info * const info)
+{
+    if (__table == NULL || info->transport == NULL
+            || info->flow.protocol != IPPROTO_TCP)
+        return;
+
+    const struct tcphdr * tcp = (const struct tcphdr *) info->transport;
+    u_int8_t flags = tcp->th_flags;
+    u_int8_t handshake = flags & (TH_SYN | TH_ACK);
+    u_int32_t sequence = ntohl (tcp->th_seq);
+    u_int64_t time = (u_int64_t) info->header->ts.tv_sec * 1000000u
+        + (u_int64_t) info->header->ts.tv_usec;
+
+    packet_flow flow = info->flow;
+    u_int8_t direction = packet_flow_canonical (& flow) ? 1 : 0;
+    bool created;
+    __tcpflow_connection * connection = flow_table_lookup (__table, & flow,
+            & created);
+
+    /* A SYN other than a retransmission starts a new connection. */
+    if (! created && handshake == TH_SYN
+            && (connection->stage == __TCPFLOW_NONE
+                || connection->client != direction
+                || connection->directions[direction].next != sequence + 1))
+    {
+        memset (connection, 0, sizeof * connection);
+        created = true;
+    }
+
+    if (created)
+    {
+        u_int16_t port = info->flow.src_port < info->flow.dest_port
+            ? info->flow.src_port : info->flow.dest_port;
+        connection->client = direction;
+        if (handshake == TH_SYN)
+            port = info->flow.dest_port;
+        else if (handshake == (TH_SYN | TH_ACK))
+        {
+            port = info->flow.src_port;
+            connection->client = ! direction;
+        }
+        connection->service = __tcpflow_service_find (port);
+        ++__services[connection->service].connections;
+    }
+
+    __tcpflow_service * service = & __services[connection->service];
+    u_int64_t elapsed = time > connection->syn ? time - connection->syn : 0;
+    if (handshake == TH_SYN)
+    {
+        connection->stage = __TCPFLOW_SYN;
+        connection->syn = time;
+    }
+    else if (handshake == (TH_SYN | TH_ACK) && direction != connection->client
+            && connection->stage == __TCPFLOW_SYN)
+    {
+        connection->stage = __TCPFLOW_SYNACK;
+        histogram_record (& service->server, elapsed);
+    }
+    else if (handshake == TH_ACK && direction == connection->client
+            && connection->stage == __TCPFLOW_SYNACK)
+    {
+        connection->stage = __TCPFLOW_DONE;
+        connection->rtt = elapsed < UINT32_MAX ? (u_int32_t) elapsed
+            : UINT32_MAX;
+        histogram_record (& service->handshake, elapsed);
+    }
+
+    /* Counters are indexed by sender: client, then server. */
+    unsigned int sender = direction == connection->client ? 0 : 1;
+    __tcpflow_direction * from = & connection->directions[direction];
+    const __tcpflow_direction * to = & connection->directions[! direction];
+    u_int32_t payload = __tcpflow_payload (info, tcp);
+    u_int32_t length = payload + (flags & TH_SYN ? 1 : 0)
+        + (flags & TH_FIN ? 1 : 0);
+    u_int32_t end = sequence + length;
+
+    if (length > 0 && ! (flags & TH_RST))
+    {
+        if (! (from->known & TCPFLOW_SEQUENCE)
+                || ! __tcpflow_before (sequence, from->next))
+        {
+            /* In order, or after segments not seen (yet). */
+            if ((from->known & TCPFLOW_SEQUENCE) && sequence != from->next
+                    && ! (from->known & TCPFLOW_HOLE))
+            {
+                from->hole = from->next;
+                from->known |= TCPFLOW_HOLE;
+            }
+            from->next = end;
+            from->highest = time;
+            from->known |= TCPFLOW_SEQUENCE;
+        }
+        /* Keep-alives resend the byte before the next one (a resent SYN or
+         * FIN has the same length, but is a retransmission). */
+        else if ((flags & (TH_SYN | TH_FIN)) || length != 1
+                || sequence + 1 != from->next)
+        {
+            /* Only the segments of a hole can be late rather than resent. */
+            u_int64_t window = connection->rtt ? connection->rtt
+                : TCPFLOW_REORDER;
+            if ((from->known & TCPFLOW_HOLE)
+                    && ! __tcpflow_before (sequence, from->hole)
+                    && time < from->highest + window)
+                ++service->out_of_order[sender];
+            else
+                ++service->retransmissions[sender];
+
+            if ((from->known & TCPFLOW_HOLE) && sequence == from->hole)
+                from->hole = end;
+            if ((from->known & TCPFLOW_HOLE)
+                    && ! __tcpflow_before (from->hole, from->next))
+                from->known &= (u_int8_t) ~ TCPFLOW_HOLE;
+            if (__tcpflow_before (from->next, end))
+                from->next = end;
+        }
+    }
+
+    if (flags & TH_ACK)
+    {
+        u_int32_t ack = ntohl (tcp->th_ack);
+        u_int16_t window = ntohs (tcp->th_win);
+
+        /* Same ACK and window while data is outstanding. */
+        if ((from->known & TCPFLOW_ACK) && payload == 0
+                && ! (flags & (TH_SYN | TH_FIN | TH_RST))
+                && ack == from->ack && window == from->window
+                && (to->known & TCPFLOW_SEQUENCE)
+                && __tcpflow_before (ack, to->next))
+            ++service->duplicate_acks[sender];
+
+        if (window == 0 && ! (flags & TH_RST)
+                && (! (from->known & TCPFLOW_ACK) || from->window != 0))
+            ++service->zero_windows[sender];
+
+        from->ack = ack;
+        from->window = window;
+        from->known |= TCPFLOW_ACK;
+    }
+
+    if (flags & TH_RST)
+        flow_table_remove (__table, connection);
+}
+
+void tcpflow_close (void)
+{
+    flow_table_destroy (__table);
+    __table = NULL;
+}
+
+void tcpflow_print (FILE * const stream)
+{
+    unsigned int order[TCPFLOW_SERVICES + 1];
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < __service_count; ++i)
+        order[count++] = i;
+    qsort (order, count, sizeof * order, __tcpflow_compare);
+    if (__services[TCPFLOW_SERVICES].connections)
+        order[count++] = TCPFLOW_SERVICES;
+
+    char name[24];
+    fprintf (stream, "TCP handshakes (us)\n-------------------\n");
+    fprintf (stream, "%-24s\t%11s %10s %10s %10s %10s %10s %10s\n", "",
+            "connections", "handshakes", "rtt p50", "rtt p90", "rtt p99",
+            "server p50", "server p99");
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        const __tcpflow_service * service = & __services[order[i]];
+        if (order[i] == TCPFLOW_SERVICES)
+            snprintf (name, sizeof name, "Other");
+        else
+            snprintf (name, sizeof name, "Port %u", service->port);
+
+        fprintf (stream, "%-24s\t%11" PRIu64 " %10" PRIu64 " %10" PRIu64
+                " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n",
+                name, service->connections, service->handshake.count,
+                histogram_percentile (& service->handshake, 0.5),
+                histogram_percentile (& service->handshake, 0.9),
+                histogram_percentile (& service->handshake, 0.99),
+                histogram_percentile (& service->server, 0.5),
+                histogram_percentile (& service->server, 0.99));
+    }
+    fprintf (stream, "\n");
+
+    fprintf (stream, "TCP anomalies (client / server)\n"
+            "-------------------------------\n");
+    fprintf (stream, "%-24s\t%17s %17s %17s %17s\n", "", "retransmissions",
+            "out of order", "zero windows", "duplicate ACKs");
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        const __tcpflow_service * service = & __services[order[i]];
+        if (order[i] == TCPFLOW_SERVICES)
+            snprintf (name, sizeof name, "Other");
+        else
+            snprintf (name, sizeof name, "Port %u", service->port);
+
+        char pairs[4][48];
+        fprintf (stream, "%-24s\t%17s %17s %17s %17s\n", name,
+                __tcpflow_pair (service->retransmissions, pairs[0]),
+                __tcpflow_pair (service->out_of_order, pairs[1]),
+                __tcpflow_pair (service->zero_windows, pairs[2]),
+                __tcpflow_pair (service->duplicate_acks, pairs[3]));
+    }
+    fprintf (stream, "\n");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+u_int8_t __tcpflow_service_find (u_int16_t port)
+{
+    for (unsigned int i = 0; i < __service_count; ++i)
+        if (__services[i].port == port)
+            return (u_int8_t) i;
+
+    if (__service_count == TCPFLOW_SERVICES)
+        return TCPFLOW_SERVICES;
+
+    __services[__service_count].port = port;
+    return (u_int8_t) __service_count++;
+}
+
+u_int32_t __tcpflow_payload (const packet_info * const info,
+        const struct tcphdr * const tcp)
+{
+    size_t headers = (size_t) (info->transport - info->network)
+        + (size_t) tcp->th_off * 4;
+    size_t total;
+
+    if (info->flow.packet_type == ETHERTYPE_IP)
+        total = ntohs (((const struct ip *) info->network)->ip_len);
+    else
+        total = sizeof (struct ip6_hdr)
+            + ntohs (((const struct ip6_hdr *) info->network)->ip6_plen);
+
+    /* Segmentation offload leaves the IP length out: use the frame. */
+    if (total == 0 || (info->flow.packet_type != ETHERTYPE_IP
+                && total == sizeof (struct ip6_hdr)))
+        total = info->header->len
+            - (size_t) (info->network - info->frame);
+
+    return total > headers ? (u_int32_t) (total - headers) : 0;
+}
+
+bool __tcpflow_before (u_int32_t a, u_int32_t b)
+{
+    return (int32_t) (a - b) < 0;
+}
+
+const char * __tcpflow_pair (const u_int64_t counter[2], char buffer[48])
+{
+    snprintf (buffer, 48, "%" PRIu64 " / %" PRIu64, counter[0], counter[1]);
+    return buffer;
+}
+
+int __tcpflow_compare (const void * const a, const void * const b)
+{
+    const __tcpflow_service * service_a =
+        & __services[* (const unsigned int *) a];
+    const __tcpflow_service * service_b =
+        & __services[* (const unsigned int *) b];
+
+    if (service_a->connections != service_b->connections)
+        return service_a->connections > service_b->connections ? -1 : 1;
+    return service_a->port < service_b->port ? -1 : 1;
+}
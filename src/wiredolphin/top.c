@@ -0,0 +1,859 @@
+/**
+ * \file top.c
+ * \brief Live dashboard.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "wiredolphin/top.h"
+#include "wiredolphin/flow.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define TOP_POLL        100     /**< Key and resize check period (ms). */
+#define TOP_WIDTH_MAX   240     /**< Columns drawn. */
+#define TOP_HEIGHT_MAX  100     /**< Rows drawn. */
+#define TOP_OUTPUT      (64 * 1024)     /**< Terminal output buffer. */
+#define TOP_TEXT_MAX    (TOP_WIDTH_MAX + 1) /**< Text line length. */
+#define TOP_MIX         5       /**< Entries per protocol mix line. */
+#define TOP_SPARK       0x2581  /**< Lowest sparkline glyph (8 levels). */
+
+/**
+ * \brief Packets and bytes of a flow or talker.
+ */
+typedef struct __top_counter
+{
+    u_int64_t packets;          /**< Packets. */
+    u_int64_t bytes;            /**< Bytes. */
+} __top_counter;
+
+/**
+ * \brief Ranked flow or talker.
+ */
+typedef struct __top_entry
+{
+    packet_flow flow;           /**< Flow (source address only for talkers). */
+    __top_counter counter;      /**< Counters over the period. */
+} __top_entry;
+
+/**
+ * \brief Ranking of a period.
+ */
+typedef struct __top_ranking
+{
+    u_int64_t period;                       /**< Period length (ns). */
+    u_int64_t flows;                        /**< Active flows. */
+    unsigned int flow_count;                /**< Flows ranked. */
+    unsigned int talker_count;              /**< Talkers ranked. */
+    __top_entry top_flows[TOP_ROWS];        /**< Busiest flows. */
+    __top_entry top_talkers[TOP_ROWS];      /**< Busiest talkers. */
+} __top_ranking;
+
+/**
+ * \brief Screen cell.
+ */
+typedef struct __top_cell
+{
+    u_int16_t glyph;            /**< Unicode code point. */
+    u_int16_t bold;             /**< Bold attribute. */
+} __top_cell;
+
+/* Settings. */
+static bool __enabled = false;              /**< Dashboard shown. */
+
+/* Capture thread state. */
+static flow_table * __flows = NULL;         /**< Flows of the period. */
+static flow_table * __talkers = NULL;       /**< Talkers of the period. */
+static u_int64_t __period_start = 0;        /**< Period start (ns). */
+
+/* Shared state. */
+static __top_ranking __published;           /**< Last ranking. */
+static u_int64_t __sequence = 0;            /**< Odd while ranking. */
+static bool __quit = false;                 /**< Stop the thread (atomic). */
+
+/* Dashboard thread state. */
+static bool __running = false;              /**< Thread started. */
+static pthread_t __worker;                  /**< Dashboard thread. */
+static const shared_segment * __segment = NULL;     /**< Statistics. */
+static int __terminal = -1;                 /**< Terminal. */
+static struct termios __saved;              /**< Terminal settings. */
+static shared_stats __stats;                /**< Current statistics. */
+static shared_stats __previous;             /**< Previous statistics. */
+static __top_ranking __ranking;             /**< Current ranking. */
+static double __packet_rates[TOP_WIDTH_MAX];    /**< Packet rate history. */
+static double __bit_rates[TOP_WIDTH_MAX];       /**< Bit rate history. */
+static unsigned int __history = 0;          /**< Samples in the history. */
+static unsigned int __width = 0;            /**< Terminal columns. */
+static unsigned int __height = 0;           /**< Terminal rows. */
+static __top_cell __shown[TOP_HEIGHT_MAX][TOP_WIDTH_MAX];   /**< On screen. */
+static __top_cell __next[TOP_HEIGHT_MAX][TOP_WIDTH_MAX];    /**< To show. */
+static char __output[TOP_OUTPUT];           /**< Terminal output. */
+static size_t __output_length = 0;          /**< Bytes in __output. */
+
+/**
+ * \brief Read the monotonic clock.
+ * \return Nanoseconds.
+ */
+static inline u_int64_t __top_clock (void);
+
+/**
+ * \brief Rank the values of a table by bytes, then empty it (capture thread).
+ * \param table Flow table.
+ * \param entries Busiest values.
+ * \return Number of entries.
+ */
+static inline unsigned int __top_rank (flow_table * table,
+        __top_entry entries[TOP_ROWS]);
+
+/**
+ * \brief Read a consistent copy of the ranking.
+ * \param ranking Copy.
+ */
+static inline void __top_read (__top_ranking * ranking);
+
+/**
+ * \brief Dashboard thread.
+ * \param user Unused.
+ * \return NULL.
+ */
+static void * __top_run (void * user);
+
+/**
+ * \brief Read the statistics and the ranking, extend the rate history.
+ */
+static inline void __top_sample (void);
+
+/**
+ * \brief Check whether the terminal size changed.
+ * \retval true If it did.
+ * \retval false otherwise.
+ */
+static inline bool __top_resized (void);
+
+/**
+ * \brief Draw a frame and send the changed cells to the terminal.
+ */
+static void __top_draw (void);
+
+/**
+ * \brief Put text into the next frame.
+ * \param row Row.
+ * \param column Column.
+ * \param bold Bold text.
+ * \param text ASCII text.
+ * \return Column following the text.
+ */
+static inline unsigned int __top_text (unsigned int row, unsigned int column,
+        bool bold, const char * text);
+
+/**
+ * \brief Put a sparkline of the latest samples into the next frame.
+ * \param row Row.
+ * \param column First column.
+ * \param samples History.
+ */
+static inline void __top_spark (unsigned int row, unsigned int column,
+        const double * samples);
+
+/**
+ * \brief Put a list of flows or talkers into the next frame.
+ * \param row First row.
+ * \param title Title.
+ * \param entries Entries.
+ * \param count Number of entries.
+ * \param talkers Whether the entries are talkers.
+ * \return Row following the list.
+ */
+static inline unsigned int __top_list (unsigned int row, const char * title,
+        const __top_entry * entries, unsigned int count, bool talkers);
+
+/**
+ * \brief Put the busiest counters of the frame, as shares of the bytes, into
+ * the next frame.
+ * \param row Row.
+ * \param label Label.
+ * \param current Current byte counters.
+ * \param previous Previous byte counters.
+ * \param first First counter.
+ * \param count Number of counters.
+ * \param name Name of a counter.
+ */
+static inline void __top_mix (unsigned int row, const char * label,
+        const u_int64_t * current, const u_int64_t * previous,
+        unsigned int first, unsigned int count,
+        const char * (* name) (unsigned int));
+
+/**
+ * \brief Name a packet type class.
+ * \param index Class.
+ * \return Name.
+ */
+static const char * __top_type_name (unsigned int index);
+
+/**
+ * \brief Name an IP protocol.
+ * \param index Protocol.
+ * \return Name.
+ */
+static const char * __top_protocol_name (unsigned int index);
+
+/**
+ * \brief Name an application.
+ * \param index Application.
+ * \return Name.
+ */
+static const char * __top_application_name (unsigned int index);
+
+/**
+ * \brief Describe a flow.
+ * \param flow Canonical flow.
+ * \param buffer Buffer.
+ * \param size Buffer size.
+ */
+static inline void __top_flow (const packet_flow * flow, char * buffer,
+        size_t size);
+
+/**
+ * \brief Format a value with a metric prefix.
+ * \param value Value.
+ * \param buffer Buffer.
+ * \param size Buffer size.
+ * \return buffer.
+ */
+static inline const char * __top_units (double value, char * buffer,
+        size_t size);
+
+/**
+ * \brief Buffer bytes for the terminal.
+ * \param bytes Bytes.
+ * \param length Number of bytes.
+ */
+static inline void __top_emit (const char * bytes, size_t length);
+
+/**
+ * \brief Send the buffered bytes to the terminal.
+ */
+static inline void __top_flush (void);
+
+////////////////////////////////////////////////////////////////////////////////
+// Live dashboard.
+////////////////////////////////////////////////////////////////////////////////
+
+void top_set_enabled (bool enabled)
+{
+    __enabled = enabled;
+}
+
+bool top_enabled (void)
+{
+    return __enabled;
+}
+
+bool top_open (const shared_segment * const segment)
+{
+    if (! __enabled)
+        return true;
+
+    __terminal = open ("/dev/tty", O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (__terminal < 0)
+    {
+        fprintf (stderr, "Error: --top needs a terminal: %s.\n",
+                strerror (errno));
+        return false;
+    }
+
+    __flows = flow_table_create (TOP_FLOWS, sizeof (__top_counter), NULL,
+            NULL);
+    __talkers = flow_table_create (TOP_FLOWS, sizeof (__top_counter), NULL,
+            NULL);
+    if (__flows == NULL || __talkers == NULL)
+    {
+        fprintf (stderr, "Error: Could not allocate the flow tables.\n");
+        flow_table_destroy (__flows);
+        flow_table_destroy (__talkers);
+        __flows = __talkers = NULL;
+        close (__terminal);
+        __terminal = -1;
+        return false;
+    }
+
+    /* Keys are read one at a time; ^C still interrupts. */
+    struct termios settings;
+    tcgetattr (__terminal, & __saved);
+    settings = __saved;
+    settings.c_lflag &= ~ (tcflag_t) (ICANON | ECHO);
+    settings.c_cc[VMIN] = 0;
+    settings.c_cc[VTIME] = 0;
+    tcsetattr (__terminal, TCSANOW, & settings);
+
+    /* Alternate screen, hidden cursor. */
+    static const char enter[] = "\033[?1049h\033[?25l";
+    __output_length = 0;
+    __top_emit (enter, sizeof enter - 1);
+    __top_flush ();
+
+    __segment = segment;
+    memset (& __published, 0, sizeof __published);
+    memset (& __stats, 0, sizeof __stats);
+    __sequence = 0;
+    __history = 0;
+    __width = __height = 0;
+    __period_start = __top_clock ();
+    __quit = false;
+
+    /* Signals are for the capture thread. */
+    sigset_t all, previous;
+    sigfillset (& all);
+    pthread_sigmask (SIG_SETMASK, & all, & previous);
+    __running = ! pthread_create (& __worker, NULL, __top_run, NULL);
+    pthread_sigmask (SIG_SETMASK, & previous, NULL);
+
+    if (! __running)
+    {
+        fprintf (stderr, "Error: Could not start the dashboard thread.\n");
+        top_close ();
+    }
+
+    return __running;
+}
+
+void top_packet (const packet_info * const info)
+{
+    if (__flows == NULL)
+        return;
+
+    /* Both directions of a conversation make one flow. */
+    packet_flow flow = info->flow;
+    packet_flow_canonical (& flow);
+    __top_counter * counter = flow_table_lookup (__flows, & flow, NULL);
+    ++counter->packets;
+    counter->bytes += info->header->len;
+
+    packet_flow talker;
+    memset (& talker, 0, sizeof talker);
+    talker.packet_type = info->flow.packet_type;
+    talker.src_addr = info->flow.src_addr;
+    counter = flow_table_lookup (__talkers, & talker, NULL);
+    ++counter->packets;
+    counter->bytes += info->header->len;
+}
+
+void top_publish (void)
+{
+    if (__flows == NULL)
+        return;
+
+    u_int64_t now = __top_clock ();
+    if (now - __period_start < TOP_PERIOD * 1000000ull)
+        return;
+
+    __top_ranking ranking;
+    ranking.period = now - __period_start;
+    ranking.flows = flow_table_size (__flows);
+    ranking.flow_count = __top_rank (__flows, ranking.top_flows);
+    ranking.talker_count = __top_rank (__talkers, ranking.top_talkers);
+    __period_start = now;
+
+    /* Single writer: an odd sequence tells the reader to retry. */
+    u_int64_t sequence = __sequence;
+    __atomic_store_n (& __sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+    __published = ranking;
+    __atomic_store_n (& __sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+void top_close (void)
+{
+    if (__running)
+    {
+        __atomic_store_n (& __quit, true, __ATOMIC_RELAXED);
+        pthread_join (__worker, NULL);
+        __running = false;
+    }
+
+    if (__terminal < 0)
+        return;
+
+    static const char leave[] = "\033[0m\033[?25h\033[?1049l";
+    __top_emit (leave, sizeof leave - 1);
+    __top_flush ();
+    tcsetattr (__terminal, TCSANOW, & __saved);
+    close (__terminal);
+    __terminal = -1;
+
+    flow_table_destroy (__flows);
+    flow_table_destroy (__talkers);
+    __flows = __talkers = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+u_int64_t __top_clock (void)
+{
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, & now);
+    return (u_int64_t) now.tv_sec * 1000000000u + (u_int64_t) now.tv_nsec;
+}
+
+unsigned int __top_rank (flow_table * const table,
+        __top_entry entries[TOP_ROWS])
+{
+    unsigned int count = 0;
+
+    for (const __top_counter * counter = flow_table_oldest (table);
+            counter != NULL; counter = flow_table_next (table, counter))
+    {
+        if (count == TOP_ROWS
+                && counter->bytes <= entries[TOP_ROWS - 1].counter.bytes)
+            continue;
+
+        /* Insertion into the few busiest. */
+        unsigned int i = count < TOP_ROWS ? count++ : TOP_ROWS - 1;
+        for (; i > 0 && entries[i - 1].counter.bytes < counter->bytes; --i)
+            entries[i] = entries[i - 1];
+        entries[i].flow = * flow_table_flow (counter);
+        entries[i].counter = * counter;
+    }
+
+    flow_table_clear (table);
+    return count;
+}
+
+void __top_read (__top_ranking * const ranking)
+{
+    u_int64_t before;
+    u_int64_t after;
+
+    do
+    {
+        before = __atomic_load_n (& __sequence, __ATOMIC_ACQUIRE);
+        if (before & 1)
+        {
+            /* Update in progress. */
+            after = before + 1;
+            continue;
+        }
+        memcpy (ranking, & __published, sizeof * ranking);
+        __atomic_thread_fence (__ATOMIC_ACQUIRE);
+        after = __atomic_load_n (& __sequence, __ATOMIC_RELAXED);
+    }
+    while (before != after);
+}
+
+void * __top_run (void * user)
+{
+    (void) user;
+
+    u_int64_t next = 0;
+    while (! __atomic_load_n (& __quit, __ATOMIC_RELAXED))
+    {
+        u_int64_t now = __top_clock ();
+        bool due = now >= next;
+        if (due)
+        {
+            __top_sample ();
+            next = now + TOP_PERIOD * 1000000ull;
+        }
+        if (__top_resized () || due)
+            __top_draw ();
+
+        struct pollfd terminal = { .fd = __terminal, .events = POLLIN, };
+        char key;
+        if (poll (& terminal, 1, TOP_POLL) > 0
+                && read (__terminal, & key, 1) == 1
+                && (key == 'q' || key == 'Q'))
+            kill (getpid (), SIGINT);
+    }
+
+    return NULL;
+}
+
+void __top_sample (void)
+{
+    __previous = __stats;
+    if (! shared_read (__segment, & __stats))
+    {
+        __stats = __previous;
+        return;
+    }
+    __top_read (& __ranking);
+
+    if (__previous.time == 0)
+        return;
+
+    double elapsed = (double) (__stats.time - __previous.time) / 1e9;
+    double packets = 0;
+    double bits = 0;
+    if (elapsed > 0)
+    {
+        packets = (double) (__stats.counters.received
+                - __previous.counters.received) / elapsed;
+        bits = (double) (__stats.counters.received_bytes
+                - __previous.counters.received_bytes) * 8 / elapsed;
+    }
+
+    if (__history == TOP_WIDTH_MAX)
+    {
+        memmove (__packet_rates, __packet_rates + 1,
+                sizeof __packet_rates - sizeof * __packet_rates);
+        memmove (__bit_rates, __bit_rates + 1,
+                sizeof __bit_rates - sizeof * __bit_rates);
+        --__history;
+    }
+    __packet_rates[__history] = packets;
+    __bit_rates[__history] = bits;
+    ++__history;
+}
+
+bool __top_resized (void)
+{
+    struct winsize size;
+    unsigned int width = 80;
+    unsigned int height = 24;
+    if (ioctl (__terminal, TIOCGWINSZ, & size) == 0 && size.ws_col > 0)
+    {
+        width = size.ws_col;
+        height = size.ws_row;
+    }
+    if (width > TOP_WIDTH_MAX)
+        width = TOP_WIDTH_MAX;
+    if (height > TOP_HEIGHT_MAX)
+        height = TOP_HEIGHT_MAX;
+
+    if (width == __width && height == __height)
+        return false;
+
+    /* The screen is cleared: every cell is blank. */
+    static const char clear[] = "\033[0m\033[2J";
+    __top_emit (clear, sizeof clear - 1);
+    for (unsigned int row = 0; row < TOP_HEIGHT_MAX; ++row)
+        for (unsigned int column = 0; column < TOP_WIDTH_MAX; ++column)
+            __shown[row][column] = (__top_cell) { .glyph = ' ', .bold = 0, };
+    __width = width;
+    __height = height;
+
+    return true;
+}
+
+void __top_draw (void)
+{
+    char text[TOP_TEXT_MAX];
+    char units[2][16];
+
+    for (unsigned int row = 0; row < __height; ++row)
+        for (unsigned int column = 0; column < __width; ++column)
+            __next[row][column] = (__top_cell) { .glyph = ' ', .bold = 0, };
+
+    char date[16] = "-";
+    time_t seconds = (time_t) (__stats.time / 1000000000u);
+    struct tm local;
+    if (__stats.time && localtime_r (& seconds, & local) != NULL)
+        strftime (date, sizeof date, "%H:%M:%S", & local);
+    snprintf (text, sizeof text, "wiredolphin  %s  %" PRIu64 " packets, "
+            "%sB  %" PRIu64 " flows  (q: quit)", date,
+            __stats.counters.received,
+            __top_units ((double) __stats.counters.received_bytes, units[0],
+                sizeof units[0]), __ranking.flows);
+    __top_text (0, 0, true, text);
+
+    double packets = __history ? __packet_rates[__history - 1] : 0;
+    double bits = __history ? __bit_rates[__history - 1] : 0;
+    snprintf (text, sizeof text, "Packets/s %8s ",
+            __top_units (packets, units[0], sizeof units[0]));
+    __top_spark (2, __top_text (2, 0, false, text), __packet_rates);
+    snprintf (text, sizeof text, "Bits/s    %8s ",
+            __top_units (bits, units[0], sizeof units[0]));
+    __top_spark (3, __top_text (3, 0, false, text), __bit_rates);
+
+    const shared_capture * capture = & __stats.capture;
+    snprintf (text, sizeof text, "Dropped   %" PRIu64 " by the kernel, %"
+            PRIu64 " by the interface, %" PRIu64 " by the writer",
+            capture->kernel_dropped, capture->interface_dropped,
+            capture->writer_dropped);
+    __top_text (4, 0, false, text);
+    snprintf (text, sizeof text, "Malformed %" PRIu64 "  Write queue %"
+            PRIu64 " buffers", __stats.counters.malformed,
+            capture->writer_queued);
+    __top_text (5, 0, false, text);
+
+    unsigned int row = __top_list (7, "Top flows", __ranking.top_flows,
+            __ranking.flow_count, false);
+    row = __top_list (row + 1, "Top talkers", __ranking.top_talkers,
+            __ranking.talker_count, true);
+
+    __top_text (++row, 0, true, "Protocol mix (bytes)");
+    const stats_counters * current = & __stats.counters;
+    const stats_counters * previous = & __previous.counters;
+    __top_mix (++row, "Types", current->type_bytes, previous->type_bytes, 0,
+            STATS_PACKET_TYPE_COUNT, __top_type_name);
+    __top_mix (++row, "Protocols", current->protocol_bytes,
+            previous->protocol_bytes, 0, 256, __top_protocol_name);
+    __top_mix (++row, "Apps", current->application_bytes,
+            previous->application_bytes, PACKET_APP_NONE + 1,
+            PACKET_APP_COUNT, __top_application_name);
+
+    /* Only the changed cells are sent. */
+    unsigned int cursor_row = __height;
+    unsigned int cursor_column = __width;
+    u_int16_t bold = 0;
+    for (row = 0; row < __height; ++row)
+        for (unsigned int column = 0; column < __width; ++column)
+        {
+            __top_cell cell = __next[row][column];
+            if (cell.glyph == __shown[row][column].glyph
+                    && cell.bold == __shown[row][column].bold)
+                continue;
+
+            if (row != cursor_row || column != cursor_column)
+            {
+                int length = snprintf (text, sizeof text, "\033[%u;%uH",
+                        row + 1, column + 1);
+                __top_emit (text, (size_t) length);
+            }
+            if (cell.bold != bold)
+            {
+                __top_emit (cell.bold ? "\033[1m" : "\033[0m", 4);
+                bold = cell.bold;
+            }
+
+            char bytes[3];
+            size_t length = 1;
+            if (cell.glyph < 0x80)
+                bytes[0] = (char) cell.glyph;
+            else
+            {
+                bytes[0] = (char) (0xe0 | (cell.glyph >> 12));
+                bytes[1] = (char) (0x80 | ((cell.glyph >> 6) & 0x3f));
+                bytes[2] = (char) (0x80 | (cell.glyph & 0x3f));
+                length = 3;
+            }
+            __top_emit (bytes, length);
+
+            __shown[row][column] = cell;
+            cursor_row = row;
+            cursor_column = column + 1;
+        }
+    if (bold)
+        __top_emit ("\033[0m", 4);
+    __top_flush ();
+}
+
+unsigned int __top_text (unsigned int row, unsigned int column, bool bold,
+        const char * text)
+{
+    if (row >= __height)
+        return column;
+
+    for (; * text != '\0' && column < __width; ++text, ++column)
+        __next[row][column] = (__top_cell)
+        {
+            .glyph = (u_int16_t) (unsigned char) * text,
+            .bold = bold,
+        };
+
+    return column;
+}
+
+void __top_spark (unsigned int row, unsigned int column,
+        const double * const samples)
+{
+    if (row >= __height || column >= __width)
+        return;
+
+    unsigned int width = __width - column;
+    unsigned int first = __history > width ? __history - width : 0;
+
+    double maximum = 0;
+    for (unsigned int i = first; i < __history; ++i)
+        if (samples[i] > maximum)
+            maximum = samples[i];
+
+    for (unsigned int i = first; i < __history; ++i, ++column)
+    {
+        unsigned int level = maximum > 0
+            ? (unsigned int) (samples[i] / maximum * 7 + 0.5) : 0;
+        __next[row][column].glyph = (u_int16_t) (TOP_SPARK + level);
+    }
+}
+
+unsigned int __top_list (unsigned int row, const char * title,
+        const __top_entry * const entries, unsigned int count, bool talkers)
+{
+    char text[TOP_TEXT_MAX];
+    char description[TOP_TEXT_MAX];
+    char units[2][16];
+
+    double period = (double) __ranking.period / 1e9;
+    snprintf (text, sizeof text, "%10s %10s  %s", "bits/s", "packets/s",
+            title);
+    __top_text (row++, 0, true, text);
+
+    for (unsigned int i = 0; i < count && period > 0; ++i, ++row)
+    {
+        if (talkers)
+            packet_flow_address (& entries[i].flow, true, description);
+        else
+            __top_flow (& entries[i].flow, description, sizeof description);
+
+        snprintf (text, sizeof text, "%10s %10s  ",
+                __top_units ((double) entries[i].counter.bytes * 8 / period,
+                    units[0], sizeof units[0]),
+                __top_units ((double) entries[i].counter.packets / period,
+                    units[1], sizeof units[1]));
+        __top_text (row, __top_text (row, 0, false, text), false,
+                description);
+    }
+
+    return row;
+}
+
+void __top_mix (unsigned int row, const char * label,
+        const u_int64_t * const current, const u_int64_t * const previous,
+        unsigned int first, unsigned int count,
+        const char * (* name) (unsigned int))
+{
+    char text[TOP_TEXT_MAX];
+    unsigned int shown[TOP_MIX];
+    unsigned int shown_count = 0;
+    u_int64_t total = 0;
+
+    for (unsigned int i = first; i < count; ++i)
+        total += current[i] - previous[i];
+
+    /* Few entries: selection of the busiest, one at a time. */
+    while (shown_count < TOP_MIX)
+    {
+        unsigned int busiest = count;
+        for (unsigned int i = first; i < count; ++i)
+        {
+            bool taken = false;
+            for (unsigned int j = 0; j < shown_count; ++j)
+                taken = taken || shown[j] == i;
+            if (! taken && current[i] > previous[i] && (busiest == count
+                        || current[i] - previous[i]
+                        > current[busiest] - previous[busiest]))
+                busiest = i;
+        }
+        if (busiest == count)
+            break;
+        shown[shown_count++] = busiest;
+    }
+
+    snprintf (text, sizeof text, "%-10s", label);
+    unsigned int column = __top_text (row, 0, false, text);
+    if (shown_count == 0)
+        __top_text (row, column, false, "-");
+
+    for (unsigned int i = 0; i < shown_count; ++i)
+    {
+        unsigned int index = shown[i];
+        snprintf (text, sizeof text, "%s %.1f%%  ", name (index),
+                (double) (current[index] - previous[index]) * 100
+                / (double) total);
+        column = __top_text (row, column, false, text);
+    }
+}
+
+const char * __top_type_name (unsigned int index)
+{
+    return stats_packet_type_string (index);
+}
+
+const char * __top_protocol_name (unsigned int index)
+{
+    const char * name = header_ip_protocol_string ((u_int8_t) index);
+    return name != NULL ? name : "?";
+}
+
+const char * __top_application_name (unsigned int index)
+{
+    return packet_application_string (index);
+}
+
+void __top_flow (const packet_flow * const flow, char * const buffer,
+        size_t size)
+{
+    char buffer_1[INET6_ADDRSTRLEN];
+    char buffer_2[INET6_ADDRSTRLEN];
+
+    packet_flow_address (flow, true, buffer_1);
+    packet_flow_address (flow, false, buffer_2);
+
+    if (flow->packet_type == ETHERTYPE_IP
+            || flow->packet_type == ETHERTYPE_IPV6)
+        snprintf (buffer, size, "%s:%u <-> %s:%u, %s", buffer_1,
+                flow->src_port, buffer_2, flow->dest_port,
+                __top_protocol_name (flow->protocol));
+    else if (flow->packet_type == ETHERTYPE_ARP)
+        snprintf (buffer, size, "%s <-> %s, ARP", buffer_1, buffer_2);
+    else
+        snprintf (buffer, size, "%s <-> %s, 0x%.4x", buffer_1, buffer_2,
+                flow->packet_type);
+}
+
+const char * __top_units (double value, char * const buffer, size_t size)
+{
+    static const char * const prefixes[] = { "", "k", "M", "G", "T", };
+
+    unsigned int i = 0;
+    while (value >= 1000 && i < sizeof prefixes / sizeof * prefixes - 1)
+    {
+        value /= 1000;
+        ++i;
+    }
+
+    if (i == 0)
+        snprintf (buffer, size, "%.0f", value);
+    else
+        snprintf (buffer, size, "%.1f%s", value, prefixes[i]);
+
+    return buffer;
+}
+
+void __top_emit (const char * const bytes, size_t length)
+{
+    if (length > TOP_OUTPUT - __output_length)
+        __top_flush ();
+
+    memcpy (__output + __output_length, bytes, length);
+    __output_length += length;
+}
+
+void __top_flush (void)
+{
+    size_t written = 0;
+    while (written < __output_length)
+    {
+        ssize_t count = write (__terminal, __output + written,
+                __output_length - written);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            break;
+        written += (size_t) count;
+    }
+    __output_length = 0;
+}
@@ -0,0 +1,436 @@
+/**
+ * \file trigger.c
+ * \brief Pre-trigger capture.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "wiredolphin/trigger.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define TRIGGER_CHUNK       (256 * 1024)    /**< Bytes written per packet. */
+#define TRIGGER_NAME_MAX    256             /**< File name length. */
+
+static const char * __filter = NULL;                    /**< Trigger filter. */
+static dhcp_message_type __dhcp = 0;                    /**< Trigger DHCP type. */
+static unsigned int __duration = 0;                     /**< Pre-trigger (s). */
+static unsigned int __size = TRIGGER_SIZE_DEFAULT;      /**< Arena (MiB). */
+static unsigned int __post = TRIGGER_POST_DEFAULT;      /**< Post-trigger (s). */
+static const char * __prefix = TRIGGER_PREFIX_DEFAULT;  /**< File prefix. */
+
+static pcap_t * __capture = NULL;           /**< Capture. */
+static struct bpf_program __program;        /**< Compiled trigger filter. */
+static u_char * __arena = NULL;             /**< Circular arena. */
+static size_t __arena_size = 0;             /**< Arena size. */
+static size_t __head = 0;                   /**< Oldest record. */
+static size_t __tail = 0;                   /**< Next record. */
+static size_t __used = 0;                   /**< Bytes in use. */
+static size_t __count = 0;                  /**< Records. */
+static size_t __pending = 0;                /**< Records to write (oldest). */
+static u_char * __scratch = NULL;           /**< Wrapped record copy. */
+static size_t __scratch_size = 0;           /**< Scratch size. */
+
+static pcap_dumper_t * __dumper = NULL;     /**< Current file. */
+static char __name[TRIGGER_NAME_MAX];       /**< Current file name. */
+static bool __collecting = false;           /**< Within the post-trigger time. */
+static time_t __deadline = 0;               /**< End of the post-trigger time. */
+static u_int64_t __written = 0;             /**< Packets written to the file. */
+
+/**
+ * \brief Copy bytes into the arena.
+ * \param offset Arena offset.
+ * \param bytes Bytes.
+ * \param length Number of bytes.
+ * \return Arena offset following the bytes.
+ */
+static inline size_t __trigger_store (size_t offset, const void * bytes,
+        size_t length);
+
+/**
+ * \brief Copy bytes out of the arena.
+ * \param offset Arena offset.
+ * \param bytes Destination.
+ * \param length Number of bytes.
+ * \return Arena offset following the bytes.
+ */
+static inline size_t __trigger_load (size_t offset, void * bytes,
+        size_t length);
+
+/**
+ * \brief Size of a record in the arena.
+ * \param caplen Captured length.
+ * \return Record size.
+ */
+static inline size_t __trigger_record_size (bpf_u_int32 caplen);
+
+/**
+ * \brief Append a packet to the arena, making room if needed.
+ * \param header pcap header.
+ * \param bytes Data.
+ * \retval true If the packet was appended.
+ * \retval false If it does not fit in the arena.
+ */
+static inline bool __trigger_push (const struct pcap_pkthdr * header,
+        const u_char * bytes);
+
+/**
+ * \brief Remove the oldest record, writing it to the file if it is pending.
+ * \return Record size.
+ */
+static inline size_t __trigger_pop (void);
+
+/**
+ * \brief Check whether a packet matches the trigger.
+ * \param info Decoded packet.
+ * \retval true If the packet matches.
+ * \retval false otherwise.
+ */
+static inline bool __trigger_match (const packet_info * info);
+
+/**
+ * \brief Open a new file.
+ * \param now Trigger time.
+ * \retval true On success.
+ * \retval false otherwise.
+ */
+static inline bool __trigger_start (const struct timeval * now);
+
+/**
+ * \brief Check that the files can be created.
+ * \retval true If the directory of the prefix is writable.
+ * \retval false otherwise.
+ */
+static inline bool __trigger_writable (void);
+
+/**
+ * \brief Close the current file.
+ */
+static inline void __trigger_finish (void);
+
+////////////////////////////////////////////////////////////////////////////////
+// Pre-trigger capture.
+////////////////////////////////////////////////////////////////////////////////
+
+void trigger_set_filter (const char * filter)
+{
+    __filter = filter;
+}
+
+bool trigger_set_dhcp (const char * type)
+{
+    for (dhcp_message_type t = DHCP_DISCOVER; t <= DHCP_RELEASE; ++t)
+    {
+        /* Accept the names with or without the DHCP_ prefix. */
+        const char * name = dhcp_message_type_string (t);
+        if (! strcasecmp (type, name) || ! strcasecmp (type, name + 5))
+        {
+            __dhcp = t;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void trigger_set_duration (unsigned int seconds)
+{
+    __duration = seconds;
+}
+
+void trigger_set_size (unsigned int megabytes)
+{
+    __size = megabytes > 0 ? megabytes : TRIGGER_SIZE_DEFAULT;
+}
+
+void trigger_set_post (unsigned int seconds)
+{
+    __post = seconds;
+}
+
+void trigger_set_prefix (const char * prefix)
+{
+    __prefix = prefix;
+}
+
+bool trigger_enabled (void)
+{
+    return __filter != NULL || __dhcp != 0;
+}
+
+bool trigger_open (pcap_t * const capture)
+{
+    if (! trigger_enabled ())
+        return true;
+
+    if (__filter != NULL && pcap_compile (capture, & __program, __filter, 1, 0))
+    {
+        fprintf (stderr, "Error: Invalid trigger filter: %s.\n",
+                pcap_geterr (capture));
+        return false;
+    }
+
+    /* Fail now rather than on a match, during the capture. */
+    if (! __trigger_writable ())
+    {
+        if (__filter != NULL)
+            pcap_freecode (& __program);
+        return false;
+    }
+
+    int snapshot = pcap_snapshot (capture);
+    __scratch_size = sizeof (struct pcap_pkthdr)
+        + (size_t) (snapshot > 0 ? snapshot : 65535);
+    __arena_size = (size_t) __size * 1024 * 1024;
+    __arena = malloc (__arena_size);
+    __scratch = malloc (__scratch_size);
+
+    if (__arena == NULL || __scratch == NULL)
+    {
+        fprintf (stderr, "Error: Could not allocate the trigger arena.\n");
+        if (__filter != NULL)
+            pcap_freecode (& __program);
+        free (__arena);
+        free (__scratch);
+        __arena = __scratch = NULL;
+        return false;
+    }
+
+    /* Fault the pages in now rather than during the capture. */
+    memset (__arena, 0, __arena_size);
+    __head = __tail = __used = __count = __pending = 0;
+    __capture = capture;
+
+    return true;
+}
+
+void trigger_packet (const packet_info * const info)
+{
+    if (__arena == NULL)
+        return;
+
+    const struct timeval * now = & info->header->ts;
+
+    if (__collecting && now->tv_sec >= __deadline)
+        __collecting = false;
+
+    /* Records older than the duration are dropped (unless pending). */
+    if (__duration > 0)
+        while (__count > __pending)
+        {
+            struct pcap_pkthdr header;
+            __trigger_load (__head, & header, sizeof header);
+            if (now->tv_sec - header.ts.tv_sec <= (time_t) __duration)
+                break;
+            __trigger_pop ();
+        }
+
+    if (__trigger_push (info->header, info->frame) && __collecting)
+        ++__pending;
+
+    if (__trigger_match (info))
+    {
+        /* Do not retry the open on every match. */
+        if (__dumper == NULL && ! __trigger_start (now))
+        {
+            fprintf (stderr, "Warning: Trigger disabled.\n");
+            trigger_close ();
+            return;
+        }
+
+        /* A match within the post-trigger time extends it. A match while the
+         * previous dump drains writes what was pushed since, too. */
+        if (__dumper != NULL)
+        {
+            __pending = __count;
+            __collecting = true;
+            __deadline = now->tv_sec + (time_t) __post;
+        }
+    }
+
+    if (__dumper == NULL)
+        return;
+
+    /* Write a chunk at a time, so as not to hold the capture. */
+    for (size_t written = 0; __pending > 0 && written < TRIGGER_CHUNK; )
+        written += __trigger_pop ();
+
+    if (__pending == 0 && ! __collecting)
+        __trigger_finish ();
+}
+
+void trigger_close (void)
+{
+    if (__arena == NULL)
+        return;
+
+    while (__pending > 0)
+        __trigger_pop ();
+    if (__dumper != NULL)
+        __trigger_finish ();
+
+    if (__filter != NULL)
+        pcap_freecode (& __program);
+    free (__arena);
+    free (__scratch);
+    __arena = __scratch = NULL;
+    __collecting = false;
+    __capture = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+size_t __trigger_store (size_t offset, const void * const bytes, size_t length)
+{
+    size_t first = __arena_size - offset < length ?
+        __arena_size - offset : length;
+
+    memcpy (__arena + offset, bytes, first);
+    memcpy (__arena, (const u_char *) bytes + first, length - first);
+
+    return (offset + length) % __arena_size;
+}
+
+size_t __trigger_load (size_t offset, void * const bytes, size_t length)
+{
+    size_t first = __arena_size - offset < length ?
+        __arena_size - offset : length;
+
+    memcpy (bytes, __arena + offset, first);
+    memcpy ((u_char *) bytes + first, __arena, length - first);
+
+    return (offset + length) % __arena_size;
+}
+
+size_t __trigger_record_size (bpf_u_int32 caplen)
+{
+    return (sizeof (struct pcap_pkthdr) + caplen + 7) & ~ (size_t) 7;
+}
+
+bool __trigger_push (const struct pcap_pkthdr * const header,
+        const u_char * const bytes)
+{
+    size_t size = __trigger_record_size (header->caplen);
+    if (size > __arena_size
+            || sizeof (struct pcap_pkthdr) + header->caplen > __scratch_size)
+        return false;
+
+    while (__arena_size - __used < size)
+        __trigger_pop ();
+
+    size_t offset = __trigger_store (__tail, header, sizeof (struct pcap_pkthdr));
+    __trigger_store (offset, bytes, header->caplen);
+    __tail = (__tail + size) % __arena_size;
+    __used += size;
+    ++__count;
+
+    return true;
+}
+
+size_t __trigger_pop (void)
+{
+    struct pcap_pkthdr header;
+    size_t offset = __trigger_load (__head, & header, sizeof header);
+    size_t size = __trigger_record_size (header.caplen);
+
+    if (__pending > 0)
+    {
+        /* Records are contiguous unless they wrap around. */
+        const u_char * bytes = __arena + offset;
+        if (offset + header.caplen > __arena_size)
+        {
+            __trigger_load (offset, __scratch, header.caplen);
+            bytes = __scratch;
+        }
+
+        if (__dumper != NULL)
+        {
+            pcap_dump ((u_char *) __dumper, & header, bytes);
+            ++__written;
+        }
+        --__pending;
+    }
+
+    __head = (__head + size) % __arena_size;
+    __used -= size;
+    --__count;
+
+    return size;
+}
+
+bool __trigger_match (const packet_info * const info)
+{
+    if (__filter != NULL
+            && pcap_offline_filter (& __program, info->header, info->frame))
+        return true;
+
+    return __dhcp != 0 && info->application == PACKET_APP_BOOTP
+        && info->data != NULL
+        && info->limit - info->data >= (long) sizeof (bootp_header)
+        && dhcp_message_type_get (info->data, info->limit) == __dhcp;
+}
+
+bool __trigger_start (const struct timeval * const now)
+{
+    char date[32];
+    time_t seconds = now->tv_sec;
+    struct tm local;
+
+    strftime (date, sizeof date, "%Y%m%d-%H%M%S",
+            localtime_r (& seconds, & local));
+    snprintf (__name, sizeof __name, "%s-%s.%06ld.pcap", __prefix, date,
+            (long) now->tv_usec);
+
+    __dumper = pcap_dump_open (__capture, __name);
+    if (__dumper == NULL)
+    {
+        fprintf (stderr, "Error: Could not open %s: %s.\n", __name,
+                pcap_geterr (__capture));
+        return false;
+    }
+
+    fprintf (stderr, "Trigger: writing %s\n", __name);
+    __written = 0;
+
+    return true;
+}
+
+bool __trigger_writable (void)
+{
+    char directory[TRIGGER_NAME_MAX];
+    snprintf (directory, sizeof directory, "%s", __prefix);
+
+    if (access (dirname (directory), W_OK))
+    {
+        fprintf (stderr, "Error: Cannot write the trigger files to %s: %s.\n",
+                directory, strerror (errno));
+        return false;
+    }
+
+    return true;
+}
+
+void __trigger_finish (void)
+{
+    pcap_dump_close (__dumper);
+    __dumper = NULL;
+    fprintf (stderr, "Trigger: %s: %" PRIu64 " packets\n", __name, __written);
+}
@@ -0,0 +1,160 @@
+/**
+ * \file view.c
+ * \brief Additional views of the capture.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "wiredolphin/view.h"
+#include "wiredolphin/sampling.h"
+#include "wiredolphin/json.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * \brief View.
+ */
+typedef struct __view
+{
+    callback_level level;               /**< Verbosity level. */
+    char * output;                      /**< Output file, "-" for stdout. */
+    char * filter;                      /**< Display filter (or NULL). */
+    FILE * stream;                      /**< Output. */
+    bool filtered;                      /**< program is set. */
+    struct bpf_program program;         /**< Compiled filter. */
+} __view;
+
+static __view __views[VIEW_MAX];        /**< Views. */
+static unsigned int __view_count = 0;   /**< Number of views. */
+
+////////////////////////////////////////////////////////////////////////////////
+// Views.
+////////////////////////////////////////////////////////////////////////////////
+
+bool view_add (const char * const description)
+{
+    char * end;
+    unsigned long level = strtoul (description, & end, 10);
+    if (end == description || * end != ':' || level >= CALLBACK_LEVEL_COUNT
+            || __view_count == VIEW_MAX)
+        return false;
+
+    /* The filter may contain colons (IPv6 addresses): it comes last. */
+    const char * output = end + 1;
+    const char * filter = strchr (output, ':');
+    size_t length = filter != NULL ? (size_t) (filter - output)
+        : strlen (output);
+    if (length == 0)
+        return false;
+
+    __view * view = & __views[__view_count];
+    view->level = (callback_level) level;
+    view->output = strndup (output, length);
+    view->filter = filter != NULL && filter[1] != '\0' ? strdup (filter + 1)
+        : NULL;
+    if (view->output == NULL
+            || (filter != NULL && filter[1] != '\0' && view->filter == NULL))
+    {
+        free (view->output);
+        free (view->filter);
+        view->output = view->filter = NULL;
+        return false;
+    }
+
+    ++__view_count;
+    return true;
+}
+
+bool view_stdout (void)
+{
+    for (unsigned int i = 0; i < __view_count; ++i)
+        if (! strcmp (__views[i].output, "-"))
+            return true;
+
+    return false;
+}
+
+bool view_open (pcap_t * const capture)
+{
+    for (unsigned int i = 0; i < __view_count; ++i)
+    {
+        __view * view = & __views[i];
+
+        view->stream = strcmp (view->output, "-") ? fopen (view->output, "w")
+            : stdout;
+        if (view->stream == NULL)
+        {
+            fprintf (stderr, "Error: Could not open %s: %s.\n", view->output,
+                    strerror (errno));
+            view_close ();
+            return false;
+        }
+
+        view->filtered = view->filter != NULL;
+        if (view->filtered && pcap_compile (capture, & view->program,
+                    view->filter, 1, 0))
+        {
+            fprintf (stderr, "Error: Invalid view filter \"%s\": %s.\n",
+                    view->filter, pcap_geterr (capture));
+            view->filtered = false;
+            view_close ();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void view_packet (const packet_info * const info)
+{
+    for (unsigned int i = 0; i < __view_count; ++i)
+    {
+        __view * view = & __views[i];
+
+        if (view->filtered && ! pcap_offline_filter (& view->program,
+                    info->header, info->frame))
+            continue;
+
+        if (json_enabled ())
+            json_packet (view->stream, info, sampling_level (view->level));
+        else
+            callback_handler (sampling_level (view->level)) (
+                    (u_char *) view->stream, info->header, info->frame);
+    }
+}
+
+void view_close (void)
+{
+    for (unsigned int i = 0; i < __view_count; ++i)
+    {
+        __view * view = & __views[i];
+
+        if (view->stream != NULL && view->stream != stdout)
+            fclose (view->stream);
+        else if (view->stream != NULL)
+            fflush (view->stream);
+        view->stream = NULL;
+
+        if (view->filtered)
+            pcap_freecode (& view->program);
+        view->filtered = false;
+
+        free (view->output);
+        free (view->filter);
+        view->output = view->filter = NULL;
+    }
+
+    __view_count = 0;
+}
@@ -0,0 +1,602 @@
+/**
+ * \file writer.c
+ * \brief pcap file writer.
+ * \author RAZANAJATO RANAIVOARIVONY Harenome
+ * \date 2015
+ * \copyright WTFPLv2
+ */
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details.
+ */
+
+/* O_DIRECT. */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "wiredolphin/writer.h"
+#include "wiredolphin/probes.h"
+
+extern char ** environ;
+
+////////////////////////////////////////////////////////////////////////////////
+// Static utilities.
+////////////////////////////////////////////////////////////////////////////////
+
+#define WRITER_BUFFER_SIZE  (1024 * 1024)   /**< Buffer size. */
+#define WRITER_BUFFERS      16              /**< Number of buffers. */
+#define WRITER_ALIGN        4096            /**< Buffer alignment. */
+#define WRITER_NAME_MAX     4096            /**< File name length. */
+#define WRITER_CHILDREN_MAX 8               /**< Running compressions. */
+
+/**
+ * \brief File counters.
+ */
+typedef struct __writer_stats
+{
+    u_int64_t packets;          /**< Packets written. */
+    u_int64_t bytes;            /**< Bytes written. */
+    u_int64_t dropped;          /**< Packets dropped (no buffer). */
+} __writer_stats;
+
+/**
+ * \brief Buffer.
+ */
+typedef struct __writer_buffer
+{
+    u_char * bytes;                 /**< Data. */
+    size_t length;                  /**< Data length. */
+    bool rotate;                    /**< Close the file, open name. */
+    char name[WRITER_NAME_MAX];     /**< File to open. */
+    __writer_stats closed;          /**< Counters of the closed file. */
+    struct __writer_buffer * next;  /**< Next buffer in its list. */
+} __writer_buffer;
+
+/* Settings. */
+static const char * __path = NULL;          /**< File path. */
+static size_t __rotate_size = 0;            /**< Maximum file size. */
+static time_t __rotate_time = 0;            /**< Maximum file duration. */
+static bool __compress = false;             /**< Compress rotated files. */
+static bool __direct = false;               /**< Use O_DIRECT. */
+
+/* Shared state, protected by __lock. */
+static pthread_mutex_t __lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t __queued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t __available = PTHREAD_COND_INITIALIZER;
+static __writer_buffer __buffers[WRITER_BUFFERS];   /**< Buffers. */
+static __writer_buffer * __free = NULL;             /**< Free buffers. */
+static __writer_buffer * __queue = NULL;            /**< Buffers to write. */
+static __writer_buffer * __queue_last = NULL;       /**< Last to write. */
+static unsigned int __queued_count = 0;             /**< Buffers to write. */
+static __writer_stats __final;                      /**< Last file counters. */
+static bool __quit = false;                         /**< Stop the thread. */
+
+/* Capture thread state. */
+static bool __running = false;              /**< Thread started. */
+static bool __live = false;                 /**< Drop rather than wait. */
+static pthread_t __worker;                 /**< Writer thread. */
+static struct pcap_file_header __header;    /**< File header. */
+static __writer_buffer * __current = NULL;  /**< Buffer being filled. */
+static __writer_stats __file;               /**< Current file counters. */
+static __writer_stats __closing;            /**< Previous file counters. */
+static time_t __file_start = 0;             /**< First packet time. */
+static unsigned int __file_number = 0;      /**< Next file number. */
+static u_int64_t __dropped = 0;             /**< Packets dropped (all files). */
+static bool __pending = false;              /**< File to open. */
+static char __pending_name[WRITER_NAME_MAX];    /**< File to open. */
+
+/* Writer thread state. */
+static int __fd = -1;                       /**< Current file. */
+static char __name[WRITER_NAME_MAX];        /**< Current file name. */
+static bool __fd_direct = false;            /**< O_DIRECT on __fd. */
+static double __write_time = 0;             /**< Time spent writing (s). */
+static u_int64_t __write_bytes = 0;         /**< Bytes written to __fd. */
+static pid_t __children[WRITER_CHILDREN_MAX];   /**< Compressions. */
+static unsigned int __children_count = 0;   /**< Running compressions. */
+
+/**
+ * \brief Switch to the next file: the current one is closed, the next one is
+ * opened with the next buffer.
+ */
+static inline void __writer_rotate (void);
+
+/**
+ * \brief Get a free buffer as current buffer.
+ * \param wait Whether to wait for a free buffer.
+ * \retval true On success.
+ * \retval false If every buffer is in use.
+ */
+static inline bool __writer_acquire (bool wait);
+
+/**
+ * \brief Make sure bytes can be appended without dropping them halfway.
+ * \param length Number of bytes.
+ * \retval true If the bytes fit.
+ * \retval false otherwise.
+ */
+static inline bool __writer_reserve (size_t length);
+
+/**
+ * \brief Append bytes to the current buffer, submitting full buffers.
+ * \param bytes Bytes.
+ * \param length Number of bytes.
+ */
+static inline void __writer_append (const void * bytes, size_t length);
+
+/**
+ * \brief Hand the current buffer over to the writer thread.
+ */
+static inline void __writer_submit (void);
+
+/**
+ * \brief Writer thread.
+ * \param user Unused.
+ * \return NULL.
+ */
+static void * __writer_run (void * user);
+
+/**
+ * \brief Open a file (writer thread).
+ * \param name File name.
+ */
+static inline void __writer_file_open (const char * name);
+
+/**
+ * \brief Close the current file and report its counters (writer thread).
+ * \param stats Counters.
+ */
+static inline void __writer_file_close (const __writer_stats * stats);
+
+/**
+ * \brief Write bytes to the current file (writer thread).
+ * \param bytes Bytes.
+ * \param length Number of bytes.
+ */
+static inline void __writer_write (const u_char * bytes, size_t length);
+
+/**
+ * \brief Compress a file in a child process (writer thread).
+ * \param name File name.
+ */
+static inline void __writer_compress (char * name);
+
+////////////////////////////////////////////////////////////////////////////////
+// pcap file writer.
+////////////////////////////////////////////////////////////////////////////////
+
+void writer_set_path (const char * path)
+{
+    __path = path;
+}
+
+void writer_set_size (unsigned int megabytes)
+{
+    __rotate_size = (size_t) megabytes * 1024 * 1024;
+}
+
+void writer_set_time (unsigned int seconds)
+{
+    __rotate_time = (time_t) seconds;
+}
+
+void writer_set_compress (bool compress)
+{
+    __compress = compress;
+}
+
+void writer_set_direct (bool direct)
+{
+    __direct = direct;
+}
+
+bool writer_enabled (void)
+{
+    return __path != NULL;
+}
+
+bool writer_open (pcap_t * const capture, bool live)
+{
+    if (! writer_enabled ())
+        return true;
+
+    __free = __queue = __queue_last = NULL;
+    __queued_count = 0;
+    for (unsigned int i = 0; i < WRITER_BUFFERS; ++i)
+    {
+        void * bytes;
+        if (posix_memalign (& bytes, WRITER_ALIGN, WRITER_BUFFER_SIZE))
+        {
+            fprintf (stderr, "Error: Could not allocate the write buffers.\n");
+            for (unsigned int j = 0; j < i; ++j)
+                free (__buffers[j].bytes);
+            return false;
+        }
+        __buffers[i].bytes = bytes;
+        __buffers[i].next = __free;
+        __free = & __buffers[i];
+    }
+
+    pcapfile_header (capture, & __header);
+    memset (& __file, 0, sizeof __file);
+    __file_number = 0;
+    __dropped = 0;
+    __current = NULL;
+    __quit = false;
+    __live = live;
+    __writer_rotate ();
+
+    /* Signals are for the capture thread. */
+    sigset_t all, previous;
+    sigfillset (& all);
+    pthread_sigmask (SIG_SETMASK, & all, & previous);
+    __running = ! pthread_create (& __worker, NULL, __writer_run, NULL);
+    pthread_sigmask (SIG_SETMASK, & previous, NULL);
+
+    if (! __running)
+    {
+        fprintf (stderr, "Error: Could not start the writer thread.\n");
+        for (unsigned int i = 0; i < WRITER_BUFFERS; ++i)
+            free (__buffers[i].bytes);
+    }
+
+    return __running;
+}
+
+void writer_packet (const struct pcap_pkthdr * const header,
+        const u_char * const bytes)
+{
+    if (! __running)
+        return;
+
+    size_t length = sizeof (pcapfile_record) + header->caplen;
+    time_t now = header->ts.tv_sec;
+
+    if (__file.packets > 0
+            && ((__rotate_size && __file.bytes + length > __rotate_size)
+                || (__rotate_time && now - __file_start >= __rotate_time)))
+        __writer_rotate ();
+
+    if (! __writer_reserve (length))
+    {
+        ++__file.dropped;
+        ++__dropped;
+        PROBE1 (packet__drop, "writer");
+        return;
+    }
+
+    if (__file.packets == 0)
+        __file_start = now;
+
+    pcapfile_record record;
+    pcapfile_record_header (header, & record);
+    __writer_append (& record, sizeof record);
+    __writer_append (bytes, header->caplen);
+
+    ++__file.packets;
+    __file.bytes += length;
+}
+
+unsigned int writer_queued (void)
+{
+    pthread_mutex_lock (& __lock);
+    unsigned int queued = __queued_count;
+    pthread_mutex_unlock (& __lock);
+
+    return queued;
+}
+
+u_int64_t writer_dropped (void)
+{
+    return __dropped;
+}
+
+void writer_close (void)
+{
+    if (! __running)
+        return;
+
+    /* Even an empty capture gets its file. */
+    if (__pending)
+        __writer_acquire (true);
+    if (__current != NULL)
+        __writer_submit ();
+
+    pthread_mutex_lock (& __lock);
+    __final = __file;
+    __quit = true;
+    pthread_cond_signal (& __queued);
+    pthread_mutex_unlock (& __lock);
+
+    pthread_join (__worker, NULL);
+    __running = false;
+
+    for (unsigned int i = 0; i < WRITER_BUFFERS; ++i)
+        free (__buffers[i].bytes);
+
+    for (unsigned int i = 0; i < __children_count; ++i)
+        waitpid (__children[i], NULL, 0);
+    __children_count = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc.
+////////////////////////////////////////////////////////////////////////////////
+
+void __writer_rotate (void)
+{
+    if (__current != NULL)
+        __writer_submit ();
+
+    if (__rotate_size || __rotate_time)
+        snprintf (__pending_name, sizeof __pending_name, "%s.%u", __path,
+                __file_number++);
+    else
+        snprintf (__pending_name, sizeof __pending_name, "%s", __path);
+
+    __closing = __file;
+    memset (& __file, 0, sizeof __file);
+    __file.bytes = sizeof __header;
+    __pending = true;
+}
+
+bool __writer_acquire (bool wait)
+{
+    pthread_mutex_lock (& __lock);
+    while (wait && __free == NULL)
+        pthread_cond_wait (& __available, & __lock);
+    __current = __free;
+    if (__current != NULL)
+        __free = __current->next;
+    pthread_mutex_unlock (& __lock);
+
+    if (__current == NULL)
+        return false;
+
+    __current->length = 0;
+    __current->rotate = __pending;
+    if (__pending)
+    {
+        /* The file starts with this buffer. */
+        memcpy (__current->name, __pending_name, sizeof __pending_name);
+        __current->closed = __closing;
+        memcpy (__current->bytes, & __header, sizeof __header);
+        __current->length = sizeof __header;
+        __pending = false;
+    }
+
+    return true;
+}
+
+bool __writer_reserve (size_t length)
+{
+    if (__current == NULL && ! __writer_acquire (! __live))
+        return false;
+
+    if (length <= WRITER_BUFFER_SIZE - __current->length)
+        return true;
+
+    /* A packet is at most 64 KiB: one more buffer is enough. */
+    pthread_mutex_lock (& __lock);
+    while (! __live && __free == NULL)
+        pthread_cond_wait (& __available, & __lock);
+    bool available = __free != NULL;
+    pthread_mutex_unlock (& __lock);
+
+    return available;
+}
+
+void __writer_append (const void * bytes, size_t length)
+{
+    const u_char * source = bytes;
+
+    while (length > 0)
+    {
+        if (__current == NULL)
+            __writer_acquire (false);
+
+        size_t space = WRITER_BUFFER_SIZE - __current->length;
+        size_t chunk = length < space ? length : space;
+        memcpy (__current->bytes + __current->length, source, chunk);
+        __current->length += chunk;
+        source += chunk;
+        length -= chunk;
+
+        if (__current->length == WRITER_BUFFER_SIZE)
+            __writer_submit ();
+    }
+}
+
+void __writer_submit (void)
+{
+    __current->next = NULL;
+
+    pthread_mutex_lock (& __lock);
+    if (__queue_last != NULL)
+        __queue_last->next = __current;
+    else
+        __queue = __current;
+    __queue_last = __current;
+    ++__queued_count;
+    pthread_cond_signal (& __queued);
+    pthread_mutex_unlock (& __lock);
+
+    __current = NULL;
+}
+
+void * __writer_run (void * user)
+{
+    (void) user;
+
+    for (;;)
+    {
+        pthread_mutex_lock (& __lock);
+        while (__queue == NULL && ! __quit)
+            pthread_cond_wait (& __queued, & __lock);
+        __writer_buffer * buffer = __queue;
+        if (buffer != NULL)
+        {
+            __queue = buffer->next;
+            if (__queue == NULL)
+                __queue_last = NULL;
+            --__queued_count;
+        }
+        pthread_mutex_unlock (& __lock);
+
+        if (buffer == NULL)
+            break;
+
+        if (buffer->rotate)
+        {
+            __writer_file_close (& buffer->closed);
+            __writer_file_open (buffer->name);
+        }
+        __writer_write (buffer->bytes, buffer->length);
+        PROBE1 (writer__flush, buffer->length);
+
+        pthread_mutex_lock (& __lock);
+        buffer->next = __free;
+        __free = buffer;
+        pthread_cond_signal (& __available);
+        pthread_mutex_unlock (& __lock);
+    }
+
+    __writer_file_close (& __final);
+
+    return NULL;
+}
+
+void __writer_file_open (const char * const name)
+{
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+    snprintf (__name, sizeof __name, "%s", name);
+    __fd_direct = __direct;
+    __fd = open (__name, flags | (__direct ? O_DIRECT : 0), 0644);
+    if (__fd < 0 && __direct && errno == EINVAL)
+    {
+        /* The file system does not support O_DIRECT. */
+        __fd_direct = false;
+        __fd = open (__name, flags, 0644);
+    }
+
+    if (__fd < 0)
+        fprintf (stderr, "Error: Could not open %s: %s.\n", __name,
+                strerror (errno));
+
+    __write_time = 0;
+    __write_bytes = 0;
+}
+
+void __writer_file_close (const __writer_stats * const stats)
+{
+    if (__fd < 0)
+        return;
+
+    close (__fd);
+    __fd = -1;
+
+    double throughput = __write_time > 0 ?
+        (double) __write_bytes / __write_time / (1024 * 1024) : 0;
+    fprintf (stderr, "Writer: %s: %" PRIu64 " packets, %" PRIu64 " bytes, "
+            "%" PRIu64 " dropped, %.1f MiB/s\n", __name, stats->packets,
+            stats->bytes, stats->dropped, throughput);
+
+    if (__compress && (__rotate_size || __rotate_time))
+        __writer_compress (__name);
+}
+
+void __writer_write (const u_char * bytes, size_t length)
+{
+    if (__fd < 0)
+        return;
+
+    struct timespec start, end;
+    clock_gettime (CLOCK_MONOTONIC, & start);
+
+    while (length > 0)
+    {
+        size_t chunk = length;
+        if (__fd_direct && length % WRITER_ALIGN)
+        {
+            /* Only the last buffer of a file is partial: write its aligned
+             * part directly, the rest through the page cache. */
+            chunk = length - length % WRITER_ALIGN;
+            if (chunk == 0)
+            {
+                fcntl (__fd, F_SETFL, fcntl (__fd, F_GETFL) & ~O_DIRECT);
+                __fd_direct = false;
+                continue;
+            }
+        }
+
+        ssize_t written = write (__fd, bytes, chunk);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            fprintf (stderr, "Error: Could not write %s: %s.\n", __name,
+                    strerror (errno));
+            break;
+        }
+
+        bytes += written;
+        length -= (size_t) written;
+        __write_bytes += (u_int64_t) written;
+    }
+
+    clock_gettime (CLOCK_MONOTONIC, & end);
+    __write_time += (double) (end.tv_sec - start.tv_sec)
+        + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+void __writer_compress (char * const name)
+{
+    /* Reap the finished compressions, wait for the oldest if need be. */
+    for (unsigned int i = 0; i < __children_count; )
+        if (waitpid (__children[i], NULL, WNOHANG) != 0)
+            __children[i] = __children[--__children_count];
+        else
+            ++i;
+
+    if (__children_count == WRITER_CHILDREN_MAX)
+    {
+        waitpid (__children[0], NULL, 0);
+        __children[0] = __children[--__children_count];
+    }
+
+    /* This thread blocks every signal: the child must not inherit that. */
+    sigset_t mask, defaults;
+    sigemptyset (& mask);
+    sigemptyset (& defaults);
+    sigaddset (& defaults, SIGINT);
+    sigaddset (& defaults, SIGTERM);
+    sigaddset (& defaults, SIGHUP);
+    sigaddset (& defaults, SIGPIPE);
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init (& attributes);
+    posix_spawnattr_setsigmask (& attributes, & mask);
+    posix_spawnattr_setsigdefault (& attributes, & defaults);
+    posix_spawnattr_setflags (& attributes,
+            POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    char * arguments[] = { "gzip", "-f", name, NULL };
+    pid_t child;
+    if (posix_spawnp (& child, "gzip", NULL, & attributes, arguments,
+                environ) == 0)
+        __children[__children_count++] = child;
+    else
+        fprintf (stderr, "Error: Could not compress %s.\n", name);
+    posix_spawnattr_destroy (& attributes);
+}